@@ -13,6 +13,7 @@
 #include <Geometry.hh>
 #include <MaterialProperty.hh>
 #include <MechanicalPhysics.hh>
+#include <MemberLoadBalancer.hh>
 #include <PointCloud.hh>
 #include <PostProcessor.hh>
 #include <RayTracing.hh>
@@ -25,11 +26,13 @@
 #include <types.hh>
 #include <utils.hh>
 
+#include <deal.II/arborx/bvh.h>
 #include <deal.II/base/index_set.h>
 #include <deal.II/base/mpi.h>
 #include <deal.II/base/symmetric_tensor.h>
 #include <deal.II/base/types.h>
 #include <deal.II/distributed/cell_data_transfer.templates.h>
+#include <deal.II/distributed/grid_refinement.h>
 #include <deal.II/distributed/solution_transfer.h>
 #include <deal.II/grid/filtered_iterator.h>
 #include <deal.II/grid/grid_refinement.h>
@@ -41,10 +44,17 @@
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <limits>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
@@ -213,6 +223,25 @@ inline void initialize_timers(MPI_Comm const &communicator,
   timers.push_back(adamantine::Timer(communicator, "Output"));
 }
 
+/**
+ * Store the scan paths of the heat sources once per compute node and return the
+ * number of bytes saved by the current processor.
+ */
+template <int dim>
+std::size_t share_scan_paths_on_node(
+    MPI_Comm const &communicator,
+    std::vector<std::shared_ptr<adamantine::HeatSource<dim>>> &heat_sources)
+{
+  std::size_t memory_saved = 0;
+  for (auto &source : heat_sources)
+  {
+    source->get_scan_path().share_on_node(communicator);
+    memory_saved += source->get_scan_path().memory_saved();
+  }
+
+  return memory_saved;
+}
+
 template <int dim, int p_order, int fe_degree, typename MaterialStates,
           typename MemorySpaceType, typename QuadratureType>
 std::unique_ptr<adamantine::ThermalPhysicsInterface<dim, MemorySpaceType>>
@@ -299,221 +328,6 @@ initialize_thermal_physics(
   }
 }
 
-template <int dim, int p_order, typename MaterialStates,
-          typename MemorySpaceType>
-void refine_and_transfer(
-    std::unique_ptr<adamantine::ThermalPhysicsInterface<dim, MemorySpaceType>>
-        &thermal_physics,
-    adamantine::MaterialProperty<dim, p_order, MaterialStates, MemorySpaceType>
-        &material_properties,
-    dealii::DoFHandler<dim> &dof_handler,
-    dealii::LA::distributed::Vector<double, MemorySpaceType> &solution)
-{
-#ifdef ADAMANTINE_WITH_CALIPER
-  CALI_CXX_MARK_FUNCTION;
-#endif
-
-  // TODO transfer mechanical data is present, need to be aware that the data
-  // does not exist on some cells because it's liquid
-
-  dealii::parallel::distributed::Triangulation<dim> &triangulation =
-      dynamic_cast<dealii::parallel::distributed::Triangulation<dim> &>(
-          const_cast<dealii::Triangulation<dim> &>(
-              dof_handler.get_triangulation()));
-
-  // Update the material state from the ThermalOperator to MaterialProperty
-  // because, for now, we need to use state from MaterialProperty to perform the
-  // transfer to the refined mesh.
-  thermal_physics->set_state_to_material_properties();
-
-  // Transfer of the solution
-  dealii::parallel::distributed::SolutionTransfer<
-      dim, dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host>>
-      solution_transfer(dof_handler);
-
-  // Transfer material state
-  unsigned int const direction_data_size = 2;
-  unsigned int const phase_history_data_size = 1;
-  unsigned int constexpr n_material_states = MaterialStates::n_material_states;
-  std::vector<std::vector<double>> data_to_transfer;
-  std::vector<double> dummy_cell_data(n_material_states + direction_data_size +
-                                          phase_history_data_size,
-                                      std::numeric_limits<double>::infinity());
-  auto state_host = Kokkos::create_mirror_view_and_copy(
-      Kokkos::HostSpace{}, material_properties.get_state());
-  unsigned int cell_id = 0;
-  unsigned int activated_cell_id = 0;
-  for (auto const &cell : dof_handler.active_cell_iterators())
-  {
-    if (cell->is_locally_owned())
-    {
-      std::vector<double> cell_data(n_material_states + direction_data_size +
-                                    phase_history_data_size);
-      for (unsigned int i = 0; i < n_material_states; ++i)
-        cell_data[i] = state_host(i, cell_id);
-      if (cell->active_fe_index() == 0)
-      {
-        cell_data[n_material_states] =
-            thermal_physics->get_deposition_cos(activated_cell_id);
-        cell_data[n_material_states + 1] =
-            thermal_physics->get_deposition_sin(activated_cell_id);
-
-        if (thermal_physics->get_has_melted(activated_cell_id))
-          cell_data[n_material_states + direction_data_size] = 1.0;
-        else
-          cell_data[n_material_states + direction_data_size] = 0.0;
-
-        ++activated_cell_id;
-      }
-      else
-      {
-        cell_data[n_material_states] = std::numeric_limits<double>::infinity();
-        cell_data[n_material_states + 1] =
-            std::numeric_limits<double>::infinity();
-        cell_data[n_material_states + direction_data_size] =
-            std::numeric_limits<double>::infinity();
-      }
-      data_to_transfer.push_back(cell_data);
-      ++cell_id;
-    }
-    else
-    {
-      data_to_transfer.push_back(dummy_cell_data);
-    }
-  }
-
-  // Prepare the Triangulation and the diffent data transfer objects for
-  // refinement
-  triangulation.prepare_coarsening_and_refinement();
-  // Prepare for refinement of the solution
-  dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host>
-      solution_host;
-  if constexpr (std::is_same_v<MemorySpaceType, dealii::MemorySpace::Host>)
-  {
-    // We need to apply the constraints before the mesh transfer
-    thermal_physics->get_affine_constraints().distribute(solution);
-    // We need to update the ghost values before we can do the interpolation on
-    // the new mesh.
-    solution.update_ghost_values();
-    solution_transfer.prepare_for_coarsening_and_refinement(solution);
-  }
-  else
-  {
-    solution_host.reinit(solution.get_partitioner());
-    solution_host.import(solution, dealii::VectorOperation::insert);
-    // We need to apply the constraints before the mesh transfer
-    thermal_physics->get_affine_constraints().distribute(solution_host);
-    // We need to update the ghost values before we can do the interpolation on
-    // the new mesh.
-    solution_host.update_ghost_values();
-    solution_transfer.prepare_for_coarsening_and_refinement(solution_host);
-  }
-
-  dealii::parallel::distributed::CellDataTransfer<
-      dim, dim, std::vector<std::vector<double>>>
-      cell_data_trans(triangulation);
-  cell_data_trans.prepare_for_coarsening_and_refinement(data_to_transfer);
-
-#ifdef ADAMANTINE_WITH_CALIPER
-  CALI_MARK_BEGIN("refine triangulation");
-#endif
-  // Execute the refinement
-  triangulation.execute_coarsening_and_refinement();
-#ifdef ADAMANTINE_WITH_CALIPER
-  CALI_MARK_END("refine triangulation");
-#endif
-
-  // Update the AffineConstraints and resize the solution
-  thermal_physics->setup_dofs();
-  thermal_physics->initialize_dof_vector(0., solution);
-
-  // Update MaterialProperty DoFHandler and resize the state vectors
-  material_properties.reinit_dofs();
-
-  // Interpolate the solution
-  if constexpr (std::is_same_v<MemorySpaceType, dealii::MemorySpace::Host>)
-  {
-    solution_transfer.interpolate(solution);
-  }
-  else
-  {
-    solution_host.reinit(solution.get_partitioner());
-    solution_transfer.interpolate(solution_host);
-    solution.import(solution_host, dealii::VectorOperation::insert);
-  }
-
-  // Unpack the material state and repopulate the material state
-  std::vector<std::vector<double>> transferred_data(
-      triangulation.n_active_cells(),
-      std::vector<double>(n_material_states + direction_data_size +
-                          phase_history_data_size));
-  cell_data_trans.unpack(transferred_data);
-  auto state = material_properties.get_state();
-  state_host = Kokkos::create_mirror_view(state);
-  unsigned int total_cell_id = 0;
-  cell_id = 0;
-  std::vector<double> transferred_cos;
-  std::vector<double> transferred_sin;
-  std::vector<bool> has_melted;
-  for (auto const &cell : dof_handler.active_cell_iterators())
-  {
-    if (cell->is_locally_owned())
-    {
-      for (unsigned int i = 0; i < n_material_states; ++i)
-      {
-        state_host(i, cell_id) = transferred_data[total_cell_id][i];
-      }
-      if (cell->active_fe_index() == 0)
-      {
-        transferred_cos.push_back(
-            transferred_data[total_cell_id][n_material_states]);
-        transferred_sin.push_back(
-            transferred_data[total_cell_id][n_material_states + 1]);
-
-        // Convert from double back to bool
-        if (transferred_data[total_cell_id]
-                            [n_material_states + direction_data_size] > 0.5)
-          has_melted.push_back(true);
-        else
-          has_melted.push_back(false);
-      }
-      ++cell_id;
-    }
-    ++total_cell_id;
-  }
-
-  // Update the deposition cos and sin
-  thermal_physics->set_material_deposition_orientation(transferred_cos,
-                                                       transferred_sin);
-
-  // Update the melted indicator
-  thermal_physics->set_has_melted_vector(has_melted);
-
-  // Copy the data back to material_property
-  Kokkos::deep_copy(state, state_host);
-
-  // Update the material states in the ThermalOperator
-  thermal_physics->get_state_from_material_properties();
-
-#if ADAMANTINE_DEBUG
-  // Check that we are not losing material
-  cell_id = 0;
-  for (auto const &cell : dof_handler.active_cell_iterators())
-  {
-    if (cell->is_locally_owned())
-    {
-      double material_ratio = 0.;
-      for (unsigned int i = 0; i < n_material_states; ++i)
-      {
-        material_ratio += state_host(i, cell_id);
-      }
-      ASSERT(std::abs(material_ratio - 1.) < 1e-14, "Material is lost.");
-      ++cell_id;
-    }
-  }
-#endif
-}
-
 template <int dim>
 std::vector<typename dealii::parallel::distributed::Triangulation<
     dim>::active_cell_iterator>
@@ -533,30 +347,86 @@ compute_cells_to_refine(
   std::vector<typename dealii::parallel::distributed::Triangulation<
       dim>::active_cell_iterator>
       cells_to_refine;
+
+  // Instead of checking every cell at every time, we gather the boxes where
+  // each beam is greater than the cut-off along its trajectory and we use
+  // ArborX to find the cells that intersect these boxes. Only these cells are
+  // checked.
+  auto const sub_time = [&](unsigned int const i)
+  {
+    return time + static_cast<double>(i) / static_cast<double>(n_time_steps) *
+                      (next_refinement_time - time);
+  };
+  std::vector<dealii::BoundingBox<dim>> beam_boxes;
+  std::vector<std::pair<unsigned int, unsigned int>> beam_box_ids;
   for (unsigned int i = 0; i < n_time_steps; ++i)
   {
-    double const current_time = time + static_cast<double>(i) /
-                                           static_cast<double>(n_time_steps) *
-                                           (next_refinement_time - time);
-    for (auto &beam : heat_sources)
+    for (unsigned int b = 0; b < heat_sources.size(); ++b)
     {
-      beam->update_time(current_time);
-      for (auto cell : dealii::filter_iterators(
-               triangulation.active_cell_iterators(),
-               dealii::IteratorFilters::LocallyOwnedCell()))
+      heat_sources[b]->update_time(sub_time(i));
+      auto const box = heat_sources[b]->get_bounding_box(
+          current_source_height, refinement_beam_cutoff);
+      if (box)
       {
-        // Check the value at the center of the cell faces. For most cases this
-        // should be sufficient, but if the beam is small compared to the
-        // coarsest mesh we may need to add other points to check (e.g.
-        // quadrature points, vertices).
-        for (unsigned int f = 0; f < cell->reference_cell().n_faces(); ++f)
+        beam_boxes.push_back(*box);
+        beam_box_ids.emplace_back(i, b);
+      }
+    }
+  }
+
+  // Exit early if we can
+  if (beam_boxes.size() == 0)
+    return cells_to_refine;
+
+  std::vector<dealii::BoundingBox<dim>> cell_boxes;
+  std::vector<typename dealii::parallel::distributed::Triangulation<
+      dim>::active_cell_iterator>
+      cell_iterators;
+  for (auto cell :
+       dealii::filter_iterators(triangulation.active_cell_iterators(),
+                                dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    cell_boxes.push_back(cell->bounding_box());
+    cell_iterators.push_back(cell);
+  }
+
+  // Exit early if we can
+  if (cell_boxes.size() == 0)
+    return cells_to_refine;
+
+  // Perform the search
+  dealii::ArborXWrappers::BVH bvh(cell_boxes);
+  dealii::ArborXWrappers::BoundingBoxIntersectPredicate bb_intersect(
+      beam_boxes);
+  auto [indices, offset] = bvh.query(bb_intersect);
+
+  // The boxes are sorted by time. Check the candidate cells at each time.
+  unsigned int current_time_step = n_time_steps;
+  for (unsigned int q = 0; q < beam_boxes.size(); ++q)
+  {
+    auto const [time_step, beam_id] = beam_box_ids[q];
+    if (time_step != current_time_step)
+    {
+      current_time_step = time_step;
+      for (auto &beam : heat_sources)
+        beam->update_time(sub_time(time_step));
+    }
+
+    for (int j = offset[q]; j < offset[q + 1]; ++j)
+    {
+      auto const &cell = cell_iterators[indices[j]];
+      // Check the value at the center of the cell faces. For most cases this
+      // should be sufficient, but if the beam is small compared to the
+      // coarsest mesh we may need to add other points to check (e.g.
+      // quadrature points, vertices).
+      for (unsigned int f = 0; f < cell->reference_cell().n_faces(); ++f)
+      {
+        if (heat_sources[beam_id]->value(cell->face(f)->center(),
+                                         current_source_height) >
+            refinement_beam_cutoff)
         {
-          if (beam->value(cell->face(f)->center(), current_source_height) >
-              refinement_beam_cutoff)
-          {
-            cells_to_refine.push_back(cell);
-            break;
-          }
+          cells_to_refine.push_back(cell);
+          break;
         }
       }
     }
@@ -565,18 +435,39 @@ compute_cells_to_refine(
   return cells_to_refine;
 }
 
+template <int dim>
+double compute_look_ahead_time(
+    std::vector<std::shared_ptr<adamantine::HeatSource<dim>>> const
+        &heat_sources,
+    double const time, double const lead_distance)
+{
+  // The refined envelope ends when the first beam has traveled lead_distance.
+  // If no beam moves anymore, the envelope never ends.
+  double look_ahead_time = std::numeric_limits<double>::max();
+  for (auto const &beam : heat_sources)
+  {
+    double const travel_end_time =
+        beam->get_scan_path().get_travel_end_time(time, lead_distance);
+    if (travel_end_time > time)
+      look_ahead_time = std::min(look_ahead_time, travel_end_time);
+  }
+
+  return look_ahead_time;
+}
+
 template <int dim, int p_order, int fe_degree, typename MaterialStates,
           typename MemorySpaceType>
 void refine_mesh(
     std::unique_ptr<adamantine::ThermalPhysicsInterface<dim, MemorySpaceType>>
         &thermal_physics,
-    adamantine::MaterialProperty<dim, p_order, MaterialStates, MemorySpaceType>
-        &material_properties,
-    dealii::LA::distributed::Vector<double, MemorySpaceType> &solution,
+    std::vector<
+        dealii::LA::distributed::Vector<double, MemorySpaceType> *> const
+        &solutions,
     std::vector<std::shared_ptr<adamantine::HeatSource<dim>>> &heat_sources,
     double const time, double const next_refinement_time,
     unsigned int const time_steps_refinement,
-    boost::property_tree::ptree const &refinement_database)
+    boost::property_tree::ptree const &refinement_database,
+    unsigned int const base_level)
 {
 #ifdef ADAMANTINE_WITH_CALIPER
   CALI_CXX_MARK_FUNCTION;
@@ -610,6 +501,59 @@ void refine_mesh(
   const double refinement_beam_cutoff =
       refinement_database.get<double>("beam_cutoff", 1.0e-15);
 
+  // PropertyTreeInput refinement.trailing_distance
+  double const trailing_distance =
+      refinement_database.get("trailing_distance", 0.);
+
+  // The cells closer than trailing_distance to the current position of the
+  // beams are not coarsened. This avoids refining and coarsening the same
+  // cells over and over.
+  std::vector<dealii::BoundingBox<dim>> trailing_boxes;
+  if (trailing_distance > 0.)
+  {
+    for (auto &beam : heat_sources)
+    {
+      beam->update_time(time);
+      auto box = beam->get_bounding_box(current_source_height,
+                                        refinement_beam_cutoff);
+      if (box)
+      {
+        box->extend(trailing_distance);
+        trailing_boxes.push_back(*box);
+      }
+    }
+  }
+
+  // PropertyTreeInput refinement.error_estimator
+  bool const error_estimator = refinement_database.get("error_estimator", false);
+  // PropertyTreeInput refinement.refine_fraction
+  double const refine_fraction =
+      refinement_database.get("refine_fraction", 0.1);
+  // PropertyTreeInput refinement.coarsen_fraction
+  double const coarsen_fraction =
+      refinement_database.get("coarsen_fraction", 0.3);
+
+  // The error indicators are computed on the current mesh, i.e., they can
+  // only be used by the first pass. If several ensemble members share the
+  // mesh, the largest indicator of each cell is used.
+  dealii::Vector<float> error_indicators;
+  if (error_estimator)
+  {
+    dealii::Vector<float> member_indicators;
+    for (auto const solution : solutions)
+    {
+      thermal_physics->compute_error_indicators(*solution, member_indicators);
+      if (error_indicators.size() == 0)
+        error_indicators.swap(member_indicators);
+      else
+      {
+        for (unsigned int i = 0; i < error_indicators.size(); ++i)
+          error_indicators[i] =
+              std::max(error_indicators[i], member_indicators[i]);
+      }
+    }
+  }
+
   for (unsigned int i = 0; i < n_refinements; ++i)
   {
     // Compute the cells to be refined.
@@ -623,35 +567,65 @@ void refine_mesh(
     const bool coarsen_after_beam =
         refinement_database.get<bool>("coarsen_after_beam", false);
 
-    // If coarsening is allowed, set the coarsening flag everywhere
-    if (coarsen_after_beam)
+    // Refine where the thermal gradients are steep and coarsen where the
+    // temperature is smooth, e.g., in the regions that have cooled down. The
+    // error estimator replaces the coarsening after the beam.
+    if (error_estimator && (i == 0))
+    {
+      dealii::parallel::distributed::GridRefinement::
+          refine_and_coarsen_fixed_number(triangulation, error_indicators,
+                                          refine_fraction, coarsen_fraction);
+      for (auto cell : dealii::filter_iterators(
+               triangulation.active_cell_iterators(),
+               dealii::IteratorFilters::LocallyOwnedCell()))
+      {
+        if (cell->level() >= static_cast<int>(base_level + n_refinements))
+          cell->clear_refine_flag();
+        if (cell->level() <= static_cast<int>(base_level))
+          cell->clear_coarsen_flag();
+      }
+    }
+
+    // If coarsening is allowed, set the coarsening flag everywhere behind the
+    // trailing distance
+    if (coarsen_after_beam && !error_estimator)
     {
       for (auto cell : dealii::filter_iterators(
                triangulation.active_cell_iterators(),
                dealii::IteratorFilters::LocallyOwnedCell()))
       {
-        if (cell->level() > 0)
-          cell->set_coarsen_flag();
+        if (cell->level() > static_cast<int>(base_level))
+        {
+          auto const cell_box = cell->bounding_box();
+          bool const trailing = std::any_of(
+              trailing_boxes.begin(), trailing_boxes.end(),
+              [&](dealii::BoundingBox<dim> const &box)
+              {
+                return box.get_neighbor_type(cell_box) !=
+                       dealii::NeighborType::not_neighbors;
+              });
+          if (!trailing)
+            cell->set_coarsen_flag();
+        }
       }
     }
 
     // Flag the cells for refinement.
     for (auto &cell : cells_to_refine)
     {
-      if (coarsen_after_beam)
-        cell->clear_coarsen_flag();
+      cell->clear_coarsen_flag();
 
-      if (cell->level() < static_cast<int>(n_refinements))
+      if (cell->level() < static_cast<int>(base_level + n_refinements))
         cell->set_refine_flag();
     }
 
-    // Execute the refinement and transfer the solution onto the new mesh.
-    refine_and_transfer(thermal_physics, material_properties, dof_handler,
-                        solution);
+    // Execute the refinement and transfer the solution onto the new mesh. The
+    // flags of the last pass are left on the Triangulation so that they can be
+    // executed together with the activation of new material. The operators are
+    // only rebuilt once the last changes are executed.
+    if (i < n_refinements - 1)
+      thermal_physics->execute_mesh_changes(solutions, false);
   }
-
-  // Recompute the inverse of the mass matrix
-  thermal_physics->compute_inverse_mass_matrix();
 }
 
 template <int dim, int p_order, typename MaterialStates,
@@ -659,13 +633,14 @@ template <int dim, int p_order, typename MaterialStates,
 void refine_mesh(
     std::unique_ptr<adamantine::ThermalPhysicsInterface<dim, MemorySpaceType>>
         &thermal_physics,
-    adamantine::MaterialProperty<dim, p_order, MaterialStates, MemorySpaceType>
-        &material_properties,
-    dealii::LA::distributed::Vector<double, MemorySpaceType> &solution,
+    std::vector<
+        dealii::LA::distributed::Vector<double, MemorySpaceType> *> const
+        &solutions,
     std::vector<std::shared_ptr<adamantine::HeatSource<dim>>> &heat_sources,
     double const time, double const next_refinement_time,
     unsigned int const time_steps_refinement,
-    boost::property_tree::ptree const &refinement_database)
+    boost::property_tree::ptree const &refinement_database,
+    unsigned int const base_level)
 {
   if (!thermal_physics)
     return;
@@ -675,36 +650,41 @@ void refine_mesh(
   case 1:
   {
     refine_mesh<dim, p_order, 1, MaterialStates>(
-        thermal_physics, material_properties, solution, heat_sources, time,
-        next_refinement_time, time_steps_refinement, refinement_database);
+        thermal_physics, solutions, heat_sources, time,
+        next_refinement_time, time_steps_refinement, refinement_database,
+        base_level);
     break;
   }
   case 2:
   {
     refine_mesh<dim, p_order, 2, MaterialStates>(
-        thermal_physics, material_properties, solution, heat_sources, time,
-        next_refinement_time, time_steps_refinement, refinement_database);
+        thermal_physics, solutions, heat_sources, time,
+        next_refinement_time, time_steps_refinement, refinement_database,
+        base_level);
     break;
   }
   case 3:
   {
     refine_mesh<dim, p_order, 3, MaterialStates>(
-        thermal_physics, material_properties, solution, heat_sources, time,
-        next_refinement_time, time_steps_refinement, refinement_database);
+        thermal_physics, solutions, heat_sources, time,
+        next_refinement_time, time_steps_refinement, refinement_database,
+        base_level);
     break;
   }
   case 4:
   {
     refine_mesh<dim, p_order, 4, MaterialStates>(
-        thermal_physics, material_properties, solution, heat_sources, time,
-        next_refinement_time, time_steps_refinement, refinement_database);
+        thermal_physics, solutions, heat_sources, time,
+        next_refinement_time, time_steps_refinement, refinement_database,
+        base_level);
     break;
   }
   case 5:
   {
     refine_mesh<dim, p_order, 5, MaterialStates>(
-        thermal_physics, material_properties, solution, heat_sources, time,
-        next_refinement_time, time_steps_refinement, refinement_database);
+        thermal_physics, solutions, heat_sources, time,
+        next_refinement_time, time_steps_refinement, refinement_database,
+        base_level);
     break;
   }
   default:
@@ -714,6 +694,37 @@ void refine_mesh(
   }
 }
 
+template <int dim, typename MemorySpaceType>
+bool grow_domain(
+    adamantine::Geometry<dim> &geometry,
+    std::unique_ptr<adamantine::ThermalPhysicsInterface<dim, MemorySpaceType>>
+        &thermal_physics,
+    std::vector<
+        dealii::LA::distributed::Vector<double, MemorySpaceType> *> const
+        &solutions,
+    std::vector<dealii::BoundingBox<dim>> const &material_deposition_boxes,
+    unsigned int const activation_start, unsigned int const activation_end)
+{
+  if (geometry.get_growth_refinements() == 0)
+    return false;
+
+  // The cells that receive material need to have the requested resolution
+  // before they are activated. The whole layer is refined at once.
+  double height = std::numeric_limits<double>::lowest();
+  for (unsigned int i = activation_start; i < activation_end; ++i)
+    height = std::max(height, material_deposition_boxes[i].upper_bound(
+                                  adamantine::axis<dim>::z));
+
+  bool mesh_changed = false;
+  while (geometry.flag_cells_to_grow(height))
+  {
+    thermal_physics->execute_mesh_changes(solutions, false);
+    mesh_changed = true;
+  }
+
+  return mesh_changed;
+}
+
 template <int dim, int p_order, typename MaterialStates,
           typename MemorySpaceType>
 std::pair<dealii::LinearAlgebra::distributed::Vector<double,
@@ -776,6 +787,20 @@ run(MPI_Comm const &communicator, boost::property_tree::ptree const &database,
     post_processor_database.put("thermal_output", true);
   }
 
+  // Store the scan paths once per node
+  // PropertyTreeInput node_shared_data
+  if (database.get("node_shared_data", false))
+  {
+    std::size_t const memory_saved = dealii::Utilities::MPI::sum(
+        share_scan_paths_on_node(communicator, heat_sources), communicator);
+    if ((dealii::Utilities::MPI::this_mpi_process(communicator) == 0) &&
+        (verbose_output == true))
+    {
+      std::cout << "Memory saved by sharing the scan paths on the nodes: "
+                << memory_saved << " bytes" << std::endl;
+    }
+  }
+
   // PropertyTreeInput materials.initial_temperature
   double const initial_temperature =
       material_database.get("initial_temperature", 300.);
@@ -937,11 +962,16 @@ run(MPI_Comm const &communicator, boost::property_tree::ptree const &database,
               mechanical_physics, displacement, material_properties, timers);
   ++n_time_step;
 
-  // Create the bounding boxes used for material deposition
-  auto [material_deposition_boxes, deposition_times, deposition_cos,
-        deposition_sin] =
-      adamantine::create_material_deposition_boxes<dim>(geometry_database,
-                                                        heat_sources);
+  // Create the stream of bounding boxes used for material deposition
+  adamantine::DepositionStream<dim> deposition_stream(geometry_database,
+                                                      heat_sources);
+  // The search of the cells to activate is kept until the mesh changes
+  std::unique_ptr<adamantine::ActivationSearch<dim>> activation_search;
+  if (use_thermal_physics)
+    activation_search = std::make_unique<adamantine::ActivationSearch<dim>>(
+        thermal_physics->get_dof_handler(),
+        [physics = thermal_physics.get()](auto const &cell)
+        { return physics->is_quiet(cell); });
   // Extract the time-stepping database
   boost::property_tree::ptree time_stepping_database =
       database.get_child("time_stepping");
@@ -961,6 +991,11 @@ run(MPI_Comm const &communicator, boost::property_tree::ptree const &database,
   // PropertyTreeInput refinement.time_steps_between_refinement
   unsigned int const time_steps_refinement =
       refinement_database.get("time_steps_between_refinement", 10);
+  // PropertyTreeInput refinement.lead_distance
+  double const lead_distance = refinement_database.get("lead_distance", 0.);
+  // When the mesh is refined ahead of the beams, it is refined again once the
+  // beams leave the refined envelope.
+  double refined_until_time = std::numeric_limits<double>::lowest();
   // PropertyTreeInput post_processor.time_steps_between_output
   unsigned int const time_steps_output =
       post_processor_database.get("time_steps_between_output", 1);
@@ -979,25 +1014,46 @@ run(MPI_Comm const &communicator, boost::property_tree::ptree const &database,
     if ((time + time_step) > duration)
       time_step = duration - time;
 
+    // The refinement and the activation of new material are executed together
+    // at the end of the mesh update.
+    bool mesh_changes_pending = false;
+    bool material_added = false;
+
     // Refine the mesh the first time we get in the loop and after
-    // time_steps_refinement time steps.
-    if (((n_time_step == 1) || ((n_time_step % time_steps_refinement) == 0)) &&
-        use_thermal_physics)
+    // time_steps_refinement time steps. If the mesh is refined ahead of the
+    // beams, refine it when the beams leave the refined envelope instead.
+    bool const refinement_needed =
+        (lead_distance > 0.)
+            ? (time + time_step > refined_until_time)
+            : ((n_time_step == 1) ||
+               ((n_time_step % time_steps_refinement) == 0));
+    if (refinement_needed && use_thermal_physics)
     {
       timers[adamantine::refine].start();
       double next_refinement_time = time + time_steps_refinement * time_step;
-      refine_mesh(thermal_physics, material_properties, temperature,
-                  heat_sources, time, next_refinement_time,
-                  time_steps_refinement, refinement_database);
-      timers[adamantine::refine].stop();
-      if ((rank == 0) && (verbose_output == true))
+      unsigned int n_refinement_steps = time_steps_refinement;
+      if (lead_distance > 0.)
       {
-        std::cout << "n_time_step: " << n_time_step << " time: " << time
-                  << " n_dofs: " << thermal_physics->get_dof_handler().n_dofs()
-                  << std::endl;
+        refined_until_time =
+            compute_look_ahead_time(heat_sources, time, lead_distance);
+        if (refined_until_time < std::numeric_limits<double>::max())
+        {
+          next_refinement_time = std::max(refined_until_time, time + time_step);
+          n_refinement_steps = static_cast<unsigned int>(
+              std::ceil((next_refinement_time - time) / time_step));
+        }
       }
+      refine_mesh(thermal_physics, {&temperature}, heat_sources, time,
+                  next_refinement_time, n_refinement_steps,
+                  refinement_database, geometry.get_growth_refinements());
+      timers[adamantine::refine].stop();
+      mesh_changes_pending = true;
     }
 
+    // Repartition the mesh if the work is not balanced between the processors.
+    if (use_thermal_physics && thermal_physics->is_repartition_needed())
+      mesh_changes_pending = true;
+
     // Add material if necessary.
     // We use an epsilon to get the "expected" behavior when the deposition
     // time and the time match should match exactly but don't because of
@@ -1005,6 +1061,8 @@ run(MPI_Comm const &communicator, boost::property_tree::ptree const &database,
     timers[adamantine::add_material_activate].start();
     if (time > activation_time_end)
     {
+      double const eps = time_step / 1e10;
+
       // If we use scan_path_for_duration, we may need to read the scan path
       // file once again.
       if (scan_path_for_duration)
@@ -1013,7 +1071,9 @@ run(MPI_Comm const &communicator, boost::property_tree::ptree const &database,
         bool need_updated_scan_path = false;
         for (auto &source : heat_sources)
         {
-          if (time > source->get_scan_path().get_segment_list().back().end_time)
+          auto const &scan_path = source->get_scan_path();
+          if (time >
+              scan_path.get_segment(scan_path.n_segments() - 1).end_time)
           {
             need_updated_scan_path = true;
             break;
@@ -1040,24 +1100,29 @@ run(MPI_Comm const &communicator, boost::property_tree::ptree const &database,
           // sources, we just exit.
           if (scan_path_end)
           {
+            if (mesh_changes_pending)
+              thermal_physics->execute_mesh_changes(temperature, true);
             break;
           }
 
-          std::tie(material_deposition_boxes, deposition_times, deposition_cos,
-                   deposition_sin) =
-              adamantine::create_material_deposition_boxes<dim>(
-                  geometry_database, heat_sources);
+          // Restart the deposition using the updated scan paths
+          deposition_stream.reset(time - eps);
+          refined_until_time = std::numeric_limits<double>::lowest();
         }
       }
 
-      double const eps = time_step / 1e10;
-
+      activation_time_end =
+          std::min(time + std::max(activation_time, time_step), duration) - eps;
+      // Generate the boxes deposited between time and activation_time_end
+      deposition_stream.advance(time - eps, activation_time_end);
+      auto const &material_deposition_boxes = deposition_stream.get_boxes();
+      auto const &deposition_times = deposition_stream.get_times();
+      auto const &deposition_cos = deposition_stream.get_cos();
+      auto const &deposition_sin = deposition_stream.get_sin();
       auto activation_start =
           std::lower_bound(deposition_times.begin(), deposition_times.end(),
                            time - eps) -
           deposition_times.begin();
-      activation_time_end =
-          std::min(time + std::max(activation_time, time_step), duration) - eps;
       auto activation_end =
           std::lower_bound(deposition_times.begin(), deposition_times.end(),
                            activation_time_end) -
@@ -1066,32 +1131,55 @@ run(MPI_Comm const &communicator, boost::property_tree::ptree const &database,
       {
         if (use_thermal_physics)
         {
-          // Compute the elements to activate.
-          // TODO Right now, we compute the list of cells that get activated for
-          // the entire material deposition. We should restrict the list to the
-          // cells that are activated between activation_start and
+          // Refine the coarse cells that are about to receive material.
+          if (grow_domain(geometry, thermal_physics, {&temperature},
+                          material_deposition_boxes, activation_start,
+                          activation_end))
+            mesh_changes_pending = true;
+
+          // Compute the elements to activate between activation_start and
           // activation_end.
           timers[adamantine::add_material_search].start();
-          auto elements_to_activate = adamantine::get_elements_to_activate(
-              thermal_physics->get_dof_handler(), material_deposition_boxes);
+          auto elements_to_activate =
+              activation_search->get_elements_to_activate(
+                  material_deposition_boxes, activation_start, activation_end);
           timers[adamantine::add_material_search].stop();
 
-          // For now assume that all deposited material has never been melted
-          // (may or may not be reasonable)
-          std::vector<bool> has_melted(deposition_cos.size(), false);
-
-          thermal_physics->add_material(elements_to_activate, deposition_cos,
-                                        deposition_sin, has_melted,
-                                        activation_start, activation_end,
-                                        new_material_temperature, temperature);
+          // If some of the cells to activate are flagged for refinement, the
+          // refinement is executed first and the cells are searched again on
+          // the refined mesh.
+          if (!thermal_physics->schedule_material(
+                  elements_to_activate, deposition_cos, deposition_sin,
+                  activation_start, activation_end, new_material_temperature))
+          {
+            thermal_physics->execute_mesh_changes(temperature, false);
+            elements_to_activate = activation_search->get_elements_to_activate(
+                material_deposition_boxes, activation_start, activation_end);
+            bool const scheduled = thermal_physics->schedule_material(
+                elements_to_activate, deposition_cos, deposition_sin,
+                activation_start, activation_end, new_material_temperature);
+            adamantine::ASSERT_THROW(
+                scheduled, "Error: Cannot schedule the activation of material.");
+          }
+          // The quiet cells are activated right away, the other cells need a
+          // mesh change.
+          if (thermal_physics->activate_scheduled_material())
+            mesh_changes_pending = true;
+          material_added = true;
         }
       }
+    }
 
-      if ((rank == 0) && (verbose_output == true) &&
-          (activation_end - activation_start > 0) && use_thermal_physics)
+    // Execute the refinement and the activation in a single mesh update.
+    if (mesh_changes_pending)
+    {
+      thermal_physics->execute_mesh_changes(temperature, true);
+      if ((rank == 0) && (verbose_output == true))
       {
-        std::cout << "n_dofs after cell activation: "
-                  << thermal_physics->get_dof_handler().n_dofs() << std::endl;
+        std::cout << "n_time_step: " << n_time_step << " time: " << time
+                  << " n_dofs: " << thermal_physics->get_dof_handler().n_dofs()
+                  << (material_added ? " after cell activation" : "")
+                  << std::endl;
       }
     }
     timers[adamantine::add_material_activate].stop();
@@ -1368,11 +1456,38 @@ run_ensemble(MPI_Comm const &global_communicator,
   split_global_communicator(global_communicator, global_ensemble_size,
                             local_communicator, local_ensemble_size,
                             first_local_member, my_color);
+  // Global indices of the members of the processor. The members may be moved
+  // to another processor during the simulation.
+  std::vector<unsigned int> member_ids(local_ensemble_size);
+  std::iota(member_ids.begin(), member_ids.end(), first_local_member);
 
   // ------ Set up the ensemble members -----
-  // There might be a more efficient way to share some of these objects
-  // between ensemble members. For now, we'll do the simpler approach of
-  // duplicating everything.
+  // By default, every ensemble member has its own Geometry, MaterialProperty,
+  // and ThermalPhysics objects. If the mesh is shared, the members on a
+  // processor use the same objects and only keep their own solution, material
+  // state, and heat source parameters.
+  // PropertyTreeInput ensemble.shared_mesh
+  bool const shared_mesh = ensemble_database.get("shared_mesh", false);
+  unsigned int n_meshes = shared_mesh ? 1 : local_ensemble_size;
+  auto const mesh_of = [&](unsigned int const member)
+  { return shared_mesh ? 0u : member; };
+
+  // Balancing of the members between the processors
+  // PropertyTreeInput ensemble.load_imbalance_threshold
+  double const member_imbalance_threshold =
+      ensemble_database.get("load_imbalance_threshold", 0.);
+  // PropertyTreeInput ensemble.time_steps_between_balancing
+  unsigned int const time_steps_balancing =
+      ensemble_database.get("time_steps_between_balancing", 10);
+  // PropertyTreeInput ensemble.migration_filename_prefix
+  std::string const migration_filename =
+      ensemble_database.get("migration_filename_prefix", "member_migration");
+  std::unique_ptr<adamantine::MemberLoadBalancer> member_load_balancer;
+  if (member_imbalance_threshold > 0.)
+  {
+    member_load_balancer = std::make_unique<adamantine::MemberLoadBalancer>(
+        global_communicator, my_color, member_imbalance_threshold);
+  }
 
   // PropertyTreeInput ensemble.initial_temperature_stddev
   const double initial_temperature_stddev =
@@ -1414,10 +1529,10 @@ run_ensemble(MPI_Comm const &global_communicator,
 
   std::vector<std::unique_ptr<
       adamantine::ThermalPhysicsInterface<dim, MemorySpaceType>>>
-      thermal_physics_ensemble(local_ensemble_size);
+      thermal_physics_ensemble(n_meshes);
 
   std::vector<std::vector<std::shared_ptr<adamantine::HeatSource<dim>>>>
-      heat_sources_ensemble(local_ensemble_size);
+      heat_sources_ensemble(n_meshes);
 
   std::vector<std::unique_ptr<adamantine::Geometry<dim>>> geometry_ensemble;
 
@@ -1470,6 +1585,12 @@ run_ensemble(MPI_Comm const &global_communicator,
   adamantine::DataAssimilator data_assimilator(global_communicator,
                                                local_communicator, my_color,
                                                data_assimilation_database);
+  // PropertyTreeInput data_assimilation.pipelined
+  bool const pipelined_assimilation =
+      data_assimilation_database.get("pipelined", false);
+  // PropertyTreeInput data_assimilation.frames_per_analysis
+  unsigned int const frames_per_analysis =
+      data_assimilation_database.get("frames_per_analysis", 1u);
 
   // Get the checkpoint and restart subtrees
   boost::optional<boost::property_tree::ptree const &>
@@ -1504,6 +1625,7 @@ run_ensemble(MPI_Comm const &global_communicator,
     // PropertyTreeInput restart.filename_prefix
     restart_filename = restart_database.get<std::string>("filename_prefix");
   }
+  std::size_t scan_path_memory_saved = 0;
   for (unsigned int member = 0; member < local_ensemble_size; ++member)
   {
     // Resize the augmented ensemble block vector to have two blocks
@@ -1552,26 +1674,38 @@ run_ensemble(MPI_Comm const &global_communicator,
 
     solution_augmented_ensemble[member].collect_sizes();
 
-    geometry_ensemble.push_back(std::make_unique<adamantine::Geometry<dim>>(
-        local_communicator, geometry_database));
-
-    material_properties_ensemble.push_back(
-        std::make_unique<adamantine::MaterialProperty<
-            dim, p_order, MaterialStates, MemorySpaceType>>(
-            local_communicator, geometry_ensemble.back()->get_triangulation(),
-            material_database));
-
-    thermal_physics_ensemble[member] = initialize_thermal_physics<dim>(
-        fe_degree, quadrature_type, local_communicator,
-        database_ensemble[member], *geometry_ensemble[member],
-        *material_properties_ensemble[member]);
-    heat_sources_ensemble[member] =
-        thermal_physics_ensemble[member]->get_heat_sources();
+    bool const new_mesh = member < n_meshes;
+    if (new_mesh)
+    {
+      geometry_ensemble.push_back(std::make_unique<adamantine::Geometry<dim>>(
+          local_communicator, geometry_database));
+
+      material_properties_ensemble.push_back(
+          std::make_unique<adamantine::MaterialProperty<
+              dim, p_order, MaterialStates, MemorySpaceType>>(
+              local_communicator, geometry_ensemble.back()->get_triangulation(),
+              material_database));
+
+      thermal_physics_ensemble[member] = initialize_thermal_physics<dim>(
+          fe_degree, quadrature_type, local_communicator,
+          database_ensemble[member], *geometry_ensemble[member],
+          *material_properties_ensemble[member]);
+      heat_sources_ensemble[member] =
+          thermal_physics_ensemble[member]->get_heat_sources();
+      // PropertyTreeInput node_shared_data
+      if (database.get("node_shared_data", false))
+      {
+        scan_path_memory_saved += share_scan_paths_on_node(
+            local_communicator, heat_sources_ensemble[member]);
+      }
+    }
+    auto &thermal_physics = thermal_physics_ensemble[mesh_of(member)];
 
     if (restart == false)
     {
-      thermal_physics_ensemble[member]->setup();
-      thermal_physics_ensemble[member]->initialize_dof_vector(
+      if (new_mesh)
+        thermal_physics->setup();
+      thermal_physics->initialize_dof_vector(
           initial_temperature[member],
           solution_augmented_ensemble[member].block(base_state));
     }
@@ -1580,7 +1714,7 @@ run_ensemble(MPI_Comm const &global_communicator,
 #ifdef ADAMANTINE_WITH_CALIPER
       CALI_MARK_BEGIN("restart from file");
 #endif
-      thermal_physics_ensemble[member]->load_checkpoint(
+      thermal_physics->load_checkpoint(
           restart_filename + '_' + std::to_string(member),
           solution_augmented_ensemble[member].block(base_state));
 #ifdef ADAMANTINE_WITH_CALIPER
@@ -1594,8 +1728,72 @@ run_ensemble(MPI_Comm const &global_communicator,
     post_processor_ensemble.push_back(
         std::make_unique<adamantine::PostProcessor<dim>>(
             local_communicator, post_processor_database,
-            thermal_physics_ensemble[member]->get_dof_handler(),
-            first_local_member + member));
+            thermal_physics->get_dof_handler(), member_ids[member]));
+  }
+  // Return the ThermalPhysics of the member. If the mesh is shared, the state
+  // of the member is loaded first.
+  auto member_physics = [&](unsigned int const member) -> std::unique_ptr<
+                             adamantine::ThermalPhysicsInterface<
+                                 dim, MemorySpaceType>> &
+  {
+    if (!shared_mesh)
+      return thermal_physics_ensemble[member];
+
+    auto &thermal_physics = thermal_physics_ensemble[0];
+    thermal_physics->select_member(member);
+    return thermal_physics;
+  };
+
+  // If the mesh is shared, each member gets its own heat sources whose
+  // parameters are set from the database of the member.
+  if (shared_mesh)
+  {
+    thermal_physics_ensemble[0]->set_n_members(local_ensemble_size);
+    for (unsigned int member = 0; member < local_ensemble_size; ++member)
+    {
+      member_physics(member)->update_physics_parameters(
+          database_ensemble[member].get_child("sources"));
+    }
+  }
+
+  // Return the solutions of the members using the given mesh.
+  auto mesh_solutions = [&](unsigned int const mesh)
+  {
+    std::vector<dealii::LA::distributed::Vector<double, MemorySpaceType> *>
+        solutions;
+    for (unsigned int member = 0; member < local_ensemble_size; ++member)
+    {
+      if (mesh_of(member) == mesh)
+        solutions.push_back(
+            &solution_augmented_ensemble[member].block(base_state));
+    }
+    return solutions;
+  };
+
+  // Execute the mesh changes of the given mesh and transfer the solutions of
+  // the members using it.
+  auto execute_mesh_changes = [&](unsigned int const mesh,
+                                  bool const update_operators)
+  {
+    thermal_physics_ensemble[mesh]->execute_mesh_changes(mesh_solutions(mesh),
+                                                         update_operators);
+    for (unsigned int member = 0; member < local_ensemble_size; ++member)
+    {
+      if (mesh_of(member) == mesh)
+        solution_augmented_ensemble[member].collect_sizes();
+    }
+  };
+
+  // PropertyTreeInput node_shared_data
+  if (database.get("node_shared_data", false))
+  {
+    scan_path_memory_saved =
+        dealii::Utilities::MPI::sum(scan_path_memory_saved, global_communicator);
+    if ((global_rank == 0) && (verbose_output == true))
+    {
+      std::cout << "Memory saved by sharing the scan paths on the nodes: "
+                << scan_path_memory_saved << " bytes" << std::endl;
+    }
   }
 
   // PostProcessor for outputting the experimental data
@@ -1714,10 +1912,10 @@ run_ensemble(MPI_Comm const &global_communicator,
   for (unsigned int member = 0; member < local_ensemble_size; ++member)
   {
     output_pvtu(*post_processor_ensemble[member], n_time_step, time,
-                thermal_physics_ensemble[member],
+                member_physics(member),
                 solution_augmented_ensemble[member].block(base_state),
                 mechanical_physics, displacement,
-                *material_properties_ensemble[member], timers);
+                *material_properties_ensemble[mesh_of(member)], timers);
   }
 
   // ----- Increment the time step -----
@@ -1727,6 +1925,11 @@ run_ensemble(MPI_Comm const &global_communicator,
   // PropertyTreeInput refinement.time_steps_between_refinement
   unsigned int const time_steps_refinement =
       refinement_database.get("time_steps_between_refinement", 10);
+  // PropertyTreeInput refinement.lead_distance
+  double const lead_distance = refinement_database.get("lead_distance", 0.);
+  // When the mesh is refined ahead of the beams, it is refined again once the
+  // beams leave the refined envelope.
+  double refined_until_time = std::numeric_limits<double>::lowest();
   // PropertyTreeInput time_stepping.time_step
   double time_step = time_stepping_database.get<double>("time_step");
   // PropertyTreeInput time_stepping.scan_path_for_duration
@@ -1744,23 +1947,256 @@ run_ensemble(MPI_Comm const &global_communicator,
   // For now assume that all ensemble members share the same geometry (they
   // have independent adamantine::Geometry objects, but all are constructed
   // from identical parameters), base new additions on the 0th ensemble member
-  auto [material_deposition_boxes, deposition_times, deposition_cos,
-        deposition_sin] =
-      adamantine::create_material_deposition_boxes<dim>(
-          geometry_database, heat_sources_ensemble[0]);
-
-  timers[adamantine::add_material_search].start();
-  std::vector<std::vector<
-      std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator>>>
-      elements_to_activate_ensemble(local_ensemble_size);
-  for (unsigned int member = 0; member < local_ensemble_size; ++member)
+  adamantine::DepositionStream<dim> deposition_stream(
+      geometry_database, heat_sources_ensemble[0]);
+
+  // The search of the cells to activate is kept until the mesh changes
+  std::vector<std::unique_ptr<adamantine::ActivationSearch<dim>>>
+      activation_search_ensemble(n_meshes);
+  for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
   {
-    elements_to_activate_ensemble[member] =
-        adamantine::get_elements_to_activate(
-            thermal_physics_ensemble[member]->get_dof_handler(),
-            material_deposition_boxes);
+    activation_search_ensemble[mesh] =
+        std::make_unique<adamantine::ActivationSearch<dim>>(
+            thermal_physics_ensemble[mesh]->get_dof_handler(),
+            [physics = thermal_physics_ensemble[mesh].get()](
+                auto const &cell) { return physics->is_quiet(cell); });
   }
-  timers[adamantine::add_material_search].stop();
+
+  // Add the increments of the pending analysis to the ensemble members and
+  // update the parameters of the heat sources.
+  auto finish_assimilation = [&]()
+  {
+    timers[adamantine::da_update_ensemble].start();
+#ifdef ADAMANTINE_WITH_CALIPER
+    CALI_MARK_BEGIN("da_update_ensemble");
+#endif
+    data_assimilator.finish_update_ensemble(solution_augmented_ensemble);
+#ifdef ADAMANTINE_WITH_CALIPER
+    CALI_MARK_END("da_update_ensemble");
+#endif
+    timers[adamantine::da_update_ensemble].stop();
+
+    // Extract the parameters from the augmented state
+    for (unsigned int member = 0; member < local_ensemble_size; ++member)
+    {
+      for (unsigned int index = 0; index < augmented_state_parameters.size();
+           ++index)
+      {
+        // FIXME: Need to consider how we want to generalize this. It
+        // could get unwieldy if we want to specify every parameter of an
+        // arbitrary number of beams.
+        if (augmented_state_parameters.at(index) ==
+            adamantine::AugmentedStateParameters::beam_0_absorption)
+        {
+          database_ensemble[member].put(
+              "sources.beam_0.absorption_efficiency",
+              solution_augmented_ensemble[member].block(
+                  augmented_state)[index]);
+        }
+        else if (augmented_state_parameters.at(index) ==
+                 adamantine::AugmentedStateParameters::beam_0_max_power)
+        {
+          database_ensemble[member].put(
+              "sources.beam_0.max_power",
+              solution_augmented_ensemble[member].block(
+                  augmented_state)[index]);
+        }
+      }
+      member_physics(member)->update_physics_parameters(
+          database_ensemble[member].get_child("sources"));
+    }
+
+    if (global_rank == 0)
+      std::cout << "Done." << std::endl;
+
+    // Print out the augmented parameters
+    for (unsigned int member = 0; member < local_ensemble_size; ++member)
+    {
+      std::cout << "Rank: " << global_rank << " | New parameters for member "
+                << member_ids[member] << ": ";
+      for (auto param : solution_augmented_ensemble[member].block(1))
+        std::cout << param << " ";
+
+      std::cout << std::endl;
+    }
+  };
+
+  // Move the ensemble members between the processors if the time spent on
+  // them is not balanced. A member is written in a checkpoint by its current
+  // processor and it is loaded by its new processor. The parameters of the
+  // member and the list of its output files are sent along. The checkpoint
+  // files are removed once they have been loaded.
+  auto migrate_members = [&]()
+  {
+    auto const migrations =
+        member_load_balancer->compute_migrations(member_ids);
+    if (migrations.empty())
+      return;
+
+    // The meshes of the moved members were refined ahead of the beams of their
+    // previous processors, so all the meshes are refined again. The migrations
+    // are known by all the processors, so they all take the same decision.
+    refined_until_time = std::numeric_limits<double>::lowest();
+
+    if ((global_rank == 0) && (verbose_output == true))
+    {
+      std::cout << "Imbalance of the ensemble members: "
+                << member_load_balancer->get_imbalance() << std::endl;
+      for (auto const &migration : migrations)
+      {
+        std::cout << "Moving member " << migration.member << " from color "
+                  << migration.source_color << " to color "
+                  << migration.destination_color << std::endl;
+      }
+    }
+
+    // Save the members leaving the processor. The parameters of a member are
+    // its index, the temperature of the new material, the parameters of the
+    // first beam, and the augmented parameters.
+    bool const local_root =
+        dealii::Utilities::MPI::this_mpi_process(local_communicator) == 0;
+    std::vector<unsigned int> leaving_members;
+    std::vector<std::pair<std::vector<double>,
+                          std::vector<std::pair<double, std::string>>>>
+        records;
+    for (auto const &migration : migrations)
+    {
+      if (migration.source_color != my_color)
+        continue;
+
+      unsigned int const member =
+          std::find(member_ids.begin(), member_ids.end(), migration.member) -
+          member_ids.begin();
+      thermal_physics_ensemble[member]->save_checkpoint(
+          migration_filename + '_' + std::to_string(migration.member),
+          solution_augmented_ensemble[member].block(base_state));
+      leaving_members.push_back(member);
+
+      if (local_root)
+      {
+        std::vector<double> parameters = {static_cast<double>(migration.member),
+                                          new_material_temperature[member]};
+        if (n_beams > 0)
+        {
+          // PropertyTreeInput sources.beam_0.max_power
+          parameters.push_back(database_ensemble[member].get<double>(
+              "sources.beam_0.max_power"));
+          // PropertyTreeInput sources.beam_0.absorption_efficiency
+          parameters.push_back(database_ensemble[member].get<double>(
+              "sources.beam_0.absorption_efficiency"));
+        }
+        for (auto param :
+             solution_augmented_ensemble[member].block(augmented_state))
+          parameters.push_back(param);
+        records.emplace_back(
+            parameters, post_processor_ensemble[member]->get_times_filenames());
+      }
+    }
+    // The records are gathered once the checkpoints are written.
+    auto const all_records =
+        dealii::Utilities::MPI::all_gather(global_communicator, records);
+
+    // Remove the members leaving the processor. The objects are destroyed in
+    // the reverse order of their dependencies.
+    auto const erase = [](auto &vector, unsigned int const i)
+    { vector.erase(vector.begin() + i); };
+    std::sort(leaving_members.rbegin(), leaving_members.rend());
+    for (auto const member : leaving_members)
+    {
+      erase(activation_search_ensemble, member);
+      erase(post_processor_ensemble, member);
+      erase(thermal_physics_ensemble, member);
+      erase(heat_sources_ensemble, member);
+      erase(material_properties_ensemble, member);
+      erase(geometry_ensemble, member);
+      erase(solution_augmented_ensemble, member);
+      erase(database_ensemble, member);
+      erase(new_material_temperature, member);
+      erase(member_ids, member);
+    }
+
+    // Load the members arriving on the processor.
+    for (auto const &rank_records : all_records)
+    {
+      for (auto const &[parameters, times_filenames] : rank_records)
+      {
+        unsigned int const member_id =
+            static_cast<unsigned int>(parameters[0]);
+        auto const migration = std::find_if(
+            migrations.begin(), migrations.end(), [&](auto const &candidate)
+            { return candidate.member == member_id; });
+        if (migration->destination_color != my_color)
+          continue;
+
+        unsigned int p = 1;
+        new_material_temperature.push_back(parameters[p++]);
+        database_ensemble.push_back(database);
+        if (n_beams > 0)
+        {
+          // PropertyTreeInput sources.beam_0.max_power
+          database_ensemble.back().put("sources.beam_0.max_power",
+                                       parameters[p++]);
+          // PropertyTreeInput sources.beam_0.absorption_efficiency
+          database_ensemble.back().put("sources.beam_0.absorption_efficiency",
+                                       parameters[p++]);
+        }
+
+        geometry_ensemble.push_back(std::make_unique<adamantine::Geometry<dim>>(
+            local_communicator, geometry_database));
+        material_properties_ensemble.push_back(
+            std::make_unique<adamantine::MaterialProperty<
+                dim, p_order, MaterialStates, MemorySpaceType>>(
+                local_communicator,
+                geometry_ensemble.back()->get_triangulation(),
+                material_database));
+        thermal_physics_ensemble.push_back(initialize_thermal_physics<dim>(
+            fe_degree, quadrature_type, local_communicator,
+            database_ensemble.back(), *geometry_ensemble.back(),
+            *material_properties_ensemble.back()));
+        auto &thermal_physics = thermal_physics_ensemble.back();
+        heat_sources_ensemble.push_back(thermal_physics->get_heat_sources());
+
+        auto &solution = solution_augmented_ensemble.emplace_back();
+        solution.reinit(2);
+        thermal_physics->load_checkpoint(
+            migration_filename + '_' + std::to_string(member_id),
+            solution.block(base_state));
+        solution.block(augmented_state).reinit(parameters.size() - p);
+        for (unsigned int i = 0; p + i < parameters.size(); ++i)
+          solution.block(augmented_state)[i] = parameters[p + i];
+        solution.collect_sizes();
+
+        post_processor_ensemble.push_back(
+            std::make_unique<adamantine::PostProcessor<dim>>(
+                local_communicator, post_processor_database,
+                thermal_physics->get_dof_handler(), member_id));
+        post_processor_ensemble.back()->set_times_filenames(times_filenames);
+        activation_search_ensemble.push_back(
+            std::make_unique<adamantine::ActivationSearch<dim>>(
+                thermal_physics->get_dof_handler(),
+                [physics = thermal_physics.get()](auto const &cell)
+                { return physics->is_quiet(cell); }));
+        member_ids.push_back(member_id);
+      }
+    }
+
+    // Remove the checkpoint files once all the destinations have loaded them.
+    MPI_Barrier(global_communicator);
+    if (global_rank == 0)
+    {
+      for (auto const &migration : migrations)
+      {
+        std::string const filename =
+            migration_filename + '_' + std::to_string(migration.member);
+        for (std::string const suffix :
+             {"", "_fixed.data", "_variable.data", ".info"})
+          std::filesystem::remove(filename + suffix);
+      }
+    }
+
+    local_ensemble_size = member_ids.size();
+    n_meshes = local_ensemble_size;
+  };
 
   // ----- Main time stepping loop -----
   if (global_rank == 0)
@@ -1777,41 +2213,90 @@ run_ensemble(MPI_Comm const &global_communicator,
     if ((time + time_step) > duration)
       time_step = duration - time;
 
+    // The refinement and the activation of new material are executed together
+    // at the end of the mesh update.
+    bool mesh_changes_pending = false;
+    bool material_added = false;
+
     // ----- Refine the mesh if necessary -----
     // Refine the mesh the first time we get in the loop and after
-    // time_steps_refinement time steps.
-    if ((n_time_step == 1) || ((n_time_step % time_steps_refinement) == 0))
+    // time_steps_refinement time steps. If the mesh is refined ahead of the
+    // beams, refine it when the beams leave the refined envelope instead.
+    bool const refinement_needed =
+        (lead_distance > 0.)
+            ? (time + time_step > refined_until_time)
+            : ((n_time_step == 1) ||
+               ((n_time_step % time_steps_refinement) == 0));
+
+    // Repartition the meshes if the work is not balanced between the
+    // processors. The imbalance is evaluated once per time step.
+    bool repartition_needed = false;
+    for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
     {
-      timers[adamantine::refine].start();
-      double const next_refinement_time =
-          time + time_steps_refinement * time_step;
+      if (thermal_physics_ensemble[mesh]->is_repartition_needed())
+        repartition_needed = true;
+    }
 
-      for (unsigned int member = 0; member < local_ensemble_size; ++member)
+    // The increments of a pending analysis are associated with the current
+    // dofs. They need to be applied before the mesh may change. The imbalance
+    // is measured on the communicator of each color but finishing the
+    // analysis is collective over all the colors, so the decision is reduced
+    // over all the processors.
+    if (data_assimilator.analysis_pending())
+    {
+      bool const mesh_may_change = refinement_needed || repartition_needed ||
+                                   (time > activation_time_end);
+      if (dealii::Utilities::MPI::max(static_cast<int>(mesh_may_change),
+                                      global_communicator) == 1)
+        finish_assimilation();
+    }
+
+    if (refinement_needed)
+    {
+      timers[adamantine::refine].start();
+      double next_refinement_time = time + time_steps_refinement * time_step;
+      unsigned int n_refinement_steps = time_steps_refinement;
+      if (lead_distance > 0.)
       {
-        refine_mesh(thermal_physics_ensemble[member],
-                    *material_properties_ensemble[member],
-                    solution_augmented_ensemble[member].block(base_state),
-                    heat_sources_ensemble[member], time, next_refinement_time,
-                    time_steps_refinement, refinement_database);
-        solution_augmented_ensemble[member].collect_sizes();
+        refined_until_time = std::numeric_limits<double>::max();
+        for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
+        {
+          refined_until_time = std::min(
+              refined_until_time,
+              compute_look_ahead_time(heat_sources_ensemble[mesh], time,
+                                      lead_distance));
+        }
+        if (refined_until_time < std::numeric_limits<double>::max())
+        {
+          next_refinement_time = std::max(refined_until_time, time + time_step);
+          n_refinement_steps = static_cast<unsigned int>(
+              std::ceil((next_refinement_time - time) / time_step));
+        }
       }
 
-      timers[adamantine::refine].stop();
-      if ((global_rank == 0) && (verbose_output == true))
+      for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
       {
-        std::cout << "n_time_step: " << n_time_step << " time: " << time
-                  << " n_dofs: "
-                  << thermal_physics_ensemble[0]->get_dof_handler().n_dofs()
-                  << std::endl;
+        refine_mesh(thermal_physics_ensemble[mesh], mesh_solutions(mesh),
+                    heat_sources_ensemble[mesh], time, next_refinement_time,
+                    n_refinement_steps, refinement_database,
+                    geometry_ensemble[mesh]->get_growth_refinements());
       }
+
+      timers[adamantine::refine].stop();
+      mesh_changes_pending = true;
     }
 
+    if (repartition_needed)
+      mesh_changes_pending = true;
+
     // We use an epsilon to get the "expected" behavior when the deposition
     // time and the time match should match exactly but don't because of
     // floating point accuracy.
     timers[adamantine::add_material_activate].start();
     if (time > activation_time_end)
     {
+      double const eps = time_step / 1e12;
+
       // If we use scan_path_for_duration, we may need to read the scan path
       // file once again.
       if (scan_path_for_duration)
@@ -1821,8 +2306,9 @@ run_ensemble(MPI_Comm const &global_communicator,
         {
           for (auto &source : heat_sources_ensemble[0])
           {
+            auto const &scan_path = source->get_scan_path();
             if (time >
-                source->get_scan_path().get_segment_list().back().end_time)
+                scan_path.get_segment(scan_path.n_segments() - 1).end_time)
             {
               need_updated_scan_path = true;
               break;
@@ -1836,12 +2322,12 @@ run_ensemble(MPI_Comm const &global_communicator,
           // updated scan path file. We assume that the scan paths are identical
           // for all the heat sources and thus, we can use
           // heat_sources_ensemble[0] to get the material deposition boxes and
-          // times. We still need every ensemble member to read the scan path in
-          // order to compute the correct heat sources.
+          // times. We still need the heat sources of every mesh to read the
+          // scan path in order to compute the correct heat sources.
           bool scan_path_end = true;
-          for (unsigned int member = 0; member < local_ensemble_size; ++member)
+          for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
           {
-            for (auto &source : heat_sources_ensemble[member])
+            for (auto &source : heat_sources_ensemble[mesh])
             {
               if (!source->get_scan_path().is_finished())
               {
@@ -1857,56 +2343,122 @@ run_ensemble(MPI_Comm const &global_communicator,
           // sources, we just exit.
           if (scan_path_end)
           {
+            if (mesh_changes_pending)
+            {
+              for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
+                execute_mesh_changes(mesh, true);
+            }
             break;
           }
 
-          std::tie(material_deposition_boxes, deposition_times, deposition_cos,
-                   deposition_sin) =
-              adamantine::create_material_deposition_boxes<dim>(
-                  geometry_database, heat_sources_ensemble[0]);
+          // Restart the deposition using the updated scan paths
+          deposition_stream.reset(time - eps);
+          refined_until_time = std::numeric_limits<double>::lowest();
         }
       }
 
-      double const eps = time_step / 1e12;
+      activation_time_end =
+          std::min(time + std::max(activation_time, time_step), duration) - eps;
+      // Generate the boxes deposited between time and activation_time_end
+      deposition_stream.advance(time - eps, activation_time_end);
+      auto const &material_deposition_boxes = deposition_stream.get_boxes();
+      auto const &deposition_times = deposition_stream.get_times();
+      auto const &deposition_cos = deposition_stream.get_cos();
+      auto const &deposition_sin = deposition_stream.get_sin();
       auto activation_start =
           std::lower_bound(deposition_times.begin(), deposition_times.end(),
                            time - eps) -
           deposition_times.begin();
-      activation_time_end =
-          std::min(time + std::max(activation_time, time_step), duration) - eps;
       auto activation_end =
           std::lower_bound(deposition_times.begin(), deposition_times.end(),
                            activation_time_end) -
           deposition_times.begin();
       if (activation_start < activation_end)
+      {
+        // Refine the coarse cells that are about to receive material.
+        for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
+        {
+          if (grow_domain(*geometry_ensemble[mesh],
+                          thermal_physics_ensemble[mesh], mesh_solutions(mesh),
+                          material_deposition_boxes, activation_start,
+                          activation_end))
+            mesh_changes_pending = true;
+        }
+
+        // Compute the elements to activate between activation_start and
+        // activation_end. The meshes that are the same as the first mesh
+        // share its list of cells.
+        timers[adamantine::add_material_search].start();
+        std::vector<adamantine::ElementsToActivate<dim>>
+            elements_to_activate_ensemble(n_meshes);
+        std::vector<bool> same_cells(n_meshes, false);
+        for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
+        {
+          same_cells[mesh] =
+              (mesh > 0) && activation_search_ensemble[mesh]->has_same_cells(
+                                *activation_search_ensemble[0]);
+          if (!same_cells[mesh])
+          {
+            elements_to_activate_ensemble[mesh] =
+                activation_search_ensemble[mesh]->get_elements_to_activate(
+                    material_deposition_boxes, activation_start,
+                    activation_end);
+          }
+        }
+        timers[adamantine::add_material_search].stop();
+
+        // Every member schedules the activation with the temperature of its
+        // new material.
         for (unsigned int member = 0; member < local_ensemble_size; ++member)
         {
-          // Compute the elements to activate.
-          // TODO Right now, we compute the list of cells that get activated
-          // for the entire material deposition. We should restrict the list
-          // to the cells that are activated between activation_start and
-          // activation_end.
-          auto elements_to_activate = adamantine::get_elements_to_activate(
-              thermal_physics_ensemble[member]->get_dof_handler(),
-              material_deposition_boxes);
-          // For now assume that all deposited material has never been
-          // melted (may or may not be reasonable)
-          std::vector<bool> has_melted(deposition_cos.size(), false);
-
-          thermal_physics_ensemble[member]->add_material(
-              elements_to_activate, deposition_cos, deposition_sin, has_melted,
-              activation_start, activation_end,
-              new_material_temperature[member],
-              solution_augmented_ensemble[member].block(base_state));
-
-          solution_augmented_ensemble[member].collect_sizes();
+          unsigned int const mesh = mesh_of(member);
+          auto &thermal_physics = member_physics(member);
+          // If some of the cells to activate are flagged for refinement, the
+          // refinement is executed first and the cells are searched again on
+          // the refined mesh.
+          if (!thermal_physics->schedule_material(
+                  same_cells[mesh] ? elements_to_activate_ensemble[0]
+                                   : elements_to_activate_ensemble[mesh],
+                  deposition_cos, deposition_sin, activation_start,
+                  activation_end, new_material_temperature[member]))
+          {
+            execute_mesh_changes(mesh, false);
+            elements_to_activate_ensemble[mesh] =
+                activation_search_ensemble[mesh]->get_elements_to_activate(
+                    material_deposition_boxes, activation_start,
+                    activation_end);
+            same_cells[mesh] = false;
+            bool const scheduled = thermal_physics->schedule_material(
+                elements_to_activate_ensemble[mesh], deposition_cos,
+                deposition_sin, activation_start, activation_end,
+                new_material_temperature[member]);
+            adamantine::ASSERT_THROW(
+                scheduled,
+                "Error: Cannot schedule the activation of material.");
+          }
         }
+        // The quiet cells are activated right away, the other cells need a
+        // mesh change.
+        for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
+        {
+          if (thermal_physics_ensemble[mesh]->activate_scheduled_material())
+            mesh_changes_pending = true;
+        }
+        material_added = true;
+      }
+    }
 
-      if ((global_rank == 0) && (verbose_output == true) &&
-          (activation_end - activation_start > 0))
+    // Execute the refinement and the activation in a single mesh update.
+    if (mesh_changes_pending)
+    {
+      for (unsigned int mesh = 0; mesh < n_meshes; ++mesh)
+        execute_mesh_changes(mesh, true);
+      if ((global_rank == 0) && (verbose_output == true))
       {
-        std::cout << "n_dofs after cell activation: "
+        std::cout << "n_time_step: " << n_time_step << " time: " << time
+                  << " n_dofs: "
                   << thermal_physics_ensemble[0]->get_dof_handler().n_dofs()
+                  << (material_added ? " after cell activation" : "")
                   << std::endl;
       }
     }
@@ -1916,21 +2468,48 @@ run_ensemble(MPI_Comm const &global_communicator,
     double const old_time = time;
     timers[adamantine::evol_time].start();
 
-    for (unsigned int member = 0; member < local_ensemble_size; ++member)
+    if (shared_mesh)
+    {
+      // The members sharing the mesh are evolved together. They cannot be
+      // migrated, so they are not timed individually.
+      time = thermal_physics_ensemble[0]->evolve_one_time_step(
+          old_time, time_step, mesh_solutions(0), timers);
+    }
+    else
     {
-      time = thermal_physics_ensemble[member]->evolve_one_time_step(
-          old_time, time_step,
-          solution_augmented_ensemble[member].block(base_state), timers);
+      for (unsigned int member = 0; member < local_ensemble_size; ++member)
+      {
+        auto const member_start = std::chrono::steady_clock::now();
+        time = thermal_physics_ensemble[member]->evolve_one_time_step(
+            old_time, time_step,
+            solution_augmented_ensemble[member].block(base_state), timers);
+        if (member_load_balancer)
+        {
+          member_load_balancer->add_member_timing(
+              member_ids[member],
+              std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            member_start)
+                  .count());
+        }
+      }
     }
     timers[adamantine::evol_time].stop();
 
     // ----- Perform data assimilation -----
     if (assimilate_data)
     {
+      // The local computation of the increments of the analysis started at the
+      // previous time step was overlapped with the time step that was just
+      // performed. The increments, computed from the state before this time
+      // step, are added to the advanced state without correction.
+      if (data_assimilator.analysis_pending())
+        finish_assimilation();
+
       for (unsigned int member = 0; member < local_ensemble_size; ++member)
       {
-        thermal_physics_ensemble[member]->get_affine_constraints().distribute(
-            solution_augmented_ensemble[member].block(base_state));
+        thermal_physics_ensemble[mesh_of(member)]
+            ->get_affine_constraints()
+            .distribute(solution_augmented_ensemble[member].block(base_state));
       }
 
       // Currently assume that all frames are synced so that the 0th camera
@@ -1952,20 +2531,30 @@ run_ensemble(MPI_Comm const &global_communicator,
         adamantine::ASSERT_THROW(
             frame_time > old_time || n_time_step == 1,
             "Unexpectedly missed a data assimilation frame.");
+        // The frames are accumulated and assimilated together every
+        // frames_per_analysis frames.
+        bool const store_frame =
+            data_assimilator.n_stored_frames() + 1 < frames_per_analysis;
         if (global_rank == 0)
-          std::cout << "Performing data assimilation at time " << time << "..."
-                    << std::endl;
+        {
+          std::cout << (store_frame ? "Storing the observations at time "
+                                    : "Performing data assimilation at time ")
+                    << time << "..." << std::endl;
+        }
 
         // Print out the augmented parameters
-        for (unsigned int member = 0; member < local_ensemble_size; ++member)
+        if (!store_frame)
         {
-          std::cout << "Rank: " << global_rank
-                    << " | Old parameters for member "
-                    << first_local_member + member << ": ";
-          for (auto param : solution_augmented_ensemble[member].block(1))
-            std::cout << param << " ";
+          for (unsigned int member = 0; member < local_ensemble_size; ++member)
+          {
+            std::cout << "Rank: " << global_rank
+                      << " | Old parameters for member "
+                      << member_ids[member] << ": ";
+            for (auto param : solution_augmented_ensemble[member].block(1))
+              std::cout << param << " ";
 
-          std::cout << std::endl;
+            std::cout << std::endl;
+          }
         }
 
         timers[adamantine::da_experimental_data].start();
@@ -2013,13 +2602,10 @@ run_ensemble(MPI_Comm const &global_communicator,
                   material_properties_ensemble[0]->get_dof_handler());
         }
 
-        // NOTE: As is, this updates the dof mapping and covariance sparsity
-        // pattern for every data assimilation operation. Strictly, this is
-        // only necessary if the mesh changes (both updates) or the locations
-        // of observations changes (the dof mapping). In practice, changes to
-        // the mesh due to deposition likely cause the updates to be required
-        // for each operation. If this is a bottleneck, it can be fixed in the
-        // future.
+        // The dof mapping and the covariance sparsity pattern are updated for
+        // every data assimilation operation. The DataAssimilator only
+        // recomputes the support points and the localization pattern if the
+        // dofs or the locations of the observations changed.
         timers[adamantine::da_dof_mapping].start();
 #ifdef ADAMANTINE_WITH_CALIPER
         CALI_MARK_BEGIN("da_dof_mapping");
@@ -2040,7 +2626,7 @@ run_ensemble(MPI_Comm const &global_communicator,
 #ifdef ADAMANTINE_WITH_CALIPER
         CALI_MARK_END("da_covariance_sparsity");
 #endif
-        timers[adamantine::da_covariance_sparsity].start();
+        timers[adamantine::da_covariance_sparsity].stop();
 
         unsigned int experimental_data_size = points_values.values.size();
 
@@ -2072,66 +2658,38 @@ run_ensemble(MPI_Comm const &global_communicator,
 #endif
         timers[adamantine::da_obs_covariance].stop();
 
-        // Perform data assimilation to update the augmented state ensemble
+        // Perform data assimilation to update the augmented state ensemble.
+        // If the assimilation is pipelined, the increments are computed while
+        // the next time step is performed and they are added to the advanced
+        // ensemble members.
         timers[adamantine::da_update_ensemble].start();
 #ifdef ADAMANTINE_WITH_CALIPER
         CALI_MARK_BEGIN("da_update_ensemble");
 #endif
-        data_assimilator.update_ensemble(solution_augmented_ensemble,
-                                         points_values.values, R);
+        if (store_frame)
+        {
+          data_assimilator.store_observations(solution_augmented_ensemble,
+                                              points_values.values, R);
+        }
+        else
+        {
+          data_assimilator.start_update_ensemble(solution_augmented_ensemble,
+                                                 points_values.values, R,
+                                                 pipelined_assimilation);
+        }
 #ifdef ADAMANTINE_WITH_CALIPER
         CALI_MARK_END("da_update_ensemble");
 #endif
         timers[adamantine::da_update_ensemble].stop();
 
-        // Extract the parameters from the augmented state
-        for (unsigned int member = 0; member < local_ensemble_size; ++member)
-        {
-          for (unsigned int index = 0;
-               index < augmented_state_parameters.size(); ++index)
-          {
-            // FIXME: Need to consider how we want to generalize this. It
-            // could get unwieldy if we want to specify every parameter of an
-            // arbitrary number of beams.
-            if (augmented_state_parameters.at(index) ==
-                adamantine::AugmentedStateParameters::beam_0_absorption)
-            {
-              database_ensemble[member].put(
-                  "sources.beam_0.absorption_efficiency",
-                  solution_augmented_ensemble[member].block(
-                      augmented_state)[index]);
-            }
-            else if (augmented_state_parameters.at(index) ==
-                     adamantine::AugmentedStateParameters::beam_0_max_power)
-            {
-              database_ensemble[member].put(
-                  "sources.beam_0.max_power",
-                  solution_augmented_ensemble[member].block(
-                      augmented_state)[index]);
-            }
-          }
-        }
-
-        if (global_rank == 0)
-          std::cout << "Done." << std::endl;
-
-        // Print out the augmented parameters
-        for (unsigned int member = 0; member < local_ensemble_size; ++member)
-        {
-          std::cout << "Rank: " << global_rank
-                    << " | New parameters for member "
-                    << first_local_member + member << ": ";
-          for (auto param : solution_augmented_ensemble[member].block(1))
-            std::cout << param << " ";
-
-          std::cout << std::endl;
-        }
+        if (!store_frame && !pipelined_assimilation)
+          finish_assimilation();
       }
 
       // Update the heat source in the ThermalPhysics objects
       for (unsigned int member = 0; member < local_ensemble_size; ++member)
       {
-        thermal_physics_ensemble[member]->update_physics_parameters(
+        member_physics(member)->update_physics_parameters(
             database_ensemble[member].get_child("sources"));
       }
     }
@@ -2139,6 +2697,8 @@ run_ensemble(MPI_Comm const &global_communicator,
     // ----- Checkpoint the ensemble members -----
     if (n_time_step % time_steps_checkpoint == 0)
     {
+      if (data_assimilator.analysis_pending())
+        finish_assimilation();
 #ifdef ADAMANTINE_WITH_CALIPER
       CALI_MARK_BEGIN("save checkpoint");
 #endif
@@ -2152,8 +2712,8 @@ run_ensemble(MPI_Comm const &global_communicator,
               : checkpoint_filename + '_' + std::to_string(n_time_step);
       for (unsigned int member = 0; member < local_ensemble_size; ++member)
       {
-        thermal_physics_ensemble[member]->save_checkpoint(
-            filename_prefix + '_' + std::to_string(first_local_member + member),
+        member_physics(member)->save_checkpoint(
+            filename_prefix + '_' + std::to_string(member_ids[member]),
             solution_augmented_ensemble[member].block(base_state));
       }
       std::ofstream file{filename_prefix + "_time.txt"};
@@ -2183,15 +2743,25 @@ run_ensemble(MPI_Comm const &global_communicator,
     {
       for (unsigned int member = 0; member < local_ensemble_size; ++member)
       {
-        thermal_physics_ensemble[member]->set_state_to_material_properties();
+        auto &thermal_physics = member_physics(member);
+        thermal_physics->set_state_to_material_properties();
         output_pvtu(*post_processor_ensemble[member], n_time_step, time,
-                    thermal_physics_ensemble[member],
+                    thermal_physics,
                     solution_augmented_ensemble[member].block(base_state),
                     mechanical_physics, displacement,
-                    *material_properties_ensemble[member], timers);
+                    *material_properties_ensemble[mesh_of(member)], timers);
       }
     }
 
+    // ----- Balance the ensemble members -----
+    // The members are only moved between two analyses.
+    if (member_load_balancer && (n_time_step % time_steps_balancing == 0) &&
+        !data_assimilator.analysis_pending() &&
+        (data_assimilator.n_stored_frames() == 0))
+    {
+      migrate_members();
+    }
+
     ++n_time_step;
   }
 
@@ -2199,6 +2769,9 @@ run_ensemble(MPI_Comm const &global_communicator,
   CALI_CXX_MARK_LOOP_END(main_loop_id);
 #endif
 
+  if (data_assimilator.analysis_pending())
+    finish_assimilation();
+
   for (unsigned int member = 0; member < local_ensemble_size; ++member)
   {
     post_processor_ensemble[member]->write_pvd();
@@ -2209,8 +2782,9 @@ run_ensemble(MPI_Comm const &global_communicator,
   {
     for (unsigned int member = 0; member < local_ensemble_size; ++member)
     {
-      thermal_physics_ensemble[member]->get_affine_constraints().distribute(
-          solution_augmented_ensemble[member].block(base_state));
+      thermal_physics_ensemble[mesh_of(member)]
+          ->get_affine_constraints()
+          .distribute(solution_augmented_ensemble[member].block(base_state));
     }
     return solution_augmented_ensemble;
   }
@@ -2231,8 +2805,9 @@ run_ensemble(MPI_Comm const &global_communicator,
       solution_augmented_ensemble_host[member].block(0).import(
           solution_augmented_ensemble[member].block(0),
           dealii::VectorOperation::insert);
-      thermal_physics_ensemble[member]->get_affine_constraints().distribute(
-          solution_augmented_ensemble_host[member].block(0));
+      thermal_physics_ensemble[mesh_of(member)]
+          ->get_affine_constraints()
+          .distribute(solution_augmented_ensemble_host[member].block(0));
 
       solution_augmented_ensemble_host[member].block(1).reinit(
           solution_augmented_ensemble[member].block(0).get_partitioner());
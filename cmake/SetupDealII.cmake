@@ -3,7 +3,7 @@ find_package(deal.II 9.5 REQUIRED PATHS ${DEAL_II_DIR})
 
 deal_ii_initialize_cached_variables()
 
-set(DEAL_II_REQUIRED_FEATURES ARBORX CXX17 MPI P4EST TRILINOS)
+set(DEAL_II_REQUIRED_FEATURES ARBORX CXX17 LAPACK MPI P4EST TRILINOS)
 
 foreach(FEATURE ${DEAL_II_REQUIRED_FEATURES})
   if(NOT DEAL_II_WITH_${FEATURE})
@@ -0,0 +1,107 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <CellCostModel.hh>
+
+#include <deal.II/base/mpi.h>
+
+#include <vector>
+
+namespace adamantine
+{
+CellCostModel::CellCostModel(MPI_Comm const &communicator)
+    : _communicator(communicator)
+{
+  _cell_time.fill(0.);
+  _n_cells.fill(0.);
+  _cell_cost.fill(1.);
+}
+
+void CellCostModel::add_cell_timing(Category const category,
+                                    unsigned int const n_cells,
+                                    double const seconds)
+{
+  unsigned int const c = static_cast<unsigned int>(category);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _cell_time[c] += seconds;
+  _n_cells[c] += n_cells;
+}
+
+void CellCostModel::add_face_timing(unsigned int const n_faces,
+                                    double const seconds)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _face_time += seconds;
+  _n_faces += n_faces;
+}
+
+double CellCostModel::get_imbalance() const
+{
+  double local_time = 0.;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    local_time = _face_time;
+    for (auto const time : _cell_time)
+      local_time += time;
+  }
+  auto const time =
+      dealii::Utilities::MPI::min_max_avg(local_time, _communicator);
+
+  return time.avg > 0. ? time.max / time.avg : 1.;
+}
+
+void CellCostModel::calibrate()
+{
+  // Use the timings of all the processors so that the costs are the same
+  // everywhere.
+  std::vector<double> timings(2 * _n_categories + 2);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (unsigned int c = 0; c < _n_categories; ++c)
+    {
+      timings[2 * c] = _cell_time[c];
+      timings[2 * c + 1] = _n_cells[c];
+    }
+    timings[2 * _n_categories] = _face_time;
+    timings[2 * _n_categories + 1] = _n_faces;
+  }
+  timings = dealii::Utilities::MPI::sum(timings, _communicator);
+
+  unsigned int const regular = static_cast<unsigned int>(Category::regular);
+  if ((timings[2 * regular] <= 0.) || (timings[2 * regular + 1] <= 0.))
+    return;
+  double const regular_time = timings[2 * regular] / timings[2 * regular + 1];
+
+  for (unsigned int c = 0; c < _n_categories; ++c)
+  {
+    if (timings[2 * c + 1] > 0.)
+      _cell_cost[c] = timings[2 * c] / timings[2 * c + 1] / regular_time;
+  }
+  if (timings[2 * _n_categories + 1] > 0.)
+    _face_cost = timings[2 * _n_categories] /
+                 timings[2 * _n_categories + 1] / regular_time;
+}
+
+void CellCostModel::reset()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _cell_time.fill(0.);
+  _n_cells.fill(0.);
+  _face_time = 0.;
+  _n_faces = 0.;
+}
+
+double CellCostModel::get_cell_cost(Category const category) const
+{
+  return _cell_cost[static_cast<unsigned int>(category)];
+}
+
+double CellCostModel::get_face_cost() const
+{
+  return _face_cost;
+}
+} // namespace adamantine
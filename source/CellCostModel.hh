@@ -0,0 +1,128 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CELL_COST_MODEL_HH
+#define CELL_COST_MODEL_HH
+
+#include <mpi.h>
+
+#include <array>
+#include <mutex>
+
+namespace adamantine
+{
+/**
+ * This class models the cost of applying the thermal operator on a cell. The
+ * cells are sorted in categories whose costs differ: cells far from the heat
+ * sources without phase change, cells under a heat source, and cells
+ * undergoing a phase change. Faces at the boundary of the activated domain add
+ * to the cost of their cell. The cost of each category, relative to the cost
+ * of a regular cell, is calibrated from the time spent on the cell batches and
+ * the face batches during the operator evaluations.
+ */
+class CellCostModel
+{
+public:
+  /**
+   * Category of a cell.
+   */
+  enum class Category
+  {
+    regular,
+    heat_source,
+    phase_change,
+    n_categories
+  };
+
+  /**
+   * Constructor.
+   */
+  CellCostModel(MPI_Comm const &communicator);
+
+  /**
+   * Add the time spent on @p n_cells cells of the given category. This
+   * function is thread-safe.
+   */
+  void add_cell_timing(Category const category, unsigned int const n_cells,
+                       double const seconds);
+
+  /**
+   * Add the time spent on @p n_faces faces at the boundary of the activated
+   * domain. This function is thread-safe.
+   */
+  void add_face_timing(unsigned int const n_faces, double const seconds);
+
+  /**
+   * Return the ratio between the largest and the average time spent by the
+   * processors since the last reset. This is a collective operation.
+   */
+  double get_imbalance() const;
+
+  /**
+   * Update the relative costs using the timings of all the processors since
+   * the last reset. The categories without timings keep their previous cost.
+   * This is a collective operation.
+   */
+  void calibrate();
+
+  /**
+   * Discard the timings. This needs to be called when the mesh changes.
+   */
+  void reset();
+
+  /**
+   * Return the cost of a cell of the given category relative to the cost of a
+   * regular cell.
+   */
+  double get_cell_cost(Category const category) const;
+
+  /**
+   * Return the cost of a face at the boundary of the activated domain relative
+   * to the cost of a regular cell.
+   */
+  double get_face_cost() const;
+
+private:
+  static unsigned int constexpr _n_categories =
+      static_cast<unsigned int>(Category::n_categories);
+
+  /**
+   * MPI communicator.
+   */
+  MPI_Comm _communicator;
+  /**
+   * Mutex protecting the timings.
+   */
+  mutable std::mutex _mutex;
+  /**
+   * Time spent on the cells of each category.
+   */
+  std::array<double, _n_categories> _cell_time;
+  /**
+   * Number of cells timed for each category.
+   */
+  std::array<double, _n_categories> _n_cells;
+  /**
+   * Time spent on the faces.
+   */
+  double _face_time = 0.;
+  /**
+   * Number of faces timed.
+   */
+  double _n_faces = 0.;
+  /**
+   * Cost of each category relative to the cost of a regular cell.
+   */
+  std::array<double, _n_categories> _cell_cost;
+  /**
+   * Cost of a face relative to the cost of a regular cell.
+   */
+  double _face_cost = 0.;
+};
+} // namespace adamantine
+
+#endif
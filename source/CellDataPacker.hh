@@ -0,0 +1,274 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CELL_DATA_PACKER_HH
+#define CELL_DATA_PACKER_HH
+
+#include <utils.hh>
+
+#include <deal.II/base/memory_space.h>
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/grid/filtered_iterator.h>
+
+#include <Kokkos_Core.hpp>
+
+#include <array>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace adamantine
+{
+/**
+ * Layout of the data attached to each cell when the mesh changes or when the
+ * simulation is checkpointed: the ratio of each material state, the cosine and
+ * the sine of the deposition angle, the melting indicator, the quiet cell
+ * indicator, and the active FE index of the cell.
+ */
+template <typename MaterialStates>
+struct CellPayload
+{
+  static unsigned int constexpr n_material_states =
+      MaterialStates::n_material_states;
+  static unsigned int constexpr cos = n_material_states;
+  static unsigned int constexpr sin = n_material_states + 1;
+  static unsigned int constexpr has_melted = n_material_states + 2;
+  static unsigned int constexpr quiet = n_material_states + 3;
+  static unsigned int constexpr fe_index = n_material_states + 4;
+  static unsigned int constexpr size = n_material_states + 5;
+
+  using value_type = std::array<double, size>;
+};
+
+/**
+ * This class packs the CellPayload of all the active cells in a single
+ * contiguous buffer that can be given to CellDataTransfer. The buffer has one
+ * entry per active cell ordered by active cell index. Only the entries of the
+ * locally owned cells are meaningful. The material states are copied between
+ * the buffer and the memory space of the states without creating a host copy
+ * of the states.
+ */
+template <int dim, typename MaterialStates, typename MemorySpaceType>
+class CellDataPacker
+{
+public:
+  using Payload = CellPayload<MaterialStates>;
+  using Buffer = std::vector<typename Payload::value_type>;
+  using StateView =
+      Kokkos::View<double **, typename MemorySpaceType::kokkos_space>;
+
+  static_assert(sizeof(typename Payload::value_type) ==
+                    Payload::size * sizeof(double),
+                "The payload of a cell must be contiguous.");
+
+  /**
+   * Constructor.
+   */
+  CellDataPacker(dealii::DoFHandler<dim> const &dof_handler);
+
+  /**
+   * Pack the states of all the locally owned cells, and the deposition angles
+   * and the melting indicators of the cells that have material.
+   */
+  Buffer &pack(StateView state, std::vector<double> const &deposition_cos,
+               std::vector<double> const &deposition_sin,
+               std::vector<bool> const &has_melted);
+
+  /**
+   * Resize the buffer to the number of active cells of the current mesh. This
+   * needs to be called before the buffer is filled by CellDataTransfer.
+   */
+  Buffer &prepare_unpack();
+
+  /**
+   * Unpack the states of the locally owned cells, and the deposition angles and
+   * the melting indicators of the cells that have material. @p state must
+   * already have the size of the current mesh.
+   */
+  void unpack(StateView state, std::vector<double> &deposition_cos,
+              std::vector<double> &deposition_sin,
+              std::vector<bool> &has_melted) const;
+
+  /**
+   * Return the payload of the given cell.
+   */
+  typename Payload::value_type &operator[](
+      typename dealii::DoFHandler<dim>::active_cell_iterator const &cell);
+
+  /**
+   * Return the buffer.
+   */
+  Buffer &get_buffer();
+
+private:
+  /**
+   * Copy the states between the buffer and @p state. If @p pack is true, the
+   * states are copied in the buffer.
+   */
+  void copy_states(StateView state, bool const pack) const;
+
+  /**
+   * Associated DoFHandler.
+   */
+  dealii::DoFHandler<dim> const &_dof_handler;
+  /**
+   * Payload of all the active cells.
+   */
+  mutable Buffer _buffer;
+};
+
+template <int dim, typename MaterialStates, typename MemorySpaceType>
+CellDataPacker<dim, MaterialStates, MemorySpaceType>::CellDataPacker(
+    dealii::DoFHandler<dim> const &dof_handler)
+    : _dof_handler(dof_handler)
+{
+}
+
+template <int dim, typename MaterialStates, typename MemorySpaceType>
+typename CellDataPacker<dim, MaterialStates, MemorySpaceType>::Buffer &
+CellDataPacker<dim, MaterialStates, MemorySpaceType>::pack(
+    StateView state, std::vector<double> const &deposition_cos,
+    std::vector<double> const &deposition_sin,
+    std::vector<bool> const &has_melted)
+{
+  typename Payload::value_type dummy_payload;
+  dummy_payload.fill(std::numeric_limits<double>::infinity());
+  _buffer.assign(_dof_handler.get_triangulation().n_active_cells(),
+                 dummy_payload);
+
+  unsigned int activated_cell_id = 0;
+  for (auto const &cell : dealii::filter_iterators(
+           _dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    auto &payload = _buffer[cell->active_cell_index()];
+    payload[Payload::fe_index] = cell->active_fe_index();
+    payload[Payload::quiet] = 0.;
+    if (cell->active_fe_index() == 0)
+    {
+      payload[Payload::cos] = deposition_cos[activated_cell_id];
+      payload[Payload::sin] = deposition_sin[activated_cell_id];
+      payload[Payload::has_melted] = has_melted[activated_cell_id] ? 1. : 0.;
+      ++activated_cell_id;
+    }
+  }
+
+  copy_states(state, true);
+
+  return _buffer;
+}
+
+template <int dim, typename MaterialStates, typename MemorySpaceType>
+typename CellDataPacker<dim, MaterialStates, MemorySpaceType>::Buffer &
+CellDataPacker<dim, MaterialStates, MemorySpaceType>::prepare_unpack()
+{
+  _buffer.resize(_dof_handler.get_triangulation().n_active_cells());
+
+  return _buffer;
+}
+
+template <int dim, typename MaterialStates, typename MemorySpaceType>
+void CellDataPacker<dim, MaterialStates, MemorySpaceType>::unpack(
+    StateView state, std::vector<double> &deposition_cos,
+    std::vector<double> &deposition_sin, std::vector<bool> &has_melted) const
+{
+  ASSERT(_buffer.size() == _dof_handler.get_triangulation().n_active_cells(),
+         "The buffer does not match the mesh.");
+
+  deposition_cos.clear();
+  deposition_sin.clear();
+  has_melted.clear();
+  for (auto const &cell : dealii::filter_iterators(
+           _dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell(),
+           dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
+  {
+    auto const &payload = _buffer[cell->active_cell_index()];
+    deposition_cos.push_back(payload[Payload::cos]);
+    deposition_sin.push_back(payload[Payload::sin]);
+    has_melted.push_back(payload[Payload::has_melted] > 0.5);
+  }
+
+  copy_states(state, false);
+}
+
+template <int dim, typename MaterialStates, typename MemorySpaceType>
+typename CellDataPacker<dim, MaterialStates, MemorySpaceType>::Payload::
+    value_type &
+    CellDataPacker<dim, MaterialStates, MemorySpaceType>::operator[](
+        typename dealii::DoFHandler<dim>::active_cell_iterator const &cell)
+{
+  return _buffer[cell->active_cell_index()];
+}
+
+template <int dim, typename MaterialStates, typename MemorySpaceType>
+typename CellDataPacker<dim, MaterialStates, MemorySpaceType>::Buffer &
+CellDataPacker<dim, MaterialStates, MemorySpaceType>::get_buffer()
+{
+  return _buffer;
+}
+
+template <int dim, typename MaterialStates, typename MemorySpaceType>
+void CellDataPacker<dim, MaterialStates, MemorySpaceType>::copy_states(
+    StateView state, bool const pack) const
+{
+  using kokkos_space = typename MemorySpaceType::kokkos_space;
+  using ExecutionSpace = std::conditional_t<
+      std::is_same_v<MemorySpaceType, dealii::MemorySpace::Host>,
+      Kokkos::DefaultHostExecutionSpace, Kokkos::DefaultExecutionSpace>;
+
+  // The states are indexed by locally owned cells while the buffer is indexed
+  // by active cells.
+  std::vector<unsigned int> active_cell_indices;
+  active_cell_indices.reserve(state.extent(1));
+  for (auto const &cell : dealii::filter_iterators(
+           _dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+    active_cell_indices.push_back(cell->active_cell_index());
+  ASSERT(active_cell_indices.size() == state.extent(1),
+         "The states do not match the mesh.");
+
+  // On the host, the views below alias the buffer and no copy is performed.
+  Kokkos::View<double **, Kokkos::LayoutRight, Kokkos::HostSpace,
+               Kokkos::MemoryTraits<Kokkos::Unmanaged>>
+      buffer_host(reinterpret_cast<double *>(_buffer.data()), _buffer.size(),
+                  Payload::size);
+  Kokkos::View<unsigned int *, Kokkos::HostSpace,
+               Kokkos::MemoryTraits<Kokkos::Unmanaged>>
+      indices_host(active_cell_indices.data(), active_cell_indices.size());
+  auto buffer =
+      Kokkos::create_mirror_view_and_copy(kokkos_space{}, buffer_host);
+  auto indices =
+      Kokkos::create_mirror_view_and_copy(kokkos_space{}, indices_host);
+
+  unsigned int constexpr n_material_states = Payload::n_material_states;
+  if (pack)
+  {
+    Kokkos::parallel_for(
+        "adamantine::pack_cell_states",
+        Kokkos::RangePolicy<ExecutionSpace>(0, indices.extent(0)),
+        KOKKOS_LAMBDA(int i) {
+          for (unsigned int j = 0; j < n_material_states; ++j)
+            buffer(indices(i), j) = state(j, i);
+        });
+    Kokkos::deep_copy(buffer_host, buffer);
+  }
+  else
+  {
+    Kokkos::parallel_for(
+        "adamantine::unpack_cell_states",
+        Kokkos::RangePolicy<ExecutionSpace>(0, indices.extent(0)),
+        KOKKOS_LAMBDA(int i) {
+          for (unsigned int j = 0; j < n_material_states; ++j)
+            state(j, i) = buffer(indices(i), j);
+        });
+    Kokkos::fence();
+  }
+}
+} // namespace adamantine
+
+#endif
@@ -64,6 +64,17 @@ double CubeHeatSource<dim>::get_current_height(double const /*time*/) const
   return _max_point[axis<dim>::z];
 }
 
+template <int dim>
+std::optional<dealii::BoundingBox<dim>>
+CubeHeatSource<dim>::get_bounding_box(double const /*height*/,
+                                      double const cutoff) const
+{
+  if ((!_source_on) || ((cutoff > 0.) && (_value <= cutoff)))
+    return {};
+
+  return dealii::BoundingBox<dim>(std::make_pair(_min_point, _max_point));
+}
+
 } // namespace adamantine
 
 INSTANTIATE_DIM(CubeHeatSource)
@@ -51,6 +51,12 @@ public:
    */
   double get_current_height(double const time) const final;
 
+  /**
+   * Return the cube if the source is on.
+   */
+  std::optional<dealii::BoundingBox<dim>>
+  get_bounding_box(double const height, double const cutoff) const final;
+
 private:
   bool _source_on = false;
   double _start_time;
@@ -8,21 +8,31 @@
 #include <DataAssimilator.hh>
 #include <utils.hh>
 
-#include <deal.II/arborx/distributed_tree.h>
+#include <deal.II/arborx/bvh.h>
+#include <deal.II/base/array_view.h>
 #include <deal.II/base/index_set.h>
 #include <deal.II/base/mpi.h>
 #include <deal.II/dofs/dof_tools.h>
 #include <deal.II/fe/mapping_q1.h>
+#include <deal.II/grid/filtered_iterator.h>
 #include <deal.II/lac/block_vector.h>
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
 #include <deal.II/lac/la_parallel_block_vector.h>
+#include <deal.II/lac/lapack_full_matrix.h>
 #include <deal.II/lac/linear_operator_tools.h>
 #include <deal.II/lac/read_write_vector.h>
-#include <deal.II/lac/trilinos_sparse_matrix.h>
 #include <deal.II/lac/vector_operation.h>
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/functional/hash.hpp>
 
-#include <ArborX.hpp>
+#include <Kokkos_Core.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <string>
 
 #ifdef ADAMANTINE_WITH_CALIPER
 #include <caliper/cali.h>
@@ -30,6 +40,204 @@
 
 namespace adamantine
 {
+namespace
+{
+/**
+ * Compute the Cholesky factor @p L of the symmetric matrix @p A such that
+ * A = L L^T. Return false if @p A is not positive definite.
+ */
+bool cholesky_factorization(dealii::FullMatrix<double> const &A,
+                            dealii::FullMatrix<double> &L)
+{
+  L.reinit(A.m(), A.n());
+  try
+  {
+    L.cholesky(A);
+  }
+  catch (dealii::ExceptionBase const &)
+  {
+    return false;
+  }
+  // A zero pivot is not detected by FullMatrix::cholesky
+  for (unsigned int i = 0; i < L.m(); ++i)
+    if (!(L(i, i) > 0.))
+      return false;
+
+  return true;
+}
+
+/**
+ * Solve L L^T X = B where L is the Cholesky factor computed by
+ * cholesky_factorization(). @p B is overwritten by X. Each column of @p B is a
+ * right-hand side.
+ */
+void cholesky_solve(dealii::FullMatrix<double> const &L,
+                    dealii::FullMatrix<double> &B)
+{
+  dealii::FullMatrix<double> L_transpose;
+  L_transpose.copy_transposed(L);
+  unsigned int const n = L.m();
+  dealii::Vector<double> rhs(n);
+  dealii::Vector<double> y(n);
+  dealii::Vector<double> x(n);
+  for (unsigned int r = 0; r < B.n(); ++r)
+  {
+    for (unsigned int i = 0; i < n; ++i)
+      rhs(i) = B(i, r);
+    L.forward(y, rhs);
+    L_transpose.backward(x, y);
+    for (unsigned int i = 0; i < n; ++i)
+      B(i, r) = x(i);
+  }
+}
+
+/**
+ * Return the anomalies of the ensemble, i.e., the difference between each
+ * ensemble member and the ensemble mean. The anomaly of each member is a
+ * column of the returned matrix.
+ */
+dealii::FullMatrix<double>
+compute_anomalies(std::vector<dealii::Vector<double>> const &ensemble)
+{
+  unsigned int const n_members = ensemble.size();
+  unsigned int const size = ensemble[0].size();
+  dealii::Vector<double> mean(size);
+  for (auto const &member : ensemble)
+    mean += member;
+  mean /= n_members;
+
+  dealii::FullMatrix<double> anomaly(size, n_members);
+  for (unsigned int k = 0; k < n_members; ++k)
+    for (unsigned int i = 0; i < size; ++i)
+      anomaly(i, k) = ensemble[k][i] - mean[i];
+
+  return anomaly;
+}
+
+/**
+ * Buffers used by compute_ensemble_transform(). The local analyses of the LETKF
+ * reuse the same buffers on each thread instead of allocating them for every
+ * entry.
+ */
+struct EnsembleTransformScratch
+{
+  dealii::FullMatrix<double> M;
+  dealii::Vector<double> rhs;
+  dealii::LAPACKFullMatrix<double> M_lapack;
+  dealii::Vector<double> eigenvalues;
+  dealii::FullMatrix<double> Q;
+  dealii::Vector<double> mean_weights;
+  dealii::Vector<double> projected_rhs;
+  dealii::FullMatrix<double> transform;
+};
+
+/**
+ * Compute the transform G of the ETKF such that the increments of the ensemble
+ * members are X' G where X' are the anomalies of the ensemble. @p C is
+ * Y'^T R^-1 and @p Y is Y', the anomalies of the observed ensemble members.
+ * @p innovation is the difference between the observations and the mean of
+ * the observed ensemble members. Only the observations in @p observations are
+ * used and the contribution of each one is multiplied by its localization
+ * weight in @p weights. The transform is stored in @p scratch.
+ */
+dealii::FullMatrix<double> const &
+compute_ensemble_transform(dealii::FullMatrix<double> const &C,
+                           dealii::FullMatrix<double> const &Y,
+                           dealii::Vector<double> const &innovation,
+                           dealii::ArrayView<unsigned int const> observations,
+                           dealii::ArrayView<double const> weights,
+                           EnsembleTransformScratch &scratch)
+{
+  unsigned int const n_members = C.m();
+  auto &M = scratch.M;
+  auto &rhs = scratch.rhs;
+  auto &eigenvalues = scratch.eigenvalues;
+  auto &Q = scratch.Q;
+
+  // Inverse of the analysis covariance in the ensemble space,
+  // (N-1) I + Y'^T R^-1 Y', and the right-hand side of the mean update,
+  // Y'^T R^-1 (y - mean(HX)).
+  M.reinit(n_members, n_members);
+  rhs.reinit(n_members);
+  for (unsigned int pos = 0; pos < observations.size(); ++pos)
+  {
+    unsigned int const j = observations[pos];
+    if (weights[pos] == 0.)
+      continue;
+    for (unsigned int k = 0; k < n_members; ++k)
+    {
+      double const c_kj = weights[pos] * C(k, j);
+      rhs(k) += c_kj * innovation(j);
+      for (unsigned int l = 0; l < n_members; ++l)
+        M(k, l) += c_kj * Y(j, l);
+    }
+  }
+  // The localization of a non-diagonal R breaks the symmetry
+  M.symmetrize();
+  for (unsigned int k = 0; k < n_members; ++k)
+    M(k, k) += n_members - 1.;
+
+  // M is positive definite, so all its eigenvalues are in (0, max]. The
+  // eigenvectors are the columns of Q.
+  scratch.M_lapack.reinit(n_members);
+  scratch.M_lapack = M;
+  scratch.M_lapack.compute_eigenvalues_symmetric(
+      0., std::numeric_limits<double>::max(), 0., eigenvalues, Q);
+  ASSERT_THROW(eigenvalues.size() == n_members,
+               "Error: The analysis covariance is not positive definite.");
+
+  // Weights of the mean update, Q Lambda^-1 Q^T rhs
+  scratch.mean_weights.reinit(n_members);
+  scratch.projected_rhs.reinit(n_members);
+  Q.Tvmult(scratch.projected_rhs, rhs);
+  for (unsigned int k = 0; k < n_members; ++k)
+    scratch.projected_rhs(k) /= eigenvalues(k);
+  Q.vmult(scratch.mean_weights, scratch.projected_rhs);
+
+  // Symmetric square root of the analysis covariance,
+  // sqrt(N-1) Q Lambda^-1/2 Q^T, to which the mean update is added and the
+  // forecast is removed.
+  auto &transform = scratch.transform;
+  transform.reinit(n_members, n_members);
+  for (unsigned int k = 0; k < n_members; ++k)
+  {
+    for (unsigned int l = 0; l < n_members; ++l)
+    {
+      double value = 0.;
+      for (unsigned int e = 0; e < n_members; ++e)
+        value += Q(k, e) * Q(l, e) / std::sqrt(eigenvalues(e));
+      transform(k, l) = std::sqrt(n_members - 1.) * value +
+                        scratch.mean_weights(k) - (k == l ? 1. : 0.);
+    }
+  }
+
+  return transform;
+}
+
+/**
+ * Execute @p functor for the indices [0, n). If @p serial is true, the loop is
+ * executed by the calling thread. This is used when the analysis runs on a
+ * background thread, since the host execution space can only be used by one
+ * thread at a time.
+ */
+template <typename Functor>
+void host_for(std::string const &label, unsigned int const n,
+              bool const serial, Functor const &functor)
+{
+  if (serial)
+  {
+    for (unsigned int i = 0; i < n; ++i)
+      functor(i);
+  }
+  else
+  {
+    Kokkos::parallel_for(
+        label, Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, n),
+        functor);
+  }
+}
+} // namespace
+
 
 DataAssimilator::DataAssimilator(MPI_Comm const &global_communicator,
                                  MPI_Comm const &local_communicator, int color,
@@ -41,12 +249,56 @@ DataAssimilator::DataAssimilator(MPI_Comm const &global_communicator,
   _global_comm_size =
       dealii::Utilities::MPI::n_mpi_processes(_global_communicator);
 
-  // We need all the processors to know the cutoff distance for ArborX
-  // DistributedTree to work correctly.
+  // All the processors localize the covariance of their slice, so they all
+  // need the localization parameters.
   // PropertyTreeInput data_assimilation.localization_cutoff_distance
   _localization_cutoff_distance = database.get(
       "localization_cutoff_distance", std::numeric_limits<double>::max());
 
+  // PropertyTreeInput data_assimilation.localization_cutoff_function
+  std::string localization_cutoff_function_str =
+      database.get("localization_cutoff_function", "none");
+
+  if (boost::iequals(localization_cutoff_function_str, "gaspari_cohn"))
+  {
+    _localization_cutoff_function = LocalizationCutoff::gaspari_cohn;
+  }
+  else if (boost::iequals(localization_cutoff_function_str, "step_function"))
+  {
+    _localization_cutoff_function = LocalizationCutoff::step_function;
+  }
+  else if (boost::iequals(localization_cutoff_function_str, "none"))
+  {
+    _localization_cutoff_function = LocalizationCutoff::none;
+  }
+  else
+  {
+    ASSERT_THROW(false,
+                 "Error: Unknown localization cutoff function. Valid options "
+                 "are 'gaspari_cohn', 'step_function', and 'none'.");
+  }
+
+  // PropertyTreeInput data_assimilation.analysis
+  std::string analysis_str = database.get("analysis", "enkf");
+
+  if (boost::iequals(analysis_str, "enkf"))
+  {
+    _analysis_scheme = AnalysisScheme::enkf;
+  }
+  else if (boost::iequals(analysis_str, "etkf"))
+  {
+    _analysis_scheme = AnalysisScheme::etkf;
+  }
+  else if (boost::iequals(analysis_str, "letkf"))
+  {
+    _analysis_scheme = AnalysisScheme::letkf;
+  }
+  else
+  {
+    ASSERT_THROW(false, "Error: Unknown analysis scheme. Valid options are "
+                        "'enkf', 'etkf', and 'letkf'.");
+  }
+
   if (_global_rank == 0)
   {
     // Set the solver parameters from the input database
@@ -65,29 +317,6 @@ DataAssimilator::DataAssimilator(MPI_Comm const &global_communicator,
     if (boost::optional<double> tolerance =
             database.get_optional<double>("solver.convergence_tolerance"))
       _solver_control.set_tolerance(*tolerance);
-
-    // PropertyTreeInput data_assimilation.localization_cutoff_function
-    std::string localization_cutoff_function_str =
-        database.get("localization_cutoff_function", "none");
-
-    if (boost::iequals(localization_cutoff_function_str, "gaspari_cohn"))
-    {
-      _localization_cutoff_function = LocalizationCutoff::gaspari_cohn;
-    }
-    else if (boost::iequals(localization_cutoff_function_str, "step_function"))
-    {
-      _localization_cutoff_function = LocalizationCutoff::step_function;
-    }
-    else if (boost::iequals(localization_cutoff_function_str, "none"))
-    {
-      _localization_cutoff_function = LocalizationCutoff::none;
-    }
-    else
-    {
-      ASSERT_THROW(false,
-                   "Error: Unknown localization cutoff function. Valid options "
-                   "are 'gaspari_cohn', 'step_function', and 'none'.");
-    }
   }
 }
 
@@ -96,387 +325,969 @@ void DataAssimilator::update_ensemble(
         &augmented_state_ensemble,
     std::vector<double> const &expt_data, dealii::SparseMatrix<double> const &R)
 {
+  start_update_ensemble(augmented_state_ensemble, expt_data, R, false);
+  finish_update_ensemble(augmented_state_ensemble);
+}
 
-  std::vector<dealii::LA::distributed::BlockVector<double>>
-      global_augmented_state_ensemble;
-  std::vector<unsigned int> local_n_ensemble_members(_global_comm_size);
-  std::vector<block_size_type> block_sizes(2, 0);
+void DataAssimilator::start_update_ensemble(
+    std::vector<dealii::LA::distributed::BlockVector<double>> const
+        &augmented_state_ensemble,
+    std::vector<double> const &expt_data, dealii::SparseMatrix<double> const &R,
+    bool const background)
+{
+  ASSERT(!analysis_pending(), "The pending analysis has not been applied.");
 
-  gather_ensemble_members(augmented_state_ensemble,
-                          global_augmented_state_ensemble,
-                          local_n_ensemble_members, block_sizes);
+  // Set some constants
+  int constexpr base_state = 0;
+  int constexpr augmented_state = 1;
+  _sim_size = augmented_state_ensemble[0].block(base_state).size();
+  _parameter_size = augmented_state_ensemble[0].block(augmented_state).size();
+  compute_slice_offsets();
 
+  adamantine::ASSERT_THROW(_expt_size == expt_data.size(),
+                           "Error: Unexpected experiment vector size.");
+
+  // Get the perturbed innovation, ( y+u - Hx )
+  // This is determined using the unaugmented state because the parameters
+  // are not observable
   if (_global_rank == 0)
-  {
-    // Set some constants
-    _num_ensemble_members = global_augmented_state_ensemble.size();
-    _sim_size = block_sizes[0];
-    _parameter_size = block_sizes[1];
+    std::cout << "Getting the perturbed innovation..." << std::endl;
 
-    adamantine::ASSERT_THROW(_expt_size == expt_data.size(),
-                             "Error: Unexpected experiment vector size.");
+#ifdef ADAMANTINE_WITH_CALIPER
+  CALI_MARK_BEGIN("da_get_pert_inno");
+#endif
 
+  std::vector<dealii::Vector<double>> HX =
+      observe_ensemble_members(augmented_state_ensemble);
+
+  // Move the ensemble members to the slices. After this, every processor has
+  // its slice of all the ensemble members.
+  _slice_entries =
+      distribute_ensemble_members(augmented_state_ensemble, _slice_ensemble);
+
+  // The stored frames are assimilated together with the current frame. The
+  // observations of the stored frames are compared to the ensemble members at
+  // their own time, while the covariance with the current state is used to
+  // spread the increments (asynchronous EnKF).
+  std::vector<double> batched_expt_data;
+  dealii::SparsityPattern batched_R_pattern;
+  dealii::SparseMatrix<double> batched_R;
+  bool const batched = !_stored_frames.empty();
+  if (batched)
+  {
+    push_observation_frame(expt_data, HX, R);
+    unsigned int batched_size = 0;
+    for (auto const &frame : _stored_frames)
+      batched_size += frame.expt_data.size();
+
+    // The observations of the frames are concatenated and R is block diagonal.
+    std::vector<dealii::Point<3>> batched_support_points;
+    std::vector<dealii::Vector<double>> batched_HX(
+        _num_ensemble_members, dealii::Vector<double>(batched_size));
+    dealii::DynamicSparsityPattern dsp(batched_size, batched_size);
+    unsigned int offset = 0;
+    for (auto const &frame : _stored_frames)
+    {
+      batched_expt_data.insert(batched_expt_data.end(), frame.expt_data.begin(),
+                               frame.expt_data.end());
+      batched_support_points.insert(batched_support_points.end(),
+                                    frame.support_points.begin(),
+                                    frame.support_points.end());
+      for (unsigned int member = 0; member < _num_ensemble_members; ++member)
+      {
+        for (unsigned int i = 0; i < frame.expt_data.size(); ++i)
+          batched_HX[member][offset + i] = frame.HX[member][i];
+      }
+      for (auto const &entry : frame.R_entries)
+        dsp.add(offset + entry.row, offset + entry.column);
+      offset += frame.expt_data.size();
+    }
+    batched_R_pattern.copy_from(dsp);
+    batched_R.reinit(batched_R_pattern);
+    offset = 0;
+    for (auto const &frame : _stored_frames)
+    {
+      for (auto const &entry : frame.R_entries)
+        batched_R.add(offset + entry.row, offset + entry.column, entry.value);
+      offset += frame.expt_data.size();
+    }
+    _stored_frames.clear();
+
+    // The localization pattern is built for the observations of all the
+    // frames. The support points of the next frame need to be recomputed.
+    _expt_size = batched_size;
+    _expt_support_points = std::move(batched_support_points);
+    _expt_support_points_outdated = true;
+    update_localization_pattern();
+    HX = std::move(batched_HX);
+  }
+  else
+  {
+    update_expt_support_points();
+  }
+  std::vector<double> const &analysis_expt_data =
+      batched ? batched_expt_data : expt_data;
+  dealii::SparseMatrix<double> const &analysis_R = batched ? batched_R : R;
+
+  // The noise is drawn on the global root so that every processor uses the
+  // same perturbations. The ETKF and the LETKF do not perturb the
+  // observations.
+  bool const perturb_observations = _analysis_scheme == AnalysisScheme::enkf;
+  std::vector<double> noise(_num_ensemble_members * _expt_size, 0.);
+  if (perturb_observations && (_global_rank == 0))
+  {
     // Check if R is diagonal, needed for filling the noise vector
-    auto bandwidth = R.get_sparsity_pattern().bandwidth();
+    auto bandwidth = analysis_R.get_sparsity_pattern().bandwidth();
     bool const R_is_diagonal = bandwidth == 0 ? true : false;
 
-    // Get the perturbed innovation, ( y+u - Hx )
-    // This is determined using the unaugmented state because the parameters
-    // are not observable
-    if (_global_rank == 0)
-      std::cout << "Getting the perturbed innovation..." << std::endl;
-
-#ifdef ADAMANTINE_WITH_CALIPER
-    CALI_MARK_BEGIN("da_get_pert_inno");
-#endif
-
-    int constexpr base_state = 0;
-    std::vector<dealii::Vector<double>> perturbed_innovation(
-        _num_ensemble_members);
+    dealii::Vector<double> noise_vector(_expt_size);
     for (unsigned int member = 0; member < _num_ensemble_members; ++member)
     {
-      perturbed_innovation[member].reinit(_expt_size);
-      fill_noise_vector(perturbed_innovation[member], R, R_is_diagonal);
-      dealii::Vector<double> temporary =
-          calc_Hx(global_augmented_state_ensemble[member].block(base_state));
+      fill_noise_vector(noise_vector, analysis_R, R_is_diagonal);
+      std::copy(noise_vector.begin(), noise_vector.end(),
+                noise.begin() + member * _expt_size);
+    }
+  }
+  if (perturb_observations)
+    noise = dealii::Utilities::MPI::broadcast(_global_communicator, noise, 0);
 
-      for (unsigned int i = 0; i < _expt_size; ++i)
-      {
-        perturbed_innovation[member][i] += expt_data[i] - temporary[i];
-      }
+  std::vector<dealii::Vector<double>> perturbed_innovation(
+      _num_ensemble_members, dealii::Vector<double>(_expt_size));
+  for (unsigned int member = 0; member < _num_ensemble_members; ++member)
+  {
+    for (unsigned int i = 0; i < _expt_size; ++i)
+    {
+      perturbed_innovation[member][i] = noise[member * _expt_size + i] +
+                                        analysis_expt_data[i] - HX[member][i];
     }
+  }
 
 #ifdef ADAMANTINE_WITH_CALIPER
-    CALI_MARK_END("da_get_pert_inno");
+  CALI_MARK_END("da_get_pert_inno");
 #endif
 
-    // Apply the Kalman gain to update the augmented state ensemble
-    if (_global_rank == 0)
-      std::cout << "Applying the Kalman gain..." << std::endl;
+  // Apply the Kalman gain to update the augmented state ensemble
+  if (_global_rank == 0)
+    std::cout << "Applying the Kalman gain..." << std::endl;
 
 #ifdef ADAMANTINE_WITH_CALIPER
-    CALI_MARK_BEGIN("da_apply_K");
+  CALI_MARK_BEGIN("da_apply_K");
 #endif
 
-    // Apply the Kalman filter to the perturbed innovation, K ( y+u - Hx )
-    std::vector<dealii::LA::distributed::BlockVector<double>> forecast_shift =
-        apply_kalman_gain(global_augmented_state_ensemble, R,
-                          perturbed_innovation);
+  // Everything that needs MPI or R is computed now. The increments of the
+  // slice, K ( y+u - Hx ) or the ensemble transform, only need local data and
+  // they can be computed while the ensemble members are advanced.
+  std::function<std::vector<dealii::Vector<double>>()> compute_increments;
+  if (perturb_observations)
+  {
+    compute_increments = [this, HX,
+                          weights = calc_kalman_weights(HX, analysis_R,
+                                                        perturbed_innovation)]()
+    { return apply_slice_covariance(_slice_ensemble, HX, weights); };
+  }
+  else
+  {
+    compute_increments =
+        [this, HX, C = calc_ensemble_space_observation_operator(HX, analysis_R),
+         expt_data = analysis_expt_data]()
+    { return apply_ensemble_transforms(_slice_ensemble, HX, C, expt_data); };
+  }
+
+  _background_analysis = background;
+  _slice_increments =
+      std::async(background ? std::launch::async : std::launch::deferred,
+                 std::move(compute_increments));
 
 #ifdef ADAMANTINE_WITH_CALIPER
-    CALI_MARK_END("da_apply_K");
+  CALI_MARK_END("da_apply_K");
 #endif
+}
 
-    // Update the ensemble, x = x + K ( y+u - Hx )
-    if (_global_rank == 0)
-      std::cout << "Updating the ensemble members..." << std::endl;
+void DataAssimilator::finish_update_ensemble(
+    std::vector<dealii::LA::distributed::BlockVector<double>>
+        &augmented_state_ensemble)
+{
+  ASSERT(analysis_pending(), "There is no analysis to apply.");
+
+  // Update the ensemble, x = x + K ( y+u - Hx )
+  if (_global_rank == 0)
+    std::cout << "Updating the ensemble members..." << std::endl;
 
 #ifdef ADAMANTINE_WITH_CALIPER
-    CALI_MARK_BEGIN("da_update_members");
+  CALI_MARK_BEGIN("da_update_members");
 #endif
 
-    for (unsigned int member = 0; member < _num_ensemble_members; ++member)
-    {
-      global_augmented_state_ensemble[member] += forecast_shift[member];
-    }
+  std::vector<dealii::Vector<double>> const slice_increments =
+      _slice_increments.get();
+  _background_analysis = false;
+  collect_ensemble_members(augmented_state_ensemble, slice_increments,
+                           _slice_entries);
+  _slice_entries.clear();
+  _slice_ensemble.clear();
 
 #ifdef ADAMANTINE_WITH_CALIPER
-    CALI_MARK_END("da_update_members");
+  CALI_MARK_END("da_update_members");
 #endif
-  }
+}
 
-  scatter_ensemble_members(augmented_state_ensemble,
-                           global_augmented_state_ensemble,
-                           local_n_ensemble_members, block_sizes);
+bool DataAssimilator::analysis_pending() const
+{
+  return _slice_increments.valid();
 }
 
-void DataAssimilator::gather_ensemble_members(
-    std::vector<dealii::LA::distributed::BlockVector<double>>
+void DataAssimilator::store_observations(
+    std::vector<dealii::LA::distributed::BlockVector<double>> const
         &augmented_state_ensemble,
-    std::vector<dealii::LA::distributed::BlockVector<double>>
-        &global_augmented_state_ensemble,
-    std::vector<unsigned int> &local_n_ensemble_members,
-    std::vector<block_size_type> &block_sizes)
-{
-  // We need to gather the augmented_state_ensemble from the other processors.
-  // BlockVector is a complex structure with its own communicator and so we
-  // cannot simple use dealii's gather to perform the communication. Instead, we
-  // extract the locally owned data and gather it to processor zero. We do this
-  // in a two step process. First, we move the data to local rank zero. Second,
-  // we move the data to global rank zero. The first step allows to simply move
-  // complete vectors to global rank zero. Otherwise, we have the vector data
-  // divided in multiple chunks when gathered on global rank zero and we have to
-  // reconstruct the vector. Finally we can build new BlockVector using the
-  // local communicator.
-
-  // Extract relevant data
+    std::vector<double> const &expt_data, dealii::SparseMatrix<double> const &R)
+{
+  ASSERT(!analysis_pending(), "The pending analysis has not been applied.");
+  adamantine::ASSERT_THROW(_expt_size == expt_data.size(),
+                           "Error: Unexpected experiment vector size.");
+  ASSERT(R.m() == _expt_size, "Matrices dimensions not compatible");
+
+  // Only the observations of the ensemble members are needed, the ensemble
+  // members are not moved.
+  _sim_size = augmented_state_ensemble[0].block(0).size();
+  _parameter_size = augmented_state_ensemble[0].block(1).size();
+  compute_slice_offsets();
+
+  push_observation_frame(expt_data,
+                         observe_ensemble_members(augmented_state_ensemble), R);
+}
+
+void DataAssimilator::push_observation_frame(
+    std::vector<double> const &expt_data,
+    std::vector<dealii::Vector<double>> const &HX,
+    dealii::SparseMatrix<double> const &R)
+{
+  // The support points and R are stored because the mesh and the observations
+  // may change before the frame is assimilated.
+  ObservationFrame frame{expt_data, HX, {}, compute_expt_support_points()};
+  for (auto const &entry : R)
+  {
+    frame.R_entries.push_back({static_cast<unsigned int>(entry.row()),
+                               static_cast<unsigned int>(entry.column()),
+                               entry.value()});
+  }
+  _stored_frames.push_back(std::move(frame));
+}
+
+unsigned int DataAssimilator::n_stored_frames() const
+{
+  return _stored_frames.size();
+}
+
+void DataAssimilator::compute_slice_offsets()
+{
+  // The slices are contiguous and balanced. The parameters are in the last
+  // slices.
+  unsigned long long const augmented_state_size = _sim_size + _parameter_size;
+  _slice_offsets.resize(_global_comm_size + 1);
+  for (int rank = 0; rank <= _global_comm_size; ++rank)
+  {
+    _slice_offsets[rank] = static_cast<unsigned int>(
+        augmented_state_size * rank / _global_comm_size);
+  }
+}
+
+unsigned int DataAssimilator::get_slice_owner(unsigned int const index) const
+{
+  ASSERT(index < _slice_offsets.back(), "Index out of the augmented state.");
+  return std::distance(_slice_offsets.begin(),
+                       std::upper_bound(_slice_offsets.begin(),
+                                        _slice_offsets.end(), index)) -
+         1;
+}
+
+unsigned int DataAssimilator::count_ensemble_members(
+    unsigned int const n_local_ensemble_members)
+{
+  // The ensemble members of a color are spread over the processors of the
+  // local communicator. The members are numbered by color.
+  auto const colors_n_members = dealii::Utilities::MPI::all_gather(
+      _global_communicator,
+      std::vector<unsigned int>{static_cast<unsigned int>(_color),
+                                n_local_ensemble_members});
+  std::map<int, unsigned int> n_members_per_color;
+  for (auto const &color_n_members : colors_n_members)
+    n_members_per_color[color_n_members[0]] = color_n_members[1];
+  _num_ensemble_members = 0;
+  unsigned int first_local_member = 0;
+  for (auto const &[color, n_members] : n_members_per_color)
+  {
+    if (color < _color)
+      first_local_member += n_members;
+    _num_ensemble_members += n_members;
+  }
+
+  return first_local_member;
+}
+
+std::vector<dealii::Vector<double>> DataAssimilator::observe_ensemble_members(
+    std::vector<dealii::LA::distributed::BlockVector<double>> const
+        &augmented_state_ensemble)
+{
   unsigned int const n_local_ensemble_members = augmented_state_ensemble.size();
-  std::vector<std::vector<std::vector<double>>> block_data(
-      n_local_ensemble_members, std::vector<std::vector<double>>(2));
-  for (unsigned int i = 0; i < n_local_ensemble_members; ++i)
+  unsigned int const first_local_member =
+      count_ensemble_members(n_local_ensemble_members);
+
+  // Each processor observes its locally owned entries. Only the observations
+  // are reduced.
+  std::vector<double> observations(_num_ensemble_members * _expt_size, 0.);
+  for (unsigned int m = 0; m < n_local_ensemble_members; ++m)
   {
-    for (unsigned int j = 0; j < 2; ++j)
+    unsigned int const member = first_local_member + m;
+    auto const &state = augmented_state_ensemble[m].block(0);
+    for (unsigned int i = 0; i < _expt_size; ++i)
     {
-      auto data_ptr = augmented_state_ensemble[i].block(j).get_values();
-      block_data[i][j].insert(
-          block_data[i][j].end(), data_ptr,
-          data_ptr + augmented_state_ensemble[i].block(j).locally_owned_size());
+      unsigned int const sim_index = _expt_to_dof_mapping.second[i];
+      unsigned int const expt_index = _expt_to_dof_mapping.first[i];
+      if (state.in_local_range(sim_index))
+        observations[member * _expt_size + expt_index] = state(sim_index);
     }
   }
+  observations =
+      dealii::Utilities::MPI::sum(observations, _global_communicator);
+
+  std::vector<dealii::Vector<double>> HX(_num_ensemble_members,
+                                         dealii::Vector<double>(_expt_size));
+  for (unsigned int member = 0; member < _num_ensemble_members; ++member)
+  {
+    for (unsigned int i = 0; i < _expt_size; ++i)
+      HX[member][i] = observations[member * _expt_size + i];
+  }
+
+  return HX;
+}
 
-  // Perform the communications on the local communicator
-  auto local_block_data =
-      dealii::Utilities::MPI::gather(_local_communicator, block_data);
-  auto local_indexsets_block_0 = dealii::Utilities::MPI::gather(
-      _local_communicator,
-      augmented_state_ensemble[0].block(0).locally_owned_elements());
-  auto local_indexsets_block_1 = dealii::Utilities::MPI::gather(
-      _local_communicator,
-      augmented_state_ensemble[0].block(1).locally_owned_elements());
-  // The local processor zero has all the data. Reorder the data before
-  // sending it to the global processor zero
-  std::vector<std::vector<std::vector<double>>> reordered_local_block_data;
-  if (dealii::Utilities::MPI::this_mpi_process(_local_communicator) == 0)
-  {
-    reordered_local_block_data.resize(n_local_ensemble_members,
-                                      std::vector<std::vector<double>>(2));
-
-    for (unsigned int i = 0; i < local_indexsets_block_0.size(); ++i)
+std::map<unsigned int, std::vector<DataAssimilator::StateEntry>>
+DataAssimilator::distribute_ensemble_members(
+    std::vector<dealii::LA::distributed::BlockVector<double>> const
+        &augmented_state_ensemble,
+    std::vector<dealii::Vector<double>> &slice_ensemble)
+{
+  unsigned int const n_local_ensemble_members = augmented_state_ensemble.size();
+  unsigned int const first_local_member =
+      count_ensemble_members(n_local_ensemble_members);
+
+  // Send the locally owned entries to the owners of the slices. The
+  // parameters are not distributed, so they are only sent by the first
+  // processor of the local communicator.
+  bool const local_root =
+      dealii::Utilities::MPI::this_mpi_process(_local_communicator) == 0;
+  std::map<unsigned int, std::vector<StateEntry>> entries_to_send;
+  for (unsigned int m = 0; m < n_local_ensemble_members; ++m)
+  {
+    unsigned int const member = first_local_member + m;
+    auto const &state = augmented_state_ensemble[m].block(0);
+    for (auto const index : state.locally_owned_elements())
     {
-      block_sizes[0] += local_indexsets_block_0[i].n_elements();
+      entries_to_send[get_slice_owner(index)].push_back(
+          {member, static_cast<unsigned int>(index), state(index)});
     }
-    // The augmented parameters are not distributed.
-    block_sizes[1] = local_indexsets_block_1[0].n_elements();
-
-    // Loop over the ensemble members
-    for (unsigned int i = 0; i < n_local_ensemble_members; ++i)
+    if (local_root)
     {
-      // Loop over the processors
-      for (unsigned int j = 0; j < local_block_data.size(); ++j)
+      auto const &parameters = augmented_state_ensemble[m].block(1);
+      for (unsigned int i = 0; i < _parameter_size; ++i)
       {
-        // Loop over the blocks
-        for (unsigned int k = 0; k < 2; ++k)
-        {
-          reordered_local_block_data[i][k].resize(block_sizes[k]);
-          // Loop over the dofs
-          for (std::size_t m = 0; m < local_block_data[j][i][k].size(); ++m)
-          {
-            auto pos = k == 0 ? local_indexsets_block_0[j].nth_index_in_set(m)
-                              : local_indexsets_block_1[j].nth_index_in_set(m);
-            reordered_local_block_data[i][k][pos] =
-                local_block_data[j][i][k][m];
-          }
-        }
+        unsigned int const index = _sim_size + i;
+        entries_to_send[get_slice_owner(index)].push_back(
+            {member, index, parameters(i)});
       }
     }
   }
-
-  // Perform the global communication.
-  auto all_local_block_data = dealii::Utilities::MPI::gather(
-      _global_communicator, reordered_local_block_data);
-
-  if (_global_rank == 0)
+  auto slice_entries = dealii::Utilities::MPI::some_to_some(
+      _global_communicator, entries_to_send);
+
+  unsigned int const slice_begin = _slice_offsets[_global_rank];
+  unsigned int const slice_size =
+      _slice_offsets[_global_rank + 1] - slice_begin;
+  slice_ensemble.assign(_num_ensemble_members,
+                        dealii::Vector<double>(slice_size));
+  for (auto const &[rank, entries] : slice_entries)
   {
-    // Build the new BlockVector
-    for (unsigned int i = 0; i < all_local_block_data.size(); ++i)
+    for (auto const &entry : entries)
     {
-      auto const &data = all_local_block_data[i];
-      local_n_ensemble_members[i] = data.size();
-      if (data.size())
-      {
-        // Loop over the ensemble members
-        for (unsigned int j = 0; j < data.size(); ++j)
-        {
-          dealii::LA::distributed::BlockVector<double> ensemble_member(
-              block_sizes);
-          // Copy the values in data to ensemble_member
-          for (unsigned int k = 0; k < data[j].size(); ++k)
-          {
-            for (unsigned int m = 0; m < data[j][k].size(); ++m)
-            {
-              ensemble_member.block(k)[m] = data[j][k][m];
-            }
-          }
-          global_augmented_state_ensemble.push_back(ensemble_member);
-        }
-      }
+      slice_ensemble[entry.member][entry.index - slice_begin] = entry.value;
     }
   }
+
+  return slice_entries;
 }
 
-void DataAssimilator::scatter_ensemble_members(
+void DataAssimilator::collect_ensemble_members(
     std::vector<dealii::LA::distributed::BlockVector<double>>
         &augmented_state_ensemble,
-    std::vector<dealii::LA::distributed::BlockVector<double>> const
-        &global_augmented_state_ensemble,
-    std::vector<unsigned int> const &local_n_ensemble_members,
-    std::vector<block_size_type> const &block_sizes)
-{
-  // Scatter global_augmented_state_ensemble to augmented_state_ensemble.
-  // First we split the data to the root of the local communicators and then,
-  // the data is moved inside each local communicator.
-  // deal.II has isend and irecv functions but we cannot them. Using these
-  // functions will result in a deadlock because the future returned by isend
-  // is blocking until we call the get function of the future returned by
-  // irecv.
-
-  std::vector<char> packed_recv_buffer;
-  if (_global_rank == 0)
+    std::vector<dealii::Vector<double>> const &slice_increments,
+    std::map<unsigned int, std::vector<StateEntry>> &slice_entries)
+{
+  // Send the increments back to the processors the entries came from. The
+  // increments are added to the ensemble members which may have been advanced
+  // since the entries were sent.
+  unsigned int const slice_begin = _slice_offsets[_global_rank];
+  for (auto &[rank, entries] : slice_entries)
   {
-    std::vector<std::vector<char>> packed_send_buffers(_global_comm_size);
-    std::vector<MPI_Request> mpi_requests(_global_comm_size);
-    unsigned int global_member_id = 0;
-    for (int i = 0; i < _global_comm_size; ++i)
+    for (auto &entry : entries)
     {
-      unsigned int const local_size = local_n_ensemble_members[i];
-      std::vector<std::vector<double>> send_buffer(local_size);
-      for (unsigned int j = 0; j < local_size; ++j)
-      {
-        auto const &global_state =
-            global_augmented_state_ensemble[global_member_id];
-        send_buffer[j].reserve(global_state.size());
-        for (auto block_vector_it = global_state.begin();
-             block_vector_it != global_state.end(); ++block_vector_it)
-        {
-          send_buffer[j].push_back(*block_vector_it);
-        }
-        ++global_member_id;
-      }
-      // Pack and send the data to the local root rank
-      packed_send_buffers[i] = dealii::Utilities::pack(send_buffer);
-      MPI_Isend(packed_send_buffers[i].data(), packed_send_buffers[i].size(),
-                MPI_CHAR, i, 0, _global_communicator, &mpi_requests[i]);
+      entry.value = slice_increments[entry.member][entry.index - slice_begin];
     }
+  }
+  auto updated_entries =
+      dealii::Utilities::MPI::some_to_some(_global_communicator, slice_entries);
 
-    // Receive the data. First, call MPI_Probe to get the size of the message.
-    MPI_Status status;
-    MPI_Probe(0, 0, _global_communicator, &status);
-    int packed_recv_buffer_size = -1;
-    MPI_Get_count(&status, MPI_CHAR, &packed_recv_buffer_size);
-    packed_recv_buffer.resize(packed_recv_buffer_size);
-    MPI_Recv(packed_recv_buffer.data(), packed_recv_buffer_size, MPI_CHAR, 0, 0,
-             _global_communicator, MPI_STATUS_IGNORE);
-
-    // Wait for all the sends to be over before freeing the buffers
-    for (auto &request : mpi_requests)
+  unsigned int const n_local_ensemble_members = augmented_state_ensemble.size();
+  std::vector<std::vector<double>> parameter_increments(
+      n_local_ensemble_members, std::vector<double>(_parameter_size, 0.));
+  unsigned int const first_local_member =
+      count_ensemble_members(n_local_ensemble_members);
+  for (auto const &[rank, entries] : updated_entries)
+  {
+    for (auto const &entry : entries)
     {
-      MPI_Wait(&request, MPI_STATUS_IGNORE);
+      unsigned int const m = entry.member - first_local_member;
+      if (entry.index < _sim_size)
+        augmented_state_ensemble[m].block(0)(entry.index) += entry.value;
+      else
+        parameter_increments[m][entry.index - _sim_size] = entry.value;
     }
   }
-  else
+
+  // Only the first processor of the local communicator received the
+  // parameters.
+  parameter_increments = dealii::Utilities::MPI::broadcast(
+      _local_communicator, parameter_increments, 0);
+  for (unsigned int m = 0; m < n_local_ensemble_members; ++m)
   {
-    MPI_Status status;
-    MPI_Probe(0, 0, _global_communicator, &status);
-    int packed_recv_buffer_size = -1;
-    MPI_Get_count(&status, MPI_CHAR, &packed_recv_buffer_size);
-    packed_recv_buffer.resize(packed_recv_buffer_size);
-    MPI_Recv(packed_recv_buffer.data(), packed_recv_buffer_size, MPI_CHAR, 0, 0,
-             _global_communicator, MPI_STATUS_IGNORE);
+    for (unsigned int i = 0; i < _parameter_size; ++i)
+    {
+      augmented_state_ensemble[m].block(1)(i) += parameter_increments[m][i];
+    }
+    augmented_state_ensemble[m].block(0).zero_out_ghost_values();
+  }
+}
+
+void DataAssimilator::update_expt_support_points()
+{
+  bool const parameters_changed =
+      _localization_pattern_parameters !=
+      std::make_pair(_localization_cutoff_distance,
+                     _localization_cutoff_function);
+
+  // The flag has the same value on all the processors.
+  if (!_expt_support_points_outdated)
+  {
+    if (parameters_changed)
+      update_localization_pattern();
+    else
+      update_localization_rows();
+    return;
+  }
+
+  // The support points are the same on all the processors. If they did not
+  // move, only the rows of the entries whose support point moved are
+  // recomputed.
+  std::vector<dealii::Point<3>> expt_support_points =
+      compute_expt_support_points();
+  _expt_support_points_outdated = false;
+  if (!parameters_changed && (expt_support_points == _expt_support_points))
+  {
+    update_localization_rows();
+    return;
   }
 
-  // Unpack the data
-  auto recv_buffer =
-      dealii::Utilities::unpack<std::vector<std::vector<double>>>(
-          packed_recv_buffer);
+  _expt_support_points = std::move(expt_support_points);
+  update_localization_pattern();
+}
 
-  // The local root ranks have all the data, now we need to update
-  // augmented_state_ensemble. This communication is easier to do than the
-  // other communications because we can use deal.II's built-in functions.
-  for (unsigned int m = 0; m < augmented_state_ensemble.size(); ++m)
+std::vector<dealii::Point<3>>
+DataAssimilator::compute_expt_support_points() const
+{
+  // The support points of the observed dofs are known by the owners of the
+  // slices.
+  unsigned int const slice_begin = _slice_offsets[_global_rank];
+  unsigned int const slice_end = std::min(_slice_offsets[_global_rank + 1],
+                                          _sim_size);
+  std::vector<double> coordinates(3 * _expt_size, 0.);
+  for (unsigned int i = 0; i < _expt_size; ++i)
   {
-    for (unsigned int b = 0; b < 2; ++b)
+    unsigned int const sim_index = _expt_to_dof_mapping.second[i];
+    unsigned int const expt_index = _expt_to_dof_mapping.first[i];
+    if ((sim_index >= slice_begin) && (sim_index < slice_end) &&
+        (sim_index - slice_begin < _slice_support_points.size()))
     {
-      dealii::LA::ReadWriteVector<double> rw_vector(block_sizes[b]);
-      unsigned int offset = b == 0 ? 0 : block_sizes[0];
-      for (std::size_t i = 0; i < block_sizes[b]; ++i)
-      {
-        rw_vector[i] = recv_buffer[m][offset + i];
-      }
-      // We cannot insert the elements because deal.II checks that the local
-      // elements and the remote ones match. Instead, we set everything to zero
-      // and then, we add the imported elements.
-      augmented_state_ensemble[m].block(b) = 0.;
-      augmented_state_ensemble[m].block(b).import_elements(
-          rw_vector, dealii::VectorOperation::add);
+      for (unsigned int d = 0; d < 3; ++d)
+        coordinates[3 * expt_index + d] =
+            _slice_support_points[sim_index - slice_begin][d];
     }
   }
+  coordinates = dealii::Utilities::MPI::sum(coordinates, _global_communicator);
+
+  std::vector<dealii::Point<3>> expt_support_points(_expt_size);
+  for (unsigned int i = 0; i < _expt_size; ++i)
+  {
+    expt_support_points[i] =
+        dealii::Point<3>(coordinates[3 * i], coordinates[3 * i + 1],
+                         coordinates[3 * i + 2]);
+  }
+
+  return expt_support_points;
 }
 
-std::vector<dealii::LA::distributed::BlockVector<double>>
-DataAssimilator::apply_kalman_gain(
-    std::vector<dealii::LA::distributed::BlockVector<double>>
-        &augmented_state_ensemble,
+void DataAssimilator::update_localization_pattern()
+{
+  _localization_pattern_parameters = std::make_pair(
+      _localization_cutoff_distance, _localization_cutoff_function);
+  _localization_row_offsets.assign(1, 0);
+  _localization_columns.clear();
+  _localization_weights.clear();
+  _localization_support_points.clear();
+
+  // Without cutoff distance, every weight is one and the covariance is not
+  // localized.
+  if (_localization_cutoff_distance == std::numeric_limits<double>::max())
+    return;
+
+  _localization_support_points = _slice_support_points;
+
+  // Only the pairs closer than the cutoff distance are stored.
+  unsigned int const n_rows = _slice_support_points.size();
+  if (_expt_support_points.empty())
+  {
+    _localization_row_offsets.assign(n_rows + 1, 0);
+    return;
+  }
+
+  // Perform the spatial search using ArborX. The observations are stored in a
+  // BVH which is queried with spheres centered on the support points of the
+  // slice.
+  dealii::ArborXWrappers::BVH bvh(_expt_support_points);
+  std::vector<std::pair<dealii::Point<3>, double>> spheres;
+  spheres.reserve(n_rows);
+  for (auto const &point : _slice_support_points)
+    spheres.push_back({point, _localization_cutoff_distance});
+  dealii::ArborXWrappers::SphereIntersectPredicate sph_intersect(spheres);
+  auto [indices, offsets] = bvh.query(sph_intersect);
+  ASSERT(offsets.size() == n_rows + 1, "There was a problem in ArborX.");
+
+  _localization_row_offsets.reserve(n_rows + 1);
+  _localization_columns.reserve(indices.size());
+  _localization_weights.reserve(indices.size());
+  for (unsigned int i = 0; i < n_rows; ++i)
+    append_localization_row(i, indices.begin() + offsets[i],
+                            indices.begin() + offsets[i + 1]);
+}
+
+void DataAssimilator::update_localization_rows()
+{
+  // The pattern is empty if the covariance is not localized.
+  if (_localization_cutoff_distance == std::numeric_limits<double>::max())
+    return;
+
+  // If the number of entries of the slice changed, the rows cannot be matched
+  // with the previous ones.
+  unsigned int const n_rows = _slice_support_points.size();
+  if (_localization_support_points.size() != n_rows)
+  {
+    update_localization_pattern();
+    return;
+  }
+
+  std::vector<unsigned int> outdated_rows;
+  for (unsigned int i = 0; i < n_rows; ++i)
+  {
+    if (_slice_support_points[i] != _localization_support_points[i])
+      outdated_rows.push_back(i);
+  }
+  if (outdated_rows.empty())
+    return;
+  _localization_support_points = _slice_support_points;
+  if (_expt_support_points.empty())
+    return;
+
+  // Only the support points that moved are searched for.
+  dealii::ArborXWrappers::BVH bvh(_expt_support_points);
+  std::vector<std::pair<dealii::Point<3>, double>> spheres;
+  spheres.reserve(outdated_rows.size());
+  for (auto const row : outdated_rows)
+    spheres.push_back(
+        {_slice_support_points[row], _localization_cutoff_distance});
+  dealii::ArborXWrappers::SphereIntersectPredicate sph_intersect(spheres);
+  auto [indices, offsets] = bvh.query(sph_intersect);
+  ASSERT(offsets.size() == outdated_rows.size() + 1,
+         "There was a problem in ArborX.");
+
+  // The other rows are copied from the previous pattern.
+  std::vector<unsigned int> const row_offsets =
+      std::move(_localization_row_offsets);
+  std::vector<unsigned int> const columns = std::move(_localization_columns);
+  std::vector<double> const weights = std::move(_localization_weights);
+  _localization_row_offsets.assign(1, 0);
+  _localization_row_offsets.reserve(n_rows + 1);
+  _localization_columns.clear();
+  _localization_columns.reserve(columns.size());
+  _localization_weights.clear();
+  _localization_weights.reserve(weights.size());
+  unsigned int k = 0;
+  for (unsigned int i = 0; i < n_rows; ++i)
+  {
+    if ((k < outdated_rows.size()) && (outdated_rows[k] == i))
+    {
+      append_localization_row(i, indices.begin() + offsets[k],
+                              indices.begin() + offsets[k + 1]);
+      ++k;
+    }
+    else
+    {
+      _localization_columns.insert(_localization_columns.end(),
+                                   columns.begin() + row_offsets[i],
+                                   columns.begin() + row_offsets[i + 1]);
+      _localization_weights.insert(_localization_weights.end(),
+                                   weights.begin() + row_offsets[i],
+                                   weights.begin() + row_offsets[i + 1]);
+      _localization_row_offsets.push_back(_localization_columns.size());
+    }
+  }
+}
+
+void DataAssimilator::append_localization_row(
+    unsigned int const row, std::vector<int>::iterator const begin,
+    std::vector<int>::iterator const end)
+{
+  // The observations found by ArborX are not sorted.
+  std::sort(begin, end);
+  for (auto it = begin; it != end; ++it)
+  {
+    unsigned int const j = *it;
+    double const weight = localization_scaling(
+        _slice_support_points[row].distance(_expt_support_points[j]));
+    if (weight > 0.)
+    {
+      _localization_columns.push_back(j);
+      _localization_weights.push_back(weight);
+    }
+  }
+  _localization_row_offsets.push_back(_localization_columns.size());
+}
+
+std::vector<dealii::Vector<double>> DataAssimilator::apply_kalman_gain(
+    std::vector<dealii::Vector<double>> const &slice_ensemble,
+    std::vector<dealii::Vector<double>> const &HX,
+    dealii::SparseMatrix<double> const &R,
+    std::vector<dealii::Vector<double>> const &perturbed_innovation)
+{
+  // Apply P H^T to the weights. Only the rows of the slice are computed.
+  return apply_slice_covariance(
+      slice_ensemble, HX, calc_kalman_weights(HX, R, perturbed_innovation));
+}
+
+dealii::FullMatrix<double> DataAssimilator::calc_kalman_weights(
+    std::vector<dealii::Vector<double>> const &HX,
     dealii::SparseMatrix<double> const &R,
     std::vector<dealii::Vector<double>> const &perturbed_innovation)
 {
-  unsigned int augmented_state_size = _sim_size + _parameter_size;
-
-  /*
-   * Currently this function uses GMRES to apply the inverse of HPH^T+R in the
-   * Kalman gain calculation for each ensemble member individually. Depending
-   * on the size of the datasets, the number of ensembles, and other factors
-   * doing a direct solve of (HPH^T+R)^-1 once and then applying to the
-   * perturbed innovation from each ensemble member might be more efficient.
-   */
-  dealii::SparsityPattern pattern_H(_expt_size, augmented_state_size,
-                                    _expt_size);
-  auto H = calc_H(pattern_H);
-  auto P = calc_sample_covariance_sparse(augmented_state_ensemble);
-
-  ASSERT(H.n() == P.m(), "Matrices dimensions not compatible");
-  ASSERT(H.m() == R.m(), "Matrices dimensions not compatible");
-
-  const auto op_H = dealii::linear_operator(H);
-  const auto op_P = dealii::linear_operator(P);
-  const auto op_R = dealii::linear_operator(R);
-
-  const auto op_HPH_plus_R =
-      op_H * op_P * dealii::transpose_operator(op_H) + op_R;
-
-  const std::vector<dealii::types::global_dof_index> block_sizes = {
-      _sim_size, _parameter_size};
-  std::vector<dealii::LA::distributed::BlockVector<double>> output(
-      _num_ensemble_members,
-      dealii::LA::distributed::BlockVector<double>(block_sizes));
-
-  // Create non-member versions of these for use in the lambda function
-  auto solver_control = _solver_control;
-  auto additional_data = _additional_data;
-
-  // Apply the Kalman gain to the perturbed innovation for the ensemble
-  // members in parallel
-  std::transform(
-      perturbed_innovation.begin(), perturbed_innovation.end(), output.begin(),
-      [&](dealii::Vector<double> entry)
+  ASSERT(HX.size() == perturbed_innovation.size(),
+         "The number of ensemble members is not consistent.");
+  ASSERT(R.m() == _expt_size, "Matrices dimensions not compatible");
+
+  // Apply the inverse of HPH^T+R to the perturbed innovation of each ensemble
+  // member. This is done in the observation space so only the global root
+  // does it and the result is broadcast.
+  std::vector<double> weights(_num_ensemble_members * _expt_size);
+  if (_global_rank == 0)
+  {
+    // HPH^T+R is a small dense matrix. It is factored once and the factor is
+    // applied to the innovations of all the ensemble members.
+    dealii::FullMatrix<double> HPH_plus_R = calc_expt_covariance(HX);
+    for (auto const &entry : R)
+      HPH_plus_R(entry.row(), entry.column()) += entry.value();
+
+    dealii::FullMatrix<double> L;
+    if (cholesky_factorization(HPH_plus_R, L))
+    {
+      dealii::FullMatrix<double> innovations(_expt_size,
+                                             _num_ensemble_members);
+      for (unsigned int member = 0; member < _num_ensemble_members; ++member)
+        for (unsigned int i = 0; i < _expt_size; ++i)
+          innovations(i, member) = perturbed_innovation[member][i];
+
+      cholesky_solve(L, innovations);
+
+      for (unsigned int member = 0; member < _num_ensemble_members; ++member)
+        for (unsigned int i = 0; i < _expt_size; ++i)
+          weights[member * _expt_size + i] = innovations(i, member);
+    }
+    else
+    {
+      // The localization can make HPH^T+R indefinite. In this case, fall
+      // back to GMRES.
+      const auto op_HPH_plus_R = dealii::linear_operator(HPH_plus_R);
+
+      // Create non-member versions of these for use in the lambda function
+      auto solver_control = _solver_control;
+      auto additional_data = _additional_data;
+
+      for (unsigned int member = 0; member < _num_ensemble_members; ++member)
       {
         dealii::SolverGMRES<dealii::Vector<double>> HPH_plus_R_inv_solver(
             solver_control, additional_data);
-
         auto op_HPH_plus_R_inv =
             dealii::inverse_operator(op_HPH_plus_R, HPH_plus_R_inv_solver);
+        dealii::Vector<double> member_weights =
+            op_HPH_plus_R_inv * perturbed_innovation[member];
+        std::copy(member_weights.begin(), member_weights.end(),
+                  weights.begin() + member * _expt_size);
+      }
+    }
+  }
+  weights = dealii::Utilities::MPI::broadcast(_global_communicator, weights, 0);
+
+  dealii::FullMatrix<double> member_weights(_expt_size, _num_ensemble_members);
+  for (unsigned int member = 0; member < _num_ensemble_members; ++member)
+    for (unsigned int j = 0; j < _expt_size; ++j)
+      member_weights(j, member) = weights[member * _expt_size + j];
+
+  return member_weights;
+}
+
+std::vector<dealii::Vector<double>> DataAssimilator::apply_slice_covariance(
+    std::vector<dealii::Vector<double>> const &slice_ensemble,
+    std::vector<dealii::Vector<double>> const &HX,
+    dealii::FullMatrix<double> const &weights) const
+{
+  dealii::FullMatrix<double> const anomaly = compute_anomalies(slice_ensemble);
+  dealii::FullMatrix<double> const expt_anomaly = compute_anomalies(HX);
+  unsigned int const slice_size = anomaly.m();
+  unsigned int const n_localized_rows = _localization_row_offsets.size() - 1;
+  double const scaling = 1. / (_num_ensemble_members - 1.);
+
+  std::vector<dealii::Vector<double>> output(
+      _num_ensemble_members, dealii::Vector<double>(slice_size));
+
+  // The rows that are not localized are computed as X (Y^T W) / (N-1), where X
+  // and Y are the anomalies of the slice and of the observations.
+  if (n_localized_rows < slice_size)
+  {
+    dealii::FullMatrix<double> projected_weights(_num_ensemble_members,
+                                                 _num_ensemble_members);
+    expt_anomaly.Tmmult(projected_weights, weights);
+    for (unsigned int i = n_localized_rows; i < slice_size; ++i)
+    {
+      for (unsigned int k = 0; k < _num_ensemble_members; ++k)
+      {
+        double value = 0.;
+        for (unsigned int l = 0; l < _num_ensemble_members; ++l)
+          value += anomaly(i, l) * projected_weights(l, k);
+        output[k][i] = scaling * value;
+      }
+    }
+  }
 
-        const auto op_K =
-            op_P * dealii::transpose_operator(op_H) * op_HPH_plus_R_inv;
+  // The Schur product with the localization prevents the factorization above.
+  // The entries of P H^T in the localization pattern are computed on the fly
+  // and applied directly.
+  host_for("adamantine::apply_localized_covariance", n_localized_rows,
+           _background_analysis,
+           [&](int const i)
+           {
+             for (unsigned int pos = _localization_row_offsets[i];
+                  pos < _localization_row_offsets[i + 1]; ++pos)
+             {
+               unsigned int const j = _localization_columns[pos];
+               double cov = 0.;
+               for (unsigned int l = 0; l < _num_ensemble_members; ++l)
+                 cov += anomaly(i, l) * expt_anomaly(j, l);
+               cov *= scaling * _localization_weights[pos];
+               for (unsigned int k = 0; k < _num_ensemble_members; ++k)
+                 output[k][i] += cov * weights(j, k);
+             }
+           });
 
-        // Apply the Kalman gain to each innovation vector
-        dealii::Vector<double> temporary = op_K * entry;
+  return output;
+}
+
+std::vector<dealii::Vector<double>> DataAssimilator::apply_ensemble_transform(
+    std::vector<dealii::Vector<double>> const &slice_ensemble,
+    std::vector<dealii::Vector<double>> const &HX,
+    dealii::SparseMatrix<double> const &R, std::vector<double> const &expt_data)
+{
+  return apply_ensemble_transforms(
+      slice_ensemble, HX, calc_ensemble_space_observation_operator(HX, R),
+      expt_data);
+}
+
+dealii::FullMatrix<double>
+DataAssimilator::calc_ensemble_space_observation_operator(
+    std::vector<dealii::Vector<double>> const &HX,
+    dealii::SparseMatrix<double> const &R)
+{
+  ASSERT(R.m() == _expt_size, "Matrices dimensions not compatible");
+
+  // C = Y'^T R^-1
+  dealii::FullMatrix<double> const expt_anomaly = compute_anomalies(HX);
+  dealii::FullMatrix<double> C(_num_ensemble_members, _expt_size);
+  bool const R_is_diagonal = R.get_sparsity_pattern().bandwidth() == 0;
+  if (R_is_diagonal)
+  {
+    for (unsigned int member = 0; member < _num_ensemble_members; ++member)
+      for (unsigned int j = 0; j < _expt_size; ++j)
+        C(member, j) = expt_anomaly(j, member) / R.diag_element(j);
+  }
+  else
+  {
+    update_R_cholesky(R);
+    dealii::FullMatrix<double> R_inv_anomaly(expt_anomaly);
+    cholesky_solve(_R_cholesky, R_inv_anomaly);
+    C.copy_transposed(R_inv_anomaly);
+  }
 
-        // Copy into a distributed block vector, this is the only place where
-        // the mismatch matters, using dealii::Vector for the experimental
-        // data and dealii::LA::distributed::BlockVector for the simulation
-        // data.
-        dealii::LA::distributed::BlockVector<double> output_member(block_sizes);
-        for (unsigned int i = 0; i < augmented_state_size; ++i)
-        {
-          output_member(i) = temporary(i);
-        }
+  return C;
+}
 
-        return output_member;
-      });
+std::vector<dealii::Vector<double>> DataAssimilator::apply_ensemble_transforms(
+    std::vector<dealii::Vector<double>> const &slice_ensemble,
+    std::vector<dealii::Vector<double>> const &HX,
+    dealii::FullMatrix<double> const &C,
+    std::vector<double> const &expt_data) const
+{
+  // Anomalies of the observed ensemble members and innovation of the mean.
+  // These quantities are small and they are computed by every processor.
+  dealii::FullMatrix<double> const expt_anomaly = compute_anomalies(HX);
+  dealii::Vector<double> innovation(expt_data.begin(), expt_data.end());
+  for (unsigned int member = 0; member < _num_ensemble_members; ++member)
+    innovation.add(-1. / _num_ensemble_members, HX[member]);
+
+  // Anomalies of the slice
+  dealii::FullMatrix<double> const anomaly = compute_anomalies(slice_ensemble);
+  unsigned int const slice_size = anomaly.m();
+
+  std::vector<dealii::Vector<double>> output(
+      _num_ensemble_members, dealii::Vector<double>(slice_size));
+  auto apply_transform = [&](unsigned int const i,
+                             dealii::FullMatrix<double> const &transform)
+  {
+    for (unsigned int k = 0; k < _num_ensemble_members; ++k)
+    {
+      double increment = 0.;
+      for (unsigned int l = 0; l < _num_ensemble_members; ++l)
+        increment += anomaly(i, l) * transform(l, k);
+      output[k][i] = increment;
+    }
+  };
+
+  // The global transform is used by the ETKF and for the parameters which are
+  // not localized.
+  std::vector<unsigned int> all_observations(_expt_size);
+  std::iota(all_observations.begin(), all_observations.end(), 0);
+  std::vector<double> const unit_weights(_expt_size, 1.);
+  EnsembleTransformScratch global_scratch;
+  dealii::FullMatrix<double> const &global_transform =
+      compute_ensemble_transform(C, expt_anomaly, innovation,
+                                 dealii::make_array_view(all_observations),
+                                 dealii::make_array_view(unit_weights),
+                                 global_scratch);
+  unsigned int const n_localized_entries =
+      _analysis_scheme == AnalysisScheme::letkf
+          ? _localization_row_offsets.size() - 1
+          : 0;
+  for (unsigned int i = n_localized_entries; i < slice_size; ++i)
+    apply_transform(i, global_transform);
+
+  // The local analyses of the LETKF are independent. Each one only uses the
+  // observations in its row of the localization pattern, so its cost scales
+  // with the number of observations in the neighborhood of the entry and not
+  // with the total number of observations.
+  host_for("adamantine::letkf", n_localized_entries, _background_analysis,
+           [&](int const i)
+           {
+             unsigned int const begin = _localization_row_offsets[i];
+             unsigned int const n_local_obs =
+                 _localization_row_offsets[i + 1] - begin;
+             // Entries without observation in their neighborhood are not
+             // updated
+             if (n_local_obs == 0)
+               return;
+
+             thread_local EnsembleTransformScratch scratch;
+             apply_transform(
+                 i, compute_ensemble_transform(
+                        C, expt_anomaly, innovation,
+                        dealii::ArrayView<unsigned int const>(
+                            _localization_columns.data() + begin, n_local_obs),
+                        dealii::ArrayView<double const>(
+                            _localization_weights.data() + begin, n_local_obs),
+                        scratch));
+           });
 
   return output;
 }
 
+dealii::FullMatrix<double> DataAssimilator::calc_slice_covariance(
+    std::vector<dealii::Vector<double>> const &slice_ensemble,
+    std::vector<dealii::Vector<double>> const &HX) const
+{
+  dealii::FullMatrix<double> const anomaly = compute_anomalies(slice_ensemble);
+  dealii::FullMatrix<double> const expt_anomaly = compute_anomalies(HX);
+
+  dealii::FullMatrix<double> cov(anomaly.m(), _expt_size);
+  anomaly.mTmult(cov, expt_anomaly);
+  cov /= (_num_ensemble_members - 1.0);
+
+  // Apply localization. The parameters are not localized.
+  unsigned int const n_localized_rows = _localization_row_offsets.size() - 1;
+  std::vector<double> row(_expt_size);
+  for (unsigned int i = 0; i < n_localized_rows; ++i)
+  {
+    for (unsigned int j = 0; j < _expt_size; ++j)
+    {
+      row[j] = cov(i, j);
+      cov(i, j) = 0.;
+    }
+    for (unsigned int pos = _localization_row_offsets[i];
+         pos < _localization_row_offsets[i + 1]; ++pos)
+    {
+      unsigned int const j = _localization_columns[pos];
+      cov(i, j) = row[j] * _localization_weights[pos];
+    }
+  }
+
+  return cov;
+}
+
+dealii::FullMatrix<double> DataAssimilator::calc_expt_covariance(
+    std::vector<dealii::Vector<double>> const &HX) const
+{
+  dealii::FullMatrix<double> const expt_anomaly = compute_anomalies(HX);
+
+  dealii::FullMatrix<double> cov(_expt_size, _expt_size);
+  expt_anomaly.mTmult(cov, expt_anomaly);
+  cov /= (_num_ensemble_members - 1.0);
+
+  // Apply localization
+  for (unsigned int i = 0; i < _expt_size; ++i)
+  {
+    for (unsigned int j = 0; j < _expt_size; ++j)
+    {
+      cov(i, j) *= localization_scaling(
+          _expt_support_points[i].distance(_expt_support_points[j]));
+    }
+  }
+
+  return cov;
+}
+
+double DataAssimilator::localization_scaling(double const distance) const
+{
+  // Entries further apart than the cutoff distance are always discarded.
+  if (distance > _localization_cutoff_distance)
+    return 0.;
+
+  if (_localization_cutoff_function == LocalizationCutoff::gaspari_cohn)
+    return gaspari_cohn_function(2.0 * distance /
+                                 _localization_cutoff_distance);
+
+  return 1.;
+}
+
 dealii::SparseMatrix<double>
 DataAssimilator::calc_H(dealii::SparsityPattern &pattern) const
 {
@@ -507,8 +1318,13 @@ template <int dim>
 void DataAssimilator::update_dof_mapping(
     std::pair<std::vector<int>, std::vector<int>> const &expt_to_dof_mapping)
 {
+  ASSERT(!analysis_pending(), "The pending analysis has not been applied.");
   _expt_size = expt_to_dof_mapping.first.size();
-  _expt_to_dof_mapping = expt_to_dof_mapping;
+  if (expt_to_dof_mapping != _expt_to_dof_mapping)
+  {
+    _expt_to_dof_mapping = expt_to_dof_mapping;
+    _expt_support_points_outdated = true;
+  }
 }
 
 template <int dim>
@@ -516,97 +1332,71 @@ void DataAssimilator::update_covariance_sparsity_pattern(
     dealii::DoFHandler<dim> const &dof_handler,
     const unsigned int parameter_size)
 {
+  ASSERT(!analysis_pending(), "The pending analysis has not been applied.");
+  _sim_size = dof_handler.n_dofs();
+  _parameter_size = parameter_size;
+  compute_slice_offsets();
+
+  // The support points only need to be moved if the dofs changed. The
+  // fingerprint of the dofs is cheap compared to the computation of the
+  // support points and the communication.
+  std::size_t dof_fingerprint = 0;
+  boost::hash_combine(dof_fingerprint, _sim_size);
+  boost::hash_combine(dof_fingerprint, _parameter_size);
+  std::vector<dealii::types::global_dof_index> local_dof_indices;
+  for (auto const &cell : dealii::filter_iterators(
+           dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    boost::hash_combine(dof_fingerprint, cell->level());
+    boost::hash_combine(dof_fingerprint, cell->index());
+    boost::hash_combine(dof_fingerprint, cell->active_fe_index());
+    local_dof_indices.resize(cell->get_fe().n_dofs_per_cell());
+    cell->get_dof_indices(local_dof_indices);
+    for (auto const dof_index : local_dof_indices)
+      boost::hash_combine(dof_fingerprint, dof_index);
+  }
+  bool const dofs_changed =
+      dealii::Utilities::MPI::max(
+          (_dof_fingerprint && (*_dof_fingerprint == dof_fingerprint)) ? 0 : 1,
+          _global_communicator) == 1;
+  if (!dofs_changed)
+    return;
+  _dof_fingerprint = dof_fingerprint;
+  _expt_support_points_outdated = true;
+
+  // The ensemble members use the same mesh, so only the processors of the
+  // first color send the support points to the owners of the slices.
+  std::map<unsigned int, std::vector<SupportPointEntry>> points_to_send;
   if (_color == 0)
   {
-    _sim_size = dof_handler.n_dofs();
-    _parameter_size = parameter_size;
-    unsigned int augmented_state_size = _sim_size + _parameter_size;
-
     auto [dof_indices, support_points] =
         get_dof_to_support_mapping(dof_handler);
-
-    // Perform the spatial search using ArborX
-    dealii::ArborXWrappers::DistributedTree distributed_tree(
-        _local_communicator, support_points);
-
-    std::vector<std::pair<dealii::Point<dim, double>, double>> spheres;
-    if (dim == 2)
-      for (auto const pt : support_points)
-        spheres.push_back({{pt[0], pt[1]}, _localization_cutoff_distance});
-    else
-      for (auto const pt : support_points)
-        spheres.push_back(
-            {{pt[0], pt[1], pt[2]}, _localization_cutoff_distance});
-    dealii::ArborXWrappers::SphereIntersectPredicate sph_intersect(spheres);
-    auto [indices_ranks, offsets] = distributed_tree.query(sph_intersect);
-    ASSERT(offsets.size() == spheres.size() + 1,
-           "There was a problem in ArborX.");
-
-    auto locally_owned_dofs_per_rank = dealii::Utilities::MPI::gather(
-        _local_communicator, dof_handler.locally_owned_dofs());
-    auto support_points_per_rank =
-        dealii::Utilities::MPI::gather(_local_communicator, support_points);
-    auto indices_ranks_per_rank =
-        dealii::Utilities::MPI::gather(_local_communicator, indices_ranks);
-    auto offsets_per_rank =
-        dealii::Utilities::MPI::gather(_local_communicator, offsets);
-
-    if (_global_rank == 0)
+    for (unsigned int i = 0; i < dof_indices.size(); ++i)
     {
-      // We need IndexSet to build the sparsity pattern. Since the data
-      // assimilation is done is serial, the IndexSet just contains
-      // everything.
-      dealii::IndexSet parallel_partitioning =
-          dealii::complete_index_set(augmented_state_size);
-      parallel_partitioning.compress();
-      _covariance_sparsity_pattern.reinit(parallel_partitioning, MPI_COMM_SELF);
-
-      // Fill in the SparsityPattern
-      unsigned int const local_comm_size =
-          dealii::Utilities::MPI::n_mpi_processes(_local_communicator);
-      for (unsigned int rank = 0; rank < local_comm_size; ++rank)
-      {
-        if (offsets_per_rank[rank].size() != 0)
-        {
-          for (unsigned int i = 0; i < offsets_per_rank[rank].size() - 1; ++i)
-          {
-            for (int j = offsets_per_rank[rank][i];
-                 j < offsets_per_rank[rank][i + 1]; ++j)
-            {
-              unsigned int row =
-                  locally_owned_dofs_per_rank[rank].nth_index_in_set(i);
-              unsigned int other_rank = indices_ranks[j].second;
-              unsigned int other_i = indices_ranks[j].first;
-              unsigned int column =
-                  locally_owned_dofs_per_rank[other_rank].nth_index_in_set(
-                      other_i);
-              _covariance_distance_map[std::make_pair(row, column)] =
-                  support_points_per_rank[rank][i].distance(
-                      support_points_per_rank[other_rank][other_i]);
-              _covariance_sparsity_pattern.add(row, column);
-            }
-          }
-        }
-      }
-
-      // Add entries for the parameter augmentation
-      for (unsigned int i1 = _sim_size; i1 < augmented_state_size; ++i1)
-      {
-        for (unsigned int j1 = 0; j1 < augmented_state_size; ++j1)
-        {
-          _covariance_sparsity_pattern.add(i1, j1);
-        }
-      }
-
-      for (unsigned int i1 = 0; i1 < _sim_size; ++i1)
-      {
-        for (unsigned int j1 = _sim_size; j1 < augmented_state_size; ++j1)
-        {
-          _covariance_sparsity_pattern.add(i1, j1);
-        }
-      }
-
-      _covariance_sparsity_pattern.compress();
+      SupportPointEntry entry{static_cast<unsigned int>(dof_indices[i]),
+                              {0., 0., 0.}};
+      for (int d = 0; d < dim; ++d)
+        entry.coordinates[d] = support_points[i][d];
+      points_to_send[get_slice_owner(entry.index)].push_back(entry);
+    }
+  }
+  auto received_points = dealii::Utilities::MPI::some_to_some(
+      _global_communicator, points_to_send);
+
+  unsigned int const slice_begin = _slice_offsets[_global_rank];
+  unsigned int const slice_end =
+      std::min(_slice_offsets[_global_rank + 1], _sim_size);
+  _slice_support_points.assign(
+      slice_end > slice_begin ? slice_end - slice_begin : 0,
+      dealii::Point<3>());
+  for (auto const &[rank, entries] : received_points)
+  {
+    for (auto const &entry : entries)
+    {
+      _slice_support_points[entry.index - slice_begin] =
+          dealii::Point<3>(entry.coordinates[0], entry.coordinates[1],
+                           entry.coordinates[2]);
     }
   }
 }
@@ -651,11 +1441,7 @@ void DataAssimilator::fill_noise_vector(dealii::Vector<double> &vec,
   }
   else
   {
-    // Do Cholesky decomposition
-    dealii::FullMatrix<double> L(vector_size);
-    dealii::FullMatrix<double> R_full(vector_size);
-    R_full.copy_from(R);
-    L.cholesky(R_full);
+    update_R_cholesky(R);
 
     // Get a vector of normally distributed values
     dealii::Vector<double> uncorrelated_noise_vector(vector_size);
@@ -665,10 +1451,30 @@ void DataAssimilator::fill_noise_vector(dealii::Vector<double> &vec,
       uncorrelated_noise_vector(i) = _normal_dist_generator(_prng);
     }
 
-    L.vmult(vec, uncorrelated_noise_vector);
+    _R_cholesky.vmult(vec, uncorrelated_noise_vector);
   }
 }
 
+void DataAssimilator::update_R_cholesky(dealii::SparseMatrix<double> const &R)
+{
+  // R does not change between the calls for the different ensemble members
+  // and usually between the analyses, so its Cholesky factor is cached.
+  unsigned int const size = R.m();
+  std::vector<double> R_values;
+  R_values.reserve(R.n_nonzero_elements());
+  for (auto const &entry : R)
+    R_values.push_back(entry.value());
+  if ((_R_cholesky.m() == size) && (R_values == _R_values))
+    return;
+
+  dealii::FullMatrix<double> R_full(size);
+  R_full.copy_from(R);
+  bool const positive_definite = cholesky_factorization(R_full, _R_cholesky);
+  ASSERT_THROW(positive_definite, "Error: The observation covariance matrix is "
+                                  "not positive definite.");
+  _R_values = std::move(R_values);
+}
+
 double DataAssimilator::gaspari_cohn_function(double const r) const
 {
   if (r < 1.0)
@@ -687,69 +1493,6 @@ double DataAssimilator::gaspari_cohn_function(double const r) const
   }
 }
 
-dealii::TrilinosWrappers::SparseMatrix
-DataAssimilator::calc_sample_covariance_sparse(
-    std::vector<dealii::LA::distributed::BlockVector<double>> const
-        &vec_ensemble) const
-{
-  unsigned int const local_size = vec_ensemble[0].locally_owned_size();
-
-  // Calculate the mean
-  dealii::Vector<double> mean(local_size);
-  auto sum = vec_ensemble[0];
-  for (unsigned int sample = 1; sample < _num_ensemble_members; ++sample)
-  {
-    sum += vec_ensemble[sample];
-  }
-  unsigned int ii = 0;
-  for (auto index : sum.locally_owned_elements())
-  {
-    mean[ii] = sum[index] / _num_ensemble_members;
-    ++ii;
-  }
-
-  dealii::TrilinosWrappers::SparseMatrix cov(_covariance_sparsity_pattern);
-
-  unsigned int pos = 0;
-  for (auto conv_iter = cov.begin(); conv_iter != cov.end(); ++conv_iter, ++pos)
-  {
-    unsigned int i = conv_iter->row();
-    unsigned int j = conv_iter->column();
-
-    // Do the element-wise matrix multiply by hand
-    double element_value = 0;
-    for (unsigned int k = 0; k < _num_ensemble_members; ++k)
-    {
-      element_value +=
-          (vec_ensemble[k][i] - mean[i]) * (vec_ensemble[k][j] - mean[j]);
-    }
-
-    element_value /= (_num_ensemble_members - 1.0);
-
-    // Apply localization
-    double localization_scaling = 1.0;
-    if (i < _sim_size && j < _sim_size)
-    {
-      double dist = _covariance_distance_map.find(std::make_pair(i, j))->second;
-      if (_localization_cutoff_function == LocalizationCutoff::gaspari_cohn)
-      {
-        localization_scaling =
-            gaspari_cohn_function(2.0 * dist / _localization_cutoff_distance);
-      }
-      else if ((_localization_cutoff_function ==
-                LocalizationCutoff::step_function) &&
-               (dist > _localization_cutoff_distance))
-      {
-        localization_scaling = 0.0;
-      }
-    }
-
-    conv_iter->value() = element_value * localization_scaling;
-  }
-
-  return cov;
-}
-
 // Explicit instantiation
 template void DataAssimilator::update_dof_mapping<2>(
     std::pair<std::vector<int>, std::vector<int>> const &expt_to_dof_mapping);
@@ -11,17 +11,22 @@
 #include <experimental_data_utils.hh>
 #include <types.hh>
 
+#include <deal.II/base/point.h>
 #include <deal.II/fe/mapping_q1_eulerian.h>
 #include <deal.II/lac/full_matrix.h>
 #include <deal.II/lac/la_parallel_block_vector.h>
 #include <deal.II/lac/la_vector.h>
 #include <deal.II/lac/solver_gmres.h>
 #include <deal.II/lac/sparse_matrix.h>
-#include <deal.II/lac/trilinos_sparse_matrix.h>
-#include <deal.II/lac/trilinos_sparsity_pattern.h>
 
+#include <boost/optional.hpp>
+
+#include <functional>
+#include <future>
 #include <map>
 #include <random>
+#include <utility>
+#include <vector>
 
 namespace adamantine
 {
@@ -39,6 +44,19 @@ enum class LocalizationCutoff
   none
 };
 
+/**
+ * Enum for the different analysis schemes. 'enkf' is the stochastic ensemble
+ * Kalman filter with perturbed observations. 'etkf' is the ensemble transform
+ * Kalman filter and 'letkf' its localized variant, see Hunt, Kostelich, and
+ * Szunyogh, Physica D, 230, 2007.
+ */
+enum class AnalysisScheme
+{
+  enkf,
+  etkf,
+  letkf
+};
+
 enum class AugmentedStateParameters
 {
   beam_0_absorption,
@@ -57,6 +75,19 @@ class DataAssimilatorTester;
  *
  * The EnKF implementation here is largely based on Chapter 6 of Data
  * Assimilation: Method and Applications by Asch, Bocquet, and Nodet.
+ *
+ * The analysis is distributed over all the processors of the global
+ * communicator. The augmented state is split in contiguous slices, one per
+ * processor, and each processor updates its slice of every ensemble member.
+ * Only the quantities in the observation space are replicated. The sample
+ * covariance matrix P is never assembled: the columns of P H^T are computed on
+ * the fly from the ensemble anomalies.
+ *
+ * Instead of the stochastic EnKF, the analysis can use the ensemble transform
+ * Kalman filter (ETKF) which works in the space spanned by the ensemble
+ * members. In its localized variant (LETKF), an independent analysis is
+ * performed for every entry of the slice using the observations weighted by
+ * the localization function.
  */
 class DataAssimilator
 {
@@ -90,6 +121,59 @@ public:
                        std::vector<double> const &expt_data,
                        dealii::SparseMatrix<double> const &R);
 
+  /**
+   * Start the assimilation process performed by update_ensemble(). All the
+   * communications and the operations involving R are blocking and they are
+   * performed before this function returns. The increments of the slice owned
+   * by the current processor only need local data. If @p background is true,
+   * only their computation is done on a separate thread so that the ensemble
+   * members can be advanced in the meantime. Otherwise, they are computed by
+   * finish_update_ensemble(). This is a collective operation.
+   */
+  void start_update_ensemble(
+      std::vector<dealii::LA::distributed::BlockVector<double>> const
+          &augmented_state_ensemble,
+      std::vector<double> const &expt_data,
+      dealii::SparseMatrix<double> const &R, bool const background);
+
+  /**
+   * Add the increments computed by the analysis started with
+   * start_update_ensemble() to the ensemble members. The ensemble members may
+   * have been advanced in time since the analysis started but the dofs must
+   * not have changed. The increments are not corrected for the time advanced
+   * in the meantime. This is a collective operation.
+   */
+  void finish_update_ensemble(
+      std::vector<dealii::LA::distributed::BlockVector<double>>
+          &augmented_state_ensemble);
+
+  /**
+   * Return true if an analysis was started and its increments have not been
+   * added to the ensemble members yet.
+   */
+  bool analysis_pending() const;
+
+  /**
+   * Store the observations of the current frame instead of assimilating them.
+   * Only the observation of the ensemble members, H x, is computed. The stored
+   * frames are assimilated together with the frame given to the next
+   * start_update_ensemble() in a single analysis. The increments use the
+   * covariance between the ensemble members at the time of the analysis and
+   * their observations at the time of each frame (asynchronous EnKF, see
+   * Sakov, Evensen, and Bertino, Tellus A, 62, 2010). This is a collective
+   * operation.
+   */
+  void store_observations(
+      std::vector<dealii::LA::distributed::BlockVector<double>> const
+          &augmented_state_ensemble,
+      std::vector<double> const &expt_data,
+      dealii::SparseMatrix<double> const &R);
+
+  /**
+   * Return the number of frames stored since the last analysis.
+   */
+  unsigned int n_stored_frames() const;
+
   /**
    * This updates the internal mapping between the indices of the entries in
    * expt_data and the indices of the entries in the sim_data ensemble members
@@ -101,9 +185,11 @@ public:
       std::pair<std::vector<int>, std::vector<int>> const &expt_to_dof_mapping);
 
   /**
-   * This updates the sparsity pattern for the sample covariance matrix for the
-   * simulation ensemble. This must be called before updateEnsemble whenever
-   * there are changes to the simulation mesh.
+   * This updates the support points of the slice of the augmented state owned
+   * by the current processor. The support points are used to localize the
+   * sample covariance. This must be called before updateEnsemble whenever there
+   * are changes to the simulation mesh. Nothing is done if the dofs did not
+   * change since the last call. This is a collective operation.
    */
   template <int dim>
   void
@@ -111,42 +197,242 @@ public:
                                      const unsigned int parameter_size);
 
 private:
-  using block_size_type =
-      dealii::LA::distributed::BlockVector<double>::size_type;
+  /**
+   * Entry of an augmented state moved between the processors.
+   */
+  struct StateEntry
+  {
+    unsigned int member;
+    unsigned int index;
+    double value;
+
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int /*version*/)
+    {
+      ar &member &index &value;
+    }
+  };
 
   /**
-   * Gather the augmented ensemble members on the global root node in order to
-   * apply the Kalman gain.
+   * Support point of an entry of the augmented state moved between the
+   * processors.
    */
-  void gather_ensemble_members(
-      std::vector<dealii::LA::distributed::BlockVector<double>>
+  struct SupportPointEntry
+  {
+    unsigned int index;
+    double coordinates[3];
+
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int /*version*/)
+    {
+      ar &index &coordinates;
+    }
+  };
+
+  /**
+   * Observations of a frame stored until the next analysis.
+   */
+  struct ObservationFrame
+  {
+    /**
+     * Nonzero entry of the observation covariance matrix.
+     */
+    struct MatrixEntry
+    {
+      unsigned int row;
+      unsigned int column;
+      double value;
+    };
+
+    std::vector<double> expt_data;
+    std::vector<dealii::Vector<double>> HX;
+    std::vector<MatrixEntry> R_entries;
+    std::vector<dealii::Point<3>> support_points;
+  };
+
+  /**
+   * Compute the offsets of the slices of the augmented state owned by each
+   * processor of the global communicator.
+   */
+  void compute_slice_offsets();
+
+  /**
+   * Return the processor of the global communicator that owns the given entry
+   * of the augmented state.
+   */
+  unsigned int get_slice_owner(unsigned int const index) const;
+
+  /**
+   * Compute the total number of ensemble members and return the index of the
+   * first ensemble member owned by the local communicator. This is a
+   * collective operation.
+   */
+  unsigned int
+  count_ensemble_members(unsigned int const n_local_ensemble_members);
+
+  /**
+   * Return the observation of every ensemble member, H x. The ensemble members
+   * are not moved, only the observations are reduced. This is a collective
+   * operation.
+   */
+  std::vector<dealii::Vector<double>> observe_ensemble_members(
+      std::vector<dealii::LA::distributed::BlockVector<double>> const
+          &augmented_state_ensemble);
+
+  /**
+   * Add a frame to the stored frames. The support points of the observations
+   * are computed with the current dof mapping. This is a collective operation.
+   */
+  void push_observation_frame(std::vector<double> const &expt_data,
+                              std::vector<dealii::Vector<double>> const &HX,
+                              dealii::SparseMatrix<double> const &R);
+
+  /**
+   * Move the locally owned entries of the ensemble members to the processors
+   * owning the associated slices. @p slice_ensemble contains the slice of every
+   * ensemble member owned by the current processor. The entries received by
+   * each processor are returned; they are needed to send the updated values
+   * back.
+   */
+  std::map<unsigned int, std::vector<StateEntry>> distribute_ensemble_members(
+      std::vector<dealii::LA::distributed::BlockVector<double>> const
           &augmented_state_ensemble,
-      std::vector<dealii::LA::distributed::BlockVector<double>>
-          &global_augmented_state_ensemble,
-      std::vector<unsigned int> &local_n_ensemble_members,
-      std::vector<block_size_type> &block_sizes);
+      std::vector<dealii::Vector<double>> &slice_ensemble);
 
   /**
-   * Scatter the @p global_augmented_state_ensemble back into @p
-   * augmented_state_ensemble.
+   * Send @p slice_increments back to the processors owning the entries of the
+   * ensemble members and add them to the ensemble members.
    */
-  void scatter_ensemble_members(
+  void collect_ensemble_members(
       std::vector<dealii::LA::distributed::BlockVector<double>>
           &augmented_state_ensemble,
-      std::vector<dealii::LA::distributed::BlockVector<double>> const
-          &global_augmented_state_ensemble,
-      std::vector<unsigned int> const &local_n_ensemble_members,
-      std::vector<block_size_type> const &block_sizes);
+      std::vector<dealii::Vector<double>> const &slice_increments,
+      std::map<unsigned int, std::vector<StateEntry>> &slice_entries);
+
+  /**
+   * Compute the support points of the observations and update the
+   * localization pattern if they are outdated. This is a collective
+   * operation.
+   */
+  void update_expt_support_points();
+
+  /**
+   * Return the support points of the observations using the current dof
+   * mapping. This is a collective operation.
+   */
+  std::vector<dealii::Point<3>> compute_expt_support_points() const;
+
+  /**
+   * Compute the localization weights between the entries of the slice and the
+   * observations that are closer than the cutoff distance.
+   */
+  void update_localization_pattern();
+
+  /**
+   * Recompute the rows of the localization pattern associated with the entries
+   * of the slice whose support point moved since the pattern was computed. The
+   * other rows are kept. The whole pattern is recomputed if the number of
+   * entries of the slice changed. The support points of the observations and
+   * the cutoff must not have changed.
+   */
+  void update_localization_rows();
+
+  /**
+   * Append to the localization pattern the row of the entry @p row of the
+   * slice. [@p begin, @p end) are the observations found in the neighborhood
+   * of its support point.
+   */
+  void append_localization_row(unsigned int const row,
+                               std::vector<int>::iterator const begin,
+                               std::vector<int>::iterator const end);
 
   /**
    * This calculates the Kalman gain and applies it to the perturbed innovation.
+   * @p slice_ensemble is the slice of the ensemble members owned by the
+   * current processor and @p HX the observation of the ensemble members. The
+   * increments of the slice are returned. HPH^T+R is inverted with a Cholesky
+   * factorization shared by all the ensemble members, GMRES is only used if
+   * the matrix is not positive definite.
    */
-  std::vector<dealii::LA::distributed::BlockVector<double>> apply_kalman_gain(
-      std::vector<dealii::LA::distributed::BlockVector<double>>
-          &augmented_state_ensemble,
+  std::vector<dealii::Vector<double>> apply_kalman_gain(
+      std::vector<dealii::Vector<double>> const &slice_ensemble,
+      std::vector<dealii::Vector<double>> const &HX,
+      dealii::SparseMatrix<double> const &R,
+      std::vector<dealii::Vector<double>> const &perturbed_innovation);
+
+  /**
+   * Solve (HPH^T+R) W = ( y+u - Hx ) for all the ensemble members. The
+   * columns of the returned matrix are the weights of the ensemble members.
+   * This is a collective operation.
+   */
+  dealii::FullMatrix<double> calc_kalman_weights(
+      std::vector<dealii::Vector<double>> const &HX,
       dealii::SparseMatrix<double> const &R,
       std::vector<dealii::Vector<double>> const &perturbed_innovation);
 
+  /**
+   * Apply the localized P H^T to the columns of @p weights and return the
+   * rows associated with the slice of the current processor for each column.
+   * P is never formed: the product is computed from the anomalies of
+   * @p slice_ensemble and @p HX, and the localization pattern.
+   */
+  std::vector<dealii::Vector<double>> apply_slice_covariance(
+      std::vector<dealii::Vector<double>> const &slice_ensemble,
+      std::vector<dealii::Vector<double>> const &HX,
+      dealii::FullMatrix<double> const &weights) const;
+
+  /**
+   * This performs the ETKF or the LETKF analysis and returns the increments of
+   * the slice owned by the current processor. Only matrices of the size of the
+   * ensemble are factored.
+   */
+  std::vector<dealii::Vector<double>> apply_ensemble_transform(
+      std::vector<dealii::Vector<double>> const &slice_ensemble,
+      std::vector<dealii::Vector<double>> const &HX,
+      dealii::SparseMatrix<double> const &R,
+      std::vector<double> const &expt_data);
+
+  /**
+   * Return Y^T R^-1 where Y are the anomalies of the observed ensemble members
+   * @p HX.
+   */
+  dealii::FullMatrix<double> calc_ensemble_space_observation_operator(
+      std::vector<dealii::Vector<double>> const &HX,
+      dealii::SparseMatrix<double> const &R);
+
+  /**
+   * Compute the ETKF or the LETKF increments of the slice using @p C returned
+   * by calc_ensemble_space_observation_operator(). Only local data is used.
+   */
+  std::vector<dealii::Vector<double>> apply_ensemble_transforms(
+      std::vector<dealii::Vector<double>> const &slice_ensemble,
+      std::vector<dealii::Vector<double>> const &HX,
+      dealii::FullMatrix<double> const &C,
+      std::vector<double> const &expt_data) const;
+
+  /**
+   * This calculates the localized sample covariance between the entries of the
+   * slice owned by the current processor and the observations, i.e., the rows
+   * of P H^T associated with the slice. The matrix is dense, the analysis uses
+   * apply_slice_covariance() instead.
+   */
+  dealii::FullMatrix<double> calc_slice_covariance(
+      std::vector<dealii::Vector<double>> const &slice_ensemble,
+      std::vector<dealii::Vector<double>> const &HX) const;
+
+  /**
+   * This calculates the localized sample covariance of the observations, i.e.,
+   * H P H^T.
+   */
+  dealii::FullMatrix<double>
+  calc_expt_covariance(std::vector<dealii::Vector<double>> const &HX) const;
+
+  /**
+   * Return the localization scaling associated with the distance between two
+   * points.
+   */
+  double localization_scaling(double const distance) const;
+
   /**
    * This calculates the observation matrix.
    */
@@ -163,13 +449,20 @@ private:
   /**
    * This fills a vector (vec) with noise from a multivariate normal
    * distribution defined by a covariance matrix (R). Note: For non-diagonal R
-   * this method currently uses full matrices, which substantially limits the
-   * allowable problem size.
+   * this method uses the dense Cholesky factor of R, which substantially
+   * limits the allowable problem size. The factor is only recomputed when R
+   * changes.
    */
   void fill_noise_vector(dealii::Vector<double> &vec,
                          dealii::SparseMatrix<double> const &R,
                          bool const R_is_diagonal);
 
+  /**
+   * Compute the Cholesky factor of @p R if it is different from the last
+   * factored matrix.
+   */
+  void update_R_cholesky(dealii::SparseMatrix<double> const &R);
+
   /**
    * A standard localization function, resembles a Gaussian, but with finite
    * support. From Gaspari and Cohn, Quarterly Journal of the Royal
@@ -177,16 +470,6 @@ private:
    */
   double gaspari_cohn_function(double const r) const;
 
-  /**
-   * This calculates the sample covariance for an input ensemble of vectors
-   * (vec_ensemble). Currently this is tied to the simulation ensemble, through
-   * the use of member variables inside. If needed, the interface could be
-   * redone to make it more generally applicable.
-   */
-  dealii::TrilinosWrappers::SparseMatrix calc_sample_covariance_sparse(
-      std::vector<dealii::LA::distributed::BlockVector<double>> const
-          &vec_ensemble) const;
-
   /**
    * Global MPI communicator.
    */
@@ -233,17 +516,62 @@ private:
   unsigned int _expt_size = 0;
 
   /**
-   * The sparsity pattern for the localized covariance matrix.
+   * Offsets of the slices of the augmented state owned by the processors of
+   * the global communicator. The slice of processor i is [_slice_offsets[i],
+   * _slice_offsets[i+1]).
    */
-  dealii::TrilinosWrappers::SparsityPattern _covariance_sparsity_pattern;
+  std::vector<unsigned int> _slice_offsets;
 
   /**
-   * Map between the indices in the covariance matrix and the distance between
-   * the support points for the associated dofs on the mesh. This is necessary
-   * for localization.
+   * Support points of the entries of the slice owned by the current processor
+   * that are part of the simulation state. In 2D, the last coordinate is zero.
    */
-  std::map<const std::pair<unsigned int, unsigned int>, double>
-      _covariance_distance_map;
+  std::vector<dealii::Point<3>> _slice_support_points;
+
+  /**
+   * Support points of the observations. In 2D, the last coordinate is zero.
+   */
+  std::vector<dealii::Point<3>> _expt_support_points;
+
+  /**
+   * Fingerprint of the dofs used to compute _slice_support_points.
+   */
+  boost::optional<std::size_t> _dof_fingerprint;
+
+  /**
+   * Flag set when _expt_support_points need to be recomputed.
+   */
+  bool _expt_support_points_outdated = true;
+
+  /**
+   * Cutoff distance and cutoff function used to compute the localization
+   * pattern.
+   */
+  std::pair<double, LocalizationCutoff> _localization_pattern_parameters = {
+      -1., LocalizationCutoff::none};
+
+  /**
+   * Offsets of the rows of the localization pattern in CSR format. A row is
+   * associated with an entry of the slice that has a support point and the
+   * columns are the observations. The pattern has no row if the covariance is
+   * not localized.
+   */
+  std::vector<unsigned int> _localization_row_offsets = {0};
+
+  /**
+   * Support points of the slice used to compute the localization pattern.
+   */
+  std::vector<dealii::Point<3>> _localization_support_points;
+
+  /**
+   * Observations of the localization pattern.
+   */
+  std::vector<unsigned int> _localization_columns;
+
+  /**
+   * Localization weights of the entries of the localization pattern.
+   */
+  std::vector<double> _localization_weights;
 
   /**
    * The distance at which the sample covariance is truncated.
@@ -256,6 +584,11 @@ private:
    */
   LocalizationCutoff _localization_cutoff_function;
 
+  /**
+   * The scheme used for the analysis.
+   */
+  AnalysisScheme _analysis_scheme = AnalysisScheme::enkf;
+
   /**
    * The pseudo-random number generator, used for the perturbations to the
    * innovation vectors.
@@ -268,6 +601,41 @@ private:
    */
   std::normal_distribution<> _normal_dist_generator;
 
+  /**
+   * Cholesky factor of the last non-diagonal observation covariance matrix.
+   */
+  dealii::FullMatrix<double> _R_cholesky;
+
+  /**
+   * Nonzero entries of the matrix factored in _R_cholesky.
+   */
+  std::vector<double> _R_values;
+
+  /**
+   * Slice of the ensemble members used by the pending analysis.
+   */
+  std::vector<dealii::Vector<double>> _slice_ensemble;
+
+  /**
+   * Entries received by the current processor for the pending analysis.
+   */
+  std::map<unsigned int, std::vector<StateEntry>> _slice_entries;
+
+  /**
+   * Increments of the slice computed by the pending analysis.
+   */
+  std::future<std::vector<dealii::Vector<double>>> _slice_increments;
+
+  /**
+   * Flag set when the increments are computed on a separate thread.
+   */
+  bool _background_analysis = false;
+
+  /**
+   * Frames stored since the last analysis.
+   */
+  std::vector<ObservationFrame> _stored_frames;
+
   /**
    * The mapping between the index in the experimental observation data vector
    * to the DoF in the simulation data vectors. This is simpler to use than the
@@ -278,14 +646,14 @@ private:
   std::pair<std::vector<int>, std::vector<int>> _expt_to_dof_mapping;
 
   /**
-   * Standardized settings for the GMRES solver needed for the matrix inversion
-   * in the Kalman gain calculation.
+   * Standardized settings for the GMRES solver used for the matrix inversion
+   * in the Kalman gain calculation when HPH^T+R is not positive definite.
    */
   dealii::SolverControl _solver_control;
 
   /**
-   * Additional settings for the GMRES solver needed for the matrix inversion in
-   * the Kalman gain calculation.
+   * Additional settings for the GMRES solver used for the matrix inversion in
+   * the Kalman gain calculation when HPH^T+R is not positive definite.
    */
   dealii::SolverGMRES<dealii::Vector<double>>::AdditionalData _additional_data;
 };
@@ -23,7 +23,13 @@ template <int dim>
 void ElectronBeamHeatSource<dim>::update_time(double time)
 {
   _beam_center = this->_scan_path.value(time);
-  double segment_power_modifier = this->_scan_path.get_power_modifier(time);
+  // When the source is swept, the power modifiers are applied piece by piece
+  // in value().
+  double segment_power_modifier = 1.;
+  if (this->_sweep_duration > 0.)
+    this->update_swept_pieces(time);
+  else
+    segment_power_modifier = this->_scan_path.get_power_modifier(time);
   _alpha =
       -this->_beam.absorption_efficiency * this->_beam.max_power *
       segment_power_modifier * _log_01 /
@@ -44,6 +50,13 @@ double ElectronBeamHeatSource<dim>::value(dealii::Point<dim> const &point,
     double const distribution_z = -3. * std::pow(z / this->_beam.depth, 2) -
                                   2. * (z / this->_beam.depth) + 1.;
 
+    if (this->_sweep_duration > 0.)
+    {
+      // Electron beam heat source equation averaged along the scan path
+      return _alpha * this->swept_distribution(point, -_log_01) *
+             distribution_z;
+    }
+
     double xpy_squared =
         std::pow(point[axis<dim>::x] - _beam_center[axis<dim>::x], 2);
     if (dim == 3)
@@ -60,6 +73,32 @@ double ElectronBeamHeatSource<dim>::value(dealii::Point<dim> const &point,
     return heat_source;
   }
 }
+
+template <int dim>
+std::optional<dealii::BoundingBox<dim>>
+ElectronBeamHeatSource<dim>::get_bounding_box(double const height,
+                                              double const cutoff) const
+{
+  if ((_alpha == 0.) ||
+      ((this->_sweep_duration > 0.) && this->_swept_pieces.empty()))
+    return {};
+
+  // The source is zero below the depth of the beam. The distribution in the
+  // build direction is a polynomial whose maximum is 4/3 and which is negative
+  // above a third of the depth. Without a cutoff, the box is not bounded from
+  // above.
+  double const exponent = this->get_support_exponent(
+      4. / 3. * _alpha * this->get_max_power_modifier(), cutoff);
+  if (exponent < 0.)
+    return {};
+  double const radius =
+      std::sqrt(-exponent / _log_01 * this->_beam.radius_squared);
+  double const z_max = cutoff > 0. ? this->_beam.depth / 3.
+                                   : std::numeric_limits<double>::infinity();
+
+  return this->beam_bounding_box(_beam_center, radius, -this->_beam.depth,
+                                 z_max, height);
+}
 } // namespace adamantine
 
 INSTANTIATE_DIM(ElectronBeamHeatSource)
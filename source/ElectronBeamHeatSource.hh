@@ -47,6 +47,12 @@ public:
   double value(dealii::Point<dim> const &point,
                double const height) const final;
 
+  /**
+   * Return the bounding box outside of which the heat source is negligible.
+   */
+  std::optional<dealii::BoundingBox<dim>>
+  get_bounding_box(double const height, double const cutoff) const final;
+
 private:
   dealii::Point<3> _beam_center;
   double _alpha = std::numeric_limits<double>::signaling_NaN();
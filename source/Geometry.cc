@@ -14,6 +14,7 @@
 #include <types.hh>
 #include <utils.hh>
 
+#include <deal.II/base/mpi.h>
 #include <deal.II/grid/filtered_iterator.h>
 #include <deal.II/grid/grid_generator.h>
 #include <deal.II/grid/grid_in.h>
@@ -138,6 +139,19 @@ Geometry<dim>::Geometry(MPI_Comm const &communicator,
 
     p2 = p2 + p1;
 
+    // When the domain grows with the build, the coarse mesh is coarser than
+    // the requested divisions.
+    // PropertyTreeInput geometry.domain_growth_refinements
+    _growth_refinements = database.get("domain_growth_refinements", 0u);
+    unsigned int const coarsening_factor = 1u << _growth_refinements;
+    for (auto &n_divisions : repetitions)
+    {
+      ASSERT_THROW(n_divisions % coarsening_factor == 0,
+                   "Error: The number of divisions needs to be divisible by "
+                   "2^domain_growth_refinements.");
+      n_divisions /= coarsening_factor;
+    }
+
     // For now we assume that the geometry is very simple.
     dealii::GridGenerator::subdivided_hyper_rectangle(
         _triangulation, repetitions, p1, p2, true);
@@ -147,11 +161,47 @@ Geometry<dim>::Geometry(MPI_Comm const &communicator,
     {
       cell->set_material_id(0);
     }
+
+    // Refine the part of the domain that already contains material.
+    // PropertyTreeInput geometry.material_height
+    double const material_height = database.get("material_height", 1e9);
+    while (flag_cells_to_grow(material_height))
+      _triangulation.execute_coarsening_and_refinement();
   }
 
   assign_material_state(database);
 }
 
+template <int dim>
+bool Geometry<dim>::flag_cells_to_grow(double const height)
+{
+  if (height <= _grown_height)
+    return false;
+
+  bool cells_flagged = false;
+  for (auto cell :
+       dealii::filter_iterators(_triangulation.active_cell_iterators(),
+                                dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    if ((cell->level() < static_cast<int>(_growth_refinements)) &&
+        (cell->bounding_box().lower_bound(axis<dim>::z) < height))
+    {
+      cell->clear_coarsen_flag();
+      cell->set_refine_flag();
+      cells_flagged = true;
+    }
+  }
+
+  cells_flagged =
+      dealii::Utilities::MPI::max(static_cast<int>(cells_flagged),
+                                  _triangulation.get_communicator()) == 1;
+  // All the cells below height have the requested resolution
+  if (!cells_flagged)
+    _grown_height = height;
+
+  return cells_flagged;
+}
+
 template <int dim>
 void Geometry<dim>::assign_material_state(
     boost::property_tree::ptree const &database)
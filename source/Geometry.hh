@@ -1,4 +1,4 @@
-/* Copyright (c) 2016 - 2021, the adamantine authors.
+/* Copyright (c) 2016 - 2024, the adamantine authors.
  *
  * This file is subject to the Modified BSD License and may not be distributed
  * without copyright and license information. Please refer to the file LICENSE
@@ -12,10 +12,18 @@
 
 #include <boost/property_tree/ptree.hpp>
 
+#include <limits>
+
 namespace adamantine
 {
 /**
  * This class generates and stores a Triangulation given a database.
+ *
+ * When the mesh is generated and domain_growth_refinements is positive, the
+ * coarse mesh is 2^domain_growth_refinements times coarser than the requested
+ * divisions. Only the cells below the material height are refined to the
+ * requested resolution. The cells above are refined layer by layer as the
+ * build grows, so that the memory follows the built volume.
  */
 template <int dim>
 class Geometry
@@ -32,11 +40,34 @@ public:
    */
   dealii::parallel::distributed::Triangulation<dim> &get_triangulation();
 
+  /**
+   * Return the number of refinements between the coarse mesh and the requested
+   * divisions.
+   */
+  unsigned int get_growth_refinements() const;
+
+  /**
+   * Flag for refinement the locally owned cells below @p height that are
+   * coarser than the requested divisions. Return true if a cell has been
+   * flagged on any processor. Each call refines the cells by one level, the
+   * function needs to be called until it returns false. This is a collective
+   * operation.
+   */
+  bool flag_cells_to_grow(double const height);
+
 private:
   /**
    * Triangulation of the domain.
    */
   dealii::parallel::distributed::Triangulation<dim> _triangulation;
+  /**
+   * Number of refinements between the coarse mesh and the requested divisions.
+   */
+  unsigned int _growth_refinements = 0;
+  /**
+   * Height below which all the cells have the requested resolution.
+   */
+  double _grown_height = std::numeric_limits<double>::lowest();
 
   /**
    * Assign the material state to the mesh.
@@ -50,6 +81,12 @@ Geometry<dim>::get_triangulation()
 {
   return _triangulation;
 }
+
+template <int dim>
+inline unsigned int Geometry<dim>::get_growth_refinements() const
+{
+  return _growth_refinements;
+}
 } // namespace adamantine
 
 #endif
@@ -23,7 +23,13 @@ template <int dim>
 void GoldakHeatSource<dim>::update_time(double time)
 {
   _beam_center = this->_scan_path.value(time);
-  double segment_power_modifier = this->_scan_path.get_power_modifier(time);
+  // When the source is swept, the power modifiers are applied piece by piece
+  // in value().
+  double segment_power_modifier = 1.;
+  if (this->_sweep_duration > 0.)
+    this->update_swept_pieces(time);
+  else
+    segment_power_modifier = this->_scan_path.get_power_modifier(time);
   _alpha = 2.0 * this->_beam.absorption_efficiency * this->_beam.max_power *
            segment_power_modifier /
            (this->_beam.radius_squared * this->_beam.depth * _pi_over_3_to_1p5);
@@ -38,6 +44,12 @@ double GoldakHeatSource<dim>::value(dealii::Point<dim> const &point,
   {
     return 0.;
   }
+  else if (this->_sweep_duration > 0.)
+  {
+    // Goldak heat source equation averaged along the scan path
+    return _alpha * this->swept_distribution(point, 3.0) *
+           std::exp(-3.0 * std::pow(z / this->_beam.depth, 2));
+  }
   else
   {
     double xpy_squared =
@@ -56,6 +68,30 @@ double GoldakHeatSource<dim>::value(dealii::Point<dim> const &point,
     return heat_source;
   }
 }
+
+template <int dim>
+std::optional<dealii::BoundingBox<dim>>
+GoldakHeatSource<dim>::get_bounding_box(double const height,
+                                        double const cutoff) const
+{
+  if ((_alpha == 0.) ||
+      ((this->_sweep_duration > 0.) && this->_swept_pieces.empty()))
+    return {};
+
+  // The source is zero below the depth of the beam and decreases like a
+  // Gaussian everywhere else. The maximum of the source is _alpha times the
+  // largest power modifier.
+  double const exponent = this->get_support_exponent(
+      _alpha * this->get_max_power_modifier(), cutoff);
+  if (exponent < 0.)
+    return {};
+  double const radius =
+      std::sqrt(exponent / 3.0 * this->_beam.radius_squared);
+  double const z_max = std::sqrt(exponent / 3.0) * this->_beam.depth;
+
+  return this->beam_bounding_box(_beam_center, radius, -this->_beam.depth,
+                                 z_max, height);
+}
 } // namespace adamantine
 
 INSTANTIATE_DIM(GoldakHeatSource)
@@ -12,8 +12,15 @@
 #include <ScanPath.hh>
 #include <types.hh>
 
+#include <deal.II/base/bounding_box.h>
 #include <deal.II/base/point.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <vector>
+
 namespace adamantine
 {
 /**
@@ -74,6 +81,18 @@ public:
    */
   virtual double value(dealii::Point<dim> const &point,
                        double const height) const = 0;
+
+  /**
+   * Return the bounding box outside of which the heat source is smaller than
+   * @p cutoff at the time given to the last call to update_time(), given the
+   * current height of the object being manufactured. If @p cutoff is zero, the
+   * box encloses the region where the heat source is not negligible. Return an
+   * empty optional if the heat source is below the cutoff everywhere. The
+   * default implementation returns a box that covers the entire space.
+   */
+  virtual std::optional<dealii::BoundingBox<dim>>
+  get_bounding_box(double const height, double const cutoff) const;
+
   /**
    * Return the scan path for the heat source.
    */
@@ -91,7 +110,89 @@ public:
    */
   virtual void set_beam_properties(boost::property_tree::ptree const &database);
 
+  /**
+   * Set the duration over which the heat source is averaged along the scan
+   * path. When the duration is positive, update_time(time) computes the average
+   * of the heat source over [time, time + duration] instead of its value at
+   * the given instant. This avoids a beaded melt track when the beam travels
+   * more than its diameter during a time step. A duration of zero (the default)
+   * evaluates the heat source at a single instant.
+   */
+  void set_sweep_duration(double const duration);
+
 protected:
+  /**
+   * Piece of the scan path traversed with a constant velocity and a constant
+   * power during the sweep.
+   */
+  struct SweptPiece
+  {
+    dealii::Point<3> start_point;
+    dealii::Tensor<1, 3> velocity;
+    double duration;
+    double power_modifier;
+  };
+
+  /**
+   * Split the scan path between @p time and @p time + _sweep_duration into
+   * pieces of constant velocity and constant power.
+   */
+  void update_swept_pieces(double const time);
+
+  /**
+   * Return the time average over the sweep of the normalized Gaussian
+   * distribution \f$\exp(-c r^2/r_b^2)\f$, where \f$r\f$ is the distance in
+   * the plane of the layer between @p point and the beam center, \f$r_b\f$ is
+   * the radius of the beam, and \f$c\f$ is @p coef. The distribution is
+   * weighted by the power modifier of each piece and integrated analytically
+   * along the pieces.
+   */
+  double swept_distribution(dealii::Point<dim> const &point,
+                            double const coef) const;
+
+  /**
+   * Return the bounding box of a beam centered on @p beam_center, or of the
+   * pieces of the scan path if the heat source is swept. The box extends by
+   * @p radius in the plane of the layer and from @p height + @p z_min to
+   * @p height + @p z_max in the build direction.
+   */
+  dealii::BoundingBox<dim>
+  beam_bounding_box(dealii::Point<3> const &beam_center, double const radius,
+                    double const z_min, double const z_max,
+                    double const height) const;
+
+  /**
+   * Return the exponent \f$c\f$ such that a Gaussian distribution of maximum
+   * @p peak is smaller than @p cutoff where \f$\exp(-c r^2/r_b^2) < 1\f$.
+   * The exponent is at most _support_exponent. Return a negative value if
+   * the distribution is smaller than @p cutoff everywhere.
+   */
+  double get_support_exponent(double const peak, double const cutoff) const;
+
+  /**
+   * Return the maximum power modifier of the pieces of the sweep, or one if
+   * the heat source is not swept.
+   */
+  double get_max_power_modifier() const;
+
+  /**
+   * Exponent of the Gaussian distributions below which the beams are
+   * considered to be zero when computing their bounding box. exp(-100) is
+   * about 4e-44.
+   */
+  static double constexpr _support_exponent = 100.;
+
+  /**
+   * Duration of the sweep. If the duration is zero, the heat source is not
+   * swept.
+   */
+  double _sweep_duration = 0.;
+
+  /**
+   * Pieces of the scan path traversed during the sweep.
+   */
+  std::vector<SweptPiece> _swept_pieces;
+
   /**
    * Structure of the physical properties of the beam heat source.
    */
@@ -103,6 +204,22 @@ protected:
   ScanPath _scan_path;
 };
 
+template <int dim>
+inline std::optional<dealii::BoundingBox<dim>>
+HeatSource<dim>::get_bounding_box(double const /*height*/,
+                                  double const /*cutoff*/) const
+{
+  dealii::Point<dim> lower_point;
+  dealii::Point<dim> upper_point;
+  for (int d = 0; d < dim; ++d)
+  {
+    lower_point[d] = std::numeric_limits<double>::lowest();
+    upper_point[d] = std::numeric_limits<double>::max();
+  }
+
+  return dealii::BoundingBox<dim>(std::make_pair(lower_point, upper_point));
+}
+
 template <int dim>
 inline ScanPath &HeatSource<dim>::get_scan_path()
 {
@@ -122,6 +239,180 @@ inline void HeatSource<dim>::set_beam_properties(
   _beam.set_from_database(database);
 }
 
+template <int dim>
+inline void HeatSource<dim>::set_sweep_duration(double const duration)
+{
+  _sweep_duration = duration;
+}
+
+template <int dim>
+inline void HeatSource<dim>::update_swept_pieces(double const time)
+{
+  _swept_pieces.clear();
+
+  // Split the sweep at the end of each segment so that each piece has a
+  // constant velocity and a constant power.
+  double const end_time = time + _sweep_duration;
+  std::vector<double> piece_times =
+      _scan_path.get_segment_end_times(time, end_time);
+  piece_times.insert(piece_times.begin(), time);
+  piece_times.push_back(end_time);
+
+  for (unsigned int i = 0; i < piece_times.size() - 1; ++i)
+  {
+    double const piece_duration = piece_times[i + 1] - piece_times[i];
+    if (piece_duration <= 0.)
+      continue;
+    // Use the middle of the piece to get the power modifier to avoid ambiguity
+    // at the end of a segment. After the end of the scan path, the power
+    // modifier is zero.
+    double const power_modifier = _scan_path.get_power_modifier(
+        0.5 * (piece_times[i] + piece_times[i + 1]));
+    if (power_modifier == 0.)
+      continue;
+
+    SweptPiece piece;
+    piece.start_point = _scan_path.value(piece_times[i]);
+    piece.velocity =
+        (_scan_path.value(piece_times[i + 1]) - piece.start_point) /
+        piece_duration;
+    piece.duration = piece_duration;
+    piece.power_modifier = power_modifier;
+    _swept_pieces.push_back(piece);
+  }
+}
+
+template <int dim>
+inline double
+HeatSource<dim>::swept_distribution(dealii::Point<dim> const &point,
+                                    double const coef) const
+{
+  double const k = coef / _beam.radius_squared;
+  double const sqrt_k = std::sqrt(k);
+  double distribution = 0.;
+  for (auto const &piece : _swept_pieces)
+  {
+    // Distance to the start of the piece and velocity in the plane of the layer
+    double d_squared = std::pow(point[axis<dim>::x] - piece.start_point[0], 2);
+    double d_dot_v =
+        (point[axis<dim>::x] - piece.start_point[0]) * piece.velocity[0];
+    double speed_squared = std::pow(piece.velocity[0], 2);
+    if (dim == 3)
+    {
+      d_squared += std::pow(point[axis<dim>::y] - piece.start_point[1], 2);
+      d_dot_v +=
+          (point[axis<dim>::y] - piece.start_point[1]) * piece.velocity[1];
+      speed_squared += std::pow(piece.velocity[1], 2);
+    }
+
+    double const speed = std::sqrt(speed_squared);
+    double integral = 0.;
+    if (speed * piece.duration * sqrt_k < 1e-6)
+    {
+      // The beam does not move: spot or vertical motion.
+      integral = piece.duration * std::exp(-k * d_squared);
+    }
+    else
+    {
+      // Decompose the distance in a component along the path and a component
+      // normal to the path. The integral along the path is given by erf.
+      double const along = d_dot_v / speed;
+      double const normal_squared = std::max(d_squared - along * along, 0.);
+      double const a = sqrt_k * along;
+      double const b = sqrt_k * (along - speed * piece.duration);
+      // Use erfc in the tails to avoid cancellation.
+      double erf_difference = 0.;
+      if (b >= 0.)
+        erf_difference = std::erfc(b) - std::erfc(a);
+      else if (a <= 0.)
+        erf_difference = std::erfc(-a) - std::erfc(-b);
+      else
+        erf_difference = std::erf(a) - std::erf(b);
+      integral = std::exp(-k * normal_squared) *
+                 std::sqrt(dealii::numbers::PI) / (2. * sqrt_k * speed) *
+                 erf_difference;
+    }
+    distribution += piece.power_modifier * integral;
+  }
+
+  return distribution / _sweep_duration;
+}
+
+template <int dim>
+inline double HeatSource<dim>::get_support_exponent(double const peak,
+                                                    double const cutoff) const
+{
+  if (cutoff <= 0.)
+    return _support_exponent;
+
+  if (peak <= cutoff)
+    return -1.;
+
+  return std::min(_support_exponent, std::log(peak / cutoff));
+}
+
+template <int dim>
+inline double HeatSource<dim>::get_max_power_modifier() const
+{
+  if (_sweep_duration == 0.)
+    return 1.;
+
+  double max_power_modifier = 0.;
+  for (auto const &piece : _swept_pieces)
+    max_power_modifier = std::max(max_power_modifier, piece.power_modifier);
+
+  return max_power_modifier;
+}
+
+template <int dim>
+inline dealii::BoundingBox<dim> HeatSource<dim>::beam_bounding_box(
+    dealii::Point<3> const &beam_center, double const radius,
+    double const z_min, double const z_max, double const height) const
+{
+  // Gather the positions of the beam center
+  std::vector<dealii::Point<3>> centers;
+  if (_sweep_duration > 0.)
+  {
+    for (auto const &piece : _swept_pieces)
+    {
+      centers.push_back(piece.start_point);
+      centers.push_back(piece.start_point + piece.duration * piece.velocity);
+    }
+  }
+  else
+  {
+    centers.push_back(beam_center);
+  }
+
+  dealii::Point<dim> lower_point;
+  dealii::Point<dim> upper_point;
+  lower_point[axis<dim>::x] = std::numeric_limits<double>::max();
+  upper_point[axis<dim>::x] = std::numeric_limits<double>::lowest();
+  if constexpr (dim == 3)
+  {
+    lower_point[axis<dim>::y] = std::numeric_limits<double>::max();
+    upper_point[axis<dim>::y] = std::numeric_limits<double>::lowest();
+  }
+  for (auto const &center : centers)
+  {
+    lower_point[axis<dim>::x] =
+        std::min(lower_point[axis<dim>::x], center[0] - radius);
+    upper_point[axis<dim>::x] =
+        std::max(upper_point[axis<dim>::x], center[0] + radius);
+    if constexpr (dim == 3)
+    {
+      lower_point[axis<dim>::y] =
+          std::min(lower_point[axis<dim>::y], center[1] - radius);
+      upper_point[axis<dim>::y] =
+          std::max(upper_point[axis<dim>::y], center[1] + radius);
+    }
+  }
+  lower_point[axis<dim>::z] = height + z_min;
+  upper_point[axis<dim>::z] = height + z_max;
+
+  return dealii::BoundingBox<dim>(std::make_pair(lower_point, upper_point));
+}
+
 } // namespace adamantine
 
 #endif
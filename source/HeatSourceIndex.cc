@@ -0,0 +1,208 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <HeatSourceIndex.hh>
+#include <instantiation.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace adamantine
+{
+namespace
+{
+/**
+ * Return true if the two boxes intersect.
+ */
+template <int dim>
+bool intersect(dealii::BoundingBox<dim> const &box_1,
+               dealii::BoundingBox<dim> const &box_2)
+{
+  for (int d = 0; d < dim; ++d)
+  {
+    if ((box_1.get_boundary_points().second[d] <
+         box_2.get_boundary_points().first[d]) ||
+        (box_2.get_boundary_points().second[d] <
+         box_1.get_boundary_points().first[d]))
+      return false;
+  }
+
+  return true;
+}
+} // namespace
+
+template <int dim>
+void HeatSourceIndex<dim>::reinit(
+    std::vector<std::shared_ptr<HeatSource<dim>>> const &heat_sources,
+    double const height)
+{
+  _boxes.clear();
+  _beam_ids.clear();
+  _unbounded.clear();
+  _bins.clear();
+
+  // Gather the bounding boxes of the heat sources which are on.
+  std::array<double, 2> lower = {{std::numeric_limits<double>::max(),
+                                  std::numeric_limits<double>::max()}};
+  std::array<double, 2> upper = {{std::numeric_limits<double>::lowest(),
+                                  std::numeric_limits<double>::lowest()}};
+  std::vector<unsigned int> bounded;
+  for (unsigned int i = 0; i < heat_sources.size(); ++i)
+  {
+    auto const box = heat_sources[i]->get_bounding_box(height, 0.);
+    if (!box)
+      continue;
+
+    unsigned int const position = _boxes.size();
+    _boxes.push_back(*box);
+    _beam_ids.push_back(i);
+
+    bool is_bounded = true;
+    for (unsigned int d = 0; d < _n_directions; ++d)
+    {
+      double const box_lower = box->get_boundary_points().first[_axes[d]];
+      double const box_upper = box->get_boundary_points().second[_axes[d]];
+      if ((box_lower == std::numeric_limits<double>::lowest()) ||
+          (box_upper == std::numeric_limits<double>::max()))
+        is_bounded = false;
+    }
+    if (is_bounded)
+    {
+      bounded.push_back(position);
+      for (unsigned int d = 0; d < _n_directions; ++d)
+      {
+        lower[d] =
+            std::min(lower[d], box->get_boundary_points().first[_axes[d]]);
+        upper[d] =
+            std::max(upper[d], box->get_boundary_points().second[_axes[d]]);
+      }
+    }
+    else
+    {
+      _unbounded.push_back(position);
+    }
+  }
+
+  // Build a uniform grid that covers the bounded boxes. We use about one bin
+  // per heat source in each direction.
+  _n_bins = {{0, 1}};
+  if (bounded.empty())
+    return;
+
+  int const n_bins_per_direction =
+      _n_directions == 1
+          ? bounded.size()
+          : std::ceil(std::sqrt(static_cast<double>(bounded.size())));
+  for (unsigned int d = 0; d < _n_directions; ++d)
+  {
+    _n_bins[d] = n_bins_per_direction;
+    _origin[d] = lower[d];
+    _bin_size[d] = (upper[d] - lower[d]) / _n_bins[d];
+    if (_bin_size[d] <= 0.)
+    {
+      _n_bins[d] = 1;
+      _bin_size[d] = 1.;
+    }
+  }
+
+  _bins.resize(_n_bins[0] * _n_bins[1]);
+  for (auto const position : bounded)
+  {
+    std::array<int, 2> lower_bin = {{0, 0}};
+    std::array<int, 2> upper_bin = {{0, 0}};
+    for (unsigned int d = 0; d < _n_directions; ++d)
+    {
+      lower_bin[d] = get_bin(
+          d, _boxes[position].get_boundary_points().first[_axes[d]]);
+      upper_bin[d] = get_bin(
+          d, _boxes[position].get_boundary_points().second[_axes[d]]);
+    }
+    for (int j = lower_bin[1]; j <= upper_bin[1]; ++j)
+      for (int i = lower_bin[0]; i <= upper_bin[0]; ++i)
+        _bins[j * _n_bins[0] + i].push_back(position);
+  }
+}
+
+template <int dim>
+void HeatSourceIndex<dim>::query(dealii::Point<dim> const &point,
+                                 std::vector<unsigned int> &beam_ids) const
+{
+  query(dealii::BoundingBox<dim>(std::make_pair(point, point)), beam_ids);
+}
+
+template <int dim>
+void HeatSourceIndex<dim>::query(dealii::BoundingBox<dim> const &box,
+                                 std::vector<unsigned int> &beam_ids) const
+{
+  beam_ids.clear();
+
+  for (auto const position : _unbounded)
+  {
+    if (intersect(_boxes[position], box))
+      beam_ids.push_back(_beam_ids[position]);
+  }
+
+  if (_bins.empty())
+    return;
+
+  // Find the bins that intersect the box. Exit early if the box is outside
+  // of the grid.
+  std::array<int, 2> lower_bin = {{0, 0}};
+  std::array<int, 2> upper_bin = {{0, 0}};
+  for (unsigned int d = 0; d < _n_directions; ++d)
+  {
+    double const box_lower = box.get_boundary_points().first[_axes[d]];
+    double const box_upper = box.get_boundary_points().second[_axes[d]];
+    if ((box_upper < _origin[d]) ||
+        (box_lower > _origin[d] + _n_bins[d] * _bin_size[d]))
+      return;
+    lower_bin[d] = get_bin(d, box_lower);
+    upper_bin[d] = get_bin(d, box_upper);
+  }
+
+  query_bins(lower_bin, upper_bin, box, beam_ids);
+}
+
+template <int dim>
+int HeatSourceIndex<dim>::get_bin(unsigned int const direction,
+                                  double const coordinate) const
+{
+  int const bin = static_cast<int>(
+      std::floor((coordinate - _origin[direction]) / _bin_size[direction]));
+
+  return std::clamp(bin, 0, _n_bins[direction] - 1);
+}
+
+template <int dim>
+void HeatSourceIndex<dim>::query_bins(std::array<int, 2> const &lower_bin,
+                                      std::array<int, 2> const &upper_bin,
+                                      dealii::BoundingBox<dim> const &box,
+                                      std::vector<unsigned int> &beam_ids) const
+{
+  for (int j = lower_bin[1]; j <= upper_bin[1]; ++j)
+  {
+    for (int i = lower_bin[0]; i <= upper_bin[0]; ++i)
+    {
+      for (auto const position : _bins[j * _n_bins[0] + i])
+      {
+        if (intersect(_boxes[position], box))
+          beam_ids.push_back(_beam_ids[position]);
+      }
+    }
+  }
+
+  // A heat source can overlap several bins. Remove the duplicates but keep the
+  // heat sources sorted so that the sum over the heat sources does not depend
+  // on the grid.
+  std::sort(beam_ids.begin(), beam_ids.end());
+  beam_ids.erase(std::unique(beam_ids.begin(), beam_ids.end()),
+                 beam_ids.end());
+}
+} // namespace adamantine
+
+INSTANTIATE_DIM(HeatSourceIndex)
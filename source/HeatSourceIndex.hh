@@ -0,0 +1,126 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef HEAT_SOURCE_INDEX_HH
+#define HEAT_SOURCE_INDEX_HH
+
+#include <HeatSource.hh>
+#include <types.hh>
+
+#include <deal.II/base/bounding_box.h>
+#include <deal.II/base/point.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace adamantine
+{
+/**
+ * This class is a spatial index over the bounding boxes of the heat sources. It
+ * is used to evaluate only the heat sources whose support overlaps a given
+ * point or a given box. This is important for machines with many beams: each
+ * beam touches a small region of the domain but looping over all the beams
+ * makes the cost of evaluating the source grow linearly with the number of
+ * beams.
+ *
+ * The index is a uniform grid in the plane of the layer. It needs to be rebuilt
+ * every time the time of the heat sources is updated.
+ */
+template <int dim>
+class HeatSourceIndex
+{
+public:
+  /**
+   * Rebuild the index using the bounding boxes of the heat sources. The heat
+   * sources need to be updated to the current time before calling this
+   * function.
+   */
+  void reinit(std::vector<std::shared_ptr<HeatSource<dim>>> const &heat_sources,
+              double const height);
+
+  /**
+   * Fill @p beam_ids with the indices of the heat sources whose bounding box
+   * contains @p point.
+   */
+  void query(dealii::Point<dim> const &point,
+             std::vector<unsigned int> &beam_ids) const;
+
+  /**
+   * Fill @p beam_ids with the indices of the heat sources whose bounding box
+   * intersects @p box.
+   */
+  void query(dealii::BoundingBox<dim> const &box,
+             std::vector<unsigned int> &beam_ids) const;
+
+  /**
+   * Return true if no heat source is on.
+   */
+  bool empty() const;
+
+private:
+  /**
+   * Return the index of the bin along the given direction of the layer.
+   */
+  int get_bin(unsigned int const direction, double const coordinate) const;
+
+  /**
+   * Add to @p beam_ids the heat sources in the bins between @p lower_bin and
+   * @p upper_bin whose bounding box intersect @p box.
+   */
+  void query_bins(std::array<int, 2> const &lower_bin,
+                  std::array<int, 2> const &upper_bin,
+                  dealii::BoundingBox<dim> const &box,
+                  std::vector<unsigned int> &beam_ids) const;
+
+  /**
+   * Number of directions in the plane of the layer.
+   */
+  static unsigned int constexpr _n_directions = dim - 1;
+  /**
+   * Axes of the plane of the layer.
+   */
+  std::array<unsigned int, 2> const _axes = {{axis<dim>::x, axis<dim>::y}};
+  /**
+   * Bounding boxes of the heat sources which are on.
+   */
+  std::vector<dealii::BoundingBox<dim>> _boxes;
+  /**
+   * Indices of the heat sources which are on.
+   */
+  std::vector<unsigned int> _beam_ids;
+  /**
+   * Positions in _boxes of the heat sources whose support is not bounded in
+   * the plane of the layer. These heat sources are always returned.
+   */
+  std::vector<unsigned int> _unbounded;
+  /**
+   * Lower corner of the grid.
+   */
+  std::array<double, 2> _origin = {{0., 0.}};
+  /**
+   * Size of the bins.
+   */
+  std::array<double, 2> _bin_size = {{1., 1.}};
+  /**
+   * Number of bins in each direction.
+   */
+  std::array<int, 2> _n_bins = {{0, 1}};
+  /**
+   * Positions in _boxes of the heat sources that overlap each bin.
+   */
+  std::vector<std::vector<unsigned int>> _bins;
+};
+
+template <int dim>
+inline bool HeatSourceIndex<dim>::empty() const
+{
+  return _boxes.empty();
+}
+} // namespace adamantine
+
+#endif
@@ -0,0 +1,144 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <MemberLoadBalancer.hh>
+
+#include <deal.II/base/mpi.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace adamantine
+{
+MemberLoadBalancer::MemberLoadBalancer(MPI_Comm const &global_communicator,
+                                       int const color,
+                                       double const imbalance_threshold)
+    : _global_communicator(global_communicator), _color(color),
+      _imbalance_threshold(imbalance_threshold)
+{
+}
+
+void MemberLoadBalancer::add_member_timing(unsigned int const member,
+                                           double const seconds)
+{
+  _member_time[member] += seconds;
+}
+
+std::vector<MemberLoadBalancer::Migration>
+MemberLoadBalancer::compute_migrations(
+    std::vector<unsigned int> const &members)
+{
+  // Gather the color, the index, the position in the color, and the time of
+  // every member.
+  std::vector<double> local_timings;
+  local_timings.reserve(4 * members.size());
+  for (unsigned int i = 0; i < members.size(); ++i)
+  {
+    auto const member_time = _member_time.find(members[i]);
+    local_timings.push_back(_color);
+    local_timings.push_back(members[i]);
+    local_timings.push_back(i);
+    local_timings.push_back(
+        member_time != _member_time.end() ? member_time->second : 0.);
+  }
+  auto const timings =
+      dealii::Utilities::MPI::all_gather(_global_communicator, local_timings);
+  reset();
+
+  // The members of a color are spread over the processors of the color. The
+  // cost of a member is set by the slowest of these processors.
+  struct MemberLoad
+  {
+    double time = 0.;
+    bool movable = false;
+  };
+  std::map<int, std::map<unsigned int, MemberLoad>> colors_members;
+  for (auto const &rank_timings : timings)
+  {
+    for (unsigned int i = 0; i < rank_timings.size(); i += 4)
+    {
+      auto &member_load =
+          colors_members[static_cast<int>(rank_timings[i])]
+                        [static_cast<unsigned int>(rank_timings[i + 1])];
+      member_load.movable = rank_timings[i + 2] > 0.5;
+      member_load.time = std::max(member_load.time, rank_timings[i + 3]);
+    }
+  }
+
+  std::map<int, double> color_loads;
+  double load_sum = 0.;
+  double load_max = 0.;
+  for (auto const &[color, color_members] : colors_members)
+  {
+    double &load = color_loads[color];
+    for (auto const &[member, member_load] : color_members)
+      load += member_load.time;
+    load_sum += load;
+    load_max = std::max(load_max, load);
+  }
+  double const load_avg =
+      color_loads.size() > 0 ? load_sum / color_loads.size() : 0.;
+  _imbalance = load_avg > 0. ? load_max / load_avg : 1.;
+
+  std::vector<Migration> migrations;
+  if (_imbalance <= _imbalance_threshold)
+    return migrations;
+
+  // Move members from the most loaded color to the least loaded one as long as
+  // it reduces the load of the most loaded color. Every member is moved at
+  // most once. Since all the processors use the same timings, they compute the
+  // same migrations.
+  while (true)
+  {
+    auto const [lightest, heaviest] = std::minmax_element(
+        color_loads.begin(), color_loads.end(),
+        [](auto const &a, auto const &b) { return a.second < b.second; });
+    if (lightest->first == heaviest->first)
+      break;
+
+    auto &heavy_members = colors_members[heaviest->first];
+    auto best_member = heavy_members.end();
+    double best_load = heaviest->second;
+    for (auto member_load = heavy_members.begin();
+         member_load != heavy_members.end(); ++member_load)
+    {
+      if (!member_load->second.movable)
+        continue;
+      double const time = member_load->second.time;
+      double const new_load =
+          std::max(heaviest->second - time, lightest->second + time);
+      if (new_load < best_load)
+      {
+        best_load = new_load;
+        best_member = member_load;
+      }
+    }
+    if (best_member == heavy_members.end())
+      break;
+
+    migrations.push_back(
+        {best_member->first, heaviest->first, lightest->first});
+    double const time = best_member->second.time;
+    heaviest->second -= time;
+    lightest->second += time;
+    colors_members[lightest->first][best_member->first] = {time, false};
+    heavy_members.erase(best_member);
+  }
+
+  return migrations;
+}
+
+double MemberLoadBalancer::get_imbalance() const
+{
+  return _imbalance;
+}
+
+void MemberLoadBalancer::reset()
+{
+  _member_time.clear();
+}
+} // namespace adamantine
@@ -0,0 +1,100 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef MEMBER_LOAD_BALANCER_HH
+#define MEMBER_LOAD_BALANCER_HH
+
+#include <mpi.h>
+
+#include <map>
+#include <vector>
+
+namespace adamantine
+{
+/**
+ * This class balances the ensemble members between the colors of the global
+ * communicator. The time spent on each member is measured at runtime. The
+ * members diverge during the simulation, e.g. because their heat sources are
+ * perturbed, and so does their cost. When the ratio between the load of the
+ * most loaded color and the average load exceeds a threshold, members are
+ * moved from the most loaded colors to the least loaded ones. The first member
+ * of each color is never moved.
+ */
+class MemberLoadBalancer
+{
+public:
+  /**
+   * Move of an ensemble member from the color @p source_color to the color
+   * @p destination_color.
+   */
+  struct Migration
+  {
+    unsigned int member;
+    int source_color;
+    int destination_color;
+  };
+
+  /**
+   * Constructor. @p color is the color of the processor in the global
+   * communicator.
+   */
+  MemberLoadBalancer(MPI_Comm const &global_communicator, int const color,
+                     double const imbalance_threshold);
+
+  /**
+   * Add the time spent on the ensemble member @p member. The members are
+   * identified by their global index.
+   */
+  void add_member_timing(unsigned int const member, double const seconds);
+
+  /**
+   * Compute the migrations that balance the load of the colors using the
+   * timings of all the processors since the last call. @p members are the
+   * global indices of the members of the color in the order in which they are
+   * stored. No member is moved if the imbalance does not exceed the threshold.
+   * Every processor returns the same migrations and the timings are discarded.
+   * This is a collective operation.
+   */
+  std::vector<Migration>
+  compute_migrations(std::vector<unsigned int> const &members);
+
+  /**
+   * Return the ratio between the largest and the average load of the colors
+   * measured by the last call to compute_migrations().
+   */
+  double get_imbalance() const;
+
+  /**
+   * Discard the timings.
+   */
+  void reset();
+
+private:
+  /**
+   * Global MPI communicator.
+   */
+  MPI_Comm _global_communicator;
+  /**
+   * Color of the processor.
+   */
+  int _color;
+  /**
+   * Imbalance above which the members are moved.
+   */
+  double _imbalance_threshold;
+  /**
+   * Imbalance measured by the last call to compute_migrations().
+   */
+  double _imbalance = 1.;
+  /**
+   * Time spent on each member of the color.
+   */
+  std::map<unsigned int, double> _member_time;
+};
+} // namespace adamantine
+
+#endif
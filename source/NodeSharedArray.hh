@@ -0,0 +1,217 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef NODE_SHARED_ARRAY_HH
+#define NODE_SHARED_ARRAY_HH
+
+#include <utils.hh>
+
+#include <mpi.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace adamantine
+{
+/**
+ * This class stores a read-only array once per compute node instead of once per
+ * processor. The array is allocated in an MPI-3 shared memory window: the first
+ * processor of the node copies the values in the window and every processor on
+ * the node gets a read-only view of the same memory. The type @tparam T needs
+ * to be trivially copyable.
+ *
+ * The construction and the destruction of the object are collective operations
+ * on the communicator used by the constructor. Copies of the object share the
+ * same window.
+ */
+template <typename T>
+class NodeSharedArray
+{
+public:
+  /**
+   * Default constructor. This creates an empty array.
+   */
+  NodeSharedArray() = default;
+
+  /**
+   * Constructor. Only the @p values of the first processor of each node are
+   * used, the other processors may pass an empty vector.
+   */
+  NodeSharedArray(MPI_Comm const &communicator, std::vector<T> const &values);
+
+  /**
+   * Return the number of elements in the array.
+   */
+  std::size_t size() const;
+
+  /**
+   * Return true if the array is empty.
+   */
+  bool empty() const;
+
+  /**
+   * Return a pointer to the first element of the array.
+   */
+  T const *data() const;
+
+  /**
+   * Return the ith element of the array.
+   */
+  T const &operator[](std::size_t i) const;
+
+  /**
+   * Return the last element of the array.
+   */
+  T const &back() const;
+
+  /**
+   * Return a pointer to the first element of the array.
+   */
+  T const *begin() const;
+
+  /**
+   * Return a pointer past the last element of the array.
+   */
+  T const *end() const;
+
+  /**
+   * Return the number of bytes that the current processor does not need to
+   * allocate because the array is shared with the first processor of the node.
+   */
+  std::size_t memory_saved() const;
+
+private:
+  /**
+   * Structure owning the shared memory window and the node communicator.
+   */
+  struct Window
+  {
+    ~Window()
+    {
+      MPI_Win_free(&win);
+      MPI_Comm_free(&node_communicator);
+    }
+
+    MPI_Win win = MPI_WIN_NULL;
+    MPI_Comm node_communicator = MPI_COMM_NULL;
+  };
+
+  /**
+   * Shared memory window. The window is freed when the last copy of the array
+   * is destroyed.
+   */
+  std::shared_ptr<Window> _window;
+  /**
+   * Pointer to the beginning of the shared memory.
+   */
+  T const *_data = nullptr;
+  /**
+   * Number of elements in the array.
+   */
+  std::size_t _size = 0;
+  /**
+   * Flag is true if the current processor owns the memory of the window.
+   */
+  bool _node_root = true;
+};
+
+template <typename T>
+NodeSharedArray<T>::NodeSharedArray(MPI_Comm const &communicator,
+                                    std::vector<T> const &values)
+    : _window(std::make_shared<Window>())
+{
+  MPI_Comm_split_type(communicator, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                      &_window->node_communicator);
+  int node_rank = 0;
+  MPI_Comm_rank(_window->node_communicator, &node_rank);
+  _node_root = (node_rank == 0);
+
+  // The size of the array is given by the first processor of the node.
+  unsigned long long size = values.size();
+  MPI_Bcast(&size, 1, MPI_UNSIGNED_LONG_LONG, 0, _window->node_communicator);
+  _size = size;
+
+  // Only the first processor of the node allocates memory.
+  MPI_Aint const local_size = _node_root ? _size * sizeof(T) : 0;
+  T *base_ptr = nullptr;
+  int ierr = MPI_Win_allocate_shared(local_size, sizeof(T), MPI_INFO_NULL,
+                                     _window->node_communicator, &base_ptr,
+                                     &_window->win);
+  ASSERT_THROW(ierr == MPI_SUCCESS,
+               "Error: Cannot allocate the shared memory window.");
+  if (!_node_root)
+  {
+    MPI_Aint root_size = 0;
+    int disp_unit = 0;
+    MPI_Win_shared_query(_window->win, 0, &root_size, &disp_unit, &base_ptr);
+  }
+
+  MPI_Win_fence(0, _window->win);
+  if (_node_root && (_size > 0))
+  {
+    std::memcpy(static_cast<void *>(base_ptr), values.data(),
+                _size * sizeof(T));
+  }
+  // Make sure that the data is written before anybody reads it.
+  MPI_Win_fence(0, _window->win);
+
+  _data = base_ptr;
+}
+
+template <typename T>
+inline std::size_t NodeSharedArray<T>::size() const
+{
+  return _size;
+}
+
+template <typename T>
+inline bool NodeSharedArray<T>::empty() const
+{
+  return _size == 0;
+}
+
+template <typename T>
+inline T const *NodeSharedArray<T>::data() const
+{
+  return _data;
+}
+
+template <typename T>
+inline T const &NodeSharedArray<T>::operator[](std::size_t i) const
+{
+  ASSERT(i < _size, "Out-of-bound access.");
+  return _data[i];
+}
+
+template <typename T>
+inline T const &NodeSharedArray<T>::back() const
+{
+  ASSERT(_size > 0, "The array is empty.");
+  return _data[_size - 1];
+}
+
+template <typename T>
+inline T const *NodeSharedArray<T>::begin() const
+{
+  return _data;
+}
+
+template <typename T>
+inline T const *NodeSharedArray<T>::end() const
+{
+  return _data + _size;
+}
+
+template <typename T>
+inline std::size_t NodeSharedArray<T>::memory_saved() const
+{
+  return _node_root ? 0 : _size * sizeof(T);
+}
+} // namespace adamantine
+
+#endif
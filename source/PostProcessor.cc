@@ -86,6 +86,20 @@ void PostProcessor<dim>::write_pvd() const
   dealii::DataOutBase::write_pvd_record(output, _times_filenames);
 }
 
+template <int dim>
+std::vector<std::pair<double, std::string>> const &
+PostProcessor<dim>::get_times_filenames() const
+{
+  return _times_filenames;
+}
+
+template <int dim>
+void PostProcessor<dim>::set_times_filenames(
+    std::vector<std::pair<double, std::string>> const &times_filenames)
+{
+  _times_filenames = times_filenames;
+}
+
 template <int dim>
 dealii::Vector<double> PostProcessor<dim>::get_stress_norm(
     std::vector<std::vector<dealii::SymmetricTensor<2, dim>>> const
@@ -111,6 +111,19 @@ public:
    */
   void write_pvd() const;
 
+  /**
+   * Return the times and the names of the pvtu files written so far.
+   */
+  std::vector<std::pair<double, std::string>> const &
+  get_times_filenames() const;
+
+  /**
+   * Set the times and the names of the pvtu files written so far. This is used
+   * when the output of an ensemble member is taken over by another processor.
+   */
+  void set_times_filenames(
+      std::vector<std::pair<double, std::string>> const &times_filenames);
+
 private:
   /**
    * Compute the norm of the stress.
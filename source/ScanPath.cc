@@ -39,6 +39,29 @@ void ScanPath::read_file()
   {
     load_event_series_scan_path();
   }
+
+  if (_share_on_node)
+    move_segments_to_node_shared_memory();
+}
+
+void ScanPath::share_on_node(MPI_Comm const &communicator)
+{
+  _communicator = communicator;
+  _share_on_node = true;
+  move_segments_to_node_shared_memory();
+}
+
+std::size_t ScanPath::memory_saved() const
+{
+  return _node_shared_segment_list.memory_saved();
+}
+
+void ScanPath::move_segments_to_node_shared_memory()
+{
+  _node_shared_segment_list =
+      NodeSharedArray<ScanPathSegment>(_communicator, _segment_list);
+  // Release the memory of the local copy.
+  std::vector<ScanPathSegment>().swap(_segment_list);
 }
 
 void ScanPath::load_segment_scan_path()
@@ -173,20 +196,20 @@ void ScanPath::update_current_segment_info(
 {
   // Get to the correct segment
   _current_segment = 0;
-  while (time > _segment_list[_current_segment].end_time)
+  while (time > get_segment(_current_segment).end_time)
   {
     ++_current_segment;
   }
   // Update the start position and time for the current segment
   if (_current_segment > 0)
   {
-    segment_start_time = _segment_list[_current_segment - 1].end_time;
-    segment_start_point = _segment_list[_current_segment - 1].end_point;
+    segment_start_time = get_segment(_current_segment - 1).end_time;
+    segment_start_point = get_segment(_current_segment - 1).end_point;
   }
   else
   {
     segment_start_time = 0.0;
-    segment_start_point = _segment_list[_current_segment].end_point;
+    segment_start_point = get_segment(_current_segment).end_point;
   }
 }
 
@@ -194,7 +217,7 @@ dealii::Point<3> ScanPath::value(double const &time) const
 {
   // If the current time is after the scan path data is over, return a point
   // that is (presumably) out of the domain.
-  if (time > _segment_list.back().end_time)
+  if (time > get_segment(n_segments() - 1).end_time)
   {
     dealii::Point<3> out_of_domain_point(std::numeric_limits<double>::lowest(),
                                          std::numeric_limits<double>::lowest(),
@@ -208,10 +231,11 @@ dealii::Point<3> ScanPath::value(double const &time) const
   update_current_segment_info(time, segment_start_point, segment_start_time);
 
   // Calculate the position in the direction given by "component"
+  ScanPathSegment const &current_segment = get_segment(_current_segment);
   dealii::Point<3> position =
       segment_start_point +
-      (_segment_list[_current_segment].end_point - segment_start_point) /
-          (_segment_list[_current_segment].end_time - segment_start_time) *
+      (current_segment.end_point - segment_start_point) /
+          (current_segment.end_time - segment_start_time) *
           (time - segment_start_time);
 
   return position;
@@ -221,7 +245,7 @@ double ScanPath::get_power_modifier(double const &time) const
 {
   // If the current time is after the scan path data is over, set the power to
   // zero.
-  if (time > _segment_list.back().end_time)
+  if (time > get_segment(n_segments() - 1).end_time)
     return 0.0;
 
   // Get to the correct segment
@@ -229,11 +253,66 @@ double ScanPath::get_power_modifier(double const &time) const
   double segment_start_time = 0.0;
   update_current_segment_info(time, segment_start_point, segment_start_time);
 
-  return _segment_list[_current_segment].power_modifier;
+  return get_segment(_current_segment).power_modifier;
+}
+
+std::vector<double>
+ScanPath::get_segment_end_times(double const start_time,
+                                double const end_time) const
+{
+  std::vector<double> end_times;
+  unsigned int const n = n_segments();
+  for (unsigned int i = 0; i < n; ++i)
+  {
+    double const segment_end_time = get_segment(i).end_time;
+    if (segment_end_time >= end_time)
+      break;
+    if (segment_end_time > start_time)
+      end_times.push_back(segment_end_time);
+  }
+
+  return end_times;
+}
+
+double ScanPath::get_travel_end_time(double const start_time,
+                                     double const distance) const
+{
+  unsigned int const n = n_segments();
+  double const path_end_time = get_segment(n - 1).end_time;
+  if (start_time >= path_end_time)
+    return path_end_time;
+  if (distance <= 0.)
+    return start_time;
+
+  double remaining_distance = distance;
+  double time = start_time;
+  dealii::Point<3> position = value(start_time);
+  for (unsigned int i = 0; i < n; ++i)
+  {
+    ScanPathSegment const &segment = get_segment(i);
+    if (segment.end_time <= time)
+      continue;
+
+    // The heat source moves at a constant velocity along a segment
+    double const segment_length = position.distance(segment.end_point);
+    if (segment_length >= remaining_distance)
+      return time + (segment.end_time - time) * remaining_distance /
+                        segment_length;
+
+    remaining_distance -= segment_length;
+    time = segment.end_time;
+    position = segment.end_point;
+  }
+
+  return path_end_time;
 }
 
 std::vector<ScanPathSegment> ScanPath::get_segment_list() const
 {
+  if (_share_on_node)
+    return std::vector<ScanPathSegment>(_node_shared_segment_list.begin(),
+                                        _node_shared_segment_list.end());
+
   return _segment_list;
 }
 
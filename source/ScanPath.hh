@@ -8,6 +8,8 @@
 #ifndef SCAN_PATH_HH
 #define SCAN_PATH_HH
 
+#include <NodeSharedArray.hh>
+
 #include <deal.II/base/function.h>
 #include <deal.II/base/point.h>
 
@@ -84,11 +86,36 @@ public:
    */
   double get_power_modifier(double const &time) const;
 
+  /**
+   * Return the end times of the segments that end strictly between
+   * @p start_time and @p end_time.
+   */
+  std::vector<double> get_segment_end_times(double const start_time,
+                                            double const end_time) const;
+
+  /**
+   * Return the time at which the heat source has traveled @p distance along
+   * the scan path starting from its position at @p start_time. If the scan
+   * path ends before, return the end time of the scan path.
+   */
+  double get_travel_end_time(double const start_time,
+                             double const distance) const;
+
   /**
    * Return the scan path's list of segments
    */
   std::vector<ScanPathSegment> get_segment_list() const;
 
+  /**
+   * Return the number of segments in the scan path.
+   */
+  unsigned int n_segments() const;
+
+  /**
+   * Return the ith segment of the scan path.
+   */
+  ScanPathSegment const &get_segment(unsigned int i) const;
+
   /**
    * Read the scan path file and update the list of segments.
    */
@@ -99,6 +126,19 @@ public:
    */
   bool is_finished() const;
 
+  /**
+   * Store the list of segments once per compute node instead of once per
+   * processor. The list is moved to a shared memory window each time the scan
+   * path file is read. This is a collective operation on @p communicator.
+   */
+  void share_on_node(MPI_Comm const &communicator);
+
+  /**
+   * Return the number of bytes that the current processor does not need to
+   * allocate because the list of segments is shared on the node.
+   */
+  std::size_t memory_saved() const;
+
 private:
   /**
    * Method to load a "segment" scan path file
@@ -110,6 +150,11 @@ private:
    */
   void load_event_series_scan_path();
 
+  /**
+   * Move the list of segments to the shared memory window.
+   */
+  void move_segments_to_node_shared_memory();
+
   /**
    * Method to determine the current segment, its start point, and start time.
    */
@@ -141,7 +186,32 @@ private:
    * The index of the current segment in the scan path.
    */
   mutable unsigned int _current_segment = 0;
+  /**
+   * Flag is true if the list of segments is shared by all the processors on
+   * the same node.
+   */
+  bool _share_on_node = false;
+  /**
+   * MPI communicator used to share the list of segments.
+   */
+  MPI_Comm _communicator = MPI_COMM_NULL;
+  /**
+   * The list of segments stored in node-shared memory. When this list is used,
+   * _segment_list is empty.
+   */
+  NodeSharedArray<ScanPathSegment> _node_shared_segment_list;
 };
+
+inline unsigned int ScanPath::n_segments() const
+{
+  return _share_on_node ? _node_shared_segment_list.size()
+                        : _segment_list.size();
+}
+
+inline ScanPathSegment const &ScanPath::get_segment(unsigned int i) const
+{
+  return _share_on_node ? _node_shared_segment_list[i] : _segment_list[i];
+}
 } // namespace adamantine
 
 #endif
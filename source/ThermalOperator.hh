@@ -9,12 +9,15 @@
 #define THERMAL_OPERATOR_HH
 
 #include <HeatSource.hh>
+#include <HeatSourceIndex.hh>
 #include <MaterialProperty.hh>
 #include <MaterialStates.hh>
 #include <ThermalOperatorBase.hh>
 
 #include <deal.II/base/aligned_vector.h>
 #include <deal.II/base/vectorization.h>
+#include <deal.II/lac/la_parallel_block_vector.h>
+#include <deal.II/matrix_free/fe_evaluation.h>
 #include <deal.II/matrix_free/matrix_free.h>
 
 namespace adamantine
@@ -90,6 +93,36 @@ public:
                  dealii::LA::distributed::Vector<double, MemorySpaceType> const
                      &src) const override;
 
+  /**
+   * Batched application of the operator on several members sharing the mesh:
+   * dst.block(b) = A_b src.block(b) where A_b uses the material state and the
+   * heat sources of member b. The mapping data, the DoF indices, the material
+   * ids, the deposition angles, and the heat sources overlapping a cell batch
+   * are loaded once per cell batch for all the members.
+   */
+  void vmult(dealii::LA::distributed::BlockVector<double> &dst,
+             dealii::LA::distributed::BlockVector<double> const &src) const;
+
+  /**
+   * Batched version of vmult_add. See vmult.
+   */
+  void vmult_add(dealii::LA::distributed::BlockVector<double> &dst,
+                 dealii::LA::distributed::BlockVector<double> const &src) const;
+
+  void store_block_state(unsigned int const block) override;
+
+  void load_block_state(unsigned int const block) override;
+
+  /**
+   * Set the heat sources of each member of the batched application. All the
+   * members need to have the same number of heat sources. If no heat source
+   * is set, all the members use the heat sources of the operator. The heat
+   * sources are updated by set_time_and_source_height().
+   */
+  void set_block_heat_sources(
+      std::vector<std::vector<std::shared_ptr<HeatSource<dim>>>> const
+          &block_heat_sources);
+
   void initialize_dof_vector(
       dealii::LA::distributed::Vector<double, MemorySpaceType> &vector)
       const override;
@@ -106,18 +139,59 @@ public:
       std::vector<double> const &deposition_cos,
       std::vector<double> const &deposition_sin) override;
 
+  void update_material_deposition_orientation(
+      std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator> const
+          &cells,
+      std::vector<double> const &deposition_cos,
+      std::vector<double> const &deposition_sin) override;
+
+  void set_heat_sources(std::vector<std::shared_ptr<HeatSource<dim>>> const
+                            &heat_sources) override;
+
   void set_time_and_source_height(double t, double height) override;
 
+  void set_cell_cost_model(
+      std::shared_ptr<CellCostModel> cell_cost_model) override;
+
+  void set_quiet_cells(std::shared_ptr<std::vector<bool> const> quiet_cells,
+                       double const conductivity_scaling) override;
+
+  void compute_gradient_jump_indicators(
+      dealii::LA::distributed::Vector<double, MemorySpaceType> const
+          &temperature,
+      dealii::Vector<float> &indicators) const override;
+
 private:
   /**
-   * Update the ratios of the material state.
+   * Tables of the ratios of the material states that change when the operator
+   * is applied.
+   */
+  struct StateTables
+  {
+    /**
+     * Table of the liquid fraction inside cells.
+     */
+    dealii::Table<2, dealii::VectorizedArray<double>> liquid_ratio;
+    /**
+     * Table of the powder fraction inside cells.
+     */
+    dealii::Table<2, dealii::VectorizedArray<double>> powder_ratio;
+    /**
+     * Table of the powder fraction on faces.
+     */
+    dealii::Table<2, dealii::VectorizedArray<double>> face_powder_ratio;
+  };
+
+  /**
+   * Update the ratios of the material state and store them in @p state.
    * @Note The input variables are not used when the only valid state is solid.
    */
   void update_state_ratios(
       [[maybe_unused]] unsigned int cell, [[maybe_unused]] unsigned int q,
       [[maybe_unused]] dealii::VectorizedArray<double> temperature,
       std::array<dealii::VectorizedArray<double>,
-                 MaterialStates::n_material_states> &state_ratios) const;
+                 MaterialStates::n_material_states> &state_ratios,
+      [[maybe_unused]] StateTables &state) const;
 
   /**
    * Update the ratios of the material state at the face quadrature points.
@@ -127,7 +201,8 @@ private:
       [[maybe_unused]] unsigned int face, [[maybe_unused]] unsigned int q,
       [[maybe_unused]] dealii::VectorizedArray<double> temperature,
       std::array<dealii::VectorizedArray<double>,
-                 MaterialStates::n_material_states> &state_ratios) const;
+                 MaterialStates::n_material_states> &state_ratios,
+      [[maybe_unused]] StateTables &state) const;
   /**
    * Return the value of \f$ \frac{1}{\rho C_p} \f$ for a given matrix-free
    * cell/face and quadrature point.
@@ -141,6 +216,49 @@ private:
       dealii::AlignedVector<dealii::VectorizedArray<double>> const
           &temperature_powers) const;
 
+  /**
+   * Return one for the cells of the batch that are active and zero for the
+   * cells that are quiet.
+   */
+  dealii::VectorizedArray<double> get_cell_activity(unsigned int cell) const;
+
+  /**
+   * Return one for the cells on the interior (or exterior) side of the face
+   * batch that are active and zero for the cells that are quiet or that do not
+   * exist.
+   */
+  dealii::VectorizedArray<double> get_face_activity(unsigned int face,
+                                                    bool interior) const;
+
+  /**
+   * Fill @p beam_ids with the indices in @p heat_source_index of the heat
+   * sources that can contribute to the source term of the cell batch on which
+   * @p fe_eval has been reinitialized.
+   */
+  void query_heat_sources(
+      dealii::FEEvaluation<dim, fe_degree, fe_degree + 1, 1, double> const
+          &fe_eval,
+      unsigned int const n_lanes, HeatSourceIndex<dim> const &heat_source_index,
+      std::vector<unsigned int> &beam_ids) const;
+
+  /**
+   * Apply the operator on the cell batch on which @p fe_eval has been
+   * reinitialized using the material state @p state and the heat sources of
+   * @p heat_sources whose indices are in @p beam_ids. @p temperature_powers is
+   * a scratch array. Return true if a cell of the batch undergoes a phase
+   * change.
+   */
+  bool apply_cell_batch(
+      dealii::FEEvaluation<dim, fe_degree, fe_degree + 1, 1, double> &fe_eval,
+      unsigned int const cell, dealii::VectorizedArray<double> const &activity,
+      std::vector<std::shared_ptr<HeatSource<dim>>> const &heat_sources,
+      std::vector<unsigned int> const &beam_ids, StateTables &state,
+      dealii::AlignedVector<dealii::VectorizedArray<double>>
+          &temperature_powers,
+      dealii::LA::distributed::Vector<double, MemorySpaceType> &dst,
+      dealii::LA::distributed::Vector<double, MemorySpaceType> const &src)
+      const;
+
   /**
    * Apply the operator on a given set of quadrature points inside each cell.
    */
@@ -150,6 +268,26 @@ private:
       dealii::LA::distributed::Vector<double, MemorySpaceType> const &src,
       std::pair<unsigned int, unsigned int> const &cell_range) const;
 
+  /**
+   * Batched version of cell_local_apply.
+   */
+  void cell_local_apply_block(
+      dealii::MatrixFree<dim, double> const &data,
+      dealii::LA::distributed::BlockVector<double> &dst,
+      dealii::LA::distributed::BlockVector<double> const &src,
+      std::pair<unsigned int, unsigned int> const &cell_range) const;
+
+  /**
+   * Apply the operator on a given set of quadrature points on each face using
+   * the material state @p state.
+   */
+  void apply_faces(
+      dealii::MatrixFree<dim, double> const &data,
+      dealii::LA::distributed::Vector<double, MemorySpaceType> &dst,
+      dealii::LA::distributed::Vector<double, MemorySpaceType> const &src,
+      std::pair<unsigned int, unsigned int> const &face_range,
+      StateTables &state) const;
+
   /**
    * Apply the operator on a given set of quadrature points on each face.
    */
@@ -159,6 +297,23 @@ private:
       dealii::LA::distributed::Vector<double, MemorySpaceType> const &src,
       std::pair<unsigned int, unsigned int> const &face_range) const;
 
+  /**
+   * Batched version of face_local_apply.
+   */
+  void face_local_apply_block(
+      dealii::MatrixFree<dim, double> const &data,
+      dealii::LA::distributed::BlockVector<double> &dst,
+      dealii::LA::distributed::BlockVector<double> const &src,
+      std::pair<unsigned int, unsigned int> const &face_range) const;
+
+  /**
+   * Force the value on the constrained dofs.
+   */
+  void apply_constrained_dofs(
+      dealii::LA::distributed::Vector<double, MemorySpaceType> &dst,
+      dealii::LA::distributed::Vector<double, MemorySpaceType> const &src)
+      const;
+
   /**
    * Apply the mass operator on a given set of quadrature points.
    */
@@ -168,6 +323,22 @@ private:
       dealii::LA::distributed::Vector<double, MemorySpaceType> const &src,
       std::pair<unsigned int, unsigned int> const &cell_range) const;
 
+  /**
+   * Copy the powder ratio and the material id of @p cell_tria at every
+   * quadrature point of the given lane of a face batch.
+   */
+  void set_face_state(
+      unsigned int const face, unsigned int const lane,
+      typename dealii::Triangulation<dim>::active_cell_iterator const
+          &cell_tria,
+      unsigned int const n_q_points);
+
+  /**
+   * Index of the Gauss-Lobatto quadrature used to compute the lumped mass
+   * matrix in the MatrixFree object of the operator.
+   */
+  static unsigned int constexpr _mass_quad_index = 1;
+
   /**
    * MPI communicator.
    */
@@ -197,6 +368,42 @@ private:
    * Vector of heat sources.
    */
   std::vector<std::shared_ptr<HeatSource<dim>>> _heat_sources;
+  /**
+   * Spatial index of the heat sources at the current time.
+   */
+  HeatSourceIndex<dim> _heat_source_index;
+  /**
+   * Heat sources of each member of the batched application.
+   */
+  std::vector<std::vector<std::shared_ptr<HeatSource<dim>>>>
+      _block_heat_sources;
+  /**
+   * Spatial index of the heat sources of all the members at the current time.
+   * The heat source j of member b has the index b * n_beams + j.
+   */
+  HeatSourceIndex<dim> _block_heat_source_index;
+  /**
+   * Model calibrated with the timings of the cell and face batches.
+   */
+  std::shared_ptr<CellCostModel> _cell_cost_model;
+  /**
+   * Flags of the quiet cells indexed by the active cell index. The pointer is
+   * null if there is no quiet cell.
+   */
+  std::shared_ptr<std::vector<bool> const> _quiet_cells;
+  /**
+   * Scaling of the thermal conductivity of the quiet cells.
+   */
+  double _quiet_conductivity_scaling = 1.;
+  /**
+   * Table of the active cell index of each cell of the cell batches.
+   */
+  dealii::Table<2, unsigned int> _cell_active_index;
+  /**
+   * Table of the active cell index of the interior and the exterior cells of
+   * each face batch.
+   */
+  dealii::Table<3, unsigned int> _face_active_index;
   /**
    * Underlying MatrixFree object.
    */
@@ -219,20 +426,16 @@ private:
            std::pair<unsigned int, unsigned int>>
       _cell_it_to_mf_cell_map;
   /**
-   * Table of the powder fraction inside cells; mutable so that it can be
-   * changed in cell_local_apply which is const.
+   * Ratios of the material states; mutable so that they can be changed in
+   * cell_local_apply and face_local_apply which are const.
    */
-  mutable dealii::Table<2, dealii::VectorizedArray<double>> _liquid_ratio;
+  mutable StateTables _state;
   /**
-   * Table of the powder fraction inside cells; mutable so that it can be
-   * changed in cell_local_apply which is const.
-   */
-  mutable dealii::Table<2, dealii::VectorizedArray<double>> _powder_ratio;
-  /**
-   * Table of the powder fraction on faces; mutable so that it can be changed in
-   * face_local_apply which is const.
+   * Ratios of the material states of each member of the batched application;
+   * mutable so that they can be changed in cell_local_apply_block and
+   * face_local_apply_block which are const.
    */
-  mutable dealii::Table<2, dealii::VectorizedArray<double>> _face_powder_ratio;
+  mutable std::vector<StateTables> _block_states;
   /**
    * Table of the material index inside cells; mutable so that it can be changed
    * in cell_local_apply which is const.
@@ -325,6 +528,76 @@ ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
   _current_source_height = height;
   for (auto &beam : _heat_sources)
     beam->update_time(t);
+  _heat_source_index.reinit(_heat_sources, height);
+
+  if (!_block_heat_sources.empty())
+  {
+    std::vector<std::shared_ptr<HeatSource<dim>>> all_heat_sources;
+    for (auto &heat_sources : _block_heat_sources)
+      for (auto &beam : heat_sources)
+      {
+        beam->update_time(t);
+        all_heat_sources.push_back(beam);
+      }
+    _block_heat_source_index.reinit(all_heat_sources, height);
+  }
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+inline void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                            MemorySpaceType>::
+    set_cell_cost_model(std::shared_ptr<CellCostModel> cell_cost_model)
+{
+  _cell_cost_model = cell_cost_model;
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+inline void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                            MemorySpaceType>::
+    set_quiet_cells(std::shared_ptr<std::vector<bool> const> quiet_cells,
+                    double const conductivity_scaling)
+{
+  _quiet_cells = quiet_cells;
+  _quiet_conductivity_scaling = conductivity_scaling;
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+inline dealii::VectorizedArray<double>
+ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                MemorySpaceType>::get_cell_activity(unsigned int cell) const
+{
+  dealii::VectorizedArray<double> activity = 1.;
+  for (unsigned int i = 0;
+       i < _matrix_free.n_active_entries_per_cell_batch(cell); ++i)
+  {
+    if ((*_quiet_cells)[_cell_active_index(cell, i)])
+      activity[i] = 0.;
+  }
+
+  return activity;
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+inline dealii::VectorizedArray<double>
+ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                MemorySpaceType>::get_face_activity(unsigned int face,
+                                                    bool interior) const
+{
+  dealii::VectorizedArray<double> activity = 0.;
+  for (unsigned int i = 0;
+       i < _matrix_free.n_active_entries_per_face_batch(face); ++i)
+  {
+    unsigned int const index = _face_active_index(face, interior ? 0 : 1, i);
+    if ((index != dealii::numbers::invalid_unsigned_int) &&
+        !(*_quiet_cells)[index])
+      activity[i] = 1.;
+  }
+
+  return activity;
 }
 } // namespace adamantine
 
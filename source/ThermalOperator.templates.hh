@@ -13,6 +13,7 @@
 
 #include <deal.II/base/aligned_vector.h>
 #include <deal.II/base/index_set.h>
+#include <deal.II/base/mpi.h>
 #include <deal.II/base/types.h>
 #include <deal.II/base/vectorization.h>
 #include <deal.II/dofs/dof_tools.h>
@@ -21,7 +22,14 @@
 #include <deal.II/hp/fe_values.h>
 #include <deal.II/matrix_free/fe_evaluation.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <limits>
 #include <type_traits>
+#include <vector>
 
 namespace adamantine
 {
@@ -46,7 +54,8 @@ ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
       dealii::update_values | dealii::update_gradients |
       dealii::update_JxW_values | dealii::update_quadrature_points;
   _matrix_free_data.mapping_update_flags_inner_faces =
-      dealii::update_values | dealii::update_JxW_values;
+      dealii::update_values | dealii::update_gradients |
+      dealii::update_JxW_values | dealii::update_normal_vectors;
   _matrix_free_data.mapping_update_flags_boundary_faces =
       dealii::update_values | dealii::update_JxW_values;
 }
@@ -59,9 +68,25 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
            dealii::AffineConstraints<double> const &affine_constraints,
            dealii::hp::QCollection<1> const &q_collection)
 {
-  _matrix_free.reinit(dealii::StaticMappingQ1<dim>::mapping, dof_handler,
-                      affine_constraints, q_collection, _matrix_free_data);
+  // The quadrature used by the lumped mass matrix is added to the MatrixFree
+  // object of the operator so that compute_inverse_mass_matrix() does not need
+  // to set up a second MatrixFree object every time the mesh changes.
+  dealii::hp::QCollection<1> mass_q_collection;
+  mass_q_collection.push_back(dealii::QGaussLobatto<1>(fe_degree + 1));
+  mass_q_collection.push_back(dealii::QGaussLobatto<1>(2));
+  std::vector<dealii::hp::QCollection<1>> q_collections(2);
+  q_collections[0] = q_collection;
+  q_collections[_mass_quad_index] = mass_q_collection;
+  _matrix_free.reinit(
+      dealii::StaticMappingQ1<dim>::mapping,
+      std::vector<dealii::DoFHandler<dim> const *>{&dof_handler},
+      std::vector<dealii::AffineConstraints<double> const *>{
+          &affine_constraints},
+      q_collections, _matrix_free_data);
   _affine_constraints = &affine_constraints;
+  // The states of the members of the batched application do not match the new
+  // mesh anymore.
+  _block_states.clear();
 
   // Compute mapping between DoFHandler cells and the MatrixFree cells
   _cell_it_to_mf_cell_map.clear();
@@ -74,6 +99,39 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
           _matrix_free.get_cell_iterator(cell, i);
       _cell_it_to_mf_cell_map[cell_it] = std::make_pair(cell, i);
     }
+
+  // Compute the active cell index of the cells and of the faces used to find
+  // the quiet cells.
+  if (_quiet_cells)
+  {
+    unsigned int constexpr n_lanes = dealii::VectorizedArray<double>::size();
+    _cell_active_index.reinit(n_cells, n_lanes);
+    for (unsigned int cell = 0; cell < n_cells; ++cell)
+      for (unsigned int i = 0;
+           i < _matrix_free.n_active_entries_per_cell_batch(cell); ++i)
+      {
+        _cell_active_index(cell, i) =
+            _matrix_free.get_cell_iterator(cell, i)->active_cell_index();
+      }
+
+    unsigned int const n_inner_faces = _matrix_free.n_inner_face_batches();
+    unsigned int const n_faces =
+        n_inner_faces + _matrix_free.n_boundary_face_batches();
+    _face_active_index.reinit(n_faces, 2, n_lanes);
+    _face_active_index.fill(dealii::numbers::invalid_unsigned_int);
+    for (unsigned int face = 0; face < n_faces; ++face)
+      for (unsigned int i = 0;
+           i < _matrix_free.n_active_entries_per_face_batch(face); ++i)
+      {
+        _face_active_index(face, 0, i) =
+            _matrix_free.get_face_iterator(face, i, true)
+                .first->active_cell_index();
+        if (face < n_inner_faces)
+          _face_active_index(face, 1, i) =
+              _matrix_free.get_face_iterator(face, i, false)
+                  .first->active_cell_index();
+      }
+  }
 }
 
 template <int dim, bool use_table, int p_order, int fe_degree,
@@ -89,7 +147,8 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
   // Get the subrange of cells associated with the fe index 0
   std::pair<unsigned int, unsigned int> cell_subrange =
       data.create_cell_subrange_hp_by_index(cell_range, 0);
-  dealii::FEEvaluation<dim, fe_degree, fe_degree + 1, 1, double> fe_eval(data);
+  dealii::FEEvaluation<dim, fe_degree, fe_degree + 1, 1, double> fe_eval(
+      data, 0, _mass_quad_index);
 
   // Loop over the "cells". Note that we don't really work on a cell but on a
   // set of quadrature point.
@@ -118,36 +177,26 @@ template <int dim, bool use_table, int p_order, int fe_degree,
 void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
                      MemorySpaceType>::
     compute_inverse_mass_matrix(
-        dealii::DoFHandler<dim> const &dof_handler,
-        dealii::AffineConstraints<double> const &affine_constraints)
+        [[maybe_unused]] dealii::DoFHandler<dim> const &dof_handler,
+        [[maybe_unused]] dealii::AffineConstraints<double> const
+            &affine_constraints)
 {
-  // Compute the inverse of the mass matrix
-  dealii::hp::QCollection<dim> mass_q_collection;
-  mass_q_collection.push_back(dealii::QGaussLobatto<dim>(fe_degree + 1));
-  mass_q_collection.push_back(dealii::QGaussLobatto<dim>(2));
+  ASSERT(&_matrix_free.get_dof_handler() == &dof_handler,
+         "reinit() needs to be called before compute_inverse_mass_matrix().");
 
-  typename dealii::MatrixFree<dim, double>::AdditionalData
-      mass_matrix_free_data;
-  mass_matrix_free_data.tasks_parallel_scheme =
-      dealii::MatrixFree<dim, double>::AdditionalData::partition_color;
-  mass_matrix_free_data.mapping_update_flags =
-      dealii::update_values | dealii::update_JxW_values;
-
-  dealii::MatrixFree<dim, double> mass_matrix_free;
-  mass_matrix_free.reinit(dealii::StaticMappingQ1<dim>::mapping, dof_handler,
-                          affine_constraints, mass_q_collection,
-                          mass_matrix_free_data);
-  mass_matrix_free.initialize_dof_vector(*_inverse_mass_matrix);
+  // Compute the inverse of the mass matrix using the Gauss-Lobatto quadrature
+  // of the MatrixFree object of the operator.
+  _matrix_free.initialize_dof_vector(*_inverse_mass_matrix);
   dealii::LA::distributed::Vector<double, MemorySpaceType> unit_vector;
-  mass_matrix_free.initialize_dof_vector(unit_vector);
+  _matrix_free.initialize_dof_vector(unit_vector);
   unit_vector = 1.;
-  mass_matrix_free.cell_loop(&ThermalOperator::cell_local_mass, this,
-                             *_inverse_mass_matrix, unit_vector);
+  _matrix_free.cell_loop(&ThermalOperator::cell_local_mass, this,
+                         *_inverse_mass_matrix, unit_vector);
   // Because cell_loop resolves the constraints, the constrained dofs are not
   // called they stay at zero. Thus, we need to force the value on the
   // constrained dofs by hand.
   std::vector<unsigned int> const &constrained_dofs =
-      mass_matrix_free.get_constrained_dofs();
+      _matrix_free.get_constrained_dofs();
   for (auto &dof : constrained_dofs)
     _inverse_mass_matrix->local_element(dof) += 1.;
 
@@ -222,6 +271,66 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
                       &ThermalOperator::face_local_apply, this, dst, src);
   }
 
+  apply_constrained_dofs(dst, src);
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    vmult(dealii::LA::distributed::BlockVector<double> &dst,
+          dealii::LA::distributed::BlockVector<double> const &src) const
+{
+  dst = 0.;
+  vmult_add(dst, src);
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    vmult_add(dealii::LA::distributed::BlockVector<double> &dst,
+              dealii::LA::distributed::BlockVector<double> const &src) const
+{
+  static_assert(std::is_same_v<MemorySpaceType, dealii::MemorySpace::Host>,
+                "The batched application is only implemented on the host.");
+  ASSERT_THROW(src.n_blocks() == dst.n_blocks(),
+               "Error: The source and the destination of the batched "
+               "application need to have the same number of members.");
+  ASSERT_THROW(_block_states.size() >= src.n_blocks(),
+               "Error: The material state of every member of the batched "
+               "application needs to be stored before applying the operator.");
+  ASSERT_THROW(_block_heat_sources.empty() ||
+                   (_block_heat_sources.size() >= src.n_blocks()),
+               "Error: The heat sources of every member of the batched "
+               "application need to be set before applying the operator.");
+
+  if (_boundary_type & BoundaryType::adiabatic)
+  {
+    _matrix_free.cell_loop(&ThermalOperator::cell_local_apply_block, this, dst,
+                           src);
+  }
+  else
+  {
+    _matrix_free.loop(&ThermalOperator::cell_local_apply_block,
+                      &ThermalOperator::face_local_apply_block,
+                      &ThermalOperator::face_local_apply_block, this, dst,
+                      src);
+  }
+
+  for (unsigned int b = 0; b < src.n_blocks(); ++b)
+    apply_constrained_dofs(dst.block(b), src.block(b));
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    apply_constrained_dofs(
+        dealii::LA::distributed::Vector<double, MemorySpaceType> &dst,
+        dealii::LA::distributed::Vector<double, MemorySpaceType> const &src)
+        const
+{
   // Because cell_loop resolves the constraints, the constrained dofs are not
   // called they stay at zero. Thus, we need to force the value on the
   // constrained dofs by hand. The variable scaling is used so that we get the
@@ -234,6 +343,53 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
     dst.local_element(dof) += scaling * src.local_element(dof);
 }
 
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    store_block_state(unsigned int const block)
+{
+  if (block >= _block_states.size())
+    _block_states.resize(block + 1);
+  _block_states[block] = _state;
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    load_block_state(unsigned int const block)
+{
+  ASSERT_THROW(block < _block_states.size(),
+               "Error: The material state of the member has not been stored.");
+  _state = _block_states[block];
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    set_heat_sources(
+        std::vector<std::shared_ptr<HeatSource<dim>>> const &heat_sources)
+{
+  _heat_sources = heat_sources;
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    set_block_heat_sources(
+        std::vector<std::vector<std::shared_ptr<HeatSource<dim>>>> const
+            &block_heat_sources)
+{
+  for (auto const &heat_sources : block_heat_sources)
+    ASSERT_THROW(heat_sources.size() == block_heat_sources[0].size(),
+                 "Error: All the members of the batched application need to "
+                 "have the same number of heat sources.");
+  _block_heat_sources = block_heat_sources;
+}
+
 template <int dim, bool use_table, int p_order, int fe_degree,
           typename MaterialStates, typename MemorySpaceType>
 void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
@@ -254,7 +410,8 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
         [[maybe_unused]] unsigned int cell, [[maybe_unused]] unsigned int q,
         [[maybe_unused]] dealii::VectorizedArray<double> temperature,
         std::array<dealii::VectorizedArray<double>,
-                   MaterialStates::n_material_states> &state_ratios) const
+                   MaterialStates::n_material_states> &state_ratios,
+        [[maybe_unused]] StateTables &state) const
 {
   unsigned int constexpr solid =
       static_cast<unsigned int>(MaterialStates::State::solid);
@@ -291,7 +448,7 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
       state_ratios[solid][n] = 1. - state_ratios[liquid][n];
     }
 
-    _liquid_ratio(cell, q) = state_ratios[liquid];
+    state.liquid_ratio(cell, q) = state_ratios[liquid];
   }
   else if constexpr (std::is_same_v<MaterialStates, SolidLiquidPowder>)
   {
@@ -313,7 +470,7 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
           _material_properties.get(material_id, Property::liquidus);
 
       // Update the state ratios
-      state_ratios[powder] = _powder_ratio(cell, q);
+      state_ratios[powder] = state.powder_ratio(cell, q);
 
       if (temperature[n] < solidus)
         state_ratios[liquid][n] = 0.;
@@ -333,8 +490,8 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
           1. - state_ratios[liquid][n] - state_ratios[powder][n];
     }
 
-    _liquid_ratio(cell, q) = state_ratios[liquid];
-    _powder_ratio(cell, q) = state_ratios[powder];
+    state.liquid_ratio(cell, q) = state_ratios[liquid];
+    state.powder_ratio(cell, q) = state_ratios[powder];
   }
 }
 
@@ -346,7 +503,8 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
         [[maybe_unused]] unsigned int face, [[maybe_unused]] unsigned int q,
         [[maybe_unused]] dealii::VectorizedArray<double> temperature,
         std::array<dealii::VectorizedArray<double>,
-                   MaterialStates::n_material_states> &face_state_ratios) const
+                   MaterialStates::n_material_states> &face_state_ratios,
+        [[maybe_unused]] StateTables &state) const
 {
   unsigned int constexpr solid =
       static_cast<unsigned int>(MaterialStates::State::solid);
@@ -410,7 +568,7 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
           _material_properties.get(material_id, Property::liquidus);
 
       // Update the state ratios
-      face_state_ratios[powder] = _face_powder_ratio(face, q);
+      face_state_ratios[powder] = state.face_powder_ratio(face, q);
 
       if (temperature[n] < solidus)
         face_state_ratios[liquid][n] = 0.;
@@ -430,7 +588,7 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
           1. - face_state_ratios[liquid][n] - face_state_ratios[powder][n];
     }
 
-    _face_powder_ratio(face, q) = face_state_ratios[powder];
+    state.face_powder_ratio(face, q) = face_state_ratios[powder];
   }
 }
 
@@ -498,6 +656,200 @@ ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
   return 1.0 / (density * specific_heat);
 }
 
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    query_heat_sources(
+        dealii::FEEvaluation<dim, fe_degree, fe_degree + 1, 1, double> const
+            &fe_eval,
+        unsigned int const n_lanes,
+        HeatSourceIndex<dim> const &heat_source_index,
+        std::vector<unsigned int> &beam_ids) const
+{
+  if (heat_source_index.empty())
+  {
+    beam_ids.clear();
+    return;
+  }
+
+  dealii::Point<dim> lower_point;
+  dealii::Point<dim> upper_point;
+  for (unsigned int d = 0; d < dim; ++d)
+  {
+    lower_point[d] = std::numeric_limits<double>::max();
+    upper_point[d] = std::numeric_limits<double>::lowest();
+  }
+  for (unsigned int q = 0; q < fe_eval.n_q_points; ++q)
+  {
+    auto const &q_point = fe_eval.quadrature_point(q);
+    for (unsigned int i = 0; i < n_lanes; ++i)
+      for (unsigned int d = 0; d < dim; ++d)
+      {
+        lower_point[d] = std::min(lower_point[d], q_point[d][i]);
+        upper_point[d] = std::max(upper_point[d], q_point[d][i]);
+      }
+  }
+  heat_source_index.query(
+      dealii::BoundingBox<dim>(std::make_pair(lower_point, upper_point)),
+      beam_ids);
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+bool ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    apply_cell_batch(
+        dealii::FEEvaluation<dim, fe_degree, fe_degree + 1, 1, double>
+            &fe_eval,
+        unsigned int const cell,
+        dealii::VectorizedArray<double> const &activity,
+        std::vector<std::shared_ptr<HeatSource<dim>>> const &heat_sources,
+        std::vector<unsigned int> const &beam_ids, StateTables &state,
+        dealii::AlignedVector<dealii::VectorizedArray<double>>
+            &temperature_powers,
+        dealii::LA::distributed::Vector<double, MemorySpaceType> &dst,
+        dealii::LA::distributed::Vector<double, MemorySpaceType> const &src)
+        const
+{
+  unsigned int const n_lanes =
+      _matrix_free.n_active_entries_per_cell_batch(cell);
+  bool phase_change = false;
+  std::array<dealii::VectorizedArray<double>, MaterialStates::n_material_states>
+      state_ratios;
+
+  // Store in a local vector the local values of src
+  fe_eval.read_dof_values(src);
+  // Evaluate the function and its gradient on the reference cell
+  fe_eval.evaluate(dealii::EvaluationFlags::values |
+                   dealii::EvaluationFlags::gradients);
+  // Apply the Jacobian of the transformation, multiply by the variable
+  // coefficients and the quadrature points
+  for (unsigned int q = 0; q < fe_eval.n_q_points; ++q)
+  {
+    auto temperature = fe_eval.get_value(q);
+    // Precompute the powers of temperature.
+    for (unsigned int i = 0; i <= p_order; ++i)
+    {
+      // FIXME Need to cast i to double due to a limitation in deal.II 9.5
+      temperature_powers[i] = std::pow(temperature, static_cast<double>(i));
+    }
+
+    // Calculate the local material properties
+    update_state_ratios(cell, q, temperature, state_ratios, state);
+    if constexpr (MaterialStates::n_material_states > 1)
+    {
+      if (_cell_cost_model)
+      {
+        unsigned int constexpr liquid =
+            static_cast<unsigned int>(MaterialStates::State::liquid);
+        for (unsigned int i = 0; i < n_lanes; ++i)
+          if ((state_ratios[liquid][i] > 0.) && (state_ratios[liquid][i] < 1.))
+            phase_change = true;
+      }
+    }
+    auto material_id = _material_id(cell, q);
+    auto inv_rho_cp = get_inv_rho_cp(material_id, state_ratios, temperature,
+                                     temperature_powers);
+    auto th_conductivity_grad = fe_eval.get_gradient(q);
+
+    // In 2D we only use x and z, and there are no deposition angle
+    if constexpr (dim == 2)
+    {
+      th_conductivity_grad[axis<dim>::x] *=
+          _material_properties.template compute_material_property<use_table>(
+              StateProperty::thermal_conductivity_x, material_id.data(),
+              state_ratios.data(), temperature, temperature_powers);
+      th_conductivity_grad[axis<dim>::z] *=
+          _material_properties.template compute_material_property<use_table>(
+              StateProperty::thermal_conductivity_z, material_id.data(),
+              state_ratios.data(), temperature, temperature_powers);
+    }
+
+    if constexpr (dim == 3)
+    {
+      auto const th_conductivity_grad_x = th_conductivity_grad[axis<dim>::x];
+      auto const th_conductivity_grad_y = th_conductivity_grad[axis<dim>::y];
+      auto const thermal_conductivity_x =
+          _material_properties.template compute_material_property<use_table>(
+              StateProperty::thermal_conductivity_x, material_id.data(),
+              state_ratios.data(), temperature, temperature_powers);
+      auto const thermal_conductivity_y =
+          _material_properties.template compute_material_property<use_table>(
+              StateProperty::thermal_conductivity_y, material_id.data(),
+              state_ratios.data(), temperature, temperature_powers);
+
+      auto cos = _deposition_cos(cell, q);
+      auto sin = _deposition_sin(cell, q);
+
+      // The rotation is performed using the following formula
+      //
+      // (cos  -sin) (x  0) ( cos  sin)
+      // (sin   cos) (0  y) (-sin  cos)
+      // =
+      // ((x*cos^2 + y*sin^2)  ((x-y) * (sin*cos)))
+      // (((x-y) * (sin*cos))  (x*sin^2 + y*cos^2))
+
+      th_conductivity_grad[axis<dim>::x] =
+          (thermal_conductivity_x * cos * cos +
+           thermal_conductivity_y * sin * sin) *
+              th_conductivity_grad_x +
+          ((thermal_conductivity_x - thermal_conductivity_y) * sin * cos) *
+              th_conductivity_grad_y;
+      th_conductivity_grad[axis<dim>::y] =
+          ((thermal_conductivity_x - thermal_conductivity_y) * sin * cos) *
+              th_conductivity_grad_x +
+          (thermal_conductivity_x * sin * sin +
+           thermal_conductivity_y * cos * cos) *
+              th_conductivity_grad_y;
+
+      // There is no deposition angle for the z axis
+      th_conductivity_grad[axis<dim>::z] *=
+          _material_properties.template compute_material_property<use_table>(
+              StateProperty::thermal_conductivity_z, material_id.data(),
+              state_ratios.data(), temperature, temperature_powers);
+    }
+
+    // The quiet cells barely conduct heat
+    if (_quiet_cells)
+      th_conductivity_grad *=
+          activity + (1. - activity) * _quiet_conductivity_scaling;
+
+    fe_eval.submit_gradient(-inv_rho_cp * th_conductivity_grad, q);
+
+    // Compute source term
+    dealii::Point<dim, dealii::VectorizedArray<double>> const &q_point =
+        fe_eval.quadrature_point(q);
+
+    dealii::VectorizedArray<double> quad_pt_source = 0.0;
+    if (beam_ids.size() > 0)
+    {
+      for (unsigned int i = 0; i < n_lanes; ++i)
+      {
+        dealii::Point<dim> q_point_loc;
+        for (unsigned int d = 0; d < dim; ++d)
+          q_point_loc(d) = q_point(d)[i];
+
+        for (auto const beam_id : beam_ids)
+          quad_pt_source[i] += heat_sources[beam_id]->value(
+              q_point_loc, _current_source_height);
+      }
+    }
+    quad_pt_source *= inv_rho_cp;
+    // The heat sources do not act on the quiet cells
+    if (_quiet_cells)
+      quad_pt_source *= activity;
+
+    fe_eval.submit_value(quad_pt_source, q);
+  }
+  // Sum over the quadrature points.
+  fe_eval.integrate(dealii::EvaluationFlags::values |
+                    dealii::EvaluationFlags::gradients);
+  fe_eval.distribute_local_to_global(dst);
+
+  return phase_change;
+}
+
 template <int dim, bool use_table, int p_order, int fe_degree,
           typename MaterialStates, typename MemorySpaceType>
 void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
@@ -513,8 +865,6 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
       data.create_cell_subrange_hp_by_index(cell_range, 0);
 
   dealii::FEEvaluation<dim, fe_degree, fe_degree + 1, 1, double> fe_eval(data);
-  std::array<dealii::VectorizedArray<double>, MaterialStates::n_material_states>
-      state_ratios;
 
   // We need powers of temperature to compute the material properties. We
   // could compute it in MaterialProperty but because it's in a hot loop.
@@ -523,119 +873,157 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
   dealii::AlignedVector<dealii::VectorizedArray<double>> temperature_powers(
       p_order + 1);
 
+  // Heat sources whose support overlaps the current cell batch.
+  std::vector<unsigned int> beam_ids;
+
+  // Time spent and number of cells for each category of the cost model.
+  unsigned int constexpr n_categories =
+      static_cast<unsigned int>(CellCostModel::Category::n_categories);
+  std::array<double, n_categories> category_time = {};
+  std::array<unsigned int, n_categories> category_n_cells = {};
+
   // Loop over the "cells". Note that we don't really work on a cell but on a
   // set of quadrature point.
   for (unsigned int cell = cell_subrange.first; cell < cell_subrange.second;
        ++cell)
   {
+    auto const batch_start = _cell_cost_model
+                                 ? std::chrono::steady_clock::now()
+                                 : std::chrono::steady_clock::time_point();
     // Reinit fe_eval on the current cell
     fe_eval.reinit(cell);
-    // Store in a local vector the local values of src
-    fe_eval.read_dof_values(src);
-    // Evaluate the function and its gradient on the reference cell
-    fe_eval.evaluate(dealii::EvaluationFlags::values |
-                     dealii::EvaluationFlags::gradients);
-    // Apply the Jacobian of the transformation, multiply by the variable
-    // coefficients and the quadrature points
-    for (unsigned int q = 0; q < fe_eval.n_q_points; ++q)
+    unsigned int const n_lanes =
+        _matrix_free.n_active_entries_per_cell_batch(cell);
+    dealii::VectorizedArray<double> const activity =
+        _quiet_cells ? get_cell_activity(cell)
+                     : dealii::make_vectorized_array<double>(1.);
+    // Find the heat sources that can contribute to the source term of the cell
+    // batch.
+    query_heat_sources(fe_eval, n_lanes, _heat_source_index, beam_ids);
+    bool const phase_change =
+        apply_cell_batch(fe_eval, cell, activity, _heat_sources, beam_ids,
+                         _state, temperature_powers, dst, src);
+
+    if (_cell_cost_model)
     {
-      auto temperature = fe_eval.get_value(q);
-      // Precompute the powers of temperature.
-      for (unsigned int i = 0; i <= p_order; ++i)
-      {
-        // FIXME Need to cast i to double due to a limitation in deal.II 9.5
-        temperature_powers[i] = std::pow(temperature, static_cast<double>(i));
-      }
+      auto const category =
+          beam_ids.size() > 0 ? CellCostModel::Category::heat_source
+          : phase_change      ? CellCostModel::Category::phase_change
+                              : CellCostModel::Category::regular;
+      unsigned int const c = static_cast<unsigned int>(category);
+      category_time[c] += std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - batch_start)
+                              .count();
+      category_n_cells[c] += n_lanes;
+    }
+  }
 
-      // Calculate the local material properties
-      update_state_ratios(cell, q, temperature, state_ratios);
-      auto material_id = _material_id(cell, q);
-      auto inv_rho_cp = get_inv_rho_cp(material_id, state_ratios, temperature,
-                                       temperature_powers);
-      auto th_conductivity_grad = fe_eval.get_gradient(q);
+  if (_cell_cost_model)
+  {
+    for (unsigned int c = 0; c < n_categories; ++c)
+    {
+      if (category_n_cells[c] > 0)
+        _cell_cost_model->add_cell_timing(
+            static_cast<CellCostModel::Category>(c), category_n_cells[c],
+            category_time[c]);
+    }
+  }
+}
 
-      // In 2D we only use x and z, and there are no deposition angle
-      if constexpr (dim == 2)
-      {
-        th_conductivity_grad[axis<dim>::x] *=
-            _material_properties.template compute_material_property<use_table>(
-                StateProperty::thermal_conductivity_x, material_id.data(),
-                state_ratios.data(), temperature, temperature_powers);
-        th_conductivity_grad[axis<dim>::z] *=
-            _material_properties.template compute_material_property<use_table>(
-                StateProperty::thermal_conductivity_z, material_id.data(),
-                state_ratios.data(), temperature, temperature_powers);
-      }
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    cell_local_apply_block(
+        dealii::MatrixFree<dim, double> const &data,
+        dealii::LA::distributed::BlockVector<double> &dst,
+        dealii::LA::distributed::BlockVector<double> const &src,
+        std::pair<unsigned int, unsigned int> const &cell_range) const
+{
+  // Get the subrange of cells associated with the fe index 0
+  std::pair<unsigned int, unsigned int> cell_subrange =
+      data.create_cell_subrange_hp_by_index(cell_range, 0);
 
-      if constexpr (dim == 3)
-      {
-        auto const th_conductivity_grad_x = th_conductivity_grad[axis<dim>::x];
-        auto const th_conductivity_grad_y = th_conductivity_grad[axis<dim>::y];
-        auto const thermal_conductivity_x =
-            _material_properties.template compute_material_property<use_table>(
-                StateProperty::thermal_conductivity_x, material_id.data(),
-                state_ratios.data(), temperature, temperature_powers);
-        auto const thermal_conductivity_y =
-            _material_properties.template compute_material_property<use_table>(
-                StateProperty::thermal_conductivity_y, material_id.data(),
-                state_ratios.data(), temperature, temperature_powers);
-
-        auto cos = _deposition_cos(cell, q);
-        auto sin = _deposition_sin(cell, q);
-
-        // The rotation is performed using the following formula
-        //
-        // (cos  -sin) (x  0) ( cos  sin)
-        // (sin   cos) (0  y) (-sin  cos)
-        // =
-        // ((x*cos^2 + y*sin^2)  ((x-y) * (sin*cos)))
-        // (((x-y) * (sin*cos))  (x*sin^2 + y*cos^2))
-
-        th_conductivity_grad[axis<dim>::x] =
-            (thermal_conductivity_x * cos * cos +
-             thermal_conductivity_y * sin * sin) *
-                th_conductivity_grad_x +
-            ((thermal_conductivity_x - thermal_conductivity_y) * sin * cos) *
-                th_conductivity_grad_y;
-        th_conductivity_grad[axis<dim>::y] =
-            ((thermal_conductivity_x - thermal_conductivity_y) * sin * cos) *
-                th_conductivity_grad_x +
-            (thermal_conductivity_x * sin * sin +
-             thermal_conductivity_y * cos * cos) *
-                th_conductivity_grad_y;
-
-        // There is no deposition angle for the z axis
-        th_conductivity_grad[axis<dim>::z] *=
-            _material_properties.template compute_material_property<use_table>(
-                StateProperty::thermal_conductivity_z, material_id.data(),
-                state_ratios.data(), temperature, temperature_powers);
-      }
+  dealii::FEEvaluation<dim, fe_degree, fe_degree + 1, 1, double> fe_eval(data);
 
-      fe_eval.submit_gradient(-inv_rho_cp * th_conductivity_grad, q);
+  // Scratch array of the powers of temperature reused by all the members.
+  dealii::AlignedVector<dealii::VectorizedArray<double>> temperature_powers(
+      p_order + 1);
 
-      // Compute source term
-      dealii::Point<dim, dealii::VectorizedArray<double>> const &q_point =
-          fe_eval.quadrature_point(q);
+  unsigned int const n_blocks = src.n_blocks();
+  bool const use_block_heat_sources = !_block_heat_sources.empty();
+  unsigned int const n_beams =
+      use_block_heat_sources ? _block_heat_sources[0].size() : 0;
+  HeatSourceIndex<dim> const &heat_source_index =
+      use_block_heat_sources ? _block_heat_source_index : _heat_source_index;
 
-      dealii::VectorizedArray<double> quad_pt_source = 0.0;
-      for (unsigned int i = 0;
-           i < _matrix_free.n_active_entries_per_cell_batch(cell); ++i)
-      {
-        dealii::Point<dim> q_point_loc;
-        for (unsigned int d = 0; d < dim; ++d)
-          q_point_loc(d) = q_point(d)[i];
+  // Heat sources of all the members whose support overlaps the current cell
+  // batch, and heat sources of a given member.
+  std::vector<unsigned int> all_beam_ids;
+  std::vector<unsigned int> beam_ids;
+
+  // Time spent and number of cells for each category of the cost model.
+  unsigned int constexpr n_categories =
+      static_cast<unsigned int>(CellCostModel::Category::n_categories);
+  std::array<double, n_categories> category_time = {};
+  std::array<unsigned int, n_categories> category_n_cells = {};
 
-        for (auto &beam : _heat_sources)
-          quad_pt_source[i] += beam->value(q_point_loc, _current_source_height);
+  for (unsigned int cell = cell_subrange.first; cell < cell_subrange.second;
+       ++cell)
+  {
+    auto const batch_start = _cell_cost_model
+                                 ? std::chrono::steady_clock::now()
+                                 : std::chrono::steady_clock::time_point();
+    // The geometry, the activity, and the heat sources overlapping the cell
+    // batch are the same for all the members.
+    fe_eval.reinit(cell);
+    unsigned int const n_lanes =
+        _matrix_free.n_active_entries_per_cell_batch(cell);
+    dealii::VectorizedArray<double> const activity =
+        _quiet_cells ? get_cell_activity(cell)
+                     : dealii::make_vectorized_array<double>(1.);
+    query_heat_sources(fe_eval, n_lanes, heat_source_index, all_beam_ids);
+
+    bool phase_change = false;
+    for (unsigned int b = 0; b < n_blocks; ++b)
+    {
+      if (use_block_heat_sources)
+      {
+        beam_ids.clear();
+        for (auto const beam_id : all_beam_ids)
+          if (beam_id / n_beams == b)
+            beam_ids.push_back(beam_id % n_beams);
       }
-      quad_pt_source *= inv_rho_cp;
+      phase_change |= apply_cell_batch(
+          fe_eval, cell, activity,
+          use_block_heat_sources ? _block_heat_sources[b] : _heat_sources,
+          use_block_heat_sources ? beam_ids : all_beam_ids, _block_states[b],
+          temperature_powers, dst.block(b), src.block(b));
+    }
 
-      fe_eval.submit_value(quad_pt_source, q);
+    if (_cell_cost_model)
+    {
+      auto const category =
+          all_beam_ids.size() > 0 ? CellCostModel::Category::heat_source
+          : phase_change          ? CellCostModel::Category::phase_change
+                                  : CellCostModel::Category::regular;
+      unsigned int const c = static_cast<unsigned int>(category);
+      category_time[c] += std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - batch_start)
+                              .count();
+      category_n_cells[c] += n_blocks * n_lanes;
+    }
+  }
+
+  if (_cell_cost_model)
+  {
+    for (unsigned int c = 0; c < n_categories; ++c)
+    {
+      if (category_n_cells[c] > 0)
+        _cell_cost_model->add_cell_timing(
+            static_cast<CellCostModel::Category>(c), category_n_cells[c],
+            category_time[c]);
     }
-    // Sum over the quadrature points.
-    fe_eval.integrate(dealii::EvaluationFlags::values |
-                      dealii::EvaluationFlags::gradients);
-    fe_eval.distribute_local_to_global(dst);
   }
 }
 
@@ -643,11 +1031,12 @@ template <int dim, bool use_table, int p_order, int fe_degree,
           typename MaterialStates, typename MemorySpaceType>
 void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
                      MemorySpaceType>::
-    face_local_apply(
+    apply_faces(
         dealii::MatrixFree<dim, double> const &data,
         dealii::LA::distributed::Vector<double, MemorySpaceType> &dst,
         dealii::LA::distributed::Vector<double, MemorySpaceType> const &src,
-        std::pair<unsigned int, unsigned int> const &face_range) const
+        std::pair<unsigned int, unsigned int> const &face_range,
+        StateTables &state) const
 {
   // Get the fe_indices of the cells that share faces in face_range;
   auto const adjacent_cells_fe_index = data.get_face_range_category(face_range);
@@ -663,8 +1052,13 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
   //  domain
   // Since we only care on the faces that are at the boundary of the activated
   // domain, we need to check that cell_1 is different than cell_2 and that at
-  // one of the two cells is using FE_Q
-  if (adjacent_cells_fe_index.first == adjacent_cells_fe_index.second)
+  // one of the two cells is using FE_Q. When there are quiet cells, the
+  // internal faces of the activated domain that separate an active cell from a
+  // quiet cell are also at the boundary of the activated domain.
+  bool const internal_face = (adjacent_cells_fe_index.first == 0) &&
+                             (adjacent_cells_fe_index.second == 0);
+  if ((adjacent_cells_fe_index.first == adjacent_cells_fe_index.second) &&
+      !(internal_face && _quiet_cells))
   {
     return;
   }
@@ -674,10 +1068,18 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
     return;
   }
 
-  // Create the FEFaceEvaluation object. The boolean in the constructor is
-  // used to decided which cell the face should be exterior to.
+  // Create the FEFaceEvaluation objects. The boolean in the constructor is
+  // used to decided which cell the face should be exterior to. On the
+  // internal faces, the boundary condition can be applied on either side.
   dealii::FEFaceEvaluation<dim, fe_degree, fe_degree + 1, 1, double>
       fe_face_eval(data, adjacent_cells_fe_index.first == 0);
+  std::unique_ptr<
+      dealii::FEFaceEvaluation<dim, fe_degree, fe_degree + 1, 1, double>>
+      fe_face_eval_exterior;
+  if (internal_face)
+    fe_face_eval_exterior = std::make_unique<
+        dealii::FEFaceEvaluation<dim, fe_degree, fe_degree + 1, 1, double>>(
+        data, false);
   std::array<dealii::VectorizedArray<double>, MaterialStates::n_material_states>
       face_state_ratios;
 
@@ -694,8 +1096,13 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
   dealii::AlignedVector<dealii::VectorizedArray<double>> temperature_powers(
       p_order + 1);
 
-  // Loop over the faces
-  for (unsigned int face = face_range.first; face < face_range.second; ++face)
+  // Apply the boundary condition on one side of the face batch. The boundary
+  // condition is multiplied by activity to turn it off on the quiet cells.
+  auto apply_boundary_condition =
+      [&](dealii::FEFaceEvaluation<dim, fe_degree, fe_degree + 1, 1, double>
+              &fe_face_eval,
+          unsigned int const face,
+          dealii::VectorizedArray<double> const &activity)
   {
     // Reinit fe_face_eval on the current face
     fe_face_eval.reinit(face);
@@ -717,7 +1124,8 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
 
       // Compute the local_properties
       auto material_id = _face_material_id(face, q);
-      update_face_state_ratios(face, q, temperature, face_state_ratios);
+      update_face_state_ratios(face, q, temperature, face_state_ratios,
+                               state);
       auto const inv_rho_cp = get_inv_rho_cp(material_id, face_state_ratios,
                                              temperature, temperature_powers);
       if (_boundary_type & BoundaryType::convective)
@@ -755,7 +1163,7 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
       }
 
       auto const boundary_val =
-          -inv_rho_cp *
+          -activity * inv_rho_cp *
           (conv_heat_transfer_coef * (temperature - conv_temperature_infty) +
            rad_heat_transfer_coef * (temperature - rad_temperature_infty));
       fe_face_eval.submit_value(boundary_val * fe_face_eval.get_value(q), q);
@@ -763,9 +1171,89 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
     // Sum over the quadrature points
     fe_face_eval.integrate(dealii::EvaluationFlags::values);
     fe_face_eval.distribute_local_to_global(dst);
+  };
+
+  auto const range_start = _cell_cost_model
+                               ? std::chrono::steady_clock::now()
+                               : std::chrono::steady_clock::time_point();
+  unsigned int n_faces = 0;
+
+  // Loop over the faces
+  for (unsigned int face = face_range.first; face < face_range.second; ++face)
+  {
+    n_faces += data.n_active_entries_per_face_batch(face);
+    if (internal_face)
+    {
+      // The boundary condition is applied on the active side of the faces
+      // between an active cell and a quiet cell.
+      auto const interior_activity = get_face_activity(face, true);
+      auto const exterior_activity = get_face_activity(face, false);
+      auto const interior_boundary =
+          interior_activity * (1. - exterior_activity);
+      auto const exterior_boundary =
+          exterior_activity * (1. - interior_activity);
+      auto const any_lane = [](dealii::VectorizedArray<double> const &mask)
+      {
+        for (unsigned int n = 0; n < mask.size(); ++n)
+          if (mask[n] > 0.)
+            return true;
+        return false;
+      };
+      if (any_lane(interior_boundary))
+        apply_boundary_condition(fe_face_eval, face, interior_boundary);
+      if (any_lane(exterior_boundary))
+        apply_boundary_condition(*fe_face_eval_exterior, face,
+                                 exterior_boundary);
+    }
+    else
+    {
+      apply_boundary_condition(
+          fe_face_eval, face,
+          _quiet_cells
+              ? get_face_activity(face, adjacent_cells_fe_index.first == 0)
+              : dealii::make_vectorized_array<double>(1.));
+    }
+  }
+
+  if (_cell_cost_model)
+  {
+    _cell_cost_model->add_face_timing(
+        n_faces, std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - range_start)
+                     .count());
   }
 }
 
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    face_local_apply(
+        dealii::MatrixFree<dim, double> const &data,
+        dealii::LA::distributed::Vector<double, MemorySpaceType> &dst,
+        dealii::LA::distributed::Vector<double, MemorySpaceType> const &src,
+        std::pair<unsigned int, unsigned int> const &face_range) const
+{
+  apply_faces(data, dst, src, face_range, _state);
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    face_local_apply_block(
+        dealii::MatrixFree<dim, double> const &data,
+        dealii::LA::distributed::BlockVector<double> &dst,
+        dealii::LA::distributed::BlockVector<double> const &src,
+        std::pair<unsigned int, unsigned int> const &face_range) const
+{
+  // The faces at the boundary of the activated domain are a small fraction of
+  // the work, so the members are simply applied one after the other.
+  for (unsigned int b = 0; b < src.n_blocks(); ++b)
+    apply_faces(data, dst.block(b), src.block(b), face_range,
+                _block_states[b]);
+}
+
 template <int dim, bool use_table, int p_order, int fe_degree,
           typename MaterialStates, typename MemorySpaceType>
 void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
@@ -777,41 +1265,58 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
 
   if constexpr (!std::is_same_v<MaterialStates, Solid>)
   {
-    _liquid_ratio.reinit(n_cells, fe_eval.n_q_points);
+    _state.liquid_ratio.reinit(n_cells, fe_eval.n_q_points);
   }
 
   if constexpr (std::is_same_v<MaterialStates, SolidLiquidPowder>)
   {
-    _powder_ratio.reinit(n_cells, fe_eval.n_q_points);
+    _state.powder_ratio.reinit(n_cells, fe_eval.n_q_points);
   }
 
   _material_id.reinit(n_cells, fe_eval.n_q_points);
 
+  // The material properties are constant on a cell, so the lookups are done
+  // once per cell and not once per quadrature point.
   for (unsigned int cell = 0; cell < n_cells; ++cell)
-    for (unsigned int q = 0; q < fe_eval.n_q_points; ++q)
-      for (unsigned int i = 0;
-           i < _matrix_free.n_active_entries_per_cell_batch(cell); ++i)
+    for (unsigned int i = 0;
+         i < _matrix_free.n_active_entries_per_cell_batch(cell); ++i)
+    {
+      typename dealii::DoFHandler<dim>::cell_iterator cell_it =
+          _matrix_free.get_cell_iterator(cell, i);
+      // Cast to Triangulation<dim>::cell_iterator to access the material_id
+      typename dealii::Triangulation<dim>::active_cell_iterator cell_tria(
+          cell_it);
+
+      [[maybe_unused]] double liquid_ratio = 0.;
+      if constexpr (!std::is_same_v<MaterialStates, Solid>)
       {
-        typename dealii::DoFHandler<dim>::cell_iterator cell_it =
-            _matrix_free.get_cell_iterator(cell, i);
-        // Cast to Triangulation<dim>::cell_iterator to access the material_id
-        typename dealii::Triangulation<dim>::active_cell_iterator cell_tria(
-            cell_it);
+        liquid_ratio = _material_properties.get_state_ratio(
+            cell_tria, MaterialStates::State::liquid);
+      }
 
+      [[maybe_unused]] double powder_ratio = 0.;
+      if constexpr (std::is_same_v<MaterialStates, SolidLiquidPowder>)
+      {
+        powder_ratio = _material_properties.get_state_ratio(
+            cell_tria, MaterialStates::State::powder);
+      }
+
+      dealii::types::material_id const material_id = cell_tria->material_id();
+      for (unsigned int q = 0; q < fe_eval.n_q_points; ++q)
+      {
         if constexpr (!std::is_same_v<MaterialStates, Solid>)
         {
-          _liquid_ratio(cell, q)[i] = _material_properties.get_state_ratio(
-              cell_tria, MaterialStates::State::liquid);
+          _state.liquid_ratio(cell, q)[i] = liquid_ratio;
         }
 
         if constexpr (std::is_same_v<MaterialStates, SolidLiquidPowder>)
         {
-          _powder_ratio(cell, q)[i] = _material_properties.get_state_ratio(
-              cell_tria, MaterialStates::State::powder);
+          _state.powder_ratio(cell, q)[i] = powder_ratio;
         }
 
-        _material_id(cell, q)[i] = cell_tria->material_id();
+        _material_id(cell, q)[i] = material_id;
       }
+    }
 
   // If we are using boundary conditions other than adiabatic, we also need to
   // update the face variables
@@ -826,75 +1331,87 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
 
     if constexpr (std::is_same_v<MaterialStates, SolidLiquidPowder>)
     {
-      _face_powder_ratio.reinit(n_faces, fe_face_eval.n_q_points);
+      _state.face_powder_ratio.reinit(n_faces, fe_face_eval.n_q_points);
     }
 
     _face_material_id.reinit(n_faces, fe_face_eval.n_q_points);
 
     for (unsigned int face = 0; face < n_inner_faces; ++face)
-      for (unsigned int q = 0; q < fe_face_eval.n_q_points; ++q)
-        for (unsigned int i = 0;
-             i < _matrix_free.n_active_entries_per_face_batch(face); ++i)
+      for (unsigned int i = 0;
+           i < _matrix_free.n_active_entries_per_face_batch(face); ++i)
+      {
+        // We get the two cells associated with the face
+        auto [cell_1, face_1] = _matrix_free.get_face_iterator(face, i, true);
+        auto [cell_2, face_2] = _matrix_free.get_face_iterator(face, i, false);
+        // We only care for cells that are at the boundary between activated
+        // and deactivated domains. When there are quiet cells, the faces
+        // between two cells with FE_Q can be at that boundary too.
+        unsigned int const active_fe_index_1 = cell_1->active_fe_index();
+        unsigned int const active_fe_index_2 = cell_2->active_fe_index();
+        if ((active_fe_index_1 == active_fe_index_2) &&
+            !(_quiet_cells && (active_fe_index_1 == 0)))
+        {
+          continue;
+        }
+        // We need the cell that has FE_Q not the one that has FE_Nothing
+        // Cast to Triangulation<dim>::cell_iterator to access the material_id
+        typename dealii::Triangulation<dim>::active_cell_iterator cell_tria(
+            (active_fe_index_1 == 0) ? cell_1 : cell_2);
+        if (cell_tria->is_locally_owned())
         {
-          // We get the two cells associated with the face
-          auto [cell_1, face_1] = _matrix_free.get_face_iterator(face, i, true);
-          auto [cell_2, face_2] =
-              _matrix_free.get_face_iterator(face, i, false);
-          // We only care for cells that are at the boundary between activated
-          // and deactivated domains
-          unsigned int const active_fe_index_1 = cell_1->active_fe_index();
-          unsigned int const active_fe_index_2 = cell_2->active_fe_index();
-          if (active_fe_index_1 == active_fe_index_2)
-          {
-            continue;
-          }
-          // We need the cell that has FE_Q not the one that has FE_Nothing
-          // Cast to Triangulation<dim>::cell_iterator to access the
-          // material_id
-          typename dealii::Triangulation<dim>::active_cell_iterator cell_tria(
-              (active_fe_index_1 == 0) ? cell_1 : cell_2);
-          if (cell_tria->is_locally_owned())
-          {
-            if constexpr (std::is_same_v<MaterialStates, SolidLiquidPowder>)
-            {
-              _face_powder_ratio(face, q)[i] =
-                  _material_properties.get_state_ratio(
-                      cell_tria, MaterialStates::State::powder);
-            }
-
-            _face_material_id(face, q)[i] = cell_tria->material_id();
-          }
+          set_face_state(face, i, cell_tria, fe_face_eval.n_q_points);
         }
+      }
 
     for (unsigned int face = n_inner_faces; face < n_faces; ++face)
-      for (unsigned int q = 0; q < fe_face_eval.n_q_points; ++q)
-        for (unsigned int i = 0;
-             i < _matrix_free.n_active_entries_per_face_batch(face); ++i)
+      for (unsigned int i = 0;
+           i < _matrix_free.n_active_entries_per_face_batch(face); ++i)
+      {
+        // We get one cell associated with the face
+        auto [cell, face_] = _matrix_free.get_face_iterator(face, i, true);
+        unsigned int const active_fe_index = cell->active_fe_index();
+        if (active_fe_index == 1)
         {
-          // We get one cell associated with the face
-          auto [cell, face_] = _matrix_free.get_face_iterator(face, i, true);
-          unsigned int const active_fe_index = cell->active_fe_index();
-          if (active_fe_index == 1)
-          {
-            continue;
-          }
-          // We need the cell that has FE_Q not the one that has FE_Nothing
-          // Cast to Triangulation<dim>::cell_iterator to access the
-          // material_id
-          typename dealii::Triangulation<dim>::active_cell_iterator cell_tria(
-              cell);
-          if (cell_tria->is_locally_owned())
-          {
-            if constexpr (std::is_same_v<MaterialStates, SolidLiquidPowder>)
-            {
-              _face_powder_ratio(face, q)[i] =
-                  _material_properties.get_state_ratio(
-                      cell_tria, MaterialStates::State::powder);
-            }
-
-            _face_material_id(face, q)[i] = cell_tria->material_id();
-          }
+          continue;
         }
+        // We need the cell that has FE_Q not the one that has FE_Nothing
+        // Cast to Triangulation<dim>::cell_iterator to access the material_id
+        typename dealii::Triangulation<dim>::active_cell_iterator cell_tria(
+            cell);
+        if (cell_tria->is_locally_owned())
+        {
+          set_face_state(face, i, cell_tria, fe_face_eval.n_q_points);
+        }
+      }
+  }
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    set_face_state(
+        unsigned int const face, unsigned int const lane,
+        typename dealii::Triangulation<dim>::active_cell_iterator const
+            &cell_tria,
+        unsigned int const n_q_points)
+{
+  [[maybe_unused]] double powder_ratio = 0.;
+  if constexpr (std::is_same_v<MaterialStates, SolidLiquidPowder>)
+  {
+    powder_ratio = _material_properties.get_state_ratio(
+        cell_tria, MaterialStates::State::powder);
+  }
+
+  dealii::types::material_id const material_id = cell_tria->material_id();
+  for (unsigned int q = 0; q < n_q_points; ++q)
+  {
+    if constexpr (std::is_same_v<MaterialStates, SolidLiquidPowder>)
+    {
+      _state.face_powder_ratio(face, q)[lane] = powder_ratio;
+    }
+
+    _face_material_id(face, q)[lane] = material_id;
   }
 }
 
@@ -903,7 +1420,7 @@ template <int dim, bool use_table, int p_order, int fe_degree,
 void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
                      MemorySpaceType>::set_state_to_material_properties()
 {
-  _material_properties.set_state(_liquid_ratio, _powder_ratio,
+  _material_properties.set_state(_state.liquid_ratio, _state.powder_ratio,
                                  _cell_it_to_mf_cell_map,
                                  _matrix_free.get_dof_handler());
 }
@@ -953,6 +1470,126 @@ void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
       }
 }
 
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    update_material_deposition_orientation(
+        std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator> const
+            &cells,
+        std::vector<double> const &deposition_cos,
+        std::vector<double> const &deposition_sin)
+{
+  ASSERT((cells.size() == deposition_cos.size()) &&
+             (cells.size() == deposition_sin.size()),
+         "The sizes of the cells and of the angles do not match.");
+
+  unsigned int const n_q_points = _deposition_cos.size(1);
+  for (unsigned int k = 0; k < cells.size(); ++k)
+  {
+    auto const [cell, i] = _cell_it_to_mf_cell_map.at(cells[k]);
+    for (unsigned int q = 0; q < n_q_points; ++q)
+    {
+      _deposition_cos(cell, q)[i] = deposition_cos[k];
+      _deposition_sin(cell, q)[i] = deposition_sin[k];
+    }
+  }
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperator<dim, use_table, p_order, fe_degree, MaterialStates,
+                     MemorySpaceType>::
+    compute_gradient_jump_indicators(
+        dealii::LA::distributed::Vector<double, MemorySpaceType> const
+            &temperature,
+        dealii::Vector<float> &indicators) const
+{
+  auto const &triangulation =
+      _matrix_free.get_dof_handler().get_triangulation();
+  indicators.reinit(triangulation.n_active_cells());
+
+  bool const update_ghosts = !temperature.has_ghost_elements();
+  if (update_ghosts)
+    temperature.update_ghost_values();
+
+  // Each face is processed by a single processor. The contributions to the
+  // ghost cells are sent to the processor that owns them.
+  std::vector<double> squared_indicators(triangulation.n_active_cells(), 0.);
+  std::map<unsigned int, std::vector<std::pair<dealii::CellId, double>>>
+      ghost_contributions;
+  auto add_contribution = [&](auto const &cell, double const value)
+  {
+    if (cell->is_locally_owned())
+      squared_indicators[cell->active_cell_index()] += value;
+    else
+      ghost_contributions[cell->subdomain_id()].emplace_back(cell->id(), value);
+  };
+
+  dealii::FEFaceEvaluation<dim, fe_degree, fe_degree + 1, 1, double>
+      fe_face_eval_interior(_matrix_free, true);
+  dealii::FEFaceEvaluation<dim, fe_degree, fe_degree + 1, 1, double>
+      fe_face_eval_exterior(_matrix_free, false);
+  for (unsigned int face = 0; face < _matrix_free.n_inner_face_batches();
+       ++face)
+  {
+    // Only the faces between two cells with degrees of freedom have a jump
+    auto const adjacent_cells_fe_index =
+        _matrix_free.get_face_range_category(std::make_pair(face, face + 1));
+    if ((adjacent_cells_fe_index.first != 0) ||
+        (adjacent_cells_fe_index.second != 0))
+      continue;
+
+    fe_face_eval_interior.reinit(face);
+    fe_face_eval_exterior.reinit(face);
+    fe_face_eval_interior.gather_evaluate(temperature,
+                                          dealii::EvaluationFlags::gradients);
+    fe_face_eval_exterior.gather_evaluate(temperature,
+                                          dealii::EvaluationFlags::gradients);
+    dealii::VectorizedArray<double> squared_jump = 0.;
+    dealii::VectorizedArray<double> face_measure = 0.;
+    for (unsigned int q = 0; q < fe_face_eval_interior.n_q_points; ++q)
+    {
+      // Both evaluators use the normal of the interior cell
+      auto const jump = fe_face_eval_interior.get_normal_derivative(q) -
+                        fe_face_eval_exterior.get_normal_derivative(q);
+      squared_jump += jump * jump * fe_face_eval_interior.JxW(q);
+      face_measure += fe_face_eval_interior.JxW(q);
+    }
+
+    // The jump is weighted by the diameter of the face as in the Kelly
+    // estimator
+    for (unsigned int i = 0;
+         i < _matrix_free.n_active_entries_per_face_batch(face); ++i)
+    {
+      double const diameter =
+          dim == 2 ? face_measure[i] : std::sqrt(face_measure[i]);
+      double const value = diameter / 24. * squared_jump[i];
+      add_contribution(_matrix_free.get_face_iterator(face, i, true).first,
+                       value);
+      add_contribution(_matrix_free.get_face_iterator(face, i, false).first,
+                       value);
+    }
+  }
+
+  if (update_ghosts)
+    temperature.zero_out_ghost_values();
+
+  auto const received_contributions = dealii::Utilities::MPI::some_to_some(
+      _matrix_free.get_dof_handler().get_communicator(), ghost_contributions);
+  for (auto const &[rank, contributions] : received_contributions)
+  {
+    for (auto const &[cell_id, value] : contributions)
+    {
+      squared_indicators[triangulation.create_cell_iterator(cell_id)
+                             ->active_cell_index()] += value;
+    }
+  }
+
+  for (unsigned int i = 0; i < squared_indicators.size(); ++i)
+    indicators[i] = std::sqrt(squared_indicators[i]);
+}
+
 } // namespace adamantine
 
 #endif
@@ -8,11 +8,17 @@
 #ifndef THERMAL_OPERATOR_BASE_HH
 #define THERMAL_OPERATOR_BASE_HH
 
+#include <CellCostModel.hh>
+#include <HeatSource.hh>
 #include <Operator.hh>
 
 #include <deal.II/dofs/dof_handler.h>
 #include <deal.II/hp/q_collection.h>
 #include <deal.II/lac/affine_constraints.h>
+#include <deal.II/lac/vector.h>
+
+#include <memory>
+#include <vector>
 
 namespace adamantine
 {
@@ -47,11 +53,75 @@ public:
 
   virtual void set_state_to_material_properties() = 0;
 
+  /**
+   * Copy the current material state of the operator, i.e., the state computed
+   * by get_state_from_material_properties() or updated by the last
+   * application of the operator, into the state stored for the ensemble
+   * member @p block. The stored states are discarded when the operator is
+   * reinitialized.
+   */
+  virtual void store_block_state(unsigned int const block) = 0;
+
+  /**
+   * Copy the material state stored for the ensemble member @p block into the
+   * current material state of the operator.
+   */
+  virtual void load_block_state(unsigned int const block) = 0;
+
   virtual void set_material_deposition_orientation(
       std::vector<double> const &deposition_cos,
       std::vector<double> const &deposition_sin) = 0;
 
+  /**
+   * Update the deposition cosine and sine angles of the given locally owned
+   * cells only.
+   */
+  virtual void update_material_deposition_orientation(
+      std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator> const
+          &cells,
+      std::vector<double> const &deposition_cos,
+      std::vector<double> const &deposition_sin) = 0;
+
+  /**
+   * Set the heat sources used by the operator. This is used to switch between
+   * ensemble members sharing the operator but not the heat sources.
+   */
+  virtual void set_heat_sources(
+      std::vector<std::shared_ptr<HeatSource<dim>>> const &heat_sources) = 0;
+
   virtual void set_time_and_source_height(double, double) = 0;
+
+  /**
+   * Set the flags of the quiet cells. @p quiet_cells is indexed by the active
+   * cell index and it needs to be up to date for the locally owned and the
+   * ghost cells when the operator is applied. The thermal conductivity of a
+   * quiet cell is scaled by @p conductivity_scaling, the heat sources do not
+   * act on it, and its faces do not carry boundary conditions. If the pointer
+   * is null, there is no quiet cell.
+   */
+  virtual void
+  set_quiet_cells(std::shared_ptr<std::vector<bool> const> quiet_cells,
+                  double const conductivity_scaling) = 0;
+
+  /**
+   * Compute an error indicator on each active cell from the jump of the normal
+   * derivative of @p temperature across the faces between cells that have
+   * degrees of freedom. This is the indicator of Kelly et al. The indicators
+   * are indexed by the active cell index and only the values of the locally
+   * owned cells are meaningful. This is a collective operation.
+   */
+  virtual void compute_gradient_jump_indicators(
+      dealii::LA::distributed::Vector<double, MemorySpaceType> const
+          &temperature,
+      dealii::Vector<float> &indicators) const = 0;
+
+  /**
+   * Set the model whose costs are calibrated from the timings of the cell
+   * batches and the face batches. If the pointer is null, the batches are not
+   * timed.
+   */
+  virtual void
+  set_cell_cost_model(std::shared_ptr<CellCostModel> cell_cost_model) = 0;
 };
 } // namespace adamantine
 #endif
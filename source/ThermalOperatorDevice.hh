@@ -78,6 +78,10 @@ public:
 
   void set_state_to_material_properties() override;
 
+  void store_block_state(unsigned int const block) override;
+
+  void load_block_state(unsigned int const block) override;
+
   /**
    * Set the deposition cosine and sine angles and convert the data from
    * std::vector to Kokkos::View.
@@ -86,11 +90,48 @@ public:
       std::vector<double> const &deposition_cos,
       std::vector<double> const &deposition_sin) override;
 
+  void set_heat_sources(
+      std::vector<std::shared_ptr<HeatSource<dim>>> const &) override
+  {
+    // The heat sources are given to the device operator by ThermalPhysics
+    // when the right-hand side is evaluated.
+  }
+
   void set_time_and_source_height(double, double) override
   {
     // TODO
   }
 
+  void set_cell_cost_model(std::shared_ptr<CellCostModel>) override
+  {
+    ASSERT_THROW(false, "Error: The cell cost model is not implemented on the "
+                        "device.");
+  }
+
+  void update_material_deposition_orientation(
+      std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator> const
+          &,
+      std::vector<double> const &, std::vector<double> const &) override
+  {
+    ASSERT_THROW(false, "Error: Quiet element activation is not implemented "
+                        "on the device.");
+  }
+
+  void set_quiet_cells(std::shared_ptr<std::vector<bool> const>,
+                       double const) override
+  {
+    ASSERT_THROW(false, "Error: Quiet element activation is not implemented "
+                        "on the device.");
+  }
+
+  void compute_gradient_jump_indicators(
+      dealii::LA::distributed::Vector<double, MemorySpaceType> const &,
+      dealii::Vector<float> &) const override
+  {
+    ASSERT_THROW(false, "Error: The gradient jump error estimator is not "
+                        "implemented on the device.");
+  }
+
   /**
    * Update \f$ \frac{1}{\rho C_p} \f$ on the cells using the values computed at
    * the quadrature points.
@@ -108,6 +149,15 @@ public:
 private:
   using kokkos_default = dealii::MemorySpace::Default::kokkos_space;
 
+  /**
+   * Ratios of the material states at the quadrature points.
+   */
+  struct StateViews
+  {
+    Kokkos::View<double *, kokkos_default> liquid_ratio;
+    Kokkos::View<double *, kokkos_default> powder_ratio;
+  };
+
   /**
    * MPI communicator.
    */
@@ -139,6 +189,10 @@ private:
       _inverse_mass_matrix;
   std::map<typename dealii::DoFHandler<dim>::cell_iterator, double>
       _inv_rho_cp_cells;
+  /**
+   * Ratios of the material states stored for each ensemble member.
+   */
+  std::vector<StateViews> _block_states;
 };
 
 template <int dim, bool use_table, int p_order, int fe_degree,
@@ -490,6 +490,10 @@ void ThermalOperatorDevice<dim, use_table, p_order, fe_degree, MaterialStates,
           &dof_handler.get_triangulation())
           ->n_locally_owned_active_cells();
 
+  // The states stored for the ensemble members do not match the new mesh
+  // anymore.
+  _block_states.clear();
+
   // Compute the mapping between DoFHandler cells and the access position in
   // MatrixFree
   _cell_it_to_mf_pos.clear();
@@ -755,6 +759,40 @@ void ThermalOperatorDevice<dim, use_table, p_order, fe_degree, MaterialStates,
                                         _matrix_free.get_dof_handler());
 }
 
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperatorDevice<dim, use_table, p_order, fe_degree, MaterialStates,
+                           MemorySpaceType>::
+    store_block_state(unsigned int const block)
+{
+  if (block >= _block_states.size())
+    _block_states.resize(block + 1);
+  auto &block_state = _block_states[block];
+  block_state.liquid_ratio = Kokkos::View<double *, kokkos_default>(
+      Kokkos::view_alloc("liquid_ratio", Kokkos::WithoutInitializing),
+      _liquid_ratio.extent(0));
+  Kokkos::deep_copy(block_state.liquid_ratio, _liquid_ratio);
+  block_state.powder_ratio = Kokkos::View<double *, kokkos_default>(
+      Kokkos::view_alloc("powder_ratio", Kokkos::WithoutInitializing),
+      _powder_ratio.extent(0));
+  Kokkos::deep_copy(block_state.powder_ratio, _powder_ratio);
+}
+
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType>
+void ThermalOperatorDevice<dim, use_table, p_order, fe_degree, MaterialStates,
+                           MemorySpaceType>::
+    load_block_state(unsigned int const block)
+{
+  ASSERT_THROW(block < _block_states.size(),
+               "Error: The material state of the member has not been stored.");
+  // The views of the operator are modified in place when the operator is
+  // applied, so the stored state is copied instead of shared.
+  auto const &block_state = _block_states[block];
+  Kokkos::deep_copy(_liquid_ratio, block_state.liquid_ratio);
+  Kokkos::deep_copy(_powder_ratio, block_state.powder_ratio);
+}
+
 template <int dim, bool use_table, int p_order, int fe_degree,
           typename MaterialStates, typename MemorySpaceType>
 void ThermalOperatorDevice<dim, use_table, p_order, fe_degree, MaterialStates,
@@ -8,19 +8,23 @@
 #ifndef THERMAL_PHYSICS_HH
 #define THERMAL_PHYSICS_HH
 
+#include <CellCostModel.hh>
 #include <Geometry.hh>
 #include <HeatSource.hh>
 #include <ImplicitOperator.hh>
 #include <ThermalOperatorBase.hh>
 #include <ThermalPhysicsInterface.hh>
+#include <dof_renumbering.hh>
 
 #include <deal.II/base/time_stepping.h>
 #include <deal.II/base/time_stepping.templates.h>
 #include <deal.II/distributed/cell_weights.h>
 #include <deal.II/hp/fe_collection.h>
+#include <deal.II/lac/la_parallel_block_vector.h>
 
 #include <boost/property_tree/ptree.hpp>
 
+#include <map>
 #include <memory>
 
 namespace adamantine
@@ -50,9 +54,7 @@ public:
   void compute_inverse_mass_matrix() override;
 
   void add_material(
-      std::vector<std::vector<
-          typename dealii::DoFHandler<dim>::active_cell_iterator>> const
-          &elements_to_activate,
+      ElementsToActivate<dim> const &elements_to_activate,
       std::vector<double> const &new_deposition_cos,
       std::vector<double> const &new_deposition_sin,
       std::vector<bool> &new_has_melted, unsigned int const activation_start,
@@ -60,10 +62,43 @@ public:
       dealii::LA::distributed::Vector<double, MemorySpaceType> &solution)
       override;
 
+  bool schedule_material(ElementsToActivate<dim> const &elements_to_activate,
+                         std::vector<double> const &new_deposition_cos,
+                         std::vector<double> const &new_deposition_sin,
+                         unsigned int const activation_start,
+                         unsigned int const activation_end,
+                         double const new_material_temperature) override;
+
+  void execute_mesh_changes(
+      dealii::LA::distributed::Vector<double, MemorySpaceType> &solution,
+      bool const update_operators) override;
+
+  void execute_mesh_changes(
+      std::vector<dealii::LA::distributed::Vector<double, MemorySpaceType> *>
+          const &solutions,
+      bool const update_operators) override;
+
+  void set_n_members(unsigned int const n_members) override;
+
+  void select_member(unsigned int const member) override;
+
+  bool is_repartition_needed() override;
+
+  bool activate_scheduled_material() override;
+
+  void compute_error_indicators(
+      dealii::LA::distributed::Vector<double, MemorySpaceType> const &solution,
+      dealii::Vector<float> &indicators) const override;
+
+  bool
+  is_quiet(typename dealii::DoFHandler<dim>::active_cell_iterator const &cell)
+      const override;
+
   /**
    * For ThermalPhysics, update_physics_parameters is used to modify the heat
    * sources in the middle of a simulation, e.g. for data assimilation with an
-   * augmented ensemble involving heat source parameters.
+   * augmented ensemble involving heat source parameters. If the mesh is
+   * shared, the heat sources of the selected member are modified.
    */
   void update_physics_parameters(
       boost::property_tree::ptree const &heat_source_database) override;
@@ -73,6 +108,12 @@ public:
       dealii::LA::distributed::Vector<double, MemorySpaceType> &solution,
       std::vector<Timer> &timers) override;
 
+  double evolve_one_time_step(
+      double t, double delta_t,
+      std::vector<dealii::LA::distributed::Vector<double, MemorySpaceType> *>
+          const &solutions,
+      std::vector<Timer> &timers) override;
+
   void
   initialize_dof_vector(double const value,
                         dealii::LA::distributed::Vector<double, MemorySpaceType>
@@ -125,12 +166,75 @@ private:
   using LA_Vector =
       typename dealii::LA::distributed::Vector<double, MemorySpaceType>;
 
+  /**
+   * State of an ensemble member sharing the mesh.
+   */
+  struct MemberState
+  {
+    /**
+     * Ratio of each material state in the locally owned cells. It is only up
+     * to date while the operators are outdated, otherwise the state of the
+     * member is stored in the operators.
+     */
+    Kokkos::View<double **, typename MemorySpaceType::kokkos_space> state;
+    /**
+     * Melting indicators of the cells with material.
+     */
+    std::vector<bool> has_melted;
+    /**
+     * Temperature of the material activated by the next mesh change.
+     */
+    double new_material_temperature = 0.;
+    /**
+     * Heat sources of the member.
+     */
+    std::vector<std::shared_ptr<HeatSource<dim>>> heat_sources;
+  };
+
   /**
    * Update the depostion cosine and sine from the Physics object to the
    * operator object.
    */
   void update_material_deposition_orientation();
 
+  /**
+   * Distribute the degrees of freedom and build the hanging node constraints
+   * without updating the operators.
+   */
+  void distribute_dofs();
+
+  /**
+   * Copy the material states of the ensemble members from the operators to
+   * the cells: the state of the selected member goes to MaterialProperty and
+   * the states of the other members go to _member_states.
+   */
+  void set_member_states_to_cells();
+
+  /**
+   * Copy the material states of the ensemble members from the cells to the
+   * operators. This is the inverse of set_member_states_to_cells().
+   */
+  void get_member_states_from_cells();
+
+  /**
+   * Send the flags of the quiet cells to the ghost cells.
+   */
+  void exchange_quiet_cells();
+
+  /**
+   * Compute the weight of the locally owned cells using the calibrated cost
+   * model. The weights are used to partition the mesh.
+   */
+  void update_cell_cost_weights();
+
+  /**
+   * Return the weight of a cell used to partition the mesh. Without cost
+   * model, the weight is the number of degrees of freedom of the cell.
+   */
+  unsigned int
+  get_cell_weight(typename dealii::DoFHandler<dim>::cell_iterator const &cell,
+                  dealii::FiniteElement<dim> const &future_fe) const;
+
   /**
    * Compute the right-hand side and apply the TermalOperator.
    */
@@ -169,6 +273,17 @@ private:
    * Current height of the object.
    */
   double _current_source_height = 0.;
+  /**
+   * If the flag is true, the heat sources are averaged along the scan path
+   * over each time step.
+   */
+  bool _swept_heat_sources = false;
+  /**
+   * Time at the beginning of the current time step. When the heat sources are
+   * swept, all the stages of the time step use the heat sources averaged over
+   * the time step.
+   */
+  double _time_step_start = 0.;
   /**
    * Type of boundary.
    */
@@ -195,9 +310,43 @@ private:
   dealii::hp::QCollection<1> _q_collection;
   /**
    * Object used to attach to each cell, a weight (used for load balancing)
-   * equal to the number of degrees of freedom associated with the cell.
+   * given by get_cell_weight().
    */
   dealii::parallel::CellWeights<dim> _cell_weights;
+  /**
+   * Model of the cost of the cells calibrated during the operator evaluations.
+   * The pointer is null if the load is balanced using the number of degrees of
+   * freedom.
+   */
+  std::shared_ptr<CellCostModel> _cell_cost_model;
+  /**
+   * Imbalance of the work between the processors above which the mesh is
+   * repartitioned.
+   */
+  double _load_imbalance_threshold = 0.;
+  /**
+   * Minimum number of time steps timed since the last mesh change before the
+   * imbalance is measured.
+   */
+  unsigned int _min_timed_steps = 10;
+  /**
+   * Number of time steps between two measurements of the imbalance.
+   */
+  unsigned int _time_steps_between_imbalance_checks = 10;
+  /**
+   * Number of time steps timed since the last mesh change. If the members
+   * share the mesh, the time steps of every member are counted.
+   */
+  unsigned int _n_timed_steps = 0;
+  /**
+   * Number of timed time steps at which the imbalance is measured next.
+   */
+  unsigned int _next_imbalance_check = 10;
+  /**
+   * Weight of the active cells computed with the cost model, indexed by the
+   * active cell index. The vector is empty if the weights are not up to date.
+   */
+  std::vector<unsigned int> _cell_cost_weights;
   /**
    * Cosine of the material deposition angles.
    */
@@ -212,11 +361,82 @@ private:
    * that has melted.
    */
   std::vector<bool> _has_melted;
+  /**
+   * Cosine and sine of the deposition angle of the elements scheduled for
+   * activation.
+   */
+  std::map<typename dealii::DoFHandler<dim>::active_cell_iterator,
+           std::pair<double, double>>
+      _scheduled_activations;
+  /**
+   * Ordering of the degrees of freedom applied every time the degrees of
+   * freedom are distributed.
+   */
+  DoFOrdering _dof_ordering = DoFOrdering::none;
+  /**
+   * This flag is true if the cells of the layers where material is deposited
+   * get degrees of freedom before the material is deposited. Until then, the
+   * cells are quiet. The quiet cells are activated without changing the mesh.
+   */
+  bool _quiet_element_activation = false;
+  /**
+   * Scaling of the thermal conductivity of the quiet cells.
+   */
+  double _quiet_element_scaling = 1e-6;
+  /**
+   * Flags of the quiet cells indexed by the active cell index. The flags are
+   * valid for the locally owned and the ghost cells.
+   */
+  std::shared_ptr<std::vector<bool>> _quiet_cells;
+  /**
+   * Position of the locally owned cells with material in _deposition_cos,
+   * _deposition_sin, and _has_melted, indexed by the active cell index.
+   */
+  std::vector<unsigned int> _material_cell_index;
+  /**
+   * Cosine and sine of the deposition angle of the quiet elements scheduled
+   * for activation.
+   */
+  std::map<typename dealii::DoFHandler<dim>::active_cell_iterator,
+           std::pair<double, double>>
+      _scheduled_quiet_activations;
+  /**
+   * Elements that get degrees of freedom with the next mesh change but that
+   * stay quiet.
+   */
+  std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator>
+      _scheduled_quiet_cells;
+  /**
+   * Temperature of the material activated by the next mesh change.
+   */
+  double _new_material_temperature = 0.;
+  /**
+   * State of the ensemble members sharing the mesh. The entry of the selected
+   * member is not used: its state lives in the operators, in _has_melted, in
+   * _new_material_temperature, and in _heat_sources. While the operators are
+   * up to date, the material states of the other members are stored in the
+   * operators too.
+   */
+  std::vector<MemberState> _member_states = std::vector<MemberState>(1);
+  /**
+   * Ensemble member whose state is used by the operators.
+   */
+  unsigned int _selected_member = 0;
+  /**
+   * This flag is true if the mesh has changed since the operators were last
+   * built.
+   */
+  bool _operators_outdated = false;
   /**
    * Associated material properties.
    */
   MaterialProperty<dim, p_order, MaterialStates, MemorySpaceType>
       &_material_properties;
+  /**
+   * Database of the heat sources. It is used to create the heat sources of the
+   * ensemble members sharing the mesh.
+   */
+  boost::property_tree::ptree _source_database;
   /**
    * Vector of heat sources.
    */
@@ -233,6 +453,14 @@ private:
    * Shared pointer to the underlying time stepping scheme.
    */
   std::unique_ptr<dealii::TimeStepping::RungeKutta<LA_Vector>> _time_stepping;
+  /**
+   * Time stepping scheme used to evolve the ensemble members sharing the mesh
+   * together. The pointer is null if the scheme is implicit or if the operator
+   * is applied on the device.
+   */
+  std::unique_ptr<dealii::TimeStepping::ExplicitRungeKutta<
+      dealii::LA::distributed::BlockVector<double>>>
+      _block_time_stepping;
 };
 
 template <int dim, int p_order, int fe_degree, typename MaterialStates,
@@ -348,6 +576,17 @@ ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
 {
   return _current_source_height;
 }
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+inline bool
+ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+               QuadratureType>::
+    is_quiet(typename dealii::DoFHandler<dim>::active_cell_iterator const &cell)
+        const
+{
+  return _quiet_cells && (*_quiet_cells)[cell->active_cell_index()];
+}
 } // namespace adamantine
 
 #endif
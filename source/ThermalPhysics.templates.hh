@@ -8,9 +8,11 @@
 #ifndef THERMAL_PHYSICS_TEMPLATES_HH
 #define THERMAL_PHYSICS_TEMPLATES_HH
 
+#include <CellDataPacker.hh>
 #include <CubeHeatSource.hh>
 #include <ElectronBeamHeatSource.hh>
 #include <GoldakHeatSource.hh>
+#include <HeatSourceIndex.hh>
 #include <ThermalOperator.hh>
 #include <ThermalOperatorDevice.hh>
 #include <ThermalPhysics.hh>
@@ -18,6 +20,7 @@
 
 #include <deal.II/base/geometry_info.h>
 #include <deal.II/base/index_set.h>
+#include <deal.II/base/mpi.h>
 #include <deal.II/base/quadrature_lib.h>
 #include <deal.II/distributed/cell_data_transfer.templates.h>
 #include <deal.II/distributed/solution_transfer.h>
@@ -25,6 +28,7 @@
 #include <deal.II/fe/fe_nothing.h>
 #include <deal.II/fe/fe_q.h>
 #include <deal.II/grid/filtered_iterator.h>
+#include <deal.II/grid/grid_tools.h>
 #include <deal.II/hp/fe_values.h>
 #include <deal.II/hp/q_collection.h>
 #include <deal.II/lac/precondition.h>
@@ -37,7 +41,9 @@
 #endif
 
 #include <algorithm>
+#include <cmath>
 #include <memory>
+#include <optional>
 
 namespace adamantine
 {
@@ -71,6 +77,82 @@ evaluate_thermal_physics_impl(
   return value;
 }
 
+template <int dim, bool use_table, int p_order, int fe_degree,
+          typename MaterialStates, typename MemorySpaceType,
+          std::enable_if_t<
+              std::is_same<MemorySpaceType, dealii::MemorySpace::Host>::value,
+              int> = 0>
+dealii::LA::distributed::BlockVector<double>
+evaluate_thermal_physics_block_impl(
+    std::shared_ptr<ThermalOperatorBase<dim, MemorySpaceType>> const
+        &thermal_operator,
+    std::vector<std::vector<std::shared_ptr<HeatSource<dim>>>> const
+        &block_heat_sources,
+    double const t, double const current_source_height,
+    dealii::LA::distributed::BlockVector<double> const &y,
+    std::vector<Timer> &timers)
+{
+  auto thermal_operator_host = std::dynamic_pointer_cast<ThermalOperator<
+      dim, use_table, p_order, fe_degree, MaterialStates, MemorySpaceType>>(
+      thermal_operator);
+
+  timers[evol_time_eval_th_ph].start();
+  thermal_operator_host->set_block_heat_sources(block_heat_sources);
+  thermal_operator_host->set_time_and_source_height(t, current_source_height);
+
+  dealii::LA::distributed::BlockVector<double> value;
+  value.reinit(y);
+  // Apply the Thermal Operator to all the members.
+  thermal_operator_host->vmult_add(value, y);
+
+  // Multiply by the inverse of the mass matrix.
+  auto const &inverse_mass_matrix =
+      *thermal_operator_host->get_inverse_mass_matrix();
+  for (unsigned int b = 0; b < value.n_blocks(); ++b)
+    value.block(b).scale(inverse_mass_matrix);
+
+  timers[evol_time_eval_th_ph].stop();
+
+  return value;
+}
+
+template <int dim>
+std::vector<std::shared_ptr<HeatSource<dim>>>
+create_heat_sources(boost::property_tree::ptree const &source_database)
+{
+  // PropertyTreeInput sources.n_beams
+  unsigned int const n_beams = source_database.get<unsigned int>("n_beams");
+  std::vector<std::shared_ptr<HeatSource<dim>>> heat_sources(n_beams);
+  for (unsigned int i = 0; i < n_beams; ++i)
+  {
+    // PropertyTreeInput sources.beam_X.type
+    boost::property_tree::ptree const &beam_database =
+        source_database.get_child("beam_" + std::to_string(i));
+    std::string type = beam_database.get<std::string>("type");
+    if (type == "goldak")
+    {
+      heat_sources[i] = std::make_shared<GoldakHeatSource<dim>>(beam_database);
+    }
+    else if (type == "electron_beam")
+    {
+      heat_sources[i] =
+          std::make_shared<ElectronBeamHeatSource<dim>>(beam_database);
+    }
+    else if (type == "cube")
+    {
+      heat_sources[i] = std::make_shared<CubeHeatSource<dim>>(beam_database);
+    }
+    else
+    {
+      ASSERT_THROW(false, "Error: Beam type '" +
+                              beam_database.get<std::string>("type") +
+                              "' not recognized.");
+    }
+  }
+
+  return heat_sources;
+}
+
 template <int dim, int fe_degree, typename MemorySpaceType,
           std::enable_if_t<
               std::is_same<MemorySpaceType, dealii::MemorySpace::Host>::value,
@@ -122,6 +204,9 @@ evaluate_thermal_physics_impl(
   // TODO do this on the GPU
   for (auto &beam : heat_sources)
     beam->update_time(t);
+  HeatSourceIndex<dim> heat_source_index;
+  heat_source_index.reinit(heat_sources, current_source_height);
+  std::vector<unsigned int> beam_ids;
   dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host> source(
       y.get_partitioner());
   source = 0.;
@@ -159,18 +244,25 @@ evaluate_thermal_physics_impl(
     dealii::FEValues<dim> const &fe_values =
         hp_fe_values.get_present_fe_values();
 
-    for (unsigned int i = 0; i < dofs_per_cell; ++i)
+    // Only evaluate the heat sources whose support overlaps the cell
+    heat_source_index.query(cell->bounding_box(), beam_ids);
+    if (beam_ids.size() > 0)
     {
-      for (unsigned int q = 0; q < n_q_points; ++q)
+      for (unsigned int i = 0; i < dofs_per_cell; ++i)
       {
-        double const inv_rho_cp = thermal_operator_dev->get_inv_rho_cp(cell, q);
-        double quad_pt_source = 0.;
-        dealii::Point<dim> const &q_point = fe_values.quadrature_point(q);
-        for (auto &beam : heat_sources)
-          quad_pt_source += beam->value(q_point, current_source_height);
-
-        cell_source[i] += inv_rho_cp * quad_pt_source *
-                          fe_values.shape_value(i, q) * fe_values.JxW(q);
+        for (unsigned int q = 0; q < n_q_points; ++q)
+        {
+          double const inv_rho_cp =
+              thermal_operator_dev->get_inv_rho_cp(cell, q);
+          double quad_pt_source = 0.;
+          dealii::Point<dim> const &q_point = fe_values.quadrature_point(q);
+          for (auto const beam_id : beam_ids)
+            quad_pt_source +=
+                heat_sources[beam_id]->value(q_point, current_source_height);
+
+          cell_source[i] += inv_rho_cp * quad_pt_source *
+                            fe_values.shape_value(i, q) * fe_values.JxW(q);
+        }
       }
     }
 
@@ -275,7 +367,9 @@ ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
       _dof_handler(_geometry.get_triangulation()),
       _cell_weights(
           _dof_handler,
-          dealii::parallel::CellWeights<dim>::ndofs_weighting({1, 1})),
+          [this](typename dealii::DoFHandler<dim>::cell_iterator const &cell,
+                 dealii::FiniteElement<dim> const &future_fe)
+          { return get_cell_weight(cell, future_fe); }),
       _material_properties(material_properties)
 {
   // Create the FECollection
@@ -287,37 +381,10 @@ ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
   _q_collection.push_back(QuadratureType(fe_degree + 1));
 
   // Create the heat sources
-  boost::property_tree::ptree const &source_database =
-      database.get_child("sources");
-  // PropertyTreeInput sources.n_beams
-  unsigned int const n_beams = source_database.get<unsigned int>("n_beams");
-  _heat_sources.resize(n_beams);
-  for (unsigned int i = 0; i < n_beams; ++i)
-  {
-    // PropertyTreeInput sources.beam_X.type
-    boost::property_tree::ptree const &beam_database =
-        source_database.get_child("beam_" + std::to_string(i));
-    std::string type = beam_database.get<std::string>("type");
-    if (type == "goldak")
-    {
-      _heat_sources[i] = std::make_shared<GoldakHeatSource<dim>>(beam_database);
-    }
-    else if (type == "electron_beam")
-    {
-      _heat_sources[i] =
-          std::make_shared<ElectronBeamHeatSource<dim>>(beam_database);
-    }
-    else if (type == "cube")
-    {
-      _heat_sources[i] = std::make_shared<CubeHeatSource<dim>>(beam_database);
-    }
-    else
-    {
-      ASSERT_THROW(false, "Error: Beam type '" +
-                              beam_database.get<std::string>("type") +
-                              "' not recognized.");
-    }
-  }
+  _source_database = database.get_child("sources");
+  // PropertyTreeInput sources.swept_heat_source
+  _swept_heat_sources = _source_database.get("swept_heat_source", false);
+  _heat_sources = create_heat_sources<dim>(_source_database);
 
   // Create the boundary condition type
   // PropertyTreeInput boundary.type
@@ -392,6 +459,47 @@ ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
     }
   }
 
+  // Create the model of the cost of the cells if the load is balanced using
+  // measured costs.
+  // PropertyTreeInput refinement.load_imbalance_threshold
+  _load_imbalance_threshold =
+      database.get("refinement.load_imbalance_threshold", 0.);
+  if (_load_imbalance_threshold > 0.)
+  {
+    _cell_cost_model = std::make_shared<CellCostModel>(communicator);
+    _thermal_operator->set_cell_cost_model(_cell_cost_model);
+    // PropertyTreeInput refinement.load_imbalance_min_time_steps
+    _min_timed_steps =
+        database.get("refinement.load_imbalance_min_time_steps", 10u);
+    // PropertyTreeInput refinement.time_steps_between_load_imbalance_checks
+    _time_steps_between_imbalance_checks = database.get(
+        "refinement.time_steps_between_load_imbalance_checks", 10u);
+    _next_imbalance_check = _min_timed_steps;
+  }
+
+  // Renumber the degrees of freedom to improve the data locality of the
+  // matrix-free loops.
+  // PropertyTreeInput discretization.thermal.dof_renumbering
+  _dof_ordering = parse_dof_ordering(
+      database.get("discretization.thermal.dof_renumbering", "none"));
+
+  // Give degrees of freedom to the layers where material is deposited before
+  // the material is deposited.
+  // PropertyTreeInput geometry.quiet_element_activation
+  _quiet_element_activation =
+      database.get("geometry.quiet_element_activation", false);
+  if (_quiet_element_activation)
+  {
+    ASSERT_THROW(
+        (std::is_same_v<MemorySpaceType, dealii::MemorySpace::Host>),
+        "Error: Quiet element activation is only supported on the host.");
+    // PropertyTreeInput geometry.quiet_element_scaling
+    _quiet_element_scaling =
+        database.get("geometry.quiet_element_scaling", 1e-6);
+    _quiet_cells = std::make_shared<std::vector<bool>>();
+    _thermal_operator->set_quiet_cells(_quiet_cells, _quiet_element_scaling);
+  }
+
   // Create the time stepping scheme
   boost::property_tree::ptree const &time_stepping_database =
       database.get_child("time_stepping");
@@ -399,18 +507,13 @@ ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
   std::string method = time_stepping_database.get<std::string>("method");
   std::transform(method.begin(), method.end(), method.begin(),
                  [](unsigned char c) { return std::tolower(c); });
+  std::optional<dealii::TimeStepping::runge_kutta_method> explicit_method;
   if (method.compare("forward_euler") == 0)
-    _time_stepping =
-        std::make_unique<dealii::TimeStepping::ExplicitRungeKutta<LA_Vector>>(
-            dealii::TimeStepping::FORWARD_EULER);
+    explicit_method = dealii::TimeStepping::FORWARD_EULER;
   else if (method.compare("rk_third_order") == 0)
-    _time_stepping =
-        std::make_unique<dealii::TimeStepping::ExplicitRungeKutta<LA_Vector>>(
-            dealii::TimeStepping::RK_THIRD_ORDER);
+    explicit_method = dealii::TimeStepping::RK_THIRD_ORDER;
   else if (method.compare("rk_fourth_order") == 0)
-    _time_stepping =
-        std::make_unique<dealii::TimeStepping::ExplicitRungeKutta<LA_Vector>>(
-            dealii::TimeStepping::RK_CLASSIC_FOURTH_ORDER);
+    explicit_method = dealii::TimeStepping::RK_CLASSIC_FOURTH_ORDER;
   else if (method.compare("backward_euler") == 0)
   {
     _time_stepping =
@@ -440,6 +543,20 @@ ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
     _implicit_method = true;
   }
 
+  if (explicit_method)
+  {
+    _time_stepping =
+        std::make_unique<dealii::TimeStepping::ExplicitRungeKutta<LA_Vector>>(
+            *explicit_method);
+    // The ensemble members sharing the mesh are evolved together on the host.
+    if constexpr (std::is_same_v<MemorySpaceType, dealii::MemorySpace::Host>)
+    {
+      _block_time_stepping =
+          std::make_unique<dealii::TimeStepping::ExplicitRungeKutta<
+              dealii::LA::distributed::BlockVector<double>>>(*explicit_method);
+    }
+  }
+
   // If the time stepping scheme is implicit, set the parameters for the solver
   // and create the implicit operator.
   if (_implicit_method == true)
@@ -511,6 +628,9 @@ void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
                     QuadratureType>::setup()
 {
   setup_dofs();
+  if (_quiet_cells)
+    _quiet_cells->assign(_dof_handler.get_triangulation().n_active_cells(),
+                         false);
   update_material_deposition_orientation();
   compute_inverse_mass_matrix();
   get_state_from_material_properties();
@@ -520,18 +640,67 @@ template <int dim, int p_order, int fe_degree, typename MaterialStates,
           typename MemorySpaceType, typename QuadratureType>
 void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
                     QuadratureType>::setup_dofs()
+{
+  distribute_dofs();
+  _thermal_operator->reinit(_dof_handler, _affine_constraints, _q_collection);
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::distribute_dofs()
 {
   _dof_handler.distribute_dofs(_fe_collection);
-  dealii::IndexSet locally_relevant_dofs;
-  dealii::DoFTools::extract_locally_relevant_dofs(_dof_handler,
-                                                  locally_relevant_dofs);
-  _affine_constraints.clear();
-  _affine_constraints.reinit(locally_relevant_dofs);
-  dealii::DoFTools::make_hanging_node_constraints(_dof_handler,
-                                                  _affine_constraints);
-  _affine_constraints.close();
+  auto make_constraints = [&]()
+  {
+    dealii::IndexSet locally_relevant_dofs;
+    dealii::DoFTools::extract_locally_relevant_dofs(_dof_handler,
+                                                    locally_relevant_dofs);
+    _affine_constraints.clear();
+    _affine_constraints.reinit(locally_relevant_dofs);
+    dealii::DoFTools::make_hanging_node_constraints(_dof_handler,
+                                                    _affine_constraints);
+    _affine_constraints.close();
+  };
+  make_constraints();
+  if (_dof_ordering != DoFOrdering::none)
+  {
+    // The constraints use the old numbering and they need to be rebuilt.
+    renumber_dofs(_dof_ordering, _dof_handler, _affine_constraints);
+    make_constraints();
+  }
 
-  _thermal_operator->reinit(_dof_handler, _affine_constraints, _q_collection);
+  if (_quiet_cells)
+  {
+    _material_cell_index.assign(
+        _dof_handler.get_triangulation().n_active_cells(),
+        dealii::numbers::invalid_unsigned_int);
+    unsigned int material_cell_id = 0;
+    for (auto const &cell : dealii::filter_iterators(
+             _dof_handler.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell(),
+             dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
+    {
+      _material_cell_index[cell->active_cell_index()] = material_cell_id;
+      ++material_cell_id;
+    }
+  }
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::exchange_quiet_cells()
+{
+  using active_cell_iterator =
+      typename dealii::DoFHandler<dim>::active_cell_iterator;
+  dealii::GridTools::exchange_cell_data_to_ghosts<bool,
+                                                  dealii::DoFHandler<dim>>(
+      _dof_handler,
+      [this](active_cell_iterator const &cell) -> std::optional<bool>
+      { return (*_quiet_cells)[cell->active_cell_index()]; },
+      [this](active_cell_iterator const &cell, bool const quiet)
+      { (*_quiet_cells)[cell->active_cell_index()] = quiet; });
 }
 
 template <int dim, int p_order, int fe_degree, typename MaterialStates,
@@ -608,9 +777,7 @@ template <int dim, int p_order, int fe_degree, typename MaterialStates,
 void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
                     QuadratureType>::
     add_material(
-        std::vector<std::vector<
-            typename dealii::DoFHandler<dim>::active_cell_iterator>> const
-            &elements_to_activate,
+        ElementsToActivate<dim> const &elements_to_activate,
         std::vector<double> const &new_deposition_cos,
         std::vector<double> const &new_deposition_sin,
         std::vector<bool> &new_has_melted, unsigned int const activation_start,
@@ -622,106 +789,217 @@ void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
   CALI_CXX_MARK_FUNCTION;
 #endif
 
-  // Update the material state from the ThermalOperator to MaterialProperty
-  // because, for now, we need to use state from MaterialProperty to perform the
-  // transfer to the refined mesh.
-  set_state_to_material_properties();
-
-  _thermal_operator->clear();
-  // The data on each cell is stored in the following order: solution, direction
-  // of deposition (cosine and sine), prior melting indictor, and state ratio.
-  std::vector<std::vector<double>> data_to_transfer;
-  unsigned int const n_dofs_per_cell = _dof_handler.get_fe().n_dofs_per_cell();
-  unsigned int const direction_data_size = 2;
-  unsigned int const phase_history_data_size = 1;
-  unsigned int constexpr n_material_states = MaterialStates::n_material_states;
-  unsigned int const data_size_per_cell =
-      n_dofs_per_cell + direction_data_size + phase_history_data_size +
-      n_material_states;
-  dealii::Vector<double> cell_solution(n_dofs_per_cell);
-  std::vector<double> dummy_cell_data(data_size_per_cell,
-                                      std::numeric_limits<double>::infinity());
-
-  solution.update_ghost_values();
-
-  // We need to move the solution on the host because we cannot use
-  // CellDataTransfer on the device.
-  dealii::IndexSet rw_index_set = solution.locally_owned_elements();
-  rw_index_set.add_indices(solution.get_partitioner()->ghost_indices());
-  dealii::LA::ReadWriteVector<double> rw_solution(rw_index_set);
-  rw_solution.import(solution, dealii::VectorOperation::insert);
+  bool const scheduled = schedule_material(
+      elements_to_activate, new_deposition_cos, new_deposition_sin,
+      activation_start, activation_end, new_material_temperature);
+  ASSERT_THROW(scheduled, "Error: Some of the cells to activate are flagged "
+                          "for refinement or coarsening.");
 
-  auto state_host = Kokkos::create_mirror_view_and_copy(
-      Kokkos::HostSpace{}, _material_properties.get_state());
-  unsigned int locally_owned_cell_id = 0;
-  unsigned int activated_cell_id = 0;
-  unsigned int cell_id = 0;
-  std::map<typename dealii::DoFHandler<dim>::active_cell_iterator, int>
-      cell_to_id;
-  for (auto const &cell : _dof_handler.active_cell_iterators())
+  // The deposited material is considered to have melted.
+  for (unsigned int i = activation_start; i < activation_end; ++i)
   {
-    if (cell->is_locally_owned())
+    unsigned int const box = i - elements_to_activate.first_box;
+    for (unsigned int k = elements_to_activate.offsets[box];
+         k < elements_to_activate.offsets[box + 1]; ++k)
     {
-      if (cell->active_fe_index() == 0)
-      {
-        std::vector<double> cell_data(
-            direction_data_size + phase_history_data_size + n_material_states);
-        cell->get_dof_values(rw_solution, cell_solution);
-        cell_data.insert(cell_data.begin(), cell_solution.begin(),
-                         cell_solution.end());
-        cell_data[n_dofs_per_cell] = _deposition_cos[activated_cell_id];
-        cell_data[n_dofs_per_cell + 1] = _deposition_sin[activated_cell_id];
-
-        if (_has_melted[activated_cell_id])
-          cell_data[n_dofs_per_cell + direction_data_size] = 1.0;
-        else
-          cell_data[n_dofs_per_cell + direction_data_size] = 0.0;
+      if (elements_to_activate.get_cell(_dof_handler, k)->active_fe_index() !=
+          0)
+        new_has_melted[i] = true;
+    }
+  }
 
-        for (unsigned int i = 0; i < n_material_states; ++i)
-          cell_data[n_dofs_per_cell + direction_data_size +
-                    phase_history_data_size + i] =
-              state_host(i, locally_owned_cell_id);
-        data_to_transfer.push_back(cell_data);
+  execute_mesh_changes(solution, true);
+}
 
-        ++activated_cell_id;
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+bool ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::
+    schedule_material(ElementsToActivate<dim> const &elements_to_activate,
+                      std::vector<double> const &new_deposition_cos,
+                      std::vector<double> const &new_deposition_sin,
+                      unsigned int const activation_start,
+                      unsigned int const activation_end,
+                      double const new_material_temperature)
+{
+  ASSERT((activation_start >= elements_to_activate.first_box) &&
+             (activation_end <= elements_to_activate.first_box +
+                                    elements_to_activate.n_boxes()),
+         "The cells to activate do not cover the deposition boxes.");
+
+  // The flags set on the Triangulation are only final after the smoothing and
+  // the 2:1 balance are applied.
+  dealii::parallel::distributed::Triangulation<dim> &triangulation =
+      dynamic_cast<dealii::parallel::distributed::Triangulation<dim> &>(
+          const_cast<dealii::Triangulation<dim> &>(
+              _dof_handler.get_triangulation()));
+  triangulation.prepare_coarsening_and_refinement();
+
+  // A cell cannot be refined or coarsened while it is activated because the
+  // cells to activate are only valid on the current mesh.
+  bool conflict = false;
+  for (unsigned int i = activation_start; i < activation_end; ++i)
+  {
+    unsigned int const box = i - elements_to_activate.first_box;
+    for (unsigned int k = elements_to_activate.offsets[box];
+         k < elements_to_activate.offsets[box + 1]; ++k)
+    {
+      auto const cell = elements_to_activate.get_cell(_dof_handler, k);
+      if ((cell->active_fe_index() != 0) &&
+          (cell->refine_flag_set() || cell->coarsen_flag_set()))
+        conflict = true;
+    }
+  }
+  if (dealii::Utilities::MPI::max(static_cast<int>(conflict),
+                                  _dof_handler.get_communicator()) == 1)
+    return false;
+
+  for (unsigned int i = activation_start; i < activation_end; ++i)
+  {
+    unsigned int const box = i - elements_to_activate.first_box;
+    for (unsigned int k = elements_to_activate.offsets[box];
+         k < elements_to_activate.offsets[box + 1]; ++k)
+    {
+      auto const cell = elements_to_activate.get_cell(_dof_handler, k);
+      if (cell->active_fe_index() != 0)
+      {
+        cell->set_future_fe_index(0);
+        _scheduled_activations[cell] =
+            std::make_pair(new_deposition_cos[i], new_deposition_sin[i]);
       }
-      else
+      else if (is_quiet(cell))
       {
-        std::vector<double> cell_data = dummy_cell_data;
-        for (unsigned int i = 0; i < n_material_states; ++i)
-          cell_data[n_dofs_per_cell + direction_data_size +
-                    phase_history_data_size + i] =
-              state_host(i, locally_owned_cell_id);
-        data_to_transfer.push_back(cell_data);
+        _scheduled_quiet_activations[cell] =
+            std::make_pair(new_deposition_cos[i], new_deposition_sin[i]);
       }
-      ++locally_owned_cell_id;
     }
-    else
+  }
+  _new_material_temperature = new_material_temperature;
+
+  // When material is deposited in a layer without degrees of freedom, the
+  // whole layer gets degrees of freedom. The rest of the layer stays quiet
+  // until material is deposited on it.
+  if (_quiet_element_activation)
+  {
+    double layer_bottom = std::numeric_limits<double>::max();
+    double layer_top = std::numeric_limits<double>::lowest();
+    for (auto const &[cell, direction] : _scheduled_activations)
     {
-      data_to_transfer.push_back(dummy_cell_data);
+      auto const [lower_point, upper_point] =
+          cell->bounding_box().get_boundary_points();
+      layer_bottom = std::min(layer_bottom, lower_point[axis<dim>::z]);
+      layer_top = std::max(layer_top, upper_point[axis<dim>::z]);
+    }
+    layer_bottom = dealii::Utilities::MPI::min(layer_bottom,
+                                               _dof_handler.get_communicator());
+    layer_top =
+        dealii::Utilities::MPI::max(layer_top, _dof_handler.get_communicator());
+
+    // The cells that are coarsened are skipped because their siblings may not
+    // be in the layer.
+    for (auto const &cell : dealii::filter_iterators(
+             _dof_handler.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell(),
+             dealii::IteratorFilters::ActiveFEIndexEqualTo(1)))
+    {
+      double const z = cell->center()[axis<dim>::z];
+      if ((cell->future_fe_index() != 0) && (z > layer_bottom) &&
+          (z < layer_top) && !cell->coarsen_flag_set())
+      {
+        cell->set_future_fe_index(0);
+        _scheduled_quiet_cells.push_back(cell);
+      }
     }
-    cell_to_id[cell] = cell_id;
-    ++cell_id;
   }
 
-  // Activate elements by updating the fe_index
-  for (unsigned int i = activation_start; i < activation_end; ++i)
+  return true;
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::
+    execute_mesh_changes(
+        dealii::LA::distributed::Vector<double, MemorySpaceType> &solution,
+        bool const update_operators)
+{
+  execute_mesh_changes(std::vector<LA_Vector *>{&solution}, update_operators);
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::
+    execute_mesh_changes(
+        std::vector<dealii::LA::distributed::Vector<double, MemorySpaceType> *>
+            const &solutions,
+        bool const update_operators)
+{
+#ifdef ADAMANTINE_WITH_CALIPER
+  CALI_CXX_MARK_FUNCTION;
+#endif
+
+  unsigned int const n_members = _member_states.size();
+  ASSERT(solutions.size() == n_members,
+         "There must be one solution per ensemble member.");
+
+  // Update the material states from the ThermalOperator to the cells because,
+  // for now, we need to use the states of the cells to perform the transfer to
+  // the new mesh. If the operators are outdated, the cells already have the
+  // latest states.
+  if (!_operators_outdated)
+    set_member_states_to_cells();
+
+  _thermal_operator->clear();
+  // Pack the material state, the direction of deposition, the prior melting
+  // indicator, and the FE index of each cell of every member. The FE index is
+  // used to find the cells that had material before the mesh change. The cells
+  // that are activated get their direction of deposition and the deposited
+  // material is considered to have melted.
+  using Packer = CellDataPacker<dim, MaterialStates, MemorySpaceType>;
+  using Payload = typename Packer::Payload;
+  std::vector<Packer> cell_data_packers;
+  cell_data_packers.reserve(n_members);
+  for (unsigned int m = 0; m < n_members; ++m)
   {
-    for (auto const &cell : elements_to_activate[i])
+    bool const selected = (m == _selected_member);
+    auto &cell_data_packer = cell_data_packers.emplace_back(_dof_handler);
+    cell_data_packer.pack(
+        selected ? _material_properties.get_state() : _member_states[m].state,
+        _deposition_cos, _deposition_sin,
+        selected ? _has_melted : _member_states[m].has_melted);
+    for (auto const &[cell, direction] : _scheduled_activations)
     {
-      if (cell->active_fe_index() != 0)
+      auto &payload = cell_data_packer[cell];
+      payload[Payload::cos] = direction.first;
+      payload[Payload::sin] = direction.second;
+      payload[Payload::has_melted] = 1.;
+    }
+    if (_quiet_cells)
+    {
+      for (auto const &cell : dealii::filter_iterators(
+               _dof_handler.active_cell_iterators(),
+               dealii::IteratorFilters::LocallyOwnedCell(),
+               dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
       {
-        cell->set_future_fe_index(0);
-        data_to_transfer[cell_to_id[cell]][n_dofs_per_cell] =
-            new_deposition_cos[i];
-        data_to_transfer[cell_to_id[cell]][n_dofs_per_cell + 1] =
-            new_deposition_sin[i];
-
-        if (data_to_transfer[cell_to_id[cell]]
-                            [n_dofs_per_cell + direction_data_size] > 0.5)
-          new_has_melted[i] = true;
-        else
-          new_has_melted[i] = false;
+        if (is_quiet(cell))
+          cell_data_packer[cell][Payload::quiet] = 1.;
+      }
+      for (auto const &[cell, direction] : _scheduled_quiet_activations)
+      {
+        auto &payload = cell_data_packer[cell];
+        payload[Payload::cos] = direction.first;
+        payload[Payload::sin] = direction.second;
+        payload[Payload::has_melted] = 1.;
+        payload[Payload::quiet] = 0.;
+      }
+      for (auto const &cell : _scheduled_quiet_cells)
+      {
+        auto &payload = cell_data_packer[cell];
+        payload[Payload::cos] = 1.;
+        payload[Payload::sin] = 0.;
+        payload[Payload::has_melted] = 0.;
+        payload[Payload::quiet] = 1.;
       }
     }
   }
@@ -731,10 +1009,53 @@ void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
           const_cast<dealii::Triangulation<dim> &>(
               _dof_handler.get_triangulation()));
   triangulation.prepare_coarsening_and_refinement();
-  dealii::parallel::distributed::CellDataTransfer<
-      dim, dim, std::vector<std::vector<double>>>
-      cell_data_trans(triangulation);
-  cell_data_trans.prepare_for_coarsening_and_refinement(data_to_transfer);
+
+  // Prepare the transfer of the solutions. The activated cells go from
+  // FE_Nothing to FE_Q and their values are set after the transfer.
+  using LA_Vector_Host =
+      dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host>;
+  dealii::parallel::distributed::SolutionTransfer<dim, LA_Vector_Host>
+      solution_transfer(_dof_handler);
+  std::vector<LA_Vector_Host> solutions_host(n_members);
+  std::vector<LA_Vector_Host const *> transferred_solutions(n_members);
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    if constexpr (std::is_same_v<MemorySpaceType, dealii::MemorySpace::Host>)
+    {
+      // We need to apply the constraints before the mesh transfer
+      _affine_constraints.distribute(*solutions[m]);
+      // We need to update the ghost values before we can do the interpolation
+      // on the new mesh.
+      solutions[m]->update_ghost_values();
+      transferred_solutions[m] = solutions[m];
+    }
+    else
+    {
+      solutions_host[m].reinit(solutions[m]->get_partitioner());
+      solutions_host[m].import(*solutions[m], dealii::VectorOperation::insert);
+      _affine_constraints.distribute(solutions_host[m]);
+      solutions_host[m].update_ghost_values();
+      transferred_solutions[m] = &solutions_host[m];
+    }
+  }
+  solution_transfer.prepare_for_coarsening_and_refinement(
+      transferred_solutions);
+
+  std::vector<std::unique_ptr<dealii::parallel::distributed::CellDataTransfer<
+      dim, dim, typename Packer::Buffer>>>
+      cell_data_transfers;
+  for (auto &cell_data_packer : cell_data_packers)
+  {
+    auto &cell_data_trans = cell_data_transfers.emplace_back(
+        std::make_unique<dealii::parallel::distributed::CellDataTransfer<
+            dim, dim, typename Packer::Buffer>>(triangulation));
+    cell_data_trans->prepare_for_coarsening_and_refinement(
+        cell_data_packer.get_buffer());
+  }
+
+  // The weights of the cells are evaluated when the mesh is repartitioned.
+  if (_cell_cost_model)
+    update_cell_cost_weights();
 
 #ifdef ADAMANTINE_WITH_CALIPER
   CALI_MARK_BEGIN("refine triangulation");
@@ -743,84 +1064,418 @@ void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
 #ifdef ADAMANTINE_WITH_CALIPER
   CALI_MARK_END("refine triangulation");
 #endif
+  _scheduled_activations.clear();
+  _scheduled_quiet_activations.clear();
+  _scheduled_quiet_cells.clear();
+  if (_cell_cost_model)
+  {
+    // The timings measured on the old partition are meaningless now.
+    _cell_cost_model->reset();
+    _cell_cost_weights.clear();
+    _n_timed_steps = 0;
+    _next_imbalance_check = _min_timed_steps;
+  }
 
-  setup_dofs();
+  distribute_dofs();
 
   // Update MaterialProperty DoFHandler and resize the state vectors
   _material_properties.reinit_dofs();
 
-  // Recompute the inverse of the mass matrix
-  compute_inverse_mass_matrix();
+  // Interpolate the solutions on the new mesh
+  dealii::IndexSet const locally_owned_dofs = _dof_handler.locally_owned_dofs();
+  dealii::IndexSet const locally_relevant_dofs =
+      dealii::DoFTools::extract_locally_relevant_dofs(_dof_handler);
+  std::vector<LA_Vector_Host *> interpolated_solutions(n_members);
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    solutions_host[m].reinit(locally_owned_dofs, locally_relevant_dofs,
+                             _dof_handler.get_communicator());
+    interpolated_solutions[m] = &solutions_host[m];
+  }
+  solution_transfer.interpolate(interpolated_solutions);
 
-  initialize_dof_vector(std::numeric_limits<double>::infinity(), solution);
-  rw_index_set = solution.locally_owned_elements();
-  rw_solution.reinit(rw_index_set);
-  for (auto val : solution.locally_owned_elements())
-    rw_solution[val] = new_material_temperature;
-
-  // Unpack the material state and repopulate the material state
-  std::vector<std::vector<double>> transferred_data(
-      triangulation.n_active_cells(), std::vector<double>(data_size_per_cell));
-  cell_data_trans.unpack(transferred_data);
-  auto state = _material_properties.get_state();
-  state_host = Kokkos::create_mirror_view(state);
-  _deposition_cos.clear();
-  _deposition_sin.clear();
-  _has_melted.clear();
-  cell_id = 0;
-  locally_owned_cell_id = 0;
-  std::vector<dealii::types::global_dof_index> local_dof_indices(
-      n_dofs_per_cell);
-  for (auto const &cell : _dof_handler.active_cell_iterators())
+  // Unpack the material state and repopulate the material state. The states of
+  // the members that are not selected are resized like the state in
+  // MaterialProperty.
+  auto const state = _material_properties.get_state();
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    bool const selected = (m == _selected_member);
+    auto &member_state = _member_states[m];
+    if (n_members > 1)
+      Kokkos::realloc(member_state.state, state.extent(0), state.extent(1));
+    cell_data_transfers[m]->unpack(cell_data_packers[m].prepare_unpack());
+    cell_data_packers[m].unpack(
+        selected ? state : member_state.state, _deposition_cos,
+        _deposition_sin, selected ? _has_melted : member_state.has_melted);
+  }
+#ifdef ADAMANTINE_DEBUG
+  // Check that we are not losing material
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    auto const member_state_host = Kokkos::create_mirror_view_and_copy(
+        Kokkos::HostSpace{},
+        (m == _selected_member) ? state : _member_states[m].state);
+    for (unsigned int cell_id = 0; cell_id < member_state_host.extent(1);
+         ++cell_id)
+    {
+      double material_ratio = 0.;
+      for (unsigned int i = 0; i < member_state_host.extent(0); ++i)
+        material_ratio += member_state_host(i, cell_id);
+      ASSERT(std::abs(material_ratio - 1.) < 1e-14, "Material is lost.");
+    }
+  }
+#endif
+  // The mesh, the quiet cells, and the activated cells are the same for all
+  // the members.
+  auto const &cell_data_packer = cell_data_packers[0];
+  if (_quiet_cells)
+  {
+    _quiet_cells->assign(triangulation.n_active_cells(), false);
+    for (auto const &cell : dealii::filter_iterators(
+             _dof_handler.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell(),
+             dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
+    {
+      (*_quiet_cells)[cell->active_cell_index()] =
+          cell_data_packer[cell][Payload::quiet] > 0.5;
+    }
+    exchange_quiet_cells();
+  }
+  // The degrees of freedom of the activated cells are set to the temperature of
+  // the new material, the ones of the cells that had material keep the
+  // transferred values.
+  std::vector<dealii::types::global_dof_index> transferred_dofs;
+  std::vector<dealii::types::global_dof_index> local_dof_indices;
+  for (auto const &cell : dealii::filter_iterators(
+           _dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell(),
+           dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
   {
-    if (cell->is_locally_owned())
+    if (cell_data_packer[cell][Payload::fe_index] == 0.)
     {
-      if (transferred_data[cell_id][0] !=
-          std::numeric_limits<double>::infinity())
+      local_dof_indices.resize(cell->get_fe().n_dofs_per_cell());
+      cell->get_dof_indices(local_dof_indices);
+      for (auto const dof : local_dof_indices)
       {
-        std::copy(transferred_data[cell_id].begin(),
-                  transferred_data[cell_id].begin() + n_dofs_per_cell,
-                  cell_solution.begin());
-        cell->get_dof_indices(local_dof_indices);
-        for (unsigned int i = 0; i < n_dofs_per_cell; ++i)
-        {
-          if (rw_index_set.is_element(local_dof_indices[i]))
-          {
-            rw_solution[local_dof_indices[i]] = cell_solution(i);
-          }
-        }
+        if (locally_owned_dofs.is_element(dof))
+          transferred_dofs.push_back(dof);
       }
+    }
+  }
 
-      if (cell->active_fe_index() == 0)
+  if (update_operators)
+  {
+    _thermal_operator->reinit(_dof_handler, _affine_constraints,
+                              _q_collection);
+    compute_inverse_mass_matrix();
+    _thermal_operator->set_material_deposition_orientation(_deposition_cos,
+                                                           _deposition_sin);
+    get_member_states_from_cells();
+    _operators_outdated = false;
+  }
+  else
+  {
+    _operators_outdated = true;
+  }
+
+  dealii::LA::ReadWriteVector<double> rw_solution(locally_owned_dofs);
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    double const new_material_temperature =
+        (m == _selected_member) ? _new_material_temperature
+                                : _member_states[m].new_material_temperature;
+    for (auto val : locally_owned_dofs)
+      rw_solution[val] = new_material_temperature;
+    for (auto const dof : transferred_dofs)
+      rw_solution[dof] = solutions_host[m][dof];
+
+    // If the operators are outdated, the MatrixFree object is not available
+    // and we use a partitioner based on the DoFHandler.
+    LA_Vector &solution = *solutions[m];
+    if (update_operators)
+      initialize_dof_vector(0., solution);
+    else
+      solution.reinit(locally_owned_dofs, locally_relevant_dofs,
+                      _dof_handler.get_communicator());
+
+    // Communicate the results.
+    solution.zero_out_ghost_values();
+    solution.import(rw_solution, dealii::VectorOperation::insert);
+    solution.update_ghost_values();
+  }
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::set_n_members(unsigned int const n_members)
+{
+  ASSERT(n_members > 0, "There must be at least one ensemble member.");
+  ASSERT(!_operators_outdated,
+         "The operators need to be updated after the mesh changes.");
+
+  // All the members start from the state of the selected member. The material
+  // states are stored in the operators and they are only copied to the cells
+  // when the mesh changes. Each member has its own heat sources so that their
+  // parameters can differ. The heat sources of the selected member are
+  // _heat_sources.
+  _selected_member = 0;
+  _member_states.assign(n_members, MemberState());
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    auto &member_state = _member_states[m];
+    member_state.has_melted = _has_melted;
+    member_state.new_material_temperature = _new_material_temperature;
+    if (m != _selected_member)
+      member_state.heat_sources = create_heat_sources<dim>(_source_database);
+    _thermal_operator->store_block_state(m);
+  }
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::select_member(unsigned int const member)
+{
+  ASSERT(member < _member_states.size(), "Unknown ensemble member.");
+  if (member == _selected_member)
+    return;
+
+  auto &stored_member = _member_states[_selected_member];
+  auto &loaded_member = _member_states[member];
+  if (_operators_outdated)
+  {
+    // The operators do not match the mesh, so the material states are stored
+    // per cell.
+    auto const state = _material_properties.get_state();
+    Kokkos::deep_copy(stored_member.state, state);
+    Kokkos::deep_copy(state, loaded_member.state);
+  }
+  else
+  {
+    // Swap the state tables of the operators. The cells are not updated.
+    _thermal_operator->store_block_state(_selected_member);
+    _thermal_operator->load_block_state(member);
+  }
+
+  stored_member.has_melted = std::move(_has_melted);
+  _has_melted = std::move(loaded_member.has_melted);
+  stored_member.new_material_temperature = _new_material_temperature;
+  _new_material_temperature = loaded_member.new_material_temperature;
+  stored_member.heat_sources = std::move(_heat_sources);
+  _heat_sources = std::move(loaded_member.heat_sources);
+  _thermal_operator->set_heat_sources(_heat_sources);
+  _selected_member = member;
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::set_member_states_to_cells()
+{
+  unsigned int const n_members = _member_states.size();
+  if (n_members > 1)
+  {
+    // MaterialProperty is used as a buffer to convert the state tables of the
+    // operators to the states of the cells.
+    auto const state = _material_properties.get_state();
+    _thermal_operator->store_block_state(_selected_member);
+    for (unsigned int m = 0; m < n_members; ++m)
+    {
+      if (m == _selected_member)
+        continue;
+      _thermal_operator->load_block_state(m);
+      set_state_to_material_properties();
+      auto &member_state = _member_states[m];
+      Kokkos::realloc(member_state.state, state.extent(0), state.extent(1));
+      Kokkos::deep_copy(member_state.state, state);
+    }
+    _thermal_operator->load_block_state(_selected_member);
+  }
+  set_state_to_material_properties();
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::get_member_states_from_cells()
+{
+  get_state_from_material_properties();
+  unsigned int const n_members = _member_states.size();
+  if (n_members > 1)
+  {
+    // The state of the selected member is saved in the operators before
+    // MaterialProperty is used as a buffer for the other members. The state of
+    // the selected member is copied back to MaterialProperty at the end.
+    auto const state = _material_properties.get_state();
+    _thermal_operator->store_block_state(_selected_member);
+    for (unsigned int m = 0; m < n_members; ++m)
+    {
+      if (m == _selected_member)
+        continue;
+      Kokkos::deep_copy(state, _member_states[m].state);
+      get_state_from_material_properties();
+      _thermal_operator->store_block_state(m);
+    }
+    _thermal_operator->load_block_state(_selected_member);
+    set_state_to_material_properties();
+  }
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+bool ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::is_repartition_needed()
+{
+  // The timings of a few time steps are too noisy to be compared to the
+  // threshold. All the processors time the same number of time steps, so they
+  // all skip the communication.
+  if (!_cell_cost_model || (_n_timed_steps < _next_imbalance_check))
+    return false;
+
+  _next_imbalance_check = _n_timed_steps + _time_steps_between_imbalance_checks;
+  return _cell_cost_model->get_imbalance() > _load_imbalance_threshold;
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+bool ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::activate_scheduled_material()
+{
+  // If the mesh has changed since the operators were built, the quiet cells
+  // are activated by the next mesh change.
+  if (_quiet_cells && !_operators_outdated)
+  {
+    unsigned int const n_cells = _scheduled_quiet_activations.size();
+    std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator> cells;
+    std::vector<double> cells_cos;
+    std::vector<double> cells_sin;
+    cells.reserve(n_cells);
+    cells_cos.reserve(n_cells);
+    cells_sin.reserve(n_cells);
+    for (auto const &[cell, direction] : _scheduled_quiet_activations)
+    {
+      (*_quiet_cells)[cell->active_cell_index()] = false;
+      unsigned int const j = _material_cell_index[cell->active_cell_index()];
+      _deposition_cos[j] = direction.first;
+      _deposition_sin[j] = direction.second;
+      _has_melted[j] = true;
+      // The quiet cells are shared by all the members.
+      for (unsigned int m = 0; m < _member_states.size(); ++m)
       {
-        _deposition_cos.push_back(transferred_data[cell_id][n_dofs_per_cell]);
-        _deposition_sin.push_back(
-            transferred_data[cell_id][n_dofs_per_cell + 1]);
-        if (transferred_data[cell_id][n_dofs_per_cell + direction_data_size] >
-            0.5)
-          _has_melted.push_back(true);
-        else
-          _has_melted.push_back(false);
+        if (m != _selected_member)
+          _member_states[m].has_melted[j] = true;
+      }
+      cells.push_back(cell);
+      cells_cos.push_back(direction.first);
+      cells_sin.push_back(direction.second);
+    }
+    _scheduled_quiet_activations.clear();
+    _thermal_operator->update_material_deposition_orientation(cells, cells_cos,
+                                                              cells_sin);
+    exchange_quiet_cells();
+  }
+
+  bool const mesh_changes_needed = !_scheduled_activations.empty() ||
+                                   !_scheduled_quiet_activations.empty() ||
+                                   !_scheduled_quiet_cells.empty();
+
+  return dealii::Utilities::MPI::max(static_cast<int>(mesh_changes_needed),
+                                     _dof_handler.get_communicator()) == 1;
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::
+    compute_error_indicators(
+        dealii::LA::distributed::Vector<double, MemorySpaceType> const
+            &solution,
+        dealii::Vector<float> &indicators) const
+{
+  ASSERT(!_operators_outdated,
+         "The operators need to be updated after the mesh changes.");
+  _thermal_operator->compute_gradient_jump_indicators(solution, indicators);
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                    QuadratureType>::update_cell_cost_weights()
+{
+  _cell_cost_model->calibrate();
+
+  HeatSourceIndex<dim> heat_source_index;
+  heat_source_index.reinit(_heat_sources, _current_source_height);
+  std::vector<unsigned int> beam_ids;
+
+  auto state_host = Kokkos::create_mirror_view_and_copy(
+      Kokkos::HostSpace{}, _material_properties.get_state());
+
+  double const face_cost = _cell_cost_model->get_face_cost();
+  _cell_cost_weights.assign(_dof_handler.get_triangulation().n_active_cells(),
+                            0);
+  unsigned int cell_id = 0;
+  for (auto const &cell : dealii::filter_iterators(
+           _dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    if (cell->future_fe_index() == 0)
+    {
+      bool phase_change = false;
+      if constexpr (MaterialStates::n_material_states > 1)
+      {
+        unsigned int constexpr liquid =
+            static_cast<unsigned int>(MaterialStates::State::liquid);
+        phase_change = (state_host(liquid, cell_id) > 0.) &&
+                       (state_host(liquid, cell_id) < 1.);
       }
-      for (unsigned int i = 0; i < n_material_states; ++i)
+      if (!heat_source_index.empty())
+        heat_source_index.query(cell->bounding_box(), beam_ids);
+      auto const category =
+          beam_ids.size() > 0 ? CellCostModel::Category::heat_source
+          : phase_change      ? CellCostModel::Category::phase_change
+                              : CellCostModel::Category::regular;
+      double cost = _cell_cost_model->get_cell_cost(category);
+
+      // The faces at the boundary of the activated domain add to the cost.
+      if (face_cost > 0.)
       {
-        state_host(i, locally_owned_cell_id) =
-            transferred_data[cell_id][n_dofs_per_cell + direction_data_size +
-                                      phase_history_data_size + i];
+        for (unsigned int f : cell->face_indices())
+        {
+          if (cell->at_boundary(f) ||
+              (cell->neighbor(f)->is_active() &&
+               (cell->neighbor(f)->active_fe_index() != 0)))
+            cost += face_cost;
+        }
       }
-      ++locally_owned_cell_id;
+
+      unsigned int const n_dofs_per_cell =
+          _fe_collection[0].n_dofs_per_cell();
+      _cell_cost_weights[cell->active_cell_index()] = std::max(
+          1u, static_cast<unsigned int>(std::round(n_dofs_per_cell * cost)));
     }
+    beam_ids.clear();
     ++cell_id;
   }
-  Kokkos::deep_copy(state, state_host);
-  get_state_from_material_properties();
-  _thermal_operator->set_material_deposition_orientation(_deposition_cos,
-                                                         _deposition_sin);
+}
+
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+unsigned int
+ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+               QuadratureType>::
+    get_cell_weight(typename dealii::DoFHandler<dim>::cell_iterator const &cell,
+                    dealii::FiniteElement<dim> const &future_fe) const
+{
+  // The cells that are coarsened do not have a measured cost. Use the number
+  // of degrees of freedom like the cells that have not been evaluated yet.
+  if (cell->is_active() &&
+      (cell->active_cell_index() < _cell_cost_weights.size()))
+    return _cell_cost_weights[cell->active_cell_index()];
 
-  // Communicate the results.
-  solution.zero_out_ghost_values();
-  solution.import(rw_solution, dealii::VectorOperation::insert);
-  solution.update_ghost_values();
+  return future_fe.n_dofs_per_cell();
 }
 
 template <int dim, int p_order, int fe_degree, typename MaterialStates,
@@ -858,6 +1513,9 @@ double ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
         dealii::LA::distributed::Vector<double, MemorySpaceType> &solution,
         std::vector<Timer> &timers)
 {
+  ASSERT(!_operators_outdated,
+         "The operators need to be updated after the mesh changes.");
+
   // Update the height of the heat source. Right now this is just the
   // maximum heat source height, which can lead to unexpected behavior for
   // different sources with different heights.
@@ -868,6 +1526,14 @@ double ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
   }
   _current_source_height = temp_height;
 
+  // Average the heat sources over the time step
+  if (_swept_heat_sources)
+  {
+    _time_step_start = t;
+    for (auto &source : _heat_sources)
+      source->set_sweep_duration(delta_t);
+  }
+
   auto eval = [&](double const t, LA_Vector const &y)
   { return evaluate_thermal_physics(t, y, timers); };
   auto id_m_Jinv = [&](double const t, double const tau, LA_Vector const &y)
@@ -875,11 +1541,129 @@ double ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
 
   double time = _time_stepping->evolve_one_time_step(eval, id_m_Jinv, t,
                                                      delta_t, solution);
+  if (_cell_cost_model)
+    ++_n_timed_steps;
+
+  // The heat sources are only averaged during the time step. Outside of it,
+  // e.g. to refine the mesh, their instantaneous value is used.
+  if (_swept_heat_sources)
+  {
+    for (auto &source : _heat_sources)
+      source->set_sweep_duration(0.);
+  }
 
   // Return the time at the end of the time step.
   return time;
 }
 
+template <int dim, int p_order, int fe_degree, typename MaterialStates,
+          typename MemorySpaceType, typename QuadratureType>
+double ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
+                      QuadratureType>::
+    evolve_one_time_step(
+        double t, double delta_t,
+        std::vector<dealii::LA::distributed::Vector<double, MemorySpaceType> *>
+            const &solutions,
+        std::vector<Timer> &timers)
+{
+  ASSERT(!_operators_outdated,
+         "The operators need to be updated after the mesh changes.");
+  unsigned int const n_members = _member_states.size();
+  ASSERT(solutions.size() == n_members,
+         "There must be one solution per ensemble member.");
+
+  if constexpr (std::is_same_v<MemorySpaceType, dealii::MemorySpace::Host>)
+  {
+    if (_block_time_stepping && (n_members > 1))
+    {
+      std::vector<std::vector<std::shared_ptr<HeatSource<dim>>>>
+          block_heat_sources(n_members);
+      for (unsigned int m = 0; m < n_members; ++m)
+        block_heat_sources[m] = (m == _selected_member)
+                                    ? _heat_sources
+                                    : _member_states[m].heat_sources;
+
+      // Update the height of the heat source. Like for a single member, this
+      // is the maximum heat source height of all the members.
+      double temp_height = std::numeric_limits<double>::lowest();
+      for (auto const &heat_sources : block_heat_sources)
+        for (auto const &source : heat_sources)
+          temp_height = std::max(temp_height, source->get_current_height(t));
+      _current_source_height = temp_height;
+
+      // Average the heat sources over the time step
+      if (_swept_heat_sources)
+      {
+        _time_step_start = t;
+        for (auto &heat_sources : block_heat_sources)
+          for (auto &source : heat_sources)
+            source->set_sweep_duration(delta_t);
+      }
+
+      // The solutions and the material states of the members are gathered so
+      // that the operator is applied to all the members in one cell loop.
+      _thermal_operator->store_block_state(_selected_member);
+      dealii::LA::distributed::BlockVector<double> block_solution(n_members);
+      for (unsigned int m = 0; m < n_members; ++m)
+      {
+        block_solution.block(m).reinit(solutions[m]->get_partitioner());
+        block_solution.block(m) = *solutions[m];
+      }
+      block_solution.collect_sizes();
+
+      auto eval = [&](double const t,
+                      dealii::LA::distributed::BlockVector<double> const &y)
+      {
+        double const source_time = _swept_heat_sources ? _time_step_start : t;
+        if (_material_properties.properties_use_table())
+        {
+          return evaluate_thermal_physics_block_impl<
+              dim, true, p_order, fe_degree, MaterialStates, MemorySpaceType>(
+              _thermal_operator, block_heat_sources, source_time,
+              _current_source_height, y, timers);
+        }
+        else
+        {
+          return evaluate_thermal_physics_block_impl<
+              dim, false, p_order, fe_degree, MaterialStates, MemorySpaceType>(
+              _thermal_operator, block_heat_sources, source_time,
+              _current_source_height, y, timers);
+        }
+      };
+
+      double time = _block_time_stepping->evolve_one_time_step(
+          eval, t, delta_t, block_solution);
+
+      for (unsigned int m = 0; m < n_members; ++m)
+        *solutions[m] = block_solution.block(m);
+      _thermal_operator->load_block_state(_selected_member);
+      if (_cell_cost_model)
+        _n_timed_steps += n_members;
+
+      if (_swept_heat_sources)
+      {
+        for (auto &heat_sources : block_heat_sources)
+          for (auto &source : heat_sources)
+            source->set_sweep_duration(0.);
+      }
+
+      // Return the time at the end of the time step.
+      return time;
+    }
+  }
+
+  // The implicit methods and the device evolve the members one after the
+  // other.
+  double time = t;
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    select_member(m);
+    time = evolve_one_time_step(t, delta_t, *solutions[m], timers);
+  }
+
+  return time;
+}
+
 template <int dim, int p_order, int fe_degree, typename MaterialStates,
           typename MemorySpaceType, typename QuadratureType>
 void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
@@ -926,10 +1710,13 @@ ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
 #ifdef ADAMANTINE_WITH_CALIPER
   CALI_CXX_MARK_FUNCTION;
 #endif
+  // When the heat sources are swept, the source is the same for all the stages
+  // of the time step.
+  double const source_time = _swept_heat_sources ? _time_step_start : t;
   if constexpr (std::is_same<MemorySpaceType, dealii::MemorySpace::Host>::value)
   {
     return evaluate_thermal_physics_impl<dim, fe_degree, MemorySpaceType>(
-        _thermal_operator, t, _current_source_height, y, timers);
+        _thermal_operator, source_time, _current_source_height, y, timers);
   }
   else
   {
@@ -937,17 +1724,17 @@ ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
     {
       return evaluate_thermal_physics_impl<dim, true, p_order, fe_degree,
                                            MaterialStates, MemorySpaceType>(
-          _thermal_operator, _fe_collection, t, _dof_handler, _heat_sources,
-          _current_source_height, _boundary_type, _material_properties,
-          _affine_constraints, y, timers);
+          _thermal_operator, _fe_collection, source_time, _dof_handler,
+          _heat_sources, _current_source_height, _boundary_type,
+          _material_properties, _affine_constraints, y, timers);
     }
     else
     {
       return evaluate_thermal_physics_impl<dim, false, p_order, fe_degree,
                                            MaterialStates, MemorySpaceType>(
-          _thermal_operator, _fe_collection, t, _dof_handler, _heat_sources,
-          _current_source_height, _boundary_type, _material_properties,
-          _affine_constraints, y, timers);
+          _thermal_operator, _fe_collection, source_time, _dof_handler,
+          _heat_sources, _current_source_height, _boundary_type,
+          _material_properties, _affine_constraints, y, timers);
     }
   }
 
@@ -996,70 +1783,51 @@ void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
         std::string const &filename,
         dealii::LA::distributed::Vector<double, MemorySpaceType> &temperature)
 {
+  ASSERT(_member_states.size() == 1,
+         "A checkpoint cannot be loaded when the mesh is shared.");
+
   // Deserialize the mesh
   auto &triangulation = _geometry.get_triangulation();
   triangulation.load(filename);
 
-  // Deserialize the states, the direction, and the fe indices.
-  unsigned int constexpr n_material_states = MaterialStates::n_material_states;
-  unsigned int constexpr direction_data_size = 2;
-  unsigned int constexpr data_size_per_cell =
-      n_material_states + direction_data_size + 1;
-  std::vector<std::vector<double>> data_to_deserialize(
-      triangulation.n_active_cells(), std::vector<double>(data_size_per_cell));
+  // Deserialize the states, the direction, the melting indicator, the quiet
+  // cell indicator, and the fe indices.
+  CellDataPacker<dim, MaterialStates, MemorySpaceType> cell_data_packer(
+      _dof_handler);
   dealii::parallel::distributed::CellDataTransfer<
-      dim, dim, std::vector<std::vector<double>>>
+      dim, dim,
+      typename CellDataPacker<dim, MaterialStates, MemorySpaceType>::Buffer>
       cell_data_trans(triangulation);
-  cell_data_trans.deserialize(data_to_deserialize);
-  _deposition_cos.clear();
-  _deposition_sin.clear();
+  cell_data_trans.deserialize(cell_data_packer.prepare_unpack());
 
-  unsigned int cell_id = 0;
-  std::vector<std::array<double, n_material_states>> cell_state;
-  for (auto const &cell : _dof_handler.active_cell_iterators())
+  // Set the fe index
+  for (auto const &cell : dealii::filter_iterators(
+           _dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
   {
-    if (cell->is_locally_owned())
-    {
-      // Get the state
-      if constexpr (n_material_states == 1)
-      {
-        cell_state.push_back({{data_to_deserialize[cell_id][0]}});
-      }
-      else if constexpr (n_material_states == 2)
-      {
-        cell_state.push_back({{data_to_deserialize[cell_id][0],
-                               data_to_deserialize[cell_id][1]}});
-      }
-      else if constexpr (n_material_states == 3)
-      {
-        cell_state.push_back(
-            {{data_to_deserialize[cell_id][0], data_to_deserialize[cell_id][1],
-              data_to_deserialize[cell_id][2]}});
-      }
-
-      // Set the fe index
-      auto fe_index = static_cast<unsigned int>(
-          data_to_deserialize[cell_id]
-                             [n_material_states + direction_data_size]);
-      cell->set_active_fe_index(fe_index);
-
-      // Get the direction
-      if (fe_index == 0)
-      {
-        _deposition_cos.push_back(
-            data_to_deserialize[cell_id][n_material_states]);
-        _deposition_sin.push_back(
-            data_to_deserialize[cell_id][n_material_states + 1]);
-      }
-    }
-    ++cell_id;
+    cell->set_active_fe_index(static_cast<unsigned int>(
+        cell_data_packer[cell][CellPayload<MaterialStates>::fe_index]));
   }
 
   setup_dofs();
   // Update MaterialProperty DoFHandler and resize the state vectors
   _material_properties.reinit_dofs();
   // Update the state of each cell
-  _material_properties.set_cell_state(cell_state);
+  cell_data_packer.unpack(_material_properties.get_state(), _deposition_cos,
+                          _deposition_sin, _has_melted);
+  if (_quiet_cells)
+  {
+    _quiet_cells->assign(triangulation.n_active_cells(), false);
+    for (auto const &cell : dealii::filter_iterators(
+             _dof_handler.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell(),
+             dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
+    {
+      (*_quiet_cells)[cell->active_cell_index()] =
+          cell_data_packer[cell][CellPayload<MaterialStates>::quiet] > 0.5;
+    }
+    exchange_quiet_cells();
+  }
 
   // Finish the setup
   _thermal_operator->set_material_deposition_orientation(_deposition_cos,
@@ -1094,60 +1862,32 @@ void ThermalPhysics<dim, p_order, fe_degree, MaterialStates, MemorySpaceType,
         std::string const &filename,
         dealii::LA::distributed::Vector<double, MemorySpaceType> &temperature)
 {
-  // Prepare the states and the fe indices for serialization.
-  unsigned int constexpr n_material_states = MaterialStates::n_material_states;
-  unsigned int constexpr direction_data_size = 2;
-  unsigned int constexpr data_size_per_cell =
-      n_material_states + direction_data_size + 1;
-  unsigned int locally_owned_cell_id = 0;
-  unsigned int activated_cell_id = 0;
-  unsigned int cell_id = 0;
+  // Prepare the states, the direction, the melting indicator, the quiet cell
+  // indicator, and the fe indices for serialization.
   auto &triangulation = _geometry.get_triangulation();
-  std::vector<std::vector<double>> data_to_serialize(
-      triangulation.n_active_cells(), std::vector<double>(data_size_per_cell));
-  std::vector<double> element_data(data_size_per_cell, 0.);
-  auto state_host = Kokkos::create_mirror_view_and_copy(
-      Kokkos::HostSpace{}, _material_properties.get_state());
-  for (auto const &cell : _dof_handler.active_cell_iterators())
+  CellDataPacker<dim, MaterialStates, MemorySpaceType> cell_data_packer(
+      _dof_handler);
+  dealii::parallel::distributed::CellDataTransfer<
+      dim, dim,
+      typename CellDataPacker<dim, MaterialStates, MemorySpaceType>::Buffer>
+      cell_data_trans(triangulation);
+  // The operators may have a more recent state than MaterialProperty.
+  if (!_operators_outdated)
+    set_state_to_material_properties();
+  cell_data_packer.pack(_material_properties.get_state(), _deposition_cos,
+                        _deposition_sin, _has_melted);
+  if (_quiet_cells)
   {
-    if (cell->is_locally_owned())
+    for (auto const &cell : dealii::filter_iterators(
+             _dof_handler.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell(),
+             dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
     {
-      // Store the state
-      for (unsigned int i = 0; i < n_material_states; ++i)
-      {
-        data_to_serialize[cell_id][i] = state_host(i, locally_owned_cell_id);
-      }
-
-      auto fe_index = cell->active_fe_index();
-      // Store the direction
-      if (fe_index == 0)
-      {
-        data_to_serialize[cell_id][n_material_states] =
-            _deposition_cos[activated_cell_id];
-        data_to_serialize[cell_id][n_material_states + 1] =
-            _deposition_sin[activated_cell_id];
-        ++activated_cell_id;
-      }
-      else
-      {
-        // If there is no material, there is no deposition direction -> use an
-        // obviously wrong value.
-        data_to_serialize[cell_id][n_material_states] = 10.;
-        data_to_serialize[cell_id][n_material_states + 1] = 10.;
-      }
-
-      // Store the FE index
-      data_to_serialize[cell_id][n_material_states + direction_data_size] =
-          fe_index;
-
-      ++locally_owned_cell_id;
+      if (is_quiet(cell))
+        cell_data_packer[cell][CellPayload<MaterialStates>::quiet] = 1.;
     }
-    ++cell_id;
   }
-  dealii::parallel::distributed::CellDataTransfer<
-      dim, dim, std::vector<std::vector<double>>>
-      cell_data_trans(triangulation);
-  cell_data_trans.prepare_for_serialization(data_to_serialize);
+  cell_data_trans.prepare_for_serialization(cell_data_packer.get_buffer());
 
   // Prepare the temperature for serialization. We need to use a ghosted
   // vector.
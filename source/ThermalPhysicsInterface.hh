@@ -8,11 +8,13 @@
 #ifndef THERMAL_PHYSICS_INTERFACE_HH
 #define THERMAL_PHYSICS_INTERFACE_HH
 
+#include <material_deposition.hh>
 #include <types.hh>
 
 #include <deal.II/dofs/dof_handler.h>
 #include <deal.II/lac/affine_constraints.h>
 #include <deal.II/lac/la_parallel_vector.h>
+#include <deal.II/lac/vector.h>
 
 namespace adamantine
 {
@@ -56,15 +58,106 @@ public:
    * domain.
    */
   virtual void add_material(
-      std::vector<std::vector<
-          typename dealii::DoFHandler<dim>::active_cell_iterator>> const
-          &elements_to_activate,
+      ElementsToActivate<dim> const &elements_to_activate,
       std::vector<double> const &new_deposition_cos,
       std::vector<double> const &new_deposition_sin,
       std::vector<bool> &new_has_melted, unsigned int const activation_start,
       unsigned int const activation_end, double const initial_temperature,
       dealii::LA::distributed::Vector<double, MemorySpaceType> &solution) = 0;
 
+  /**
+   * Schedule the activation of the elements associated with the deposition
+   * boxes activation_start to activation_end. The elements are activated by the
+   * next call to execute_mesh_changes(), together with the refinement and the
+   * coarsening flagged on the Triangulation. Return false, and schedule
+   * nothing, if one of the elements to activate is also flagged for refinement
+   * or coarsening on any processor. In that case, the flagged changes need to
+   * be executed first and the elements to activate need to be searched again.
+   */
+  virtual bool
+  schedule_material(ElementsToActivate<dim> const &elements_to_activate,
+                    std::vector<double> const &new_deposition_cos,
+                    std::vector<double> const &new_deposition_sin,
+                    unsigned int const activation_start,
+                    unsigned int const activation_end,
+                    double const new_material_temperature) = 0;
+
+  /**
+   * Execute the refinement, the coarsening, and the activation scheduled on the
+   * mesh in a single pass and transfer the solution and the material state to
+   * the new mesh. If @p update_operators is false, the MatrixFree objects and
+   * the inverse of the mass matrix are not rebuilt. This is used when the mesh
+   * changes again before the next time step. The operators must be updated
+   * before evolving the solution.
+   */
+  virtual void execute_mesh_changes(
+      dealii::LA::distributed::Vector<double, MemorySpaceType> &solution,
+      bool const update_operators) = 0;
+
+  /**
+   * Same as above but the solutions of all the ensemble members sharing the
+   * mesh, ordered by member, are transferred to the new mesh. The material
+   * state of each member is transferred as well.
+   */
+  virtual void execute_mesh_changes(
+      std::vector<dealii::LA::distributed::Vector<double, MemorySpaceType> *>
+          const &solutions,
+      bool const update_operators) = 0;
+
+  /**
+   * Share the mesh, the degrees of freedom, and the operators between
+   * @p n_members ensemble members. Each member keeps its own material state,
+   * melting indicators, temperature of the new material, and heat sources. The
+   * operators use the state of the member given to select_member(). The state
+   * of the other members is stored in the operators and it is only copied per
+   * cell when the mesh changes. This needs to be called after setup().
+   */
+  virtual void set_n_members(unsigned int const n_members) = 0;
+
+  /**
+   * Store the state of the selected ensemble member and load the state of
+   * @p member in the operators.
+   */
+  virtual void select_member(unsigned int const member) = 0;
+
+  /**
+   * Return true if the measured imbalance of the work between the processors
+   * exceeds the threshold given in the input file. In that case, the mesh
+   * should be repartitioned by executing the mesh changes. The imbalance is
+   * only measured once enough time steps have been timed since the last mesh
+   * change, and then at regular intervals. This function should be called once
+   * per time step. It is a collective operation.
+   */
+  virtual bool is_repartition_needed() = 0;
+
+  /**
+   * Activate the scheduled elements that already have degrees of freedom,
+   * i.e., the quiet elements, without changing the mesh. The temperature of
+   * the quiet elements is left unchanged. Return true if a call
+   * to execute_mesh_changes() is needed to activate the other scheduled
+   * elements. This is a collective operation.
+   */
+  virtual bool activate_scheduled_material() = 0;
+
+  /**
+   * Return true if the given locally owned cell has degrees of freedom but no
+   * material yet. Such a cell is called quiet.
+   */
+  virtual bool is_quiet(
+      typename dealii::DoFHandler<dim>::active_cell_iterator const &cell)
+      const = 0;
+
+  /**
+   * Compute an error indicator on each active cell from the jump of the normal
+   * derivative of @p solution across the faces of the cells that have
+   * material. The indicators are indexed by the active cell index and only the
+   * values of the locally owned cells are meaningful. The operators need to be
+   * up to date. This is a collective operation.
+   */
+  virtual void compute_error_indicators(
+      dealii::LA::distributed::Vector<double, MemorySpaceType> const &solution,
+      dealii::Vector<float> &indicators) const = 0;
+
   /**
    * Public interface for modifying the private state of the Physics object. One
    * use of this is to modify nominally constant parameters in the middle of a
@@ -83,6 +176,18 @@ public:
       dealii::LA::distributed::Vector<double, MemorySpaceType> &solution,
       std::vector<Timer> &timers) = 0;
 
+  /**
+   * Same as above but the solutions of all the ensemble members sharing the
+   * mesh, ordered by member, are evolved. With an explicit time stepping
+   * method on the host, the operator is applied to all the members in a single
+   * cell loop. Otherwise, the members are evolved one after the other.
+   */
+  virtual double evolve_one_time_step(
+      double t, double delta_t,
+      std::vector<dealii::LA::distributed::Vector<double, MemorySpaceType> *>
+          const &solutions,
+      std::vector<Timer> &timers) = 0;
+
   /**
    * Initialize the given vector with the given value.
    */
@@ -0,0 +1,71 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <dof_renumbering.hh>
+#include <utils.hh>
+
+#include <deal.II/dofs/dof_renumbering.h>
+#include <deal.II/dofs/dof_renumbering.templates.h>
+#include <deal.II/matrix_free/matrix_free.h>
+
+#include <boost/algorithm/string.hpp>
+
+namespace adamantine
+{
+DoFOrdering parse_dof_ordering(std::string const &dof_ordering)
+{
+  if (boost::iequals(dof_ordering, "none"))
+    return DoFOrdering::none;
+  if (boost::iequals(dof_ordering, "space_filling_curve"))
+    return DoFOrdering::space_filling_curve;
+  if (boost::iequals(dof_ordering, "data_locality"))
+    return DoFOrdering::data_locality;
+
+  ASSERT_THROW(false, "Error: Unknown DoF renumbering. Valid options are "
+                      "'none', 'space_filling_curve', and 'data_locality'.");
+
+  return DoFOrdering::none;
+}
+
+template <int dim>
+void renumber_dofs(DoFOrdering const dof_ordering,
+                   dealii::DoFHandler<dim> &dof_handler,
+                   dealii::AffineConstraints<double> const &affine_constraints)
+{
+  if (dof_ordering == DoFOrdering::space_filling_curve)
+  {
+    // The locally owned cells are ordered along the Morton curve of p4est.
+    dealii::DoFRenumbering::hierarchical(dof_handler);
+  }
+  else if (dof_ordering == DoFOrdering::data_locality)
+  {
+    // Use the same loops as the thermal operator: the cell loop and the face
+    // loop at the boundary of the activated domain.
+    typename dealii::MatrixFree<dim, double>::AdditionalData matrix_free_data;
+    matrix_free_data.tasks_parallel_scheme =
+        dealii::MatrixFree<dim, double>::AdditionalData::partition_color;
+    matrix_free_data.mapping_update_flags_inner_faces = dealii::update_values;
+    matrix_free_data.mapping_update_flags_boundary_faces =
+        dealii::update_values;
+    dealii::DoFRenumbering::matrix_free_data_locality(
+        dof_handler, affine_constraints, matrix_free_data);
+  }
+}
+} // namespace adamantine
+
+//-------------------- Explicit Instantiations --------------------//
+namespace adamantine
+{
+template void
+renumber_dofs<2>(DoFOrdering const dof_ordering,
+                 dealii::DoFHandler<2> &dof_handler,
+                 dealii::AffineConstraints<double> const &affine_constraints);
+template void
+renumber_dofs<3>(DoFOrdering const dof_ordering,
+                 dealii::DoFHandler<3> &dof_handler,
+                 dealii::AffineConstraints<double> const &affine_constraints);
+} // namespace adamantine
@@ -0,0 +1,49 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef DOF_RENUMBERING_HH
+#define DOF_RENUMBERING_HH
+
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/lac/affine_constraints.h>
+
+#include <string>
+
+namespace adamantine
+{
+/**
+ * Enum on the different orderings of the degrees of freedom. The
+ * 'space_filling_curve' option orders the degrees of freedom following the
+ * space-filling curve used by p4est to order the cells. The 'data_locality'
+ * option orders the degrees of freedom in the order in which they are accessed
+ * by the matrix-free cell and face loops.
+ */
+enum class DoFOrdering
+{
+  none,
+  space_filling_curve,
+  data_locality
+};
+
+/**
+ * Convert a string to a DoFOrdering. The comparison is case insensitive.
+ */
+DoFOrdering parse_dof_ordering(std::string const &dof_ordering);
+
+/**
+ * Renumber the degrees of freedom of @p dof_handler. The @p affine_constraints
+ * need to be built for the current numbering. They are only used by the
+ * 'data_locality' ordering and they need to be rebuilt after the
+ * renumbering.
+ */
+template <int dim>
+void renumber_dofs(DoFOrdering const dof_ordering,
+                   dealii::DoFHandler<dim> &dof_handler,
+                   dealii::AffineConstraints<double> const &affine_constraints);
+} // namespace adamantine
+
+#endif
@@ -14,6 +14,7 @@
 #include <boost/algorithm/string.hpp>
 
 #include <algorithm>
+#include <memory>
 #include <fstream>
 #include <tuple>
 
@@ -129,6 +130,159 @@ read_material_deposition(boost::property_tree::ptree const &geometry_database)
                          material_deposition_cos, material_deposition_sin);
 }
 
+template <int dim>
+ScanPathDeposition<dim>::ScanPathDeposition(
+    boost::property_tree::ptree const &geometry_database,
+    ScanPath const &scan_path, double const start_time)
+    : _scan_path(scan_path)
+{
+  // Load the box size information and lead time
+
+  // PropertyTreeInput geometry.deposition_length
+  _deposition_length = geometry_database.get<double>("deposition_length");
+  // PropertyTreeInput geometry.deposition_height
+  _deposition_height = geometry_database.get<double>("deposition_height");
+  // PropertyTreeInput geometry.deposition_width
+  _deposition_width = geometry_database.get<double>("deposition_width", 0.0);
+
+  // PropertyTreeInput geometry.deposition_lead_time
+  _lead_time = geometry_database.get<double>("deposition_lead_time");
+
+  unsigned int const n_segments = _scan_path.n_segments();
+  if (n_segments == 0)
+    return;
+
+  // The boxes of a segment are deposited before the end time of the segment
+  // minus the lead time. Use a binary search to skip the segments whose boxes
+  // are all deposited before start_time.
+  unsigned int first = 0;
+  unsigned int last = n_segments;
+  while (first < last)
+  {
+    unsigned int const middle = first + (last - first) / 2;
+    if (std::max(_scan_path.get_segment(middle).end_time - _lead_time,
+                 _eps_time) < start_time)
+      first = middle + 1;
+    else
+      last = middle;
+  }
+  _segment = first;
+  if (_segment == 0)
+  {
+    _segment_start_point = _scan_path.get_segment(0).end_point;
+    _segment_start_time = 0.0;
+  }
+  else
+  {
+    _segment_start_point = _scan_path.get_segment(_segment - 1).end_point;
+    _segment_start_time = _scan_path.get_segment(_segment - 1).end_time;
+  }
+}
+
+template <int dim>
+bool ScanPathDeposition<dim>::next(dealii::BoundingBox<dim> &box, double &time,
+                                   double &cos, double &sin)
+{
+  // Move to the next segment where the power is on
+  while (!_in_segment)
+  {
+    if (_segment >= _scan_path.n_segments())
+      return false;
+
+    ScanPathSegment const &segment = _scan_path.get_segment(_segment);
+    // Only add material if the power is on
+    if (segment.power_modifier > _eps)
+    {
+      _segment_length = segment.end_point.distance(_segment_start_point);
+      _center = _segment_start_point;
+      _segment_velocity =
+          _segment_length / (segment.end_time - _segment_start_time);
+
+      // Set the segment orientation
+      _cos = (segment.end_point[0] - _segment_start_point[0]) / _segment_length;
+      _sin = (segment.end_point[1] - _segment_start_point[1]) / _segment_length;
+      _next_box_length = _deposition_length;
+      _in_segment = true;
+    }
+    else
+    {
+      _segment_start_point = segment.end_point;
+      _segment_start_time = segment.end_time;
+      ++_segment;
+    }
+  }
+
+  bool const segment_along_x = std::abs(_cos) > std::abs(_sin) ? true : false;
+  double distance_to_box_center = _center.distance(_segment_start_point);
+  double time_to_box_center = distance_to_box_center / _segment_velocity;
+
+  std::vector<double> box_size(dim);
+  box_size.at(axis<dim>::z) = _deposition_height;
+
+  if (dim == 2)
+  {
+    box_size.at(axis<dim>::x) = _next_box_length;
+  }
+  else
+  {
+    if (segment_along_x)
+    {
+      box_size.at(axis<dim>::x) = std::abs(_cos) * _next_box_length;
+      box_size.at(axis<dim>::y) =
+          _deposition_width + std::abs(_sin) * _next_box_length;
+    }
+    else
+    {
+      box_size.at(axis<dim>::x) =
+          _deposition_width + std::abs(_cos) * _next_box_length;
+      box_size.at(axis<dim>::y) = std::abs(_sin) * _next_box_length;
+    }
+  }
+
+  dealii::Point<dim> bounding_pt_a;
+  dealii::Point<dim> bounding_pt_b;
+  for (int d = 0; d < dim - 1; ++d)
+  {
+    bounding_pt_a[d] = _center[d] - 0.5 * box_size[d];
+    bounding_pt_b[d] = _center[d] + 0.5 * box_size[d];
+  }
+  bounding_pt_a[dim - 1] = _center[dim - 1] - box_size[dim - 1];
+  bounding_pt_b[dim - 1] = _center[dim - 1];
+
+  box = dealii::BoundingBox<dim>(std::make_pair(bounding_pt_a, bounding_pt_b));
+  time = std::max(_segment_start_time + time_to_box_center - _lead_time,
+                  _eps_time);
+  cos = _cos;
+  sin = _sin;
+
+  // Get the next box center
+  if (distance_to_box_center + _eps > _segment_length)
+  {
+    ScanPathSegment const &segment = _scan_path.get_segment(_segment);
+    _segment_start_point = segment.end_point;
+    _segment_start_time = segment.end_time;
+    ++_segment;
+    _in_segment = false;
+  }
+  else
+  {
+    // Check to see if the next box is at the end of the segment and
+    // needs to have a modified length
+    double center_increment = _deposition_length;
+    if (distance_to_box_center + _deposition_length > _segment_length)
+    {
+      center_increment = _deposition_length / 2.0 +
+                         (_segment_length - distance_to_box_center) / 2.0;
+      _next_box_length = _segment_length - distance_to_box_center;
+    }
+
+    _center[0] += _cos * center_increment;
+    _center[1] += _sin * center_increment;
+  }
+
+  return true;
+}
+
 template <int dim>
 std::tuple<std::vector<dealii::BoundingBox<dim>>, std::vector<double>,
            std::vector<double>, std::vector<double>>
@@ -143,117 +297,113 @@ deposition_along_scan_path(boost::property_tree::ptree const &geometry_database,
   int constexpr tuple_cos = 2;
   int constexpr tuple_sin = 3;
 
-  // Load the box size information and lead time
+  // Loop through the scan path segements, adding boxes inside each one
+  ScanPathDeposition<dim> scan_path_deposition(geometry_database, scan_path);
+  dealii::BoundingBox<dim> box;
+  double time = 0.;
+  double cos = 0.;
+  double sin = 0.;
+  while (scan_path_deposition.next(box, time, cos, sin))
+  {
+    std::get<tuple_box>(deposition_path).push_back(box);
+    std::get<tuple_time>(deposition_path).push_back(time);
+    std::get<tuple_cos>(deposition_path).push_back(cos);
+    std::get<tuple_sin>(deposition_path).push_back(sin);
+  }
 
-  // PropertyTreeInput geometry.deposition_length
-  double deposition_length = geometry_database.get<double>("deposition_length");
-  // PropertyTreeInput geometry.deposition_height
-  double deposition_height = geometry_database.get<double>("deposition_height");
-  // PropertyTreeInput geometry.deposition_width
-  double deposition_width =
-      geometry_database.get<double>("deposition_width", 0.0);
+  return deposition_path;
+}
 
-  // PropertyTreeInput geometry.deposition_lead_time
-  double lead_time = geometry_database.get<double>("deposition_lead_time");
+template <int dim>
+DepositionStream<dim>::DepositionStream(
+    boost::property_tree::ptree const &geometry_database,
+    std::vector<std::shared_ptr<HeatSource<dim>>> const &heat_sources)
+    : _geometry_database(geometry_database), _heat_sources(heat_sources)
+{
+  // PropertyTreeInput geometry.material_deposition
+  bool const material_deposition =
+      geometry_database.get("material_deposition", false);
 
-  // Loop through the scan path segements, adding boxes inside each one
-  std::vector<ScanPathSegment> segment_list = scan_path.get_segment_list();
-  double segment_start_time = 0.0;
-  dealii::Point<3> segment_start_point = segment_list.at(0).end_point;
-  for (ScanPathSegment segment : segment_list)
+  if (!material_deposition)
+    return;
+
+  // PropertyTreeInput geometry.material_deposition_method
+  std::string const method =
+      geometry_database.get<std::string>("material_deposition_method");
+
+  if (method == "file")
   {
-    // Only add material if the power is on
-    double const eps = 1.0e-12;
-    double const eps_time = 1.0e-12;
-    if (segment.power_modifier > eps)
-    {
-      dealii::Point<3> segment_end_point = segment.end_point;
-      double segment_length = segment_end_point.distance(segment_start_point);
-      bool in_segment = true;
-      dealii::Point<3> center = segment_start_point;
-      double segment_velocity =
-          segment_length / (segment.end_time - segment_start_time);
+    // The file is already sorted and it is read in a single pass.
+    std::tie(_boxes, _times, _cos, _sin) =
+        read_material_deposition<dim>(geometry_database);
+  }
+  else
+  {
+    _along_scan_path = true;
+    reset(0.);
+  }
+}
 
-      // Set the segment orientation
-      double const cos =
-          (segment_end_point[0] - segment_start_point[0]) / segment_length;
-      double const sin =
-          (segment_end_point[1] - segment_start_point[1]) / segment_length;
-      bool segment_along_x = std::abs(cos) > std::abs(sin) ? true : false;
-      double next_box_length = deposition_length;
-
-      while (in_segment)
-      {
-        double distance_to_box_center = center.distance(segment_start_point);
-        double time_to_box_center = distance_to_box_center / segment_velocity;
-
-        std::vector<double> box_size(dim);
-        box_size.at(axis<dim>::z) = deposition_height;
-
-        if (dim == 2)
-        {
-          box_size.at(axis<dim>::x) = next_box_length;
-        }
-        else
-        {
-          if (segment_along_x)
-          {
-            box_size.at(axis<dim>::x) = std::abs(cos) * next_box_length;
-            box_size.at(axis<dim>::y) =
-                deposition_width + std::abs(sin) * next_box_length;
-          }
-          else
-          {
-            box_size.at(axis<dim>::x) =
-                deposition_width + std::abs(cos) * next_box_length;
-            box_size.at(axis<dim>::y) = std::abs(sin) * next_box_length;
-          }
-        }
-
-        dealii::Point<dim> bounding_pt_a;
-        dealii::Point<dim> bounding_pt_b;
-        for (int d = 0; d < dim - 1; ++d)
-        {
-          bounding_pt_a[d] = center[d] - 0.5 * box_size[d];
-          bounding_pt_b[d] = center[d] + 0.5 * box_size[d];
-        }
-        bounding_pt_a[dim - 1] = center[dim - 1] - box_size[dim - 1];
-        bounding_pt_b[dim - 1] = center[dim - 1];
-
-        std::get<tuple_box>(deposition_path)
-            .push_back(std::make_pair(bounding_pt_a, bounding_pt_b));
-        std::get<tuple_time>(deposition_path)
-            .push_back(std::max(
-                segment_start_time + time_to_box_center - lead_time, eps_time));
-        std::get<tuple_cos>(deposition_path).push_back(cos);
-        std::get<tuple_sin>(deposition_path).push_back(sin);
-
-        // Get the next box center
-        if (distance_to_box_center + eps > segment_length)
-        {
-          in_segment = false;
-        }
-        else
-        {
-          // Check to see if the next box is at the end of the segment and
-          // needs to have a modified length
-          double center_increment = deposition_length;
-          if (distance_to_box_center + deposition_length > segment_length)
-          {
-            center_increment = deposition_length / 2.0 +
-                               (segment_length - distance_to_box_center) / 2.0;
-            next_box_length = segment_length - distance_to_box_center;
-          }
-
-          center[0] += cos * center_increment;
-          center[1] += sin * center_increment;
-        }
-      }
+template <int dim>
+void DepositionStream<dim>::reset(double const start_time)
+{
+  if (!_along_scan_path)
+    return;
+
+  _boxes.clear();
+  _times.clear();
+  _cos.clear();
+  _sin.clear();
+  _queue = decltype(_queue)();
+  _paths.clear();
+  _paths.reserve(_heat_sources.size());
+  _heads.resize(_heat_sources.size());
+  for (unsigned int i = 0; i < _heat_sources.size(); ++i)
+  {
+    _paths.emplace_back(_geometry_database,
+                        _heat_sources[i]->get_scan_path(), start_time);
+    pop_next(i);
+  }
+}
+
+template <int dim>
+void DepositionStream<dim>::pop_next(unsigned int const i)
+{
+  Head &head = _heads[i];
+  if (_paths[i].next(head.box, head.time, head.cos, head.sin))
+    _queue.emplace(head.time, i);
+}
+
+template <int dim>
+void DepositionStream<dim>::advance(double const start_time,
+                                    double const end_time)
+{
+  // Discard the boxes that have been deposited.
+  auto const n_discarded =
+      std::lower_bound(_times.begin(), _times.end(), start_time) -
+      _times.begin();
+  _boxes.erase(_boxes.begin(), _boxes.begin() + n_discarded);
+  _times.erase(_times.begin(), _times.begin() + n_discarded);
+  _cos.erase(_cos.begin(), _cos.begin() + n_discarded);
+  _sin.erase(_sin.begin(), _sin.begin() + n_discarded);
+
+  // Merge the boxes of the different scan paths until we reach end_time. Every
+  // scan path generates its boxes in chronological order, so the box with the
+  // smallest time among the heads is the next one.
+  while ((!_queue.empty()) && (_queue.top().first < end_time))
+  {
+    unsigned int const i = _queue.top().second;
+    _queue.pop();
+    Head const &head = _heads[i];
+    if (head.time >= start_time)
+    {
+      _boxes.push_back(head.box);
+      _times.push_back(head.time);
+      _cos.push_back(head.cos);
+      _sin.push_back(head.sin);
     }
-    segment_start_point = segment.end_point;
-    segment_start_time = segment.end_time;
+    pop_next(i);
   }
-  return deposition_path;
 }
 
 template <int dim>
@@ -305,50 +455,120 @@ merge_deposition_paths(
 }
 
 template <int dim>
-std::vector<std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator>>
-get_elements_to_activate(
+ActivationSearch<dim>::ActivationSearch(
     dealii::DoFHandler<dim> const &dof_handler,
-    std::vector<dealii::BoundingBox<dim>> const &material_deposition_boxes)
+    std::function<
+        bool(typename dealii::DoFHandler<dim>::active_cell_iterator const &)>
+        is_quiet)
+    : _dof_handler(dof_handler), _is_quiet(std::move(is_quiet))
+{
+  // The list of cells and the BVH become invalid every time the mesh changes.
+  _mesh_change_connection =
+      _dof_handler.get_triangulation().signals.any_change.connect(
+          [this]()
+          {
+            _cells_outdated = true;
+            _bvh.reset();
+          });
+}
+
+template <int dim>
+ActivationSearch<dim>::~ActivationSearch()
+{
+  _mesh_change_connection.disconnect();
+}
+
+template <int dim>
+void ActivationSearch<dim>::update_cells()
+{
+  if (!_cells_outdated)
+    return;
+
+  _cells.clear();
+  _cell_ids.clear();
+  _bvh.reset();
+  for (auto const &cell :
+       dealii::filter_iterators(_dof_handler.active_cell_iterators(),
+                                dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    if ((cell->active_fe_index() == 1) || (_is_quiet && _is_quiet(cell)))
+    {
+      _cells.emplace_back(cell->level(), cell->index());
+      _cell_ids.push_back(cell->id());
+    }
+  }
+  _cells_outdated = false;
+}
+
+template <int dim>
+bool ActivationSearch<dim>::has_same_cells(ActivationSearch<dim> &other)
+{
+  update_cells();
+  other.update_cells();
+
+  return (_cells == other._cells) && (_cell_ids == other._cell_ids);
+}
+
+template <int dim>
+ElementsToActivate<dim> ActivationSearch<dim>::get_elements_to_activate(
+    std::vector<dealii::BoundingBox<dim>> const &material_deposition_boxes,
+    unsigned int const activation_start, unsigned int const activation_end)
 {
+  ElementsToActivate<dim> elements_to_activate;
+  elements_to_activate.first_box = activation_start;
+
   // Exit early if we can
-  if (material_deposition_boxes.size() == 0)
-    return std::vector<
-        std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator>>();
+  if (activation_start >= activation_end)
+    return elements_to_activate;
 
   // We activate the cells that intersect a box. To do that we use ArborX.
-  // First, we create the bounding boxes of all the non-activated cells.
-  std::vector<dealii::BoundingBox<dim>> bounding_boxes;
-  std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator>
-      cell_iterators;
-  for (auto const &cell : dealii::filter_iterators(
-           dof_handler.active_cell_iterators(),
-           dealii::IteratorFilters::LocallyOwnedCell(),
-           dealii::IteratorFilters::ActiveFEIndexEqualTo(1)))
+  // First, we create the bounding volume hierarchy of all the non-activated
+  // cells if the mesh has changed.
+  update_cells();
+  if (!_bvh)
   {
-    bounding_boxes.push_back(cell->bounding_box());
-    cell_iterators.push_back(cell);
+    std::vector<dealii::BoundingBox<dim>> bounding_boxes;
+    bounding_boxes.reserve(_cells.size());
+    for (auto const &[level, index] : _cells)
+    {
+      typename dealii::DoFHandler<dim>::active_cell_iterator cell(
+          &_dof_handler.get_triangulation(), level, index, &_dof_handler);
+      bounding_boxes.push_back(cell->bounding_box());
+    }
+    _bvh = std::make_unique<dealii::ArborXWrappers::BVH>(bounding_boxes);
   }
 
-  // Perform the search
-  dealii::ArborXWrappers::BVH bvh(bounding_boxes);
+  // Perform the search using only the boxes in the activation window
+  std::vector<dealii::BoundingBox<dim>> active_boxes(
+      material_deposition_boxes.begin() + activation_start,
+      material_deposition_boxes.begin() + activation_end);
   dealii::ArborXWrappers::BoundingBoxIntersectPredicate bb_intersect(
-      material_deposition_boxes);
-  auto [indices, offset] = bvh.query(bb_intersect);
+      active_boxes);
+  auto [indices, offset] = _bvh->query(bb_intersect);
 
-  unsigned int const n_queries = material_deposition_boxes.size();
-  std::vector<
-      std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator>>
-      elements_to_activate(n_queries);
+  unsigned int const n_queries = active_boxes.size();
+  elements_to_activate.offsets.resize(n_queries + 1);
+  elements_to_activate.cells.resize(indices.size());
   for (unsigned int i = 0; i < n_queries; ++i)
   {
+    elements_to_activate.offsets[i + 1] = offset[i + 1];
     for (int j = offset[i]; j < offset[i + 1]; ++j)
-    {
-      elements_to_activate[i].push_back(cell_iterators[indices[j]]);
-    }
+      elements_to_activate.cells[j] = _cells[indices[j]];
   }
 
   return elements_to_activate;
 }
+
+template <int dim>
+ElementsToActivate<dim> get_elements_to_activate(
+    dealii::DoFHandler<dim> const &dof_handler,
+    std::vector<dealii::BoundingBox<dim>> const &material_deposition_boxes)
+{
+  ActivationSearch<dim> activation_search(dof_handler);
+
+  return activation_search.get_elements_to_activate(
+      material_deposition_boxes, 0, material_deposition_boxes.size());
+}
 } // namespace adamantine
 
 //-------------------- Explicit Instantiations --------------------//
@@ -372,14 +592,18 @@ template std::tuple<std::vector<dealii::BoundingBox<3>>, std::vector<double>,
                     std::vector<double>, std::vector<double>>
 read_material_deposition(boost::property_tree::ptree const &geometry_database);
 
-template std::vector<
-    std::vector<typename dealii::DoFHandler<2>::active_cell_iterator>>
-get_elements_to_activate(
+template class ScanPathDeposition<2>;
+template class ScanPathDeposition<3>;
+template class DepositionStream<2>;
+template class DepositionStream<3>;
+
+template class ActivationSearch<2>;
+template class ActivationSearch<3>;
+
+template ElementsToActivate<2> get_elements_to_activate(
     dealii::DoFHandler<2> const &dof_handler,
     std::vector<dealii::BoundingBox<2>> const &material_deposition_boxes);
-template std::vector<
-    std::vector<typename dealii::DoFHandler<3>::active_cell_iterator>>
-get_elements_to_activate(
+template ElementsToActivate<3> get_elements_to_activate(
     dealii::DoFHandler<3> const &dof_handler,
     std::vector<dealii::BoundingBox<3>> const &material_deposition_boxes);
 
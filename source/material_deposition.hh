@@ -12,11 +12,365 @@
 
 #include <deal.II/base/bounding_box.h>
 #include <deal.II/dofs/dof_handler.h>
+#include <deal.II/grid/cell_id.h>
 
 #include <boost/property_tree/ptree.hpp>
+#include <boost/signals2/connection.hpp>
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace dealii
+{
+namespace ArborXWrappers
+{
+class BVH;
+}
+} // namespace dealii
 
 namespace adamantine
 {
+/**
+ * This class generates the material deposition boxes along a scan path one at
+ * a time, in chronological order. Only the current position along the scan
+ * path is stored.
+ */
+template <int dim>
+class ScanPathDeposition
+{
+public:
+  /**
+   * Constructor. The boxes deposited before @p start_time may be skipped.
+   */
+  ScanPathDeposition(boost::property_tree::ptree const &geometry_database,
+                     ScanPath const &scan_path, double const start_time = 0.);
+
+  /**
+   * Compute the next box, its deposition time, and the cosine and the sine of
+   * its deposition angle. Return false if there is no box left.
+   */
+  bool next(dealii::BoundingBox<dim> &box, double &time, double &cos,
+            double &sin);
+
+private:
+  /**
+   * Tolerance used to decide if the power is on and if the end of a segment
+   * has been reached.
+   */
+  static double constexpr _eps = 1.0e-12;
+  /**
+   * Smallest deposition time.
+   */
+  static double constexpr _eps_time = 1.0e-12;
+  /**
+   * Scan path followed by the deposition.
+   */
+  ScanPath const &_scan_path;
+  /**
+   * Length of the deposition boxes.
+   */
+  double _deposition_length;
+  /**
+   * Height of the deposition boxes.
+   */
+  double _deposition_height;
+  /**
+   * Width of the deposition boxes.
+   */
+  double _deposition_width;
+  /**
+   * Time between the deposition of the material and the arrival of the beam.
+   */
+  double _lead_time;
+  /**
+   * Index of the current segment.
+   */
+  unsigned int _segment = 0;
+  /**
+   * Flag is true if some boxes of the current segment have not been generated.
+   */
+  bool _in_segment = false;
+  /**
+   * Start point of the current segment.
+   */
+  dealii::Point<3> _segment_start_point;
+  /**
+   * Start time of the current segment.
+   */
+  double _segment_start_time = 0.;
+  /**
+   * Length of the current segment.
+   */
+  double _segment_length = 0.;
+  /**
+   * Velocity of the beam along the current segment.
+   */
+  double _segment_velocity = 0.;
+  /**
+   * Cosine of the direction of the current segment.
+   */
+  double _cos = 1.;
+  /**
+   * Sine of the direction of the current segment.
+   */
+  double _sin = 0.;
+  /**
+   * Center of the next box.
+   */
+  dealii::Point<3> _center;
+  /**
+   * Length of the next box.
+   */
+  double _next_box_length = 0.;
+};
+
+/**
+ * This class streams the material deposition boxes of all the heat sources in
+ * chronological order. Instead of creating the boxes for the entire build, the
+ * boxes are generated for a time window on demand and the boxes deposited
+ * before the window are discarded. The streams of the different heat sources
+ * are combined using a k-way merge. If the material deposition is read from a
+ * file, all the boxes are read at once.
+ */
+template <int dim>
+class DepositionStream
+{
+public:
+  /**
+   * Constructor.
+   */
+  DepositionStream(
+      boost::property_tree::ptree const &geometry_database,
+      std::vector<std::shared_ptr<HeatSource<dim>>> const &heat_sources);
+
+  /**
+   * Discard the boxes deposited before @p start_time and generate the boxes
+   * deposited before @p end_time.
+   */
+  void advance(double const start_time, double const end_time);
+
+  /**
+   * Discard all the boxes and restart the deposition at @p start_time using the
+   * current scan paths. This needs to be called after the scan paths have been
+   * updated.
+   */
+  void reset(double const start_time);
+
+  /**
+   * Return the boxes in the current window sorted by deposition time.
+   */
+  std::vector<dealii::BoundingBox<dim>> const &get_boxes() const;
+
+  /**
+   * Return the deposition times of the boxes in the current window.
+   */
+  std::vector<double> const &get_times() const;
+
+  /**
+   * Return the cosine of the deposition angles of the boxes in the current
+   * window.
+   */
+  std::vector<double> const &get_cos() const;
+
+  /**
+   * Return the sine of the deposition angles of the boxes in the current
+   * window.
+   */
+  std::vector<double> const &get_sin() const;
+
+private:
+  /**
+   * Next box of a heat source that has not been added to the window.
+   */
+  struct Head
+  {
+    dealii::BoundingBox<dim> box;
+    double time;
+    double cos;
+    double sin;
+  };
+
+  /**
+   * Generate the next box of the ith scan path and add it to the queue.
+   */
+  void pop_next(unsigned int const i);
+
+  /**
+   * Database of the geometry.
+   */
+  boost::property_tree::ptree _geometry_database;
+  /**
+   * Heat sources whose scan paths are followed by the deposition.
+   */
+  std::vector<std::shared_ptr<HeatSource<dim>>> _heat_sources;
+  /**
+   * Flag is true if the material is deposited along the scan paths.
+   */
+  bool _along_scan_path = false;
+  /**
+   * Generators of the deposition boxes along each scan path.
+   */
+  std::vector<ScanPathDeposition<dim>> _paths;
+  /**
+   * Next box of each scan path.
+   */
+  std::vector<Head> _heads;
+  /**
+   * Min-heap of the deposition times of the heads and of the indices of the
+   * corresponding scan paths.
+   */
+  std::priority_queue<std::pair<double, unsigned int>,
+                      std::vector<std::pair<double, unsigned int>>,
+                      std::greater<std::pair<double, unsigned int>>>
+      _queue;
+  /**
+   * Boxes in the current window.
+   */
+  std::vector<dealii::BoundingBox<dim>> _boxes;
+  /**
+   * Deposition times of the boxes in the current window.
+   */
+  std::vector<double> _times;
+  /**
+   * Cosine of the deposition angles of the boxes in the current window.
+   */
+  std::vector<double> _cos;
+  /**
+   * Sine of the deposition angles of the boxes in the current window.
+   */
+  std::vector<double> _sin;
+};
+
+/**
+ * Cells to activate for a contiguous range of deposition boxes, stored in a
+ * compressed sparse row format: the cells activated by the deposition box
+ * first_box + i are cells[offsets[i]], ..., cells[offsets[i+1] - 1]. The cells
+ * are identified by their level and their index in the Triangulation. Since
+ * these do not depend on the DoFHandler, the same object can be used with
+ * every DoFHandler built on an identical mesh.
+ */
+template <int dim>
+struct ElementsToActivate
+{
+  /**
+   * Return the number of deposition boxes.
+   */
+  unsigned int n_boxes() const;
+
+  /**
+   * Return an iterator of @p dof_handler to the kth cell of the list.
+   */
+  typename dealii::DoFHandler<dim>::active_cell_iterator
+  get_cell(dealii::DoFHandler<dim> const &dof_handler,
+           unsigned int const k) const;
+
+  /**
+   * Index of the first deposition box.
+   */
+  unsigned int first_box = 0;
+  /**
+   * Offsets of the cells of each deposition box.
+   */
+  std::vector<unsigned int> offsets = {0};
+  /**
+   * Level and index of the cells to activate.
+   */
+  std::vector<std::pair<int, int>> cells;
+};
+
+/**
+ * This class finds the cells that intersect the material deposition boxes. The
+ * bounding volume hierarchy of the non-activated cells is built the first time
+ * it is needed and it is kept until the mesh changes. The non-activated cells
+ * are the cells without degrees of freedom and the quiet cells. Because the
+ * quiet cells are activated without changing the mesh, the search can return
+ * cells that have been activated since the hierarchy was built.
+ */
+template <int dim>
+class ActivationSearch
+{
+public:
+  /**
+   * Constructor. @p is_quiet returns true if a locally owned cell with
+   * degrees of freedom has no material yet. If @p is_quiet is empty, there is
+   * no quiet cell.
+   */
+  ActivationSearch(
+      dealii::DoFHandler<dim> const &dof_handler,
+      std::function<bool(
+          typename dealii::DoFHandler<dim>::active_cell_iterator const &)>
+          is_quiet = {});
+
+  /**
+   * Destructor.
+   */
+  ~ActivationSearch();
+
+  ActivationSearch(ActivationSearch<dim> const &) = delete;
+
+  ActivationSearch<dim> &operator=(ActivationSearch<dim> const &) = delete;
+
+  /**
+   * Return the locally owned cells that are not activated and that intersect
+   * the deposition boxes between @p activation_start and @p activation_end.
+   */
+  ElementsToActivate<dim> get_elements_to_activate(
+      std::vector<dealii::BoundingBox<dim>> const &material_deposition_boxes,
+      unsigned int const activation_start, unsigned int const activation_end);
+
+  /**
+   * Return true if the locally owned cells that are not activated are the same
+   * for this object and for @p other, both as cells of the mesh hierarchy and
+   * as positions in the Triangulation. When this is the case, the cells to
+   * activate are the same for both objects. Comparing only the positions is
+   * not enough because the Triangulation reuses them after coarsening.
+   */
+  bool has_same_cells(ActivationSearch<dim> &other);
+
+private:
+  /**
+   * Update the list of the locally owned cells that are not activated if the
+   * mesh has changed.
+   */
+  void update_cells();
+
+  /**
+   * DoFHandler associated with the mesh.
+   */
+  dealii::DoFHandler<dim> const &_dof_handler;
+  /**
+   * Function that returns true if a cell is quiet.
+   */
+  std::function<bool(
+      typename dealii::DoFHandler<dim>::active_cell_iterator const &)>
+      _is_quiet;
+  /**
+   * Connection to the signal of the Triangulation that is triggered every time
+   * the mesh changes.
+   */
+  boost::signals2::connection _mesh_change_connection;
+  /**
+   * Flag is true if the mesh has changed since the list of cells was built.
+   */
+  bool _cells_outdated = true;
+  /**
+   * Level and index of the locally owned cells that are not activated.
+   */
+  std::vector<std::pair<int, int>> _cells;
+  /**
+   * CellId of the locally owned cells that are not activated.
+   */
+  std::vector<dealii::CellId> _cell_ids;
+  /**
+   * Bounding volume hierarchy of the locally owned cells that are not
+   * activated. The pointer is null if the hierarchy needs to be rebuilt.
+   */
+  std::unique_ptr<dealii::ArborXWrappers::BVH> _bvh;
+};
+
 /**
  * Return the bounding boxes, the deposition times, the cosine of the deposition
  * angles, and the sine of the deposition angles.
@@ -58,13 +412,54 @@ merge_deposition_paths(
                            std::vector<double>, std::vector<double>,
                            std::vector<double>>> const &bounding_box_lists);
 /**
- * Return a vector of cells to activate for each time deposition.
+ * Return the cells to activate for each time deposition.
  */
 template <int dim>
-std::vector<std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator>>
+ElementsToActivate<dim>
 get_elements_to_activate(
     dealii::DoFHandler<dim> const &dof_handler,
     std::vector<dealii::BoundingBox<dim>> const &material_deposition_boxes);
+
+template <int dim>
+inline std::vector<dealii::BoundingBox<dim>> const &
+DepositionStream<dim>::get_boxes() const
+{
+  return _boxes;
+}
+
+template <int dim>
+inline std::vector<double> const &DepositionStream<dim>::get_times() const
+{
+  return _times;
+}
+
+template <int dim>
+inline std::vector<double> const &DepositionStream<dim>::get_cos() const
+{
+  return _cos;
+}
+
+template <int dim>
+inline std::vector<double> const &DepositionStream<dim>::get_sin() const
+{
+  return _sin;
+}
+
+template <int dim>
+inline unsigned int ElementsToActivate<dim>::n_boxes() const
+{
+  return offsets.size() - 1;
+}
+
+template <int dim>
+inline typename dealii::DoFHandler<dim>::active_cell_iterator
+ElementsToActivate<dim>::get_cell(dealii::DoFHandler<dim> const &dof_handler,
+                                  unsigned int const k) const
+{
+  return typename dealii::DoFHandler<dim>::active_cell_iterator(
+      &dof_handler.get_triangulation(), cells[k].first, cells[k].second,
+      &dof_handler);
+}
 } // namespace adamantine
 
 #endif
@@ -12,6 +12,8 @@
 #include <boost/algorithm/string/predicate.hpp>
 
 #include <algorithm>
+#include <string>
+#include <vector>
 
 namespace adamantine
 {
@@ -93,6 +95,23 @@ void validate_input_database(boost::property_tree::ptree &database)
         ASSERT_THROW(false, "Error: Unknown quadrature type.");
       }
     }
+
+    // PropertyTreeInput discretization.thermal.dof_renumbering
+    boost::optional<std::string> dof_renumbering_optional =
+        database.get_optional<std::string>(
+            "discretization.thermal.dof_renumbering");
+    if (dof_renumbering_optional)
+    {
+      std::string dof_renumbering = dof_renumbering_optional.get();
+      if (!(boost::iequals(dof_renumbering, "none") ||
+            boost::iequals(dof_renumbering, "space_filling_curve") ||
+            boost::iequals(dof_renumbering, "data_locality")))
+      {
+        ASSERT_THROW(false, "Error: Unknown DoF renumbering. Valid options "
+                            "are 'none', 'space_filling_curve', and "
+                            "'data_locality'.");
+      }
+    }
   }
 
   // Tree: geometry
@@ -151,6 +170,14 @@ void validate_input_database(boost::property_tree::ptree &database)
     }
   }
 
+  if (database.get("geometry.quiet_element_activation", false))
+  {
+    double const quiet_element_scaling =
+        database.get("geometry.quiet_element_scaling", 1e-6);
+    ASSERT_THROW((quiet_element_scaling > 0.) && (quiet_element_scaling <= 1.),
+                 "Error: The quiet element scaling must be in (0, 1].");
+  }
+
   bool import_mesh = database.get<bool>("geometry.import_mesh");
   if (import_mesh)
   {
@@ -160,6 +187,9 @@ void validate_input_database(boost::property_tree::ptree &database)
     ASSERT_THROW(database.get_child("geometry").count("mesh_format") != 0,
                  "Error: If the the mesh is imported, "
                  "'mesh_format' must be given.");
+    ASSERT_THROW(
+        database.get_child("geometry").count("domain_growth_refinements") == 0,
+        "Error: The domain growth is only supported for generated meshes.");
   }
   else
   {
@@ -175,6 +205,20 @@ void validate_input_database(boost::property_tree::ptree &database)
                    "Error: If the the mesh is not imported, "
                    "'width' must be given.");
     }
+    unsigned int const coarsening_factor =
+        1u << database.get("geometry.domain_growth_refinements", 0u);
+    std::vector<std::string> divisions_names = {"length_divisions",
+                                                "height_divisions"};
+    if (dim == 3)
+      divisions_names.push_back("width_divisions");
+    for (auto const &divisions : divisions_names)
+    {
+      ASSERT_THROW(database.get("geometry." + divisions, 10u) %
+                           coarsening_factor ==
+                       0,
+                   "Error: The number of divisions must be divisible by "
+                   "2^domain_growth_refinements.");
+    }
   }
 
   // Tree: materials
@@ -320,6 +364,50 @@ void validate_input_database(boost::property_tree::ptree &database)
                  "Error: The refinement beam cutoff must be non-negative.");
   }
 
+  boost::optional<double> load_imbalance_threshold_optional =
+      database.get_optional<double>("refinement.load_imbalance_threshold");
+  if (load_imbalance_threshold_optional)
+  {
+    double const threshold = load_imbalance_threshold_optional.get();
+    ASSERT_THROW((threshold == 0.) || (threshold > 1.),
+                 "Error: The load imbalance threshold must be greater than one "
+                 "or zero to disable the repartitioning.");
+    ASSERT_THROW((threshold == 0.) ||
+                     (database.get("memory_space", "host") == "host"),
+                 "Error: The repartitioning using measured cell costs is only "
+                 "supported on the host.");
+  }
+  boost::optional<unsigned int> time_steps_between_checks =
+      database.get_optional<unsigned int>(
+          "refinement.time_steps_between_load_imbalance_checks");
+  if (time_steps_between_checks)
+  {
+    ASSERT_THROW(time_steps_between_checks.get() > 0,
+                 "Error: The number of time steps between the load imbalance "
+                 "checks must be positive.");
+  }
+
+  if (database.get("refinement.error_estimator", false))
+  {
+    double const refine_fraction =
+        database.get("refinement.refine_fraction", 0.1);
+    double const coarsen_fraction =
+        database.get("refinement.coarsen_fraction", 0.3);
+    ASSERT_THROW((refine_fraction >= 0.) && (coarsen_fraction >= 0.) &&
+                     (refine_fraction + coarsen_fraction <= 1.),
+                 "Error: The refine and coarsen fractions must be non-negative "
+                 "and their sum must not exceed one.");
+    ASSERT_THROW(database.get("memory_space", "host") == "host",
+                 "Error: The error estimator is only supported on the host.");
+  }
+
+  for (std::string const distance : {"lead_distance", "trailing_distance"})
+  {
+    ASSERT_THROW(database.get("refinement." + distance, 0.) >= 0.,
+                 "Error: The refinement " + distance +
+                     " must be non-negative.");
+  }
+
   // Tree: sources
   unsigned int n_beams = database.get<unsigned int>("sources.n_beams");
   for (unsigned int beam_index = 0; beam_index < n_beams; ++beam_index)
@@ -458,6 +546,36 @@ void validate_input_database(boost::property_tree::ptree &database)
                  "must be non-negative.");
   }
 
+  if (database.get("ensemble.shared_mesh", false))
+  {
+    ASSERT_THROW(database.count("restart") == 0,
+                 "Error: Restarting is not supported when the ensemble members "
+                 "share the mesh.");
+  }
+
+  boost::optional<double> member_imbalance_threshold_optional =
+      database.get_optional<double>("ensemble.load_imbalance_threshold");
+  if (member_imbalance_threshold_optional)
+  {
+    double const threshold = member_imbalance_threshold_optional.get();
+    ASSERT_THROW((threshold == 0.) || (threshold > 1.),
+                 "Error: The ensemble load imbalance threshold must be greater "
+                 "than one or zero to disable the migration of the members.");
+    ASSERT_THROW((threshold == 0.) ||
+                     !database.get("ensemble.shared_mesh", false),
+                 "Error: The ensemble members cannot be migrated when they "
+                 "share the mesh.");
+  }
+  boost::optional<unsigned int> time_steps_between_balancing =
+      database.get_optional<unsigned int>(
+          "ensemble.time_steps_between_balancing");
+  if (time_steps_between_balancing)
+  {
+    ASSERT_THROW(time_steps_between_balancing.get() > 0,
+                 "Error: The number of time steps between the balancing of "
+                 "the ensemble members must be positive.");
+  }
+
   // Tree: data_assimilation
   boost::optional<double> convergence_tolerance =
       database.get_optional<double>("data_assimilation.convergence_tolerance");
@@ -479,5 +597,16 @@ void validate_input_database(boost::property_tree::ptree &database)
                  "Error: Unknown localization cutoff function. Valid options "
                  "are 'gaspari_cohn', 'step_function', and 'none'.");
   }
+
+  std::string analysis_str = database.get("data_assimilation.analysis", "enkf");
+  ASSERT_THROW(boost::iequals(analysis_str, "enkf") ||
+                   boost::iequals(analysis_str, "etkf") ||
+                   boost::iequals(analysis_str, "letkf"),
+               "Error: Unknown analysis scheme. Valid options are 'enkf', "
+               "'etkf', and 'letkf'.");
+
+  ASSERT_THROW(
+      database.get("data_assimilation.frames_per_analysis", 1u) > 0,
+      "Error: The number of frames per analysis must be greater than zero.");
 }
 } // namespace adamantine
@@ -0,0 +1,195 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+// Measure the time spent in ThermalOperator::vmult on an adapted mesh for
+// every DoFOrdering. This is not a unit test and it is not run by ctest. The
+// benchmark needs scan_path.txt in the working directory. The optional
+// arguments are the number of vmults and the number of cells in the x
+// direction.
+
+#include <Geometry.hh>
+#include <GoldakHeatSource.hh>
+#include <MaterialStates.hh>
+#include <ThermalOperator.hh>
+#include <dof_renumbering.hh>
+
+#include <deal.II/base/function.h>
+#include <deal.II/base/mpi.h>
+#include <deal.II/base/quadrature_lib.h>
+#include <deal.II/dofs/dof_tools.h>
+#include <deal.II/fe/fe_nothing.h>
+#include <deal.II/fe/fe_q.h>
+#include <deal.II/grid/filtered_iterator.h>
+#include <deal.II/numerics/vector_tools.h>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[])
+{
+  dealii::Utilities::MPI::MPI_InitFinalize mpi_initialization(
+      argc, argv, dealii::numbers::invalid_unsigned_int);
+  MPI_Comm communicator = MPI_COMM_WORLD;
+  bool const is_root =
+      dealii::Utilities::MPI::this_mpi_process(communicator) == 0;
+
+  unsigned int const n_vmults = argc > 1 ? std::stoi(argv[1]) : 100;
+  unsigned int const length_divisions = argc > 2 ? std::stoi(argv[2]) : 192;
+
+  // Create an adapted mesh with hanging nodes. A quarter of the domain is
+  // refined twice and the cells around it are refined once.
+  boost::property_tree::ptree geometry_database;
+  geometry_database.put("import_mesh", false);
+  geometry_database.put("length", 12);
+  geometry_database.put("length_divisions", length_divisions);
+  geometry_database.put("height", 6);
+  geometry_database.put("height_divisions", length_divisions / 2);
+  adamantine::Geometry<2> geometry(communicator, geometry_database);
+  auto &triangulation = geometry.get_triangulation();
+  for (unsigned int level = 0; level < 2; ++level)
+  {
+    for (auto const &cell : dealii::filter_iterators(
+             triangulation.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell()))
+    {
+      double const margin = level == 0 ? 1. : 0.;
+      if ((cell->center()[0] < 6. + margin) &&
+          (cell->center()[1] > 3. - margin))
+        cell->set_refine_flag();
+    }
+    triangulation.execute_coarsening_and_refinement();
+  }
+
+  dealii::hp::FECollection<2> fe_collection;
+  fe_collection.push_back(dealii::FE_Q<2>(2));
+  fe_collection.push_back(dealii::FE_Nothing<2>());
+  dealii::DoFHandler<2> dof_handler(triangulation);
+  dealii::AffineConstraints<double> affine_constraints;
+  dealii::hp::QCollection<1> q_collection;
+  q_collection.push_back(dealii::QGauss<1>(3));
+  q_collection.push_back(dealii::QGauss<1>(1));
+
+  // Create the MaterialProperty
+  boost::property_tree::ptree mat_prop_database;
+  mat_prop_database.put("property_format", "polynomial");
+  mat_prop_database.put("n_materials", 1);
+  mat_prop_database.put("material_0.solid.density", 1.);
+  mat_prop_database.put("material_0.powder.density", 1.);
+  mat_prop_database.put("material_0.liquid.density", 1.);
+  mat_prop_database.put("material_0.solid.specific_heat", 1.);
+  mat_prop_database.put("material_0.powder.specific_heat", 1.);
+  mat_prop_database.put("material_0.liquid.specific_heat", 1.);
+  mat_prop_database.put("material_0.solid.thermal_conductivity_x", 10.);
+  mat_prop_database.put("material_0.solid.thermal_conductivity_z", 10.);
+  mat_prop_database.put("material_0.powder.thermal_conductivity_x", 10.);
+  mat_prop_database.put("material_0.powder.thermal_conductivity_z", 10.);
+  mat_prop_database.put("material_0.liquid.thermal_conductivity_x", 10.);
+  mat_prop_database.put("material_0.liquid.thermal_conductivity_z", 10.);
+  adamantine::MaterialProperty<2, 1, adamantine::SolidLiquidPowder,
+                               dealii::MemorySpace::Host>
+      mat_properties(communicator, triangulation, mat_prop_database);
+
+  // Create the heat sources
+  boost::property_tree::ptree beam_database;
+  beam_database.put("depth", 0.1);
+  beam_database.put("absorption_efficiency", 0.1);
+  beam_database.put("diameter", 1.0);
+  beam_database.put("max_power", 0.);
+  beam_database.put("scan_path_file", "scan_path.txt");
+  beam_database.put("scan_path_file_format", "segment");
+  std::vector<std::shared_ptr<adamantine::HeatSource<2>>> heat_sources;
+  heat_sources.resize(1);
+  heat_sources[0] =
+      std::make_shared<adamantine::GoldakHeatSource<2>>(beam_database);
+  heat_sources[0]->update_time(0.);
+
+  adamantine::ThermalOperator<2, false, 1, 2, adamantine::SolidLiquidPowder,
+                              dealii::MemorySpace::Host>
+      thermal_operator(communicator, adamantine::BoundaryType::adiabatic,
+                       mat_properties, heat_sources);
+  std::vector<double> deposition_cos(
+      triangulation.n_locally_owned_active_cells(), 1.);
+  std::vector<double> deposition_sin(
+      triangulation.n_locally_owned_active_cells(), 0.);
+
+  dealii::ScalarFunctionFromFunctionObject<2> function(
+      [](dealii::Point<2> const &p) { return p[0] + 2. * p[1] * p[1]; });
+
+  if (is_root)
+    std::cout << "Number of active cells: "
+              << triangulation.n_global_active_cells() << std::endl;
+
+  for (auto const dof_ordering : {adamantine::DoFOrdering::none,
+                                  adamantine::DoFOrdering::space_filling_curve,
+                                  adamantine::DoFOrdering::data_locality})
+  {
+    dof_handler.distribute_dofs(fe_collection);
+    auto make_constraints = [&]()
+    {
+      dealii::IndexSet locally_relevant_dofs;
+      dealii::DoFTools::extract_locally_relevant_dofs(dof_handler,
+                                                      locally_relevant_dofs);
+      affine_constraints.clear();
+      affine_constraints.reinit(locally_relevant_dofs);
+      dealii::DoFTools::make_hanging_node_constraints(dof_handler,
+                                                      affine_constraints);
+      affine_constraints.close();
+    };
+    make_constraints();
+    adamantine::renumber_dofs(dof_ordering, dof_handler, affine_constraints);
+    make_constraints();
+
+    thermal_operator.reinit(dof_handler, affine_constraints, q_collection);
+    thermal_operator.set_material_deposition_orientation(deposition_cos,
+                                                         deposition_sin);
+    thermal_operator.compute_inverse_mass_matrix(dof_handler,
+                                                 affine_constraints);
+    thermal_operator.get_state_from_material_properties();
+
+    dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host> src;
+    dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host> dst;
+    dealii::MatrixFree<2, double> const &matrix_free =
+        thermal_operator.get_matrix_free();
+    matrix_free.initialize_dof_vector(src);
+    matrix_free.initialize_dof_vector(dst);
+    dealii::VectorTools::interpolate(dof_handler, function, src);
+    affine_constraints.distribute(src);
+
+    // Warm up
+    thermal_operator.vmult(dst, src);
+
+    MPI_Barrier(communicator);
+    auto const start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < n_vmults; ++i)
+      thermal_operator.vmult(dst, src);
+    auto const end = std::chrono::steady_clock::now();
+    double const seconds = dealii::Utilities::MPI::max(
+        std::chrono::duration<double>(end - start).count(), communicator);
+
+    // The bandwidth is estimated from the reads of the source vector and the
+    // writes of the destination vector. The accesses to the inverse mass
+    // matrix, the material state, and the geometry are not counted, so this
+    // is a lower bound.
+    double const gbytes = 2. * n_vmults * dst.size() * sizeof(double) / 1e9;
+    if (is_root)
+    {
+      std::string const name =
+          dof_ordering == adamantine::DoFOrdering::none ? "none"
+          : dof_ordering == adamantine::DoFOrdering::space_filling_curve
+              ? "space_filling_curve"
+              : "data_locality";
+      std::cout << "DoF ordering " << name << ": " << seconds / n_vmults
+                << " s per vmult, " << gbytes / seconds << " GB/s"
+                << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,64 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE CellCostModel
+
+#include <CellCostModel.hh>
+
+#include <deal.II/base/mpi.h>
+
+#include "main.cc"
+
+namespace utf = boost::unit_test;
+
+namespace adamantine
+{
+BOOST_AUTO_TEST_CASE(cell_cost_model, *utf::tolerance(1e-12))
+{
+  MPI_Comm communicator = MPI_COMM_WORLD;
+  unsigned int const rank =
+      dealii::Utilities::MPI::this_mpi_process(communicator);
+  unsigned int const n_procs =
+      dealii::Utilities::MPI::n_mpi_processes(communicator);
+
+  CellCostModel cell_cost_model(communicator);
+
+  // Without timings, every cell has the same cost and the load is balanced.
+  BOOST_TEST(cell_cost_model.get_cell_cost(CellCostModel::Category::regular) ==
+             1.);
+  BOOST_TEST(
+      cell_cost_model.get_cell_cost(CellCostModel::Category::heat_source) ==
+      1.);
+  BOOST_TEST(cell_cost_model.get_face_cost() == 0.);
+  BOOST_TEST(cell_cost_model.get_imbalance() == 1.);
+
+  // Only the first processor has cells under the heat source.
+  cell_cost_model.add_cell_timing(CellCostModel::Category::regular, 10, 1.);
+  cell_cost_model.add_face_timing(4, 0.2);
+  if (rank == 0)
+    cell_cost_model.add_cell_timing(CellCostModel::Category::heat_source, 2,
+                                    0.6);
+  double const avg_time = 1.2 + 0.6 / n_procs;
+  BOOST_TEST(cell_cost_model.get_imbalance() == 1.8 / avg_time);
+
+  cell_cost_model.calibrate();
+  BOOST_TEST(cell_cost_model.get_cell_cost(CellCostModel::Category::regular) ==
+             1.);
+  BOOST_TEST(
+      cell_cost_model.get_cell_cost(CellCostModel::Category::heat_source) ==
+      3.);
+  BOOST_TEST(
+      cell_cost_model.get_cell_cost(CellCostModel::Category::phase_change) ==
+      1.);
+  BOOST_TEST(cell_cost_model.get_face_cost() == 0.5);
+
+  // The costs are kept after the timings are discarded.
+  cell_cost_model.reset();
+  BOOST_TEST(cell_cost_model.get_imbalance() == 1.);
+  BOOST_TEST(cell_cost_model.get_face_cost() == 0.5);
+}
+} // namespace adamantine
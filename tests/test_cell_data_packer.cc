@@ -0,0 +1,126 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE CellDataPacker
+
+#include <CellDataPacker.hh>
+#include <MaterialStates.hh>
+
+#include <deal.II/distributed/cell_data_transfer.templates.h>
+#include <deal.II/distributed/tria.h>
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/fe/fe_nothing.h>
+#include <deal.II/fe/fe_q.h>
+#include <deal.II/grid/grid_generator.h>
+#include <deal.II/hp/fe_collection.h>
+
+#include "main.cc"
+
+namespace adamantine
+{
+BOOST_AUTO_TEST_CASE(cell_data_packer)
+{
+  int constexpr dim = 2;
+  using Packer =
+      CellDataPacker<dim, SolidLiquidPowder, dealii::MemorySpace::Host>;
+  using Payload = Packer::Payload;
+  unsigned int constexpr n_material_states =
+      SolidLiquidPowder::n_material_states;
+
+  MPI_Comm communicator = MPI_COMM_WORLD;
+  dealii::parallel::distributed::Triangulation<dim> triangulation(communicator);
+  dealii::GridGenerator::hyper_cube(triangulation);
+  triangulation.refine_global(3);
+  dealii::hp::FECollection<dim> fe_collection;
+  fe_collection.push_back(dealii::FE_Q<dim>(1));
+  fe_collection.push_back(dealii::FE_Nothing<dim>());
+  dealii::DoFHandler<dim> dof_handler(triangulation);
+  for (auto const &cell : dealii::filter_iterators(
+           dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    if (cell->center()[1] > 0.5)
+      cell->set_active_fe_index(1);
+  }
+  dof_handler.distribute_dofs(fe_collection);
+
+  // Fill the data of the locally owned cells
+  unsigned int const n_cells = triangulation.n_locally_owned_active_cells();
+  Packer::StateView state("state", n_material_states, n_cells);
+  std::vector<double> deposition_cos;
+  std::vector<double> deposition_sin;
+  std::vector<bool> has_melted;
+  unsigned int cell_id = 0;
+  for (auto const &cell : dealii::filter_iterators(
+           dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    for (unsigned int i = 0; i < n_material_states; ++i)
+      state(i, cell_id) = cell->center()[0] + i;
+    if (cell->active_fe_index() == 0)
+    {
+      deposition_cos.push_back(cell->center()[0]);
+      deposition_sin.push_back(cell->center()[1]);
+      has_melted.push_back(cell_id % 2 == 0);
+    }
+    ++cell_id;
+  }
+
+  Packer cell_data_packer(dof_handler);
+  auto &buffer = cell_data_packer.pack(state, deposition_cos, deposition_sin,
+                                       has_melted);
+  BOOST_TEST(buffer.size() == triangulation.n_active_cells());
+  for (auto const &cell : dealii::filter_iterators(
+           dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    auto const &payload = cell_data_packer[cell];
+    BOOST_TEST(payload[Payload::fe_index] == cell->active_fe_index());
+    for (unsigned int i = 0; i < n_material_states; ++i)
+      BOOST_TEST(payload[i] == cell->center()[0] + i);
+  }
+
+  // Refine every cell and transfer the data to the children
+  dealii::parallel::distributed::CellDataTransfer<dim, dim, Packer::Buffer>
+      cell_data_trans(triangulation);
+  triangulation.set_all_refine_flags();
+  triangulation.prepare_coarsening_and_refinement();
+  cell_data_trans.prepare_for_coarsening_and_refinement(buffer);
+  triangulation.execute_coarsening_and_refinement();
+  dof_handler.distribute_dofs(fe_collection);
+  cell_data_trans.unpack(cell_data_packer.prepare_unpack());
+
+  unsigned int const n_new_cells = triangulation.n_locally_owned_active_cells();
+  Packer::StateView new_state("new_state", n_material_states, n_new_cells);
+  std::vector<double> new_deposition_cos;
+  std::vector<double> new_deposition_sin;
+  std::vector<bool> new_has_melted;
+  cell_data_packer.unpack(new_state, new_deposition_cos, new_deposition_sin,
+                          new_has_melted);
+
+  // The children have the data of their parent
+  unsigned int n_activated_cells = 0;
+  cell_id = 0;
+  for (auto const &cell : dealii::filter_iterators(
+           dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    auto const parent_center = cell->parent()->center();
+    for (unsigned int i = 0; i < n_material_states; ++i)
+      BOOST_TEST(new_state(i, cell_id) == parent_center[0] + i);
+    if (cell->active_fe_index() == 0)
+    {
+      BOOST_TEST(new_deposition_cos[n_activated_cells] == parent_center[0]);
+      BOOST_TEST(new_deposition_sin[n_activated_cells] == parent_center[1]);
+      ++n_activated_cells;
+    }
+    ++cell_id;
+  }
+  BOOST_TEST(new_deposition_cos.size() == n_activated_cells);
+  BOOST_TEST(new_has_melted.size() == n_activated_cells);
+}
+} // namespace adamantine
@@ -13,6 +13,8 @@
 #include <deal.II/fe/fe_q.h>
 #include <deal.II/lac/la_parallel_vector.h>
 
+#include <limits>
+
 #include "main.cc"
 
 namespace tt = boost::test_tools;
@@ -88,6 +90,7 @@ public:
     da._num_ensemble_members = 3;
     da.update_dof_mapping<2>(expt_to_dof_mapping);
     da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
+    da.update_expt_support_points();
 
     // Create the simulation data
     std::vector<dealii::LA::distributed::BlockVector<double>>
@@ -125,17 +128,26 @@ public:
     R.add(0, 0, 0.002);
     R.add(1, 1, 0.001);
 
+    // With a single processor, the slice is the whole augmented state
+    std::vector<dealii::Vector<double>> slice_ensemble(3);
+    for (unsigned int sample = 0; sample < slice_ensemble.size(); ++sample)
+    {
+      slice_ensemble[sample].reinit(sim_size);
+      for (unsigned int i = 0; i < sim_size; ++i)
+        slice_ensemble[sample][i] = augmented_state_ensemble[sample][i];
+    }
+
     // Create the (perturbed) innovation
+    std::vector<dealii::Vector<double>> HX(3);
     std::vector<dealii::Vector<double>> perturbed_innovation(3);
     for (unsigned int sample = 0; sample < perturbed_innovation.size();
          ++sample)
     {
       perturbed_innovation[sample].reinit(expt_size);
-      dealii::Vector<double> temp =
-          da.calc_Hx(augmented_state_ensemble[sample].block(0));
+      HX[sample] = da.calc_Hx(augmented_state_ensemble[sample].block(0));
       for (unsigned int i = 0; i < expt_size; ++i)
       {
-        perturbed_innovation[sample][i] = expt_vec[i] - temp[i];
+        perturbed_innovation[sample][i] = expt_vec[i] - HX[sample][i];
       }
     }
 
@@ -147,8 +159,8 @@ public:
     perturbed_innovation[2][1] = perturbed_innovation[2][1] - 0.0009;
 
     // Apply the Kalman gain
-    std::vector<dealii::LA::distributed::BlockVector<double>> forecast_shift =
-        da.apply_kalman_gain(augmented_state_ensemble, R, perturbed_innovation);
+    std::vector<dealii::Vector<double>> forecast_shift =
+        da.apply_kalman_gain(slice_ensemble, HX, R, perturbed_innovation);
 
     double tol = 1.0e-4;
 
@@ -167,6 +179,138 @@ public:
     BOOST_TEST(forecast_shift[2][3] == 0.34824753, tt::tolerance(tol));
   };
 
+  void test_ensemble_transform()
+  {
+    MPI_Comm communicator = MPI_COMM_WORLD;
+
+    boost::property_tree::ptree database;
+    database.put("import_mesh", false);
+    database.put("length", 1);
+    database.put("length_divisions", 1);
+    database.put("height", 1);
+    database.put("height_divisions", 1);
+    adamantine::Geometry<2> geometry(communicator, database);
+    dealii::parallel::distributed::Triangulation<2> const &tria =
+        geometry.get_triangulation();
+
+    dealii::FE_Q<2> fe(1);
+    dealii::DoFHandler<2> dof_handler(tria);
+    dof_handler.distribute_dofs(fe);
+
+    unsigned int const sim_size = 4;
+    unsigned int const expt_size = 2;
+    unsigned int const n_members = 3;
+    std::vector<double> expt_data = {2.5, 9.5};
+
+    std::pair<std::vector<int>, std::vector<int>> expt_to_dof_mapping;
+    expt_to_dof_mapping.first = {0, 1};
+    expt_to_dof_mapping.second = {1, 3};
+
+    boost::property_tree::ptree da_database;
+    da_database.put("analysis", "etkf");
+    DataAssimilator da(communicator, communicator, 0, da_database);
+    BOOST_TEST((da._analysis_scheme == AnalysisScheme::etkf));
+    da._num_ensemble_members = n_members;
+    da.update_dof_mapping<2>(expt_to_dof_mapping);
+    da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
+    da.update_expt_support_points();
+
+    std::vector<std::vector<double>> const members = {
+        {1.0, 3.0, 6.0, 9.0}, {1.5, 3.2, 6.3, 9.7}, {1.1, 3.1, 6.1, 9.1}};
+    std::vector<dealii::Vector<double>> slice_ensemble(n_members);
+    std::vector<dealii::Vector<double>> HX(n_members);
+    for (unsigned int k = 0; k < n_members; ++k)
+    {
+      slice_ensemble[k] =
+          dealii::Vector<double>(members[k].begin(), members[k].end());
+      HX[k].reinit(expt_size);
+      HX[k][0] = members[k][1];
+      HX[k][1] = members[k][3];
+    }
+
+    dealii::SparsityPattern pattern(expt_size, expt_size, 1);
+    pattern.add(0, 0);
+    pattern.add(1, 1);
+    pattern.compress();
+    dealii::SparseMatrix<double> R(pattern);
+    R.add(0, 0, 0.002);
+    R.add(1, 1, 0.001);
+
+    auto increments =
+        da.apply_ensemble_transform(slice_ensemble, HX, R, expt_data);
+
+    // The mean of the analysis is the mean of the forecast updated with the
+    // Kalman gain K = P H^T (H P H^T + R)^-1
+    dealii::FullMatrix<double> PH = da.calc_slice_covariance(slice_ensemble, HX);
+    dealii::FullMatrix<double> S = da.calc_expt_covariance(HX);
+    S(0, 0) += 0.002;
+    S(1, 1) += 0.001;
+    S.gauss_jordan();
+    dealii::FullMatrix<double> K(sim_size, expt_size);
+    PH.mmult(K, S);
+    dealii::Vector<double> innovation(expt_size);
+    for (unsigned int k = 0; k < n_members; ++k)
+      for (unsigned int j = 0; j < expt_size; ++j)
+        innovation[j] += (expt_data[j] - HX[k][j]) / n_members;
+    dealii::Vector<double> mean_increment(sim_size);
+    K.vmult(mean_increment, innovation);
+
+    double const tol = 1e-8;
+    std::vector<dealii::Vector<double>> analysis(n_members);
+    std::vector<dealii::Vector<double>> analysis_HX(n_members);
+    for (unsigned int i = 0; i < sim_size; ++i)
+    {
+      double increment = 0.;
+      for (unsigned int k = 0; k < n_members; ++k)
+        increment += increments[k][i] / n_members;
+      BOOST_TEST(increment == mean_increment[i], tt::tolerance(tol));
+    }
+
+    // The analysis covariance is (I - K H) P
+    for (unsigned int k = 0; k < n_members; ++k)
+    {
+      analysis[k] = slice_ensemble[k];
+      analysis[k] += increments[k];
+      analysis_HX[k].reinit(expt_size);
+      analysis_HX[k][0] = analysis[k][1];
+      analysis_HX[k][1] = analysis[k][3];
+    }
+    dealii::FullMatrix<double> analysis_PH =
+        da.calc_slice_covariance(analysis, analysis_HX);
+    dealii::FullMatrix<double> HPH = da.calc_expt_covariance(HX);
+    dealii::FullMatrix<double> KHPH(sim_size, expt_size);
+    K.mmult(KHPH, HPH);
+    for (unsigned int i = 0; i < sim_size; ++i)
+      for (unsigned int j = 0; j < expt_size; ++j)
+        BOOST_TEST(analysis_PH(i, j) == PH(i, j) - KHPH(i, j),
+                   tt::tolerance(1e-6));
+
+    // Without localization, the LETKF is the ETKF
+    da._analysis_scheme = AnalysisScheme::letkf;
+    da._localization_cutoff_distance = 100.;
+    da._localization_cutoff_function = LocalizationCutoff::step_function;
+    da.update_localization_pattern();
+    auto local_increments =
+        da.apply_ensemble_transform(slice_ensemble, HX, R, expt_data);
+    for (unsigned int k = 0; k < n_members; ++k)
+      for (unsigned int i = 0; i < sim_size; ++i)
+        BOOST_TEST(local_increments[k][i] == increments[k][i],
+                   tt::tolerance(tol));
+
+    // With a very short localization, only the observed entries are updated
+    da._localization_cutoff_distance = 1e-6;
+    da.update_localization_pattern();
+    local_increments =
+        da.apply_ensemble_transform(slice_ensemble, HX, R, expt_data);
+    for (unsigned int k = 0; k < n_members; ++k)
+    {
+      BOOST_TEST(local_increments[k][0] == 0.);
+      BOOST_TEST(local_increments[k][1] != 0.);
+      BOOST_TEST(local_increments[k][2] == 0.);
+      BOOST_TEST(local_increments[k][3] != 0.);
+    }
+  }
+
   void test_update_dof_mapping()
   {
     unsigned int sim_size = 4;
@@ -327,35 +471,140 @@ public:
     dealii::DoFHandler<2> dof_handler(tria);
     dof_handler.distribute_dofs(fe);
 
-    // Effectively a dense matrix
     boost::property_tree::ptree solver_settings_database;
     DataAssimilator da(communicator, communicator, 0, solver_settings_database);
-    da._localization_cutoff_distance = 100.0;
-    da._localization_cutoff_function = LocalizationCutoff::step_function;
     da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
-    BOOST_TEST(da._covariance_sparsity_pattern.n_nonzero_elements() == 81u);
 
-    // Sparse diagonal matrix
+    // With a single processor, the slice is the whole augmented state
+    BOOST_TEST(da._slice_offsets.size() == 2u);
+    BOOST_TEST(da._slice_offsets[0] == 0u);
+    BOOST_TEST(da._slice_offsets[1] == 9u);
+    BOOST_TEST(da._slice_support_points.size() == 9u);
+    auto [dof_indices, support_points] =
+        get_dof_to_support_mapping(dof_handler);
+    for (unsigned int i = 0; i < dof_indices.size(); ++i)
+    {
+      auto const &point = da._slice_support_points[dof_indices[i]];
+      BOOST_TEST(point[0] == support_points[i][0]);
+      BOOST_TEST(point[1] == support_points[i][1]);
+      BOOST_TEST(point[2] == 0.);
+    }
+    BOOST_TEST(da.get_slice_owner(8) == 0u);
+
+    // Nothing is recomputed if the dofs did not change
+    da._slice_support_points[0] = dealii::Point<3>(-1., -1., -1.);
+    da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
+    BOOST_TEST(da._slice_support_points[0][0] == -1.);
+
+    // The augmentation parameters belong to the slice but they don't have a
+    // support point
+    da.update_covariance_sparsity_pattern<2>(dof_handler, 2);
+    BOOST_TEST(da._slice_offsets[1] == 11u);
+    BOOST_TEST(da._slice_support_points.size() == 9u);
+    BOOST_TEST(da.get_slice_owner(10) == 0u);
+
+    // The support points of the observations are the support points of the
+    // observed dofs
+    std::pair<std::vector<int>, std::vector<int>> expt_to_dof_mapping;
+    expt_to_dof_mapping.first = {0, 1};
+    expt_to_dof_mapping.second = {static_cast<int>(dof_indices[4]),
+                                  static_cast<int>(dof_indices[7])};
+    da.update_dof_mapping<2>(expt_to_dof_mapping);
+    da.update_expt_support_points();
+    BOOST_TEST(da._expt_support_points.size() == 2u);
+    BOOST_TEST(da._expt_support_points[0][0] == support_points[4][0]);
+    BOOST_TEST(da._expt_support_points[0][1] == support_points[4][1]);
+    BOOST_TEST(da._expt_support_points[1][0] == support_points[7][0]);
+    BOOST_TEST(da._expt_support_points[1][1] == support_points[7][1]);
+    BOOST_TEST(!da._expt_support_points_outdated);
+
+    // The localization pattern is rebuilt when the localization changes
+    BOOST_TEST(da._localization_weights.size() == 0u);
     da._localization_cutoff_distance = 1.0e-6;
     da._localization_cutoff_function = LocalizationCutoff::step_function;
-    da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
-    BOOST_TEST(da._covariance_sparsity_pattern.n_nonzero_elements() == 9u);
+    da.update_dof_mapping<2>(expt_to_dof_mapping);
+    BOOST_TEST(!da._expt_support_points_outdated);
+    da.update_expt_support_points();
+    BOOST_TEST(da._localization_weights.size() == 2u);
+
+    // Only the rows of the entries whose support point moved are recomputed
+    unsigned int const moved_row = dof_indices[4];
+    unsigned int const new_row = dof_indices[0];
+    unsigned int const kept_row = dof_indices[7];
+    da._slice_support_points[moved_row] = dealii::Point<3>(2., 2., 0.);
+    da._slice_support_points[new_row] = da._expt_support_points[1];
+    da.update_expt_support_points();
+    auto const &row_offsets = da._localization_row_offsets;
+    BOOST_TEST(row_offsets.size() == 10u);
+    BOOST_TEST(da._localization_weights.size() == 2u);
+    BOOST_TEST(row_offsets[moved_row + 1] == row_offsets[moved_row]);
+    BOOST_TEST(row_offsets[new_row + 1] - row_offsets[new_row] == 1u);
+    BOOST_TEST(da._localization_columns[row_offsets[new_row]] == 1u);
+    BOOST_TEST(row_offsets[kept_row + 1] - row_offsets[kept_row] == 1u);
+    BOOST_TEST(da._localization_columns[row_offsets[kept_row]] == 1u);
+
+    // Number of nonzero entries of the localized covariance P. Every dof is
+    // observed so that P H^T is made of the columns of P associated with the
+    // dofs. The other entries of P are known by symmetry, and the block of
+    // the parameters, which is not localized, is dense.
+    std::pair<std::vector<int>, std::vector<int>> all_dofs_mapping;
+    for (int i = 0; i < 9; ++i)
+    {
+      all_dofs_mapping.first.push_back(i);
+      all_dofs_mapping.second.push_back(i);
+    }
+    DataAssimilator cov_da(communicator, communicator, 0,
+                           solver_settings_database);
+    cov_da._num_ensemble_members = 2;
+    cov_da.update_dof_mapping<2>(all_dofs_mapping);
+    auto count_nonzeros =
+        [&](double const cutoff_distance, unsigned int const parameter_size)
+    {
+      cov_da._localization_cutoff_distance = cutoff_distance;
+      cov_da._localization_cutoff_function = LocalizationCutoff::step_function;
+      cov_da.update_covariance_sparsity_pattern<2>(dof_handler, parameter_size);
+      cov_da.update_expt_support_points();
+
+      // The anomalies of all the entries are nonzero
+      std::vector<dealii::Vector<double>> ensemble(
+          2, dealii::Vector<double>(9 + parameter_size));
+      std::vector<dealii::Vector<double>> HX(2, dealii::Vector<double>(9));
+      for (unsigned int i = 0; i < 9 + parameter_size; ++i)
+      {
+        ensemble[0][i] = i;
+        ensemble[1][i] = 2. * i + 1.;
+      }
+      for (unsigned int i = 0; i < 9; ++i)
+      {
+        HX[0][i] = ensemble[0][i];
+        HX[1][i] = ensemble[1][i];
+      }
+
+      auto const cov = cov_da.calc_slice_covariance(ensemble, HX);
+      unsigned int n_nonzeros = parameter_size * parameter_size;
+      for (unsigned int i = 0; i < cov.m(); ++i)
+        for (unsigned int j = 0; j < cov.n(); ++j)
+          if (cov(i, j) != 0.)
+            n_nonzeros += i < 9 ? 1 : 2;
+
+      return n_nonzeros;
+    };
+
+    // Effectively a dense matrix
+    BOOST_TEST(count_nonzeros(100.0, 0) == 81u);
+
+    // Sparse diagonal matrix
+    BOOST_TEST(count_nonzeros(1.0e-6, 0) == 9u);
 
     // More general sparse matrix, cuts off interactions between the corners
     // of the domain
-    da._localization_cutoff_distance = 1.2;
-    da._localization_cutoff_function = LocalizationCutoff::step_function;
-    da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
-    BOOST_TEST(da._covariance_sparsity_pattern.n_nonzero_elements() == 77u);
+    BOOST_TEST(count_nonzeros(1.2, 0) == 77u);
 
     // Sparse diagonal matrix with two augmentation parameters
-    da._localization_cutoff_distance = 1.0e-6;
-    da._localization_cutoff_function = LocalizationCutoff::step_function;
-    da.update_covariance_sparsity_pattern<2>(dof_handler, 2);
-    BOOST_TEST(da._covariance_sparsity_pattern.n_nonzero_elements() == 49u);
+    BOOST_TEST(count_nonzeros(1.0e-6, 2) == 49u);
   }
 
-  void test_calc_sample_covariance_sparse()
+  void test_calc_slice_covariance()
   {
     MPI_Comm communicator = MPI_COMM_WORLD;
 
@@ -373,16 +622,20 @@ public:
     dealii::DoFHandler<2> dof_handler(tria);
     dof_handler.distribute_dofs(fe);
 
+    // Every dof is observed so that P H^T and H P H^T are both equal to P
+    std::pair<std::vector<int>, std::vector<int>> expt_to_dof_mapping;
+    expt_to_dof_mapping.first = {0, 1, 2, 3};
+    expt_to_dof_mapping.second = {0, 1, 2, 3};
+
     // Trivial case of identical vectors, effectively dense, covariance should
     // be the zero matrix
-    dealii::LA::distributed::BlockVector<double> sim_vec(1,
-                                                         dof_handler.n_dofs());
+    dealii::Vector<double> sim_vec(dof_handler.n_dofs());
     sim_vec[0] = 2.0;
     sim_vec[1] = 4.0;
     sim_vec[2] = 5.0;
     sim_vec[3] = 7.0;
 
-    std::vector<dealii::LA::distributed::BlockVector<double>> vec_ensemble;
+    std::vector<dealii::Vector<double>> vec_ensemble;
     vec_ensemble.push_back(sim_vec);
     vec_ensemble.push_back(sim_vec);
 
@@ -391,12 +644,13 @@ public:
     solver_settings_database.put("localization_cutoff_function",
                                  "step_function");
     DataAssimilator da(communicator, communicator, 0, solver_settings_database);
-    da._sim_size = sim_vec.size();
     da._num_ensemble_members = vec_ensemble.size();
-
+    da.update_dof_mapping<2>(expt_to_dof_mapping);
     da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
+    da.update_expt_support_points();
 
-    auto cov = da.calc_sample_covariance_sparse(vec_ensemble);
+    auto cov = da.calc_slice_covariance(vec_ensemble, vec_ensemble);
+    auto expt_cov = da.calc_expt_covariance(vec_ensemble);
 
     // Check results
     double tol = 1e-10;
@@ -404,104 +658,83 @@ public:
     {
       for (unsigned int j = 0; j < 4; ++j)
       {
-        BOOST_TEST(cov.el(i, j) == 0., tt::tolerance(tol));
+        BOOST_TEST(cov(i, j) == 0., tt::tolerance(tol));
+        BOOST_TEST(expt_cov(i, j) == 0., tt::tolerance(tol));
       }
     }
 
     // Non-trivial case, still effectively dense, using NumPy solution as the
     // reference
-    dealii::LA::distributed::BlockVector<double> sim_vec1(1,
-                                                          dof_handler.n_dofs());
+    dealii::Vector<double> sim_vec1(dof_handler.n_dofs());
     sim_vec1(0) = 2.1;
     sim_vec1(1) = 4.3;
     sim_vec1(2) = 5.2;
     sim_vec1(3) = 7.4;
 
-    std::vector<dealii::LA::distributed::BlockVector<double>> vec_ensemble1;
+    std::vector<dealii::Vector<double>> vec_ensemble1;
     vec_ensemble1.push_back(sim_vec);
     vec_ensemble1.push_back(sim_vec1);
 
-    auto cov1 = da.calc_sample_covariance_sparse(vec_ensemble1);
-
-    BOOST_TEST(cov1.el(0, 0) == 0.005, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(0, 1) == 0.015, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(0, 2) == 0.01, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(0, 3) == 0.02, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(1, 0) == 0.015, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(1, 1) == 0.045, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(1, 2) == 0.03, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(1, 3) == 0.06, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(2, 0) == 0.01, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(2, 1) == 0.03, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(2, 2) == 0.02, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(2, 3) == 0.04, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(3, 0) == 0.02, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(3, 1) == 0.06, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(3, 2) == 0.04, tt::tolerance(tol));
-    BOOST_TEST(cov1.el(3, 3) == 0.08, tt::tolerance(tol));
-
-    // Non-trivial case with step-function sparsity
+    std::vector<std::vector<double>> const reference = {
+        {0.005, 0.015, 0.01, 0.02},
+        {0.015, 0.045, 0.03, 0.06},
+        {0.01, 0.03, 0.02, 0.04},
+        {0.02, 0.06, 0.04, 0.08}};
+
+    auto cov1 = da.calc_slice_covariance(vec_ensemble1, vec_ensemble1);
+    auto expt_cov1 = da.calc_expt_covariance(vec_ensemble1);
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+      for (unsigned int j = 0; j < 4; ++j)
+      {
+        BOOST_TEST(cov1(i, j) == reference[i][j], tt::tolerance(tol));
+        BOOST_TEST(expt_cov1(i, j) == reference[i][j], tt::tolerance(tol));
+      }
+    }
+
+    // Non-trivial case with step-function localization
     da._localization_cutoff_distance = 1.0e-6;
-    da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
-    BOOST_TEST(da._covariance_sparsity_pattern.n_nonzero_elements() == 4);
-    auto cov2 = da.calc_sample_covariance_sparse(vec_ensemble1);
-
-    BOOST_TEST(cov2.el(0, 0) == 0.005, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(0, 1) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(0, 2) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(0, 3) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(1, 0) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(1, 1) == 0.045, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(1, 2) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(1, 3) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(2, 0) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(2, 1) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(2, 2) == 0.02, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(2, 3) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(3, 0) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(3, 1) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(3, 2) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov2.el(3, 3) == 0.08, tt::tolerance(tol));
-
-    // Non-trivial case with Gaspari-Cohn sparsity
+    da.update_localization_pattern();
+    BOOST_TEST(da._localization_weights.size() == 4u);
+    auto cov2 = da.calc_slice_covariance(vec_ensemble1, vec_ensemble1);
+    auto expt_cov2 = da.calc_expt_covariance(vec_ensemble1);
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+      for (unsigned int j = 0; j < 4; ++j)
+      {
+        double const value = i == j ? reference[i][j] : 0.;
+        BOOST_TEST(cov2(i, j) == value, tt::tolerance(tol));
+        BOOST_TEST(expt_cov2(i, j) == value, tt::tolerance(tol));
+      }
+    }
+
+    // Non-trivial case with Gaspari-Cohn localization
     da._localization_cutoff_distance = 3.0;
     da._localization_cutoff_function = LocalizationCutoff::gaspari_cohn;
-    da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
-    BOOST_TEST(da._covariance_sparsity_pattern.n_nonzero_elements() == 16);
-    auto cov3 = da.calc_sample_covariance_sparse(vec_ensemble1);
-
-    BOOST_TEST(cov3.el(0, 0) == 0.005, tt::tolerance(tol));
-    BOOST_TEST(cov3.el(0, 1) > 0.0);
-    BOOST_TEST(cov3.el(0, 1) < 0.015);
-    BOOST_TEST(cov3.el(0, 2) > 0.0);
-    BOOST_TEST(cov3.el(0, 2) < 0.01);
-    BOOST_TEST(cov3.el(0, 3) > 0.0);
-    BOOST_TEST(cov3.el(0, 3) < 0.02);
-    BOOST_TEST(cov3.el(1, 0) > 0.0);
-    BOOST_TEST(cov3.el(1, 0) < 0.015);
-    BOOST_TEST(cov3.el(1, 1) == 0.045, tt::tolerance(tol));
-    BOOST_TEST(cov3.el(1, 2) > 0.0);
-    BOOST_TEST(cov3.el(1, 2) < 0.03);
-    BOOST_TEST(cov3.el(1, 3) > 0.0);
-    BOOST_TEST(cov3.el(1, 3) < 0.06);
-    BOOST_TEST(cov3.el(2, 0) > 0.0);
-    BOOST_TEST(cov3.el(2, 0) < 0.01);
-    BOOST_TEST(cov3.el(2, 1) > 0.0);
-    BOOST_TEST(cov3.el(2, 1) < 0.03);
-    BOOST_TEST(cov3.el(2, 2) == 0.02, tt::tolerance(tol));
-    BOOST_TEST(cov3.el(2, 3) > 0.0);
-    BOOST_TEST(cov3.el(2, 3) < 0.04);
-    BOOST_TEST(cov3.el(3, 0) > 0.0);
-    BOOST_TEST(cov3.el(3, 0) < 0.02);
-    BOOST_TEST(cov3.el(3, 1) > 0.0);
-    BOOST_TEST(cov3.el(3, 1) < 0.06);
-    BOOST_TEST(cov3.el(3, 2) > 0.0);
-    BOOST_TEST(cov3.el(3, 2) < 0.04);
-    BOOST_TEST(cov3.el(3, 3) == 0.08, tt::tolerance(tol));
-
-    // Non-trivial case with step-function sparsity and two augmented parameters
-    dealii::LA::distributed::BlockVector<double> sim_vec2(
-        1, dof_handler.n_dofs() + 2);
+    da.update_localization_pattern();
+    BOOST_TEST(da._localization_weights.size() == 16u);
+    auto cov3 = da.calc_slice_covariance(vec_ensemble1, vec_ensemble1);
+    auto expt_cov3 = da.calc_expt_covariance(vec_ensemble1);
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+      for (unsigned int j = 0; j < 4; ++j)
+      {
+        if (i == j)
+        {
+          BOOST_TEST(cov3(i, j) == reference[i][j], tt::tolerance(tol));
+        }
+        else
+        {
+          BOOST_TEST(cov3(i, j) > 0.0);
+          BOOST_TEST(cov3(i, j) < reference[i][j]);
+        }
+        BOOST_TEST(expt_cov3(i, j) == cov3(i, j), tt::tolerance(tol));
+      }
+    }
+
+    // Non-trivial case with step-function localization and two augmented
+    // parameters. The parameters are not localized.
+    dealii::Vector<double> sim_vec2(dof_handler.n_dofs() + 2);
     sim_vec2(0) = 2.0;
     sim_vec2(1) = 4.0;
     sim_vec2(2) = 5.0;
@@ -509,8 +742,7 @@ public:
     sim_vec2(4) = 1.0;
     sim_vec2(5) = 1.5;
 
-    dealii::LA::distributed::BlockVector<double> sim_vec3(
-        1, dof_handler.n_dofs() + 2);
+    dealii::Vector<double> sim_vec3(dof_handler.n_dofs() + 2);
     sim_vec3(0) = 2.1;
     sim_vec3(1) = 4.3;
     sim_vec3(2) = 5.2;
@@ -518,45 +750,73 @@ public:
     sim_vec3(4) = 1.1;
     sim_vec3(5) = 1.4;
 
-    std::vector<dealii::LA::distributed::BlockVector<double>> vec_ensemble2;
+    std::vector<dealii::Vector<double>> vec_ensemble2;
     vec_ensemble2.push_back(sim_vec2);
     vec_ensemble2.push_back(sim_vec3);
 
     da._localization_cutoff_distance = 1.0e-6;
+    da._localization_cutoff_function = LocalizationCutoff::step_function;
     da.update_covariance_sparsity_pattern<2>(dof_handler, 2);
-    BOOST_TEST(da._covariance_sparsity_pattern.n_nonzero_elements() == 24u);
-    auto cov4 = da.calc_sample_covariance_sparse(vec_ensemble2);
-
-    BOOST_TEST(cov4.el(0, 0) == 0.005, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(0, 1) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(0, 2) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(0, 3) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(1, 0) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(1, 1) == 0.045, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(1, 2) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(1, 3) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(2, 0) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(2, 1) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(2, 2) == 0.02, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(2, 3) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(3, 0) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(3, 1) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(3, 2) == 0.0, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(3, 3) == 0.08, tt::tolerance(tol));
-
-    BOOST_TEST(cov4.el(4, 0) == 0.005, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(4, 1) == 0.015, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(4, 2) == 0.01, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(4, 3) == 0.02, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(4, 4) == 0.005, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(4, 5) == -0.005, tt::tolerance(tol));
-
-    BOOST_TEST(cov4.el(5, 0) == -0.005, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(5, 1) == -0.015, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(5, 2) == -0.01, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(5, 3) == -0.02, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(5, 4) == -0.005, tt::tolerance(tol));
-    BOOST_TEST(cov4.el(5, 5) == 0.005, tt::tolerance(tol));
+    da.update_localization_pattern();
+    auto cov4 = da.calc_slice_covariance(vec_ensemble2, vec_ensemble1);
+    BOOST_TEST(cov4.m() == 6u);
+    BOOST_TEST(cov4.n() == 4u);
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+      for (unsigned int j = 0; j < 4; ++j)
+      {
+        double const value = i == j ? reference[i][j] : 0.;
+        BOOST_TEST(cov4(i, j) == value, tt::tolerance(tol));
+      }
+    }
+
+    BOOST_TEST(cov4(4, 0) == 0.005, tt::tolerance(tol));
+    BOOST_TEST(cov4(4, 1) == 0.015, tt::tolerance(tol));
+    BOOST_TEST(cov4(4, 2) == 0.01, tt::tolerance(tol));
+    BOOST_TEST(cov4(4, 3) == 0.02, tt::tolerance(tol));
+
+    BOOST_TEST(cov4(5, 0) == -0.005, tt::tolerance(tol));
+    BOOST_TEST(cov4(5, 1) == -0.015, tt::tolerance(tol));
+    BOOST_TEST(cov4(5, 2) == -0.01, tt::tolerance(tol));
+    BOOST_TEST(cov4(5, 3) == -0.02, tt::tolerance(tol));
+
+    // The matrix-free product matches the dense covariance for both the
+    // localized entries and the parameters
+    dealii::FullMatrix<double> weights(4, 2);
+    for (unsigned int j = 0; j < 4; ++j)
+    {
+      weights(j, 0) = 1.0 + j;
+      weights(j, 1) = 0.5 - j;
+    }
+    auto product =
+        da.apply_slice_covariance(vec_ensemble2, vec_ensemble1, weights);
+    for (unsigned int k = 0; k < 2; ++k)
+    {
+      for (unsigned int i = 0; i < 6; ++i)
+      {
+        double value = 0.;
+        for (unsigned int j = 0; j < 4; ++j)
+          value += cov4(i, j) * weights(j, k);
+        BOOST_TEST(product[k][i] == value, tt::tolerance(tol));
+      }
+    }
+
+    // Without cutoff distance, no localization pattern is stored
+    da._localization_cutoff_distance = std::numeric_limits<double>::max();
+    da.update_localization_pattern();
+    BOOST_TEST(da._localization_weights.size() == 0u);
+    auto cov5 = da.calc_slice_covariance(vec_ensemble2, vec_ensemble1);
+    product = da.apply_slice_covariance(vec_ensemble2, vec_ensemble1, weights);
+    for (unsigned int k = 0; k < 2; ++k)
+    {
+      for (unsigned int i = 0; i < 6; ++i)
+      {
+        double value = 0.;
+        for (unsigned int j = 0; j < 4; ++j)
+          value += cov5(i, j) * weights(j, k);
+        BOOST_TEST(product[k][i] == value, tt::tolerance(tol));
+      }
+    }
   };
 
   void test_fill_noise_vector(bool R_is_diagonal)
@@ -634,6 +894,13 @@ public:
       BOOST_TEST(R(1, 1) == Rtest(1, 1), tt::tolerance(tol));
       BOOST_TEST(R(0, 1) == Rtest(0, 1), tt::tolerance(tol));
       BOOST_TEST(R(2, 2) == Rtest(2, 2), tt::tolerance(tol));
+
+      // The cached Cholesky factor reproduces R
+      dealii::FullMatrix<double> LLt(3);
+      da._R_cholesky.mTmult(LLt, da._R_cholesky);
+      for (unsigned int i = 0; i < 3; ++i)
+        for (unsigned int j = 0; j < 3; ++j)
+          BOOST_TEST(LLt(i, j) == R.el(i, j), tt::tolerance(1e-12));
     }
   }; // namespace adamantine
 
@@ -754,6 +1021,164 @@ public:
     }
   };
 
+  void test_pipelined_update_ensemble()
+  {
+    MPI_Comm communicator = MPI_COMM_WORLD;
+
+    boost::property_tree::ptree database;
+    database.put("import_mesh", false);
+    database.put("length", 1);
+    database.put("length_divisions", 1);
+    database.put("height", 1);
+    database.put("height_divisions", 1);
+    adamantine::Geometry<2> geometry(communicator, database);
+    dealii::parallel::distributed::Triangulation<2> const &tria =
+        geometry.get_triangulation();
+
+    dealii::FE_Q<2> fe(1);
+    dealii::DoFHandler<2> dof_handler(tria);
+    dof_handler.distribute_dofs(fe);
+
+    unsigned int const n_members = 3;
+    std::vector<double> expt_vec = {2.5, 9.5};
+    std::pair<std::vector<int>, std::vector<int>> expt_to_dof_mapping = {
+        {0, 1}, {1, 3}};
+
+    dealii::SparsityPattern pattern(2, 2, 1);
+    pattern.add(0, 0);
+    pattern.add(1, 1);
+    pattern.compress();
+    dealii::SparseMatrix<double> R(pattern);
+    R.add(0, 0, 0.002);
+    R.add(1, 1, 0.001);
+
+    std::vector<std::vector<double>> const values = {
+        {1.0, 3.0, 6.0, 9.0}, {1.5, 3.2, 6.3, 9.7}, {1.1, 3.1, 6.1, 9.1}};
+    auto create_ensemble = [&]()
+    {
+      std::vector<dealii::LA::distributed::BlockVector<double>> ensemble(
+          n_members);
+      for (unsigned int member = 0; member < n_members; ++member)
+      {
+        ensemble[member].reinit(2);
+        ensemble[member].block(0).reinit(4);
+        for (unsigned int i = 0; i < 4; ++i)
+          ensemble[member].block(0)(i) = values[member][i];
+        ensemble[member].collect_sizes();
+      }
+      return ensemble;
+    };
+
+    // The ETKF is deterministic so both analyses give the same increments
+    boost::property_tree::ptree da_database;
+    da_database.put("analysis", "etkf");
+    DataAssimilator da(communicator, communicator, 0, da_database);
+    da._num_ensemble_members = n_members;
+    da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
+    da.update_dof_mapping<2>(expt_to_dof_mapping);
+
+    auto reference_ensemble = create_ensemble();
+    da.update_ensemble(reference_ensemble, expt_vec, R);
+
+    // The increments are added to the ensemble members that were advanced
+    // while the analysis was running.
+    auto pipelined_ensemble = create_ensemble();
+    BOOST_TEST(!da.analysis_pending());
+    da.start_update_ensemble(pipelined_ensemble, expt_vec, R, true);
+    BOOST_TEST(da.analysis_pending());
+    for (auto &member : pipelined_ensemble)
+      member.block(0).add(1.);
+    da.finish_update_ensemble(pipelined_ensemble);
+    BOOST_TEST(!da.analysis_pending());
+
+    for (unsigned int member = 0; member < n_members; ++member)
+      for (unsigned int i = 0; i < 4; ++i)
+        BOOST_TEST(pipelined_ensemble[member].block(0)(i) ==
+                       reference_ensemble[member].block(0)(i) + 1.,
+                   tt::tolerance(1e-12));
+  }
+
+  void test_batched_update_ensemble()
+  {
+    MPI_Comm communicator = MPI_COMM_WORLD;
+
+    boost::property_tree::ptree database;
+    database.put("import_mesh", false);
+    database.put("length", 1);
+    database.put("length_divisions", 1);
+    database.put("height", 1);
+    database.put("height_divisions", 1);
+    adamantine::Geometry<2> geometry(communicator, database);
+    dealii::parallel::distributed::Triangulation<2> const &tria =
+        geometry.get_triangulation();
+
+    dealii::FE_Q<2> fe(1);
+    dealii::DoFHandler<2> dof_handler(tria);
+    dof_handler.distribute_dofs(fe);
+
+    unsigned int const n_members = 3;
+    std::vector<double> expt_vec = {2.5, 9.5};
+    std::pair<std::vector<int>, std::vector<int>> expt_to_dof_mapping = {
+        {0, 1}, {1, 3}};
+
+    // Observing twice the same state with the covariance R is the same as
+    // observing it once with the covariance R/2.
+    dealii::SparsityPattern pattern(2, 2, 1);
+    pattern.add(0, 0);
+    pattern.add(1, 1);
+    pattern.compress();
+    dealii::SparseMatrix<double> R(pattern);
+    R.add(0, 0, 0.002);
+    R.add(1, 1, 0.001);
+    dealii::SparseMatrix<double> half_R(pattern);
+    half_R.add(0, 0, 0.001);
+    half_R.add(1, 1, 0.0005);
+
+    std::vector<std::vector<double>> const values = {
+        {1.0, 3.0, 6.0, 9.0}, {1.5, 3.2, 6.3, 9.7}, {1.1, 3.1, 6.1, 9.1}};
+    auto create_ensemble = [&]()
+    {
+      std::vector<dealii::LA::distributed::BlockVector<double>> ensemble(
+          n_members);
+      for (unsigned int member = 0; member < n_members; ++member)
+      {
+        ensemble[member].reinit(2);
+        ensemble[member].block(0).reinit(4);
+        for (unsigned int i = 0; i < 4; ++i)
+          ensemble[member].block(0)(i) = values[member][i];
+        ensemble[member].collect_sizes();
+      }
+      return ensemble;
+    };
+
+    boost::property_tree::ptree da_database;
+    da_database.put("analysis", "etkf");
+
+    DataAssimilator reference_da(communicator, communicator, 0, da_database);
+    reference_da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
+    reference_da.update_dof_mapping<2>(expt_to_dof_mapping);
+    auto reference_ensemble = create_ensemble();
+    reference_da.update_ensemble(reference_ensemble, expt_vec, half_R);
+
+    DataAssimilator da(communicator, communicator, 0, da_database);
+    da.update_covariance_sparsity_pattern<2>(dof_handler, 0);
+    da.update_dof_mapping<2>(expt_to_dof_mapping);
+    auto batched_ensemble = create_ensemble();
+    da.store_observations(batched_ensemble, expt_vec, R);
+    BOOST_TEST(da.n_stored_frames() == 1u);
+    da.update_dof_mapping<2>(expt_to_dof_mapping);
+    da.update_ensemble(batched_ensemble, expt_vec, R);
+    BOOST_TEST(da.n_stored_frames() == 0u);
+    BOOST_TEST(da._expt_size == 4u);
+    BOOST_TEST(da._expt_support_points.size() == 4u);
+
+    for (unsigned int member = 0; member < n_members; ++member)
+      for (unsigned int i = 0; i < 4; ++i)
+        BOOST_TEST(batched_ensemble[member].block(0)(i) ==
+                       reference_ensemble[member].block(0)(i),
+                   tt::tolerance(1e-12));
+  }
+
   void test_update_ensemble_augmented()
   {
     // Create the DoF mapping
@@ -934,13 +1359,16 @@ BOOST_AUTO_TEST_CASE(data_assimilator)
   dat.test_constructor();
   dat.test_update_dof_mapping();
   dat.test_update_covariance_sparsity_pattern();
-  dat.test_calc_sample_covariance_sparse();
+  dat.test_calc_slice_covariance();
   dat.test_fill_noise_vector(true);
   dat.test_fill_noise_vector(false);
   dat.test_calc_H();
   dat.test_calc_Hx();
   dat.test_calc_kalman_gain();
+  dat.test_ensemble_transform();
   dat.test_update_ensemble();
+  dat.test_pipelined_update_ensemble();
+  dat.test_batched_update_ensemble();
   dat.test_update_ensemble_augmented();
 }
 } // namespace adamantine
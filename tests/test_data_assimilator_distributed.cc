@@ -0,0 +1,120 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE DataAssimilatorDistributed
+
+#include <DataAssimilator.hh>
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/base/mpi.h>
+#include <deal.II/lac/la_parallel_block_vector.h>
+
+#include "main.cc"
+
+namespace adamantine
+{
+class DataAssimilatorTester
+{
+public:
+  void test_distribute_collect_ensemble_members()
+  {
+    MPI_Comm communicator = MPI_COMM_WORLD;
+    unsigned int const rank =
+        dealii::Utilities::MPI::this_mpi_process(communicator);
+    unsigned int const n_procs =
+        dealii::Utilities::MPI::n_mpi_processes(communicator);
+
+    // All the processors share the same color. The first member is owned by
+    // the first processor only, so the other processors own no entry of their
+    // first local member. The second member is spread over all the
+    // processors.
+    boost::property_tree::ptree database;
+    DataAssimilator da(communicator, communicator, 0, database);
+    unsigned int const sim_size = 4 * n_procs;
+    unsigned int const parameter_size = 2;
+    da._sim_size = sim_size;
+    da._parameter_size = parameter_size;
+    da.compute_slice_offsets();
+
+    unsigned int const n_members = 2;
+    auto initial_value = [](unsigned int member, unsigned int index)
+    { return 100. * member + index; };
+    std::vector<dealii::LA::distributed::BlockVector<double>>
+        augmented_state_ensemble(n_members);
+    for (unsigned int m = 0; m < n_members; ++m)
+    {
+      dealii::IndexSet locally_owned(sim_size);
+      if (m == 0)
+      {
+        if (rank == 0)
+          locally_owned.add_range(0, sim_size);
+      }
+      else
+      {
+        locally_owned.add_range(4 * rank, 4 * (rank + 1));
+      }
+      augmented_state_ensemble[m].reinit(2);
+      augmented_state_ensemble[m].block(0).reinit(locally_owned, communicator);
+      for (auto const index : locally_owned)
+        augmented_state_ensemble[m].block(0)(index) = initial_value(m, index);
+      augmented_state_ensemble[m].block(1).reinit(parameter_size);
+      for (unsigned int i = 0; i < parameter_size; ++i)
+        augmented_state_ensemble[m].block(1)(i) =
+            initial_value(m, sim_size + i);
+      augmented_state_ensemble[m].collect_sizes();
+    }
+
+    // Every processor receives its slice of every member.
+    std::vector<dealii::Vector<double>> slice_ensemble;
+    auto slice_entries = da.distribute_ensemble_members(
+        augmented_state_ensemble, slice_ensemble);
+    BOOST_TEST(da._num_ensemble_members == n_members);
+    BOOST_TEST(slice_ensemble.size() == n_members);
+    unsigned int const slice_begin = da._slice_offsets[rank];
+    unsigned int const slice_end = da._slice_offsets[rank + 1];
+    for (unsigned int m = 0; m < n_members; ++m)
+    {
+      BOOST_TEST(slice_ensemble[m].size() == slice_end - slice_begin);
+      for (unsigned int i = slice_begin; i < slice_end; ++i)
+        BOOST_TEST(slice_ensemble[m][i - slice_begin] == initial_value(m, i));
+    }
+
+    // The increments must be added to the members they were computed for.
+    auto increment = [](unsigned int member, unsigned int index)
+    { return 1000. * (member + 1) + index; };
+    std::vector<dealii::Vector<double>> slice_increments(
+        n_members, dealii::Vector<double>(slice_end - slice_begin));
+    for (unsigned int m = 0; m < n_members; ++m)
+      for (unsigned int i = slice_begin; i < slice_end; ++i)
+        slice_increments[m][i - slice_begin] = increment(m, i);
+    da.collect_ensemble_members(augmented_state_ensemble, slice_increments,
+                                slice_entries);
+
+    for (unsigned int m = 0; m < n_members; ++m)
+    {
+      auto const &state = augmented_state_ensemble[m].block(0);
+      for (auto const index : state.locally_owned_elements())
+      {
+        unsigned int const i = static_cast<unsigned int>(index);
+        BOOST_TEST(state(index) == initial_value(m, i) + increment(m, i));
+      }
+      auto const &parameters = augmented_state_ensemble[m].block(1);
+      for (unsigned int i = 0; i < parameter_size; ++i)
+      {
+        BOOST_TEST(parameters(i) == initial_value(m, sim_size + i) +
+                                        increment(m, sim_size + i));
+      }
+    }
+  }
+};
+
+BOOST_AUTO_TEST_CASE(distribute_collect_ensemble_members)
+{
+  DataAssimilatorTester dat;
+  dat.test_distribute_collect_ensemble_members();
+}
+} // namespace adamantine
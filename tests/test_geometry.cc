@@ -158,3 +158,46 @@ BOOST_AUTO_TEST_CASE(gmsh)
   dealii::types::boundary_id const top_boundary = 1;
   check_material_id(tria, top_boundary);
 }
+
+BOOST_AUTO_TEST_CASE(geometry_domain_growth)
+{
+  MPI_Comm communicator = MPI_COMM_WORLD;
+  boost::property_tree::ptree database;
+  database.put("import_mesh", false);
+  database.put("length", 8);
+  database.put("length_divisions", 8);
+  database.put("height", 8);
+  database.put("height_divisions", 8);
+  database.put("width", 8);
+  database.put("width_divisions", 8);
+  database.put("material_height", 4);
+  database.put("domain_growth_refinements", 2);
+
+  adamantine::Geometry<3> geometry(communicator, database);
+  dealii::parallel::distributed::Triangulation<3> &tria =
+      geometry.get_triangulation();
+
+  // Only the cells below the material height have the requested resolution
+  BOOST_TEST(geometry.get_growth_refinements() == 2u);
+  BOOST_TEST(tria.n_global_active_cells() < 512u);
+  for (auto cell :
+       dealii::filter_iterators(tria.active_cell_iterators(),
+                                dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    if (cell->center()[2] < 4.)
+      BOOST_TEST(cell->level() == 2);
+  }
+
+  // Grow the domain up to the top
+  unsigned int n_passes = 0;
+  while (geometry.flag_cells_to_grow(7.))
+  {
+    tria.execute_coarsening_and_refinement();
+    ++n_passes;
+  }
+  BOOST_TEST(n_passes <= 2u);
+  BOOST_TEST(tria.n_global_active_cells() == 512u);
+
+  // The domain has already grown
+  BOOST_TEST(!geometry.flag_cells_to_grow(6.));
+}
@@ -206,4 +206,114 @@ BOOST_AUTO_TEST_CASE(heat_source_height, *utf::tolerance(1e-12))
   BOOST_TEST(eb_height == 0.001);
 }
 
+BOOST_AUTO_TEST_CASE(swept_heat_source, *utf::tolerance(1e-6))
+{
+  boost::property_tree::ptree database;
+
+  database.put("depth", 0.1);
+  database.put("absorption_efficiency", 0.1);
+  database.put("diameter", 1.0e-3);
+  database.put("max_power", 10.);
+  database.put("scan_path_file", "scan_path.txt");
+  database.put("scan_path_file_format", "segment");
+  GoldakHeatSource<2> goldak_heat_source(database);
+  ElectronBeamHeatSource<2> eb_heat_source(database);
+  GoldakHeatSource<2> swept_goldak_heat_source(database);
+  ElectronBeamHeatSource<2> swept_eb_heat_source(database);
+
+  // The first window crosses the end of the first segment, the second window
+  // crosses the end of the scan path.
+  double const sweep_duration = 1.0e-3;
+  swept_goldak_heat_source.set_sweep_duration(sweep_duration);
+  swept_eb_heat_source.set_sweep_duration(sweep_duration);
+  for (double const time : {0., 2.0e-3})
+  {
+    swept_goldak_heat_source.update_time(time);
+    swept_eb_heat_source.update_time(time);
+    for (double const x : {2.0e-4, 7.0e-4, 1.8e-3})
+    {
+      dealii::Point<2> point(x, 0.19);
+      // Compute the time average using the midpoint rule
+      unsigned int const n_samples = 20000;
+      double g_average = 0.;
+      double eb_average = 0.;
+      for (unsigned int i = 0; i < n_samples; ++i)
+      {
+        double const sample_time =
+            time + (i + 0.5) * sweep_duration / n_samples;
+        goldak_heat_source.update_time(sample_time);
+        eb_heat_source.update_time(sample_time);
+        g_average += goldak_heat_source.value(point, 0.2);
+        eb_average += eb_heat_source.value(point, 0.2);
+      }
+      g_average /= n_samples;
+      eb_average /= n_samples;
+
+      BOOST_TEST(swept_goldak_heat_source.value(point, 0.2) == g_average);
+      BOOST_TEST(swept_eb_heat_source.value(point, 0.2) == eb_average);
+    }
+  }
+
+  // Without sweep duration, the instantaneous value is used again
+  swept_goldak_heat_source.set_sweep_duration(0.);
+  swept_eb_heat_source.set_sweep_duration(0.);
+  double const time = 7.0e-4;
+  swept_goldak_heat_source.update_time(time);
+  swept_eb_heat_source.update_time(time);
+  goldak_heat_source.update_time(time);
+  eb_heat_source.update_time(time);
+  for (double const x : {2.0e-4, 7.0e-4, 1.8e-3})
+  {
+    dealii::Point<2> point(x, 0.19);
+    BOOST_TEST(swept_goldak_heat_source.value(point, 0.2) ==
+               goldak_heat_source.value(point, 0.2));
+    BOOST_TEST(swept_eb_heat_source.value(point, 0.2) ==
+               eb_heat_source.value(point, 0.2));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(heat_source_bounding_box_cutoff)
+{
+  boost::property_tree::ptree database;
+
+  database.put("depth", 0.1);
+  database.put("absorption_efficiency", 0.1);
+  database.put("diameter", 0.1);
+  database.put("max_power", 10.);
+  database.put("scan_path_file", "scan_path.txt");
+  database.put("scan_path_file_format", "segment");
+  GoldakHeatSource<2> goldak_heat_source(database);
+  ElectronBeamHeatSource<2> eb_heat_source(database);
+  goldak_heat_source.update_time(0.4);
+  eb_heat_source.update_time(0.4);
+
+  double const height = 0.1;
+  double const cutoff = 1.;
+  auto const g_box = goldak_heat_source.get_bounding_box(height, cutoff);
+  auto const eb_box = eb_heat_source.get_bounding_box(height, cutoff);
+  BOOST_TEST(g_box.has_value());
+  BOOST_TEST(eb_box.has_value());
+  // The boxes with a cutoff are smaller than the support of the beams
+  BOOST_TEST(g_box->volume() <
+             goldak_heat_source.get_bounding_box(height, 0.)->volume());
+
+  // Every point where the heat source is larger than the cutoff is in the box
+  unsigned int const n_points = 201;
+  for (unsigned int i = 0; i < n_points; ++i)
+    for (unsigned int j = 0; j < n_points; ++j)
+    {
+      dealii::Point<2> point(-0.2 + 0.4 * i / (n_points - 1),
+                             0.4 * j / (n_points - 1));
+      if (goldak_heat_source.value(point, height) > cutoff)
+        BOOST_TEST(g_box->point_inside(point));
+      if (eb_heat_source.value(point, height) > cutoff)
+        BOOST_TEST(eb_box->point_inside(point));
+    }
+
+  // When the cutoff is larger than the maximum of the heat source, there is no
+  // box
+  BOOST_TEST(!goldak_heat_source.get_bounding_box(height, 1e20).has_value());
+  BOOST_TEST(!eb_heat_source.get_bounding_box(height, 1e20).has_value());
+}
+
 } // namespace adamantine
@@ -0,0 +1,98 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE HeatSourceIndex
+
+#include <CubeHeatSource.hh>
+#include <ElectronBeamHeatSource.hh>
+#include <GoldakHeatSource.hh>
+#include <HeatSourceIndex.hh>
+
+#include "main.cc"
+
+namespace adamantine
+{
+BOOST_AUTO_TEST_CASE(heat_source_index)
+{
+  boost::property_tree::ptree beam_database;
+  beam_database.put("depth", 0.1);
+  beam_database.put("absorption_efficiency", 0.1);
+  beam_database.put("diameter", 0.02);
+  beam_database.put("max_power", 10.);
+  beam_database.put("scan_path_file", "scan_path.txt");
+  beam_database.put("scan_path_file_format", "segment");
+
+  boost::property_tree::ptree cube_database;
+  cube_database.put("start_time", 0.);
+  cube_database.put("end_time", 1.);
+  cube_database.put("value", 10.);
+  cube_database.put("min_x", 0.5);
+  cube_database.put("max_x", 0.6);
+  cube_database.put("min_y", 0.5);
+  cube_database.put("max_y", 0.6);
+  cube_database.put("min_z", 0.);
+  cube_database.put("max_z", 0.1);
+
+  std::vector<std::shared_ptr<HeatSource<3>>> heat_sources;
+  heat_sources.push_back(
+      std::make_shared<GoldakHeatSource<3>>(beam_database));
+  heat_sources.push_back(std::make_shared<CubeHeatSource<3>>(cube_database));
+  heat_sources.push_back(
+      std::make_shared<ElectronBeamHeatSource<3>>(beam_database));
+  for (auto &beam : heat_sources)
+    beam->update_time(0.4);
+
+  double const height = 0.1;
+  HeatSourceIndex<3> heat_source_index;
+  heat_source_index.reinit(heat_sources, height);
+  BOOST_TEST(!heat_source_index.empty());
+
+  // Compare the heat sources returned by the index with the heat sources that
+  // are not negligible.
+  std::vector<unsigned int> beam_ids;
+  unsigned int const n_points = 41;
+  for (unsigned int i = 0; i < n_points; ++i)
+    for (unsigned int j = 0; j < n_points; ++j)
+      for (unsigned int k = 0; k < n_points; ++k)
+      {
+        dealii::Point<3> const point(0.8 * i / (n_points - 1) - 0.1,
+                                     0.8 * j / (n_points - 1) - 0.1,
+                                     0.2 * k / (n_points - 1));
+        heat_source_index.query(point, beam_ids);
+        BOOST_TEST(std::is_sorted(beam_ids.begin(), beam_ids.end()));
+        for (unsigned int b = 0; b < heat_sources.size(); ++b)
+        {
+          if (heat_sources[b]->value(point, height) > 1e-20)
+          {
+            BOOST_TEST(std::find(beam_ids.begin(), beam_ids.end(), b) !=
+                       beam_ids.end());
+          }
+        }
+      }
+
+  // Far away from the beams, only the cube is returned.
+  dealii::BoundingBox<3> box(std::make_pair(dealii::Point<3>(0.4, 0.4, 0.),
+                                            dealii::Point<3>(0.7, 0.7, 0.2)));
+  heat_source_index.query(box, beam_ids);
+  BOOST_TEST(beam_ids.size() == 1u);
+  BOOST_TEST(beam_ids[0] == 1u);
+
+  // Close to the beams, both beams are returned but not the cube.
+  dealii::Point<3> const beam_center(0.001, 0.1, 0.1);
+  heat_source_index.query(beam_center, beam_ids);
+  BOOST_TEST(beam_ids.size() == 2u);
+  BOOST_TEST(beam_ids[0] == 0u);
+  BOOST_TEST(beam_ids[1] == 2u);
+
+  // When the cube is turned off, it is not returned anymore.
+  for (auto &beam : heat_sources)
+    beam->update_time(1.1);
+  heat_source_index.reinit(heat_sources, height);
+  heat_source_index.query(box, beam_ids);
+  BOOST_TEST(beam_ids.size() == 0u);
+}
+} // namespace adamantine
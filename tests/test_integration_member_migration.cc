@@ -0,0 +1,112 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include "MaterialStates.hh"
+#define BOOST_TEST_MODULE Integration_Member_Migration
+
+#include "../application/adamantine.hh"
+
+#include <boost/property_tree/info_parser.hpp>
+
+#include <algorithm>
+#include <filesystem>
+
+#include "main.cc"
+
+namespace tt = boost::test_tools;
+
+/**
+ * Return the minimum and the maximum temperature of every ensemble member of
+ * every processor. The members have different initial temperatures, so the
+ * pairs are sorted by minimum temperature to identify the members.
+ */
+std::vector<std::pair<double, double>>
+integration_member_migration(MPI_Comm communicator,
+                             unsigned int &n_local_members)
+{
+  std::vector<adamantine::Timer> timers;
+  initialize_timers(communicator, timers);
+
+  // Read the input.
+  std::string const filename = "integration_member_migration.info";
+  adamantine::ASSERT_THROW(std::filesystem::exists(filename) == true,
+                           "The file " + filename + " does not exist.");
+  boost::property_tree::ptree database;
+  boost::property_tree::info_parser::read_info(filename, database);
+
+  auto result =
+      run_ensemble<2, 3, adamantine::SolidLiquidPowder,
+                   dealii::MemorySpace::Host>(communicator, database, timers);
+  n_local_members = result.size();
+
+  // Every processor is its own color, so the members are not distributed.
+  std::vector<double> local_min_max;
+  for (auto const &member : result)
+  {
+    auto const &temperature = member.block(0);
+    local_min_max.push_back(
+        *std::min_element(temperature.begin(), temperature.end()));
+    local_min_max.push_back(
+        *std::max_element(temperature.begin(), temperature.end()));
+  }
+  std::vector<std::pair<double, double>> min_max;
+  for (auto const &rank_min_max :
+       dealii::Utilities::MPI::all_gather(communicator, local_min_max))
+  {
+    for (unsigned int i = 0; i < rank_min_max.size(); i += 2)
+      min_max.emplace_back(rank_min_max[i], rank_min_max[i + 1]);
+  }
+  std::sort(min_max.begin(), min_max.end());
+
+  return min_max;
+}
+
+BOOST_AUTO_TEST_CASE(integration_member_migration_2D)
+{
+  MPI_Comm communicator = MPI_COMM_WORLD;
+  unsigned int const rank =
+      dealii::Utilities::MPI::this_mpi_process(communicator);
+  unsigned int const n_procs =
+      dealii::Utilities::MPI::n_mpi_processes(communicator);
+
+  // The five members are split 3/1/1 on three processors. The members cost the
+  // same, so the first processor is 80% above the average load and one of its
+  // members is moved to another processor. On one processor, no member is
+  // moved.
+  unsigned int n_local_members = 0;
+  auto const min_max_world =
+      integration_member_migration(communicator, n_local_members);
+  BOOST_TEST(dealii::Utilities::MPI::sum(n_local_members, communicator) == 5);
+  if ((n_procs == 3) && (rank == 0))
+    BOOST_TEST(n_local_members == 2);
+
+  // The checkpoint files used to move the members are removed.
+  MPI_Barrier(communicator);
+  for (unsigned int member = 0; member < 5; ++member)
+  {
+    BOOST_TEST(!std::filesystem::exists("member_migration_test_" +
+                                        std::to_string(member) + ".info"));
+    BOOST_TEST(!std::filesystem::exists("member_migration_test_" +
+                                        std::to_string(member) +
+                                        "_fixed.data"));
+  }
+
+  // The moved members continue with their own solution and heat source, so
+  // the results match the simulation without migration.
+  unsigned int n_self_members = 0;
+  auto const min_max_self =
+      integration_member_migration(MPI_COMM_SELF, n_self_members);
+  BOOST_TEST(n_self_members == 5);
+  BOOST_TEST(min_max_world.size() == min_max_self.size());
+  for (unsigned int i = 0; i < min_max_self.size(); ++i)
+  {
+    BOOST_TEST(min_max_world[i].first == min_max_self[i].first,
+               tt::tolerance(1e-12));
+    BOOST_TEST(min_max_world[i].second == min_max_self[i].second,
+               tt::tolerance(1e-12));
+  }
+}
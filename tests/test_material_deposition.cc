@@ -9,6 +9,7 @@
 #define BOOST_TEST_MODULE MaterialDeposition
 
 #include <Geometry.hh>
+#include <GoldakHeatSource.hh>
 #include <MaterialProperty.hh>
 #include <ThermalPhysics.hh>
 #include <Timer.hh>
@@ -18,6 +19,8 @@
 #include <deal.II/dofs/dof_handler.h>
 #include <deal.II/fe/fe_nothing.h>
 #include <deal.II/fe/fe_q.h>
+#include <deal.II/grid/grid_generator.h>
+#include <deal.II/grid/tria.h>
 
 #include "main.cc"
 
@@ -145,7 +148,7 @@ BOOST_AUTO_TEST_CASE(get_elements_to_activate_2d)
     auto elements_to_activate =
         adamantine::get_elements_to_activate(dof_handler, bounding_boxes);
 
-    BOOST_TEST(elements_to_activate.size() == bounding_boxes.size());
+    BOOST_TEST(elements_to_activate.n_boxes() == bounding_boxes.size());
 
     std::vector<std::vector<dealii::CellId>> cell_id_ref(3);
     cell_id_ref[0].push_back(dealii::CellId("0_0:"));
@@ -158,10 +161,13 @@ BOOST_AUTO_TEST_CASE(get_elements_to_activate_2d)
 
     for (unsigned int i = 0; i < cell_id_ref.size(); ++i)
     {
-      BOOST_TEST(elements_to_activate[i].size() == cell_id_ref[i].size());
+      unsigned int const offset = elements_to_activate.offsets[i];
+      BOOST_TEST(elements_to_activate.offsets[i + 1] - offset ==
+                 cell_id_ref[i].size());
       for (unsigned int j = 0; j < cell_id_ref[i].size(); ++j)
       {
-        BOOST_TEST(elements_to_activate[i][j]->id() == cell_id_ref[i][j]);
+        BOOST_TEST(elements_to_activate.get_cell(dof_handler, offset + j)->id() ==
+                   cell_id_ref[i][j]);
       }
     }
   }
@@ -207,7 +213,7 @@ BOOST_AUTO_TEST_CASE(get_elements_to_activate_3d)
     auto elements_to_activate =
         adamantine::get_elements_to_activate(dof_handler, bounding_boxes);
 
-    BOOST_TEST(elements_to_activate.size() == bounding_boxes.size());
+    BOOST_TEST(elements_to_activate.n_boxes() == bounding_boxes.size());
 
     std::vector<std::vector<dealii::CellId>> cell_id_ref(3);
     cell_id_ref[0].push_back(dealii::CellId("0_0:"));
@@ -224,10 +230,13 @@ BOOST_AUTO_TEST_CASE(get_elements_to_activate_3d)
 
     for (unsigned int i = 0; i < cell_id_ref.size(); ++i)
     {
-      BOOST_TEST(elements_to_activate[i].size() == cell_id_ref[i].size());
+      unsigned int const offset = elements_to_activate.offsets[i];
+      BOOST_TEST(elements_to_activate.offsets[i + 1] - offset ==
+                 cell_id_ref[i].size());
       for (unsigned int j = 0; j < cell_id_ref[i].size(); ++j)
       {
-        BOOST_TEST(elements_to_activate[i][j]->id() == cell_id_ref[i][j]);
+        BOOST_TEST(elements_to_activate.get_cell(dof_handler, offset + j)->id() ==
+                   cell_id_ref[i][j]);
       }
     }
   }
@@ -312,6 +321,7 @@ BOOST_AUTO_TEST_CASE(material_deposition)
 #else
   unsigned int const i_max = 10;
 #endif
+  adamantine::ActivationSearch<dim> activation_search(dof_handler);
   for (unsigned int i = 0; i < i_max; ++i)
   {
     auto activation_start =
@@ -324,8 +334,11 @@ BOOST_AUTO_TEST_CASE(material_deposition)
         deposition_times.begin();
     if (activation_start < activation_end)
     {
-      auto elements_to_activate = adamantine::get_elements_to_activate(
-          dof_handler, material_deposition_boxes);
+      auto elements_to_activate = activation_search.get_elements_to_activate(
+          material_deposition_boxes, activation_start, activation_end);
+      BOOST_TEST(elements_to_activate.first_box == activation_start);
+      BOOST_TEST(elements_to_activate.n_boxes() ==
+                 activation_end - activation_start);
 
       std::vector<bool> has_melted(deposition_cos.size(), false);
 
@@ -351,6 +364,419 @@ BOOST_AUTO_TEST_CASE(material_deposition)
   }
 }
 
+BOOST_AUTO_TEST_CASE(material_deposition_and_refinement,
+                     *utf::tolerance(1e-12))
+{
+  int constexpr dim = 3;
+  MPI_Comm communicator = MPI_COMM_WORLD;
+
+  double const initial_temperature = 300.;
+  double const new_material_temperature = 500.;
+
+  boost::property_tree::ptree database;
+  // Geometry database
+  database.put("geometry.import_mesh", false);
+  database.put("geometry.length", 10);
+  database.put("geometry.length_divisions", 10);
+  database.put("geometry.width", 10);
+  database.put("geometry.width_divisions", 10);
+  database.put("geometry.height", 10);
+  database.put("geometry.height_divisions", 10);
+  database.put("geometry.material_height", 6.);
+  database.put("geometry.material_deposition", true);
+  database.put("geometry.material_deposition_file",
+               "material_path_test_material_deposition.txt");
+  // Build Geometry
+  boost::property_tree::ptree geometry_database =
+      database.get_child("geometry");
+  adamantine::Geometry<dim> geometry(communicator, geometry_database);
+
+  // MaterialProperty database
+  database.put("materials.property_format", "polynomial");
+  database.put("materials.initial_temperature", initial_temperature);
+  database.put("materials.new_material_temperature", new_material_temperature);
+  database.put("materials.n_materials", 1);
+  database.put("materials.material_0.solid.density", 1.);
+  database.put("materials.material_0.liquid.density", 1.);
+  database.put("materials.material_0.solid.specific_heat", 1.);
+  database.put("materials.material_0.liquid.specific_heat", 1.);
+  database.put("materials.material_0.solid.thermal_conductivity_x", 1.);
+  database.put("materials.material_0.solid.thermal_conductivity_z", 1.);
+  database.put("materials.material_0.liquid.thermal_conductivity_x", 1.);
+  database.put("materials.material_0.liquid.thermal_conductivity_z", 1.);
+  // Build MaterialProperty
+  boost::property_tree::ptree material_property_database =
+      database.get_child("materials");
+  adamantine::MaterialProperty<dim, 1, adamantine::SolidLiquidPowder,
+                               dealii::MemorySpace::Host>
+      material_properties(communicator, geometry.get_triangulation(),
+                          material_property_database);
+
+  // Source database
+  database.put("sources.n_beams", 0);
+  // Time-stepping database
+  database.put("time_stepping.method", "forward_euler");
+  // Boundary database
+  database.put("boundary.type", "adiabatic");
+
+  // Build ThermalPhysics
+  adamantine::ThermalPhysics<dim, 1, dim, adamantine::SolidLiquidPowder,
+                             dealii::MemorySpace::Host, dealii::QGauss<1>>
+      thermal_physics(communicator, database, geometry, material_properties);
+  thermal_physics.setup();
+  auto &dof_handler = thermal_physics.get_dof_handler();
+
+  auto [material_deposition_boxes, deposition_times, deposition_cos,
+        deposition_sin] =
+      adamantine::read_material_deposition<dim>(geometry_database);
+  dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host> solution;
+  thermal_physics.initialize_dof_vector(initial_temperature, solution);
+
+  // Refine the two bottom layers of the domain in two passes. The first pass
+  // is executed without updating the operators.
+  auto flag_layer = [&](double const z_min, double const z_max)
+  {
+    for (auto const &cell : dealii::filter_iterators(
+             dof_handler.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell()))
+    {
+      if ((cell->center()[dim - 1] > z_min) &&
+          (cell->center()[dim - 1] < z_max) && (cell->level() == 0))
+        cell->set_refine_flag();
+    }
+  };
+  flag_layer(0., 1.);
+  thermal_physics.execute_mesh_changes(solution, false);
+  flag_layer(1., 2.);
+
+  // Activate the material deposited during the first time step
+  double const time_step = 0.1;
+  double const eps = time_step / 1e12;
+  auto activation_start =
+      std::lower_bound(deposition_times.begin(), deposition_times.end(),
+                       time_step - eps) -
+      deposition_times.begin();
+  auto activation_end =
+      std::lower_bound(deposition_times.begin(), deposition_times.end(),
+                       2. * time_step - eps) -
+      deposition_times.begin();
+  adamantine::ActivationSearch<dim> activation_search(dof_handler);
+  auto elements_to_activate = activation_search.get_elements_to_activate(
+      material_deposition_boxes, activation_start, activation_end);
+
+  // The activation cannot be scheduled if one of the cells is also refined
+  bool const has_cells = elements_to_activate.cells.size() > 0;
+  if (has_cells)
+    elements_to_activate.get_cell(dof_handler, 0)->set_refine_flag();
+  BOOST_TEST(!thermal_physics.schedule_material(
+      elements_to_activate, deposition_cos, deposition_sin, activation_start,
+      activation_end, new_material_temperature));
+  if (has_cells)
+    elements_to_activate.get_cell(dof_handler, 0)->clear_refine_flag();
+  BOOST_TEST(thermal_physics.schedule_material(
+      elements_to_activate, deposition_cos, deposition_sin, activation_start,
+      activation_end, new_material_temperature));
+
+  // Refine and activate in a single mesh change
+  thermal_physics.execute_mesh_changes(solution, true);
+
+  unsigned int n_cells = 0;
+  for (auto const &cell : dealii::filter_iterators(
+           dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell(),
+           dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
+  {
+    (void)cell;
+    ++n_cells;
+  }
+  // 200 cells are refined and 10 cells are activated
+  BOOST_TEST(dealii::Utilities::MPI::sum(n_cells, communicator) ==
+             600 + 200 * 7 + 10);
+
+  // The old material keeps its temperature and the new material uses the
+  // temperature of new material.
+  double min_temperature = std::numeric_limits<double>::max();
+  double max_temperature = std::numeric_limits<double>::lowest();
+  for (auto const val : solution.locally_owned_elements())
+  {
+    min_temperature = std::min(min_temperature, solution[val]);
+    max_temperature = std::max(max_temperature, solution[val]);
+  }
+  BOOST_TEST(dealii::Utilities::MPI::min(min_temperature, communicator) ==
+             initial_temperature);
+  BOOST_TEST(dealii::Utilities::MPI::max(max_temperature, communicator) ==
+             new_material_temperature);
+
+  // The operators are up to date
+  std::vector<adamantine::Timer> timers(adamantine::Timing::n_timers);
+  thermal_physics.evolve_one_time_step(time_step, time_step, solution, timers);
+}
+
+BOOST_AUTO_TEST_CASE(shared_mesh_material_deposition, *utf::tolerance(1e-12))
+{
+  int constexpr dim = 3;
+  MPI_Comm communicator = MPI_COMM_WORLD;
+
+  std::vector<double> const initial_temperature = {300., 400.};
+  std::vector<double> const new_material_temperature = {500., 600.};
+
+  boost::property_tree::ptree database;
+  // Geometry database
+  database.put("geometry.import_mesh", false);
+  database.put("geometry.length", 10);
+  database.put("geometry.length_divisions", 10);
+  database.put("geometry.width", 10);
+  database.put("geometry.width_divisions", 10);
+  database.put("geometry.height", 10);
+  database.put("geometry.height_divisions", 10);
+  database.put("geometry.material_height", 6.);
+  database.put("geometry.material_deposition", true);
+  database.put("geometry.material_deposition_file",
+               "material_path_test_material_deposition.txt");
+  // Build Geometry
+  boost::property_tree::ptree geometry_database =
+      database.get_child("geometry");
+  adamantine::Geometry<dim> geometry(communicator, geometry_database);
+
+  // MaterialProperty database
+  database.put("materials.property_format", "polynomial");
+  database.put("materials.n_materials", 1);
+  database.put("materials.material_0.solid.density", 1.);
+  database.put("materials.material_0.liquid.density", 1.);
+  database.put("materials.material_0.solid.specific_heat", 1.);
+  database.put("materials.material_0.liquid.specific_heat", 1.);
+  database.put("materials.material_0.solid.thermal_conductivity_x", 1.);
+  database.put("materials.material_0.solid.thermal_conductivity_z", 1.);
+  database.put("materials.material_0.liquid.thermal_conductivity_x", 1.);
+  database.put("materials.material_0.liquid.thermal_conductivity_z", 1.);
+  // Build MaterialProperty
+  boost::property_tree::ptree material_property_database =
+      database.get_child("materials");
+  adamantine::MaterialProperty<dim, 1, adamantine::SolidLiquidPowder,
+                               dealii::MemorySpace::Host>
+      material_properties(communicator, geometry.get_triangulation(),
+                          material_property_database);
+
+  // Source database
+  database.put("sources.n_beams", 0);
+  // Time-stepping database
+  database.put("time_stepping.method", "forward_euler");
+  // Boundary database
+  database.put("boundary.type", "adiabatic");
+
+  // Build ThermalPhysics shared by two ensemble members
+  adamantine::ThermalPhysics<dim, 1, dim, adamantine::SolidLiquidPowder,
+                             dealii::MemorySpace::Host, dealii::QGauss<1>>
+      thermal_physics(communicator, database, geometry, material_properties);
+  thermal_physics.setup();
+  thermal_physics.set_n_members(2);
+  auto &dof_handler = thermal_physics.get_dof_handler();
+
+  std::vector<
+      dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host>>
+      solutions(2);
+  for (unsigned int member = 0; member < 2; ++member)
+    thermal_physics.initialize_dof_vector(initial_temperature[member],
+                                          solutions[member]);
+
+  // Only the second member has melted
+  thermal_physics.select_member(1);
+  std::vector<bool> has_melted = thermal_physics.get_has_melted_vector();
+  std::fill(has_melted.begin(), has_melted.end(), true);
+  thermal_physics.set_has_melted_vector(has_melted);
+
+  // Both members activate the material deposited during the first time step
+  // with their own temperature of the new material.
+  auto [material_deposition_boxes, deposition_times, deposition_cos,
+        deposition_sin] =
+      adamantine::read_material_deposition<dim>(geometry_database);
+  double const time_step = 0.1;
+  double const eps = time_step / 1e12;
+  auto activation_start =
+      std::lower_bound(deposition_times.begin(), deposition_times.end(),
+                       time_step - eps) -
+      deposition_times.begin();
+  auto activation_end =
+      std::lower_bound(deposition_times.begin(), deposition_times.end(),
+                       2. * time_step - eps) -
+      deposition_times.begin();
+  adamantine::ActivationSearch<dim> activation_search(dof_handler);
+  auto elements_to_activate = activation_search.get_elements_to_activate(
+      material_deposition_boxes, activation_start, activation_end);
+  for (unsigned int member : {1, 0})
+  {
+    thermal_physics.select_member(member);
+    BOOST_TEST(thermal_physics.schedule_material(
+        elements_to_activate, deposition_cos, deposition_sin, activation_start,
+        activation_end, new_material_temperature[member]));
+  }
+  thermal_physics.execute_mesh_changes({&solutions[0], &solutions[1]}, true);
+
+  std::vector<unsigned int> const n_melted_ref = {10, 610};
+  std::vector<adamantine::Timer> timers(adamantine::Timing::n_timers);
+  for (unsigned int member : {0, 1})
+  {
+    thermal_physics.select_member(member);
+
+    // The old material keeps the temperature of the member and the new
+    // material uses the temperature of new material of the member.
+    double min_temperature = std::numeric_limits<double>::max();
+    double max_temperature = std::numeric_limits<double>::lowest();
+    for (auto const val : solutions[member].locally_owned_elements())
+    {
+      min_temperature = std::min(min_temperature, solutions[member][val]);
+      max_temperature = std::max(max_temperature, solutions[member][val]);
+    }
+    BOOST_TEST(dealii::Utilities::MPI::min(min_temperature, communicator) ==
+               initial_temperature[member]);
+    BOOST_TEST(dealii::Utilities::MPI::max(max_temperature, communicator) ==
+               new_material_temperature[member]);
+
+    // The melting indicators are transferred for each member
+    auto const member_has_melted = thermal_physics.get_has_melted_vector();
+    unsigned int const n_melted = std::count(
+        member_has_melted.begin(), member_has_melted.end(), true);
+    BOOST_TEST(dealii::Utilities::MPI::sum(n_melted, communicator) ==
+               n_melted_ref[member]);
+
+    // The operators are up to date
+    thermal_physics.evolve_one_time_step(time_step, time_step,
+                                         solutions[member], timers);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(quiet_material_deposition)
+{
+  int constexpr dim = 3;
+  MPI_Comm communicator = MPI_COMM_WORLD;
+
+  double const initial_temperature = 300.;
+  double const new_material_temperature = 500.;
+
+  boost::property_tree::ptree database;
+  // Geometry database
+  database.put("geometry.import_mesh", false);
+  database.put("geometry.length", 10);
+  database.put("geometry.length_divisions", 10);
+  database.put("geometry.width", 10);
+  database.put("geometry.width_divisions", 10);
+  database.put("geometry.height", 10);
+  database.put("geometry.height_divisions", 10);
+  database.put("geometry.material_height", 6.);
+  database.put("geometry.material_deposition", true);
+  database.put("geometry.material_deposition_file",
+               "material_path_test_material_deposition.txt");
+  database.put("geometry.quiet_element_activation", true);
+  // Build Geometry
+  boost::property_tree::ptree geometry_database =
+      database.get_child("geometry");
+  adamantine::Geometry<dim> geometry(communicator, geometry_database);
+
+  // MaterialProperty database
+  database.put("materials.property_format", "polynomial");
+  database.put("materials.initial_temperature", initial_temperature);
+  database.put("materials.new_material_temperature", new_material_temperature);
+  database.put("materials.n_materials", 1);
+  database.put("materials.material_0.solid.density", 1.);
+  database.put("materials.material_0.liquid.density", 1.);
+  database.put("materials.material_0.solid.specific_heat", 1.);
+  database.put("materials.material_0.liquid.specific_heat", 1.);
+  database.put("materials.material_0.solid.thermal_conductivity_x", 1.);
+  database.put("materials.material_0.solid.thermal_conductivity_z", 1.);
+  database.put("materials.material_0.liquid.thermal_conductivity_x", 1.);
+  database.put("materials.material_0.liquid.thermal_conductivity_z", 1.);
+  // Build MaterialProperty
+  boost::property_tree::ptree material_property_database =
+      database.get_child("materials");
+  adamantine::MaterialProperty<dim, 1, adamantine::SolidLiquidPowder,
+                               dealii::MemorySpace::Host>
+      material_properties(communicator, geometry.get_triangulation(),
+                          material_property_database);
+
+  // Source database
+  database.put("sources.n_beams", 0);
+  // Time-stepping database
+  database.put("time_stepping.method", "forward_euler");
+  // Boundary database
+  database.put("boundary.type", "adiabatic");
+
+  // Build ThermalPhysics
+  adamantine::ThermalPhysics<dim, 1, dim, adamantine::SolidLiquidPowder,
+                             dealii::MemorySpace::Host, dealii::QGauss<1>>
+      thermal_physics(communicator, database, geometry, material_properties);
+  thermal_physics.setup();
+  auto &dof_handler = thermal_physics.get_dof_handler();
+
+  auto [material_deposition_boxes, deposition_times, deposition_cos,
+        deposition_sin] =
+      adamantine::read_material_deposition<dim>(geometry_database);
+  dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host> solution;
+  thermal_physics.initialize_dof_vector(initial_temperature, solution);
+
+  auto count_cells = [&]()
+  {
+    unsigned int n_material_cells = 0;
+    unsigned int n_quiet_cells = 0;
+    for (auto const &cell : dealii::filter_iterators(
+             dof_handler.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell(),
+             dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
+    {
+      ++n_material_cells;
+      if (thermal_physics.is_quiet(cell))
+        ++n_quiet_cells;
+    }
+    return std::make_pair(
+        dealii::Utilities::MPI::sum(n_material_cells, communicator),
+        dealii::Utilities::MPI::sum(n_quiet_cells, communicator));
+  };
+
+  double const time_step = 0.1;
+  double const eps = time_step / 1e12;
+  auto activate = [&](double const time)
+  {
+    auto activation_start =
+        std::lower_bound(deposition_times.begin(), deposition_times.end(),
+                         time - eps) -
+        deposition_times.begin();
+    auto activation_end =
+        std::lower_bound(deposition_times.begin(), deposition_times.end(),
+                         time + time_step - eps) -
+        deposition_times.begin();
+    adamantine::ActivationSearch<dim> activation_search(
+        dof_handler,
+        [&](dealii::DoFHandler<dim>::active_cell_iterator const &cell)
+        { return thermal_physics.is_quiet(cell); });
+    auto elements_to_activate = activation_search.get_elements_to_activate(
+        material_deposition_boxes, activation_start, activation_end);
+    BOOST_TEST(thermal_physics.schedule_material(
+        elements_to_activate, deposition_cos, deposition_sin, activation_start,
+        activation_end, new_material_temperature));
+
+    return thermal_physics.activate_scheduled_material();
+  };
+
+  // The first deposition in the layer requires a mesh change. The whole layer
+  // gets degrees of freedom but only the deposited cells are active.
+  BOOST_TEST(activate(time_step));
+  thermal_physics.execute_mesh_changes(solution, true);
+  auto [n_material_cells, n_quiet_cells] = count_cells();
+  BOOST_TEST(n_material_cells == 600 + 100);
+  BOOST_TEST(n_quiet_cells == 100 - 10);
+  std::vector<adamantine::Timer> timers(adamantine::Timing::n_timers);
+  thermal_physics.evolve_one_time_step(time_step, time_step, solution, timers);
+
+  // The next depositions in the layer only activate quiet cells
+  auto const n_dofs = dof_handler.n_dofs();
+  BOOST_TEST(!activate(2. * time_step));
+  std::tie(n_material_cells, n_quiet_cells) = count_cells();
+  BOOST_TEST(dof_handler.n_dofs() == n_dofs);
+  BOOST_TEST(n_material_cells == 600 + 100);
+  BOOST_TEST(n_quiet_cells < 100 - 10);
+  thermal_physics.evolve_one_time_step(2. * time_step, time_step, solution,
+                                       timers);
+}
+
 BOOST_AUTO_TEST_CASE(deposition_from_scan_path_2d, *utf::tolerance(1e-13))
 {
   adamantine::ScanPath scan_path("scan_path.txt", "segment");
@@ -644,3 +1070,134 @@ BOOST_AUTO_TEST_CASE(merge_multiple_deposition_paths, *utf::tolerance(1e-10))
     BOOST_TEST(sin[i] == sin_ref[i]);
   }
 }
+
+BOOST_AUTO_TEST_CASE(deposition_stream)
+{
+  boost::property_tree::ptree geometry_database;
+  geometry_database.put("material_deposition", true);
+  geometry_database.put("material_deposition_method", "scan_paths");
+  geometry_database.put("deposition_length", 0.0005);
+  geometry_database.put("deposition_height", 0.1);
+  geometry_database.put("deposition_width", 0.1);
+  geometry_database.put("deposition_lead_time", 0.0);
+
+  std::vector<std::shared_ptr<adamantine::HeatSource<3>>> heat_sources;
+  for (std::string const scan_path_file :
+       {"scan_path_L.txt", "scan_path_layers.txt"})
+  {
+    boost::property_tree::ptree beam_database;
+    beam_database.put("depth", 0.1);
+    beam_database.put("absorption_efficiency", 0.1);
+    beam_database.put("diameter", 1.0);
+    beam_database.put("max_power", 10.);
+    beam_database.put("scan_path_file", scan_path_file);
+    beam_database.put("scan_path_file_format", "segment");
+    heat_sources.push_back(
+        std::make_shared<adamantine::GoldakHeatSource<3>>(beam_database));
+  }
+
+  // Reference: all the boxes of the build
+  auto [bounding_boxes_ref, times_ref, cos_ref, sin_ref] =
+      adamantine::create_material_deposition_boxes<3>(geometry_database,
+                                                      heat_sources);
+  BOOST_TEST(times_ref.size() > 0u);
+
+  // Go through the build using windows of different sizes and check that we
+  // get the same boxes.
+  adamantine::DepositionStream<3> deposition_stream(geometry_database,
+                                                    heat_sources);
+  double const window = 3e-4;
+  unsigned int n_boxes = 0;
+  for (double start_time = 0.; start_time < times_ref.back() + window;
+       start_time += window)
+  {
+    double const end_time = start_time + 1.5 * window;
+    deposition_stream.advance(start_time, end_time);
+    auto const &times = deposition_stream.get_times();
+    auto const begin_ref =
+        std::lower_bound(times_ref.begin(), times_ref.end(), start_time);
+    auto const end_ref =
+        std::lower_bound(times_ref.begin(), times_ref.end(), end_time);
+    BOOST_TEST(times.size() == static_cast<unsigned int>(end_ref - begin_ref));
+    BOOST_TEST(std::equal(times.begin(), times.end(), begin_ref));
+    BOOST_TEST(std::is_sorted(times.begin(), times.end()));
+    n_boxes = std::max(n_boxes, static_cast<unsigned int>(times.size()));
+  }
+  // Only the boxes in the window are stored
+  BOOST_TEST(n_boxes < times_ref.size());
+
+  // Restart the deposition in the middle of the build
+  double const restart_time = times_ref[times_ref.size() / 2];
+  deposition_stream.reset(restart_time);
+  deposition_stream.advance(restart_time, restart_time + window);
+  auto const &times = deposition_stream.get_times();
+  auto const begin_ref =
+      std::lower_bound(times_ref.begin(), times_ref.end(), restart_time);
+  BOOST_TEST(times.size() > 0u);
+  BOOST_TEST(std::equal(times.begin(), times.end(), begin_ref));
+}
+
+BOOST_AUTO_TEST_CASE(activation_search_same_cells)
+{
+  int constexpr dim = 2;
+
+  // The first mesh refines the first cell, coarsens it back, and refines the
+  // second cell. The children of the second cell reuse the positions freed by
+  // the children of the first cell. The second mesh only refines the first
+  // cell. The third mesh refines the second cell.
+  std::array<dealii::Triangulation<dim>, 3> triangulations;
+  for (auto &triangulation : triangulations)
+  {
+    dealii::GridGenerator::subdivided_hyper_rectangle(
+        triangulation, {2, 1}, dealii::Point<dim>(0., 0.),
+        dealii::Point<dim>(2., 1.));
+  }
+  auto refine_coarse_cell = [](dealii::Triangulation<dim> &triangulation,
+                               int const coarse_cell)
+  {
+    for (auto const &cell : triangulation.active_cell_iterators())
+    {
+      if ((cell->level() == 0) && (cell->index() == coarse_cell))
+        cell->set_refine_flag();
+    }
+    triangulation.execute_coarsening_and_refinement();
+  };
+  refine_coarse_cell(triangulations[0], 0);
+  for (auto const &cell : triangulations[0].active_cell_iterators())
+    cell->set_coarsen_flag();
+  triangulations[0].execute_coarsening_and_refinement();
+  refine_coarse_cell(triangulations[0], 1);
+  refine_coarse_cell(triangulations[1], 0);
+  refine_coarse_cell(triangulations[2], 1);
+
+  // Only the children are not activated.
+  dealii::hp::FECollection<dim> fe_collection;
+  fe_collection.push_back(dealii::FE_Q<dim>(1));
+  fe_collection.push_back(dealii::FE_Nothing<dim>());
+  std::vector<std::unique_ptr<dealii::DoFHandler<dim>>> dof_handlers;
+  std::vector<std::vector<std::pair<int, int>>> positions;
+  for (auto &triangulation : triangulations)
+  {
+    auto &dof_handler = *dof_handlers.emplace_back(
+        std::make_unique<dealii::DoFHandler<dim>>(triangulation));
+    for (auto const &cell : dof_handler.active_cell_iterators())
+      cell->set_active_fe_index(cell->level() == 1 ? 1 : 0);
+    dof_handler.distribute_dofs(fe_collection);
+    auto &cell_positions = positions.emplace_back();
+    for (auto const &cell : dof_handler.active_cell_iterators())
+    {
+      if (cell->level() == 1)
+        cell_positions.emplace_back(cell->level(), cell->index());
+    }
+  }
+  // The children of different cells are stored at the same positions.
+  BOOST_REQUIRE(positions[0] == positions[1]);
+
+  adamantine::ActivationSearch<dim> search_0(*dof_handlers[0]);
+  adamantine::ActivationSearch<dim> search_1(*dof_handlers[1]);
+  adamantine::ActivationSearch<dim> search_2(*dof_handlers[2]);
+  BOOST_TEST(!search_0.has_same_cells(search_1));
+  BOOST_TEST(!search_1.has_same_cells(search_2));
+  BOOST_TEST(search_0.has_same_cells(search_2) ==
+             (positions[0] == positions[2]));
+}
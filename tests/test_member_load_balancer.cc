@@ -0,0 +1,85 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE MemberLoadBalancer
+
+#include <MemberLoadBalancer.hh>
+
+#include <deal.II/base/mpi.h>
+
+#include "main.cc"
+
+namespace utf = boost::unit_test;
+
+namespace adamantine
+{
+BOOST_AUTO_TEST_CASE(member_load_balancer, *utf::tolerance(1e-12))
+{
+  MPI_Comm communicator = MPI_COMM_WORLD;
+  unsigned int const rank =
+      dealii::Utilities::MPI::this_mpi_process(communicator);
+  unsigned int const n_procs =
+      dealii::Utilities::MPI::n_mpi_processes(communicator);
+
+  // Every processor is its own color and owns three members. The members of
+  // the first processor are ten times more expensive than the others.
+  std::vector<unsigned int> members = {3 * rank, 3 * rank + 1, 3 * rank + 2};
+  double const member_time = rank == 0 ? 10. : 1.;
+
+  MemberLoadBalancer member_load_balancer(communicator, rank, 1.2);
+
+  // Without timings, the load is balanced.
+  BOOST_TEST(member_load_balancer.compute_migrations(members).empty());
+  BOOST_TEST(member_load_balancer.get_imbalance() == 1.);
+
+  // The timings of a member are accumulated.
+  for (auto const member : members)
+  {
+    member_load_balancer.add_member_timing(member, 0.5 * member_time);
+    member_load_balancer.add_member_timing(member, 0.5 * member_time);
+  }
+  auto migrations = member_load_balancer.compute_migrations(members);
+  if (n_procs == 1)
+  {
+    BOOST_TEST(member_load_balancer.get_imbalance() == 1.);
+    BOOST_TEST(migrations.empty());
+  }
+  else
+  {
+    double const avg = (30. + 3. * (n_procs - 1)) / n_procs;
+    BOOST_TEST(member_load_balancer.get_imbalance() == 30. / avg);
+    BOOST_TEST(migrations.size() > 0);
+    for (auto const &migration : migrations)
+    {
+      // The first member of a color is never moved.
+      BOOST_TEST(migration.member % 3 != 0);
+      BOOST_TEST(migration.source_color != migration.destination_color);
+    }
+  }
+  if (n_procs == 2)
+  {
+    // Moving a second member would make the second processor the most loaded
+    // one.
+    BOOST_TEST(migrations.size() == 1);
+    BOOST_TEST(migrations[0].member == 1);
+    BOOST_TEST(migrations[0].source_color == 0);
+    BOOST_TEST(migrations[0].destination_color == 1);
+  }
+
+  // The timings are discarded after the migrations are computed.
+  BOOST_TEST(member_load_balancer.compute_migrations(members).empty());
+  BOOST_TEST(member_load_balancer.get_imbalance() == 1.);
+
+  // Below the threshold, the imbalance is measured but no member is moved.
+  MemberLoadBalancer tolerant_balancer(communicator, rank, 100.);
+  for (auto const member : members)
+    tolerant_balancer.add_member_timing(member, member_time);
+  BOOST_TEST(tolerant_balancer.compute_migrations(members).empty());
+  if (n_procs > 1)
+    BOOST_TEST(tolerant_balancer.get_imbalance() > 1.);
+}
+} // namespace adamantine
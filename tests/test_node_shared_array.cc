@@ -0,0 +1,67 @@
+/* Copyright (c) 2024, the adamantine authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE NodeSharedArray
+
+#include <NodeSharedArray.hh>
+
+#include <numeric>
+
+#include "main.cc"
+
+BOOST_AUTO_TEST_CASE(node_shared_array)
+{
+  MPI_Comm communicator = MPI_COMM_WORLD;
+
+  // Only the first processor of the node fills the vector.
+  MPI_Comm node_communicator;
+  MPI_Comm_split_type(communicator, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                      &node_communicator);
+  int node_rank = 0;
+  int node_size = 0;
+  MPI_Comm_rank(node_communicator, &node_rank);
+  MPI_Comm_size(node_communicator, &node_size);
+  MPI_Comm_free(&node_communicator);
+
+  unsigned int const size = 100;
+  std::vector<double> values;
+  if (node_rank == 0)
+  {
+    values.resize(size);
+    std::iota(values.begin(), values.end(), 0.);
+  }
+
+  adamantine::NodeSharedArray<double> shared_array(communicator, values);
+
+  BOOST_TEST(shared_array.size() == size);
+  BOOST_TEST(!shared_array.empty());
+  for (unsigned int i = 0; i < size; ++i)
+    BOOST_TEST(shared_array[i] == static_cast<double>(i));
+  BOOST_TEST(shared_array.back() == static_cast<double>(size - 1));
+  BOOST_TEST(std::accumulate(shared_array.begin(), shared_array.end(), 0.) ==
+             size * (size - 1) / 2.);
+
+  // The copy shares the same memory.
+  adamantine::NodeSharedArray<double> shared_array_copy = shared_array;
+  BOOST_TEST(shared_array_copy.data() == shared_array.data());
+
+  std::size_t const memory_saved = node_rank == 0 ? 0 : size * sizeof(double);
+  BOOST_TEST(shared_array.memory_saved() == memory_saved);
+
+  // The memory saved on all the nodes is at least the memory saved on the
+  // current node.
+  unsigned long long local_memory_saved = shared_array.memory_saved();
+  unsigned long long global_memory_saved = 0;
+  MPI_Allreduce(&local_memory_saved, &global_memory_saved, 1,
+                MPI_UNSIGNED_LONG_LONG, MPI_SUM, communicator);
+  BOOST_TEST(global_memory_saved >= (node_size - 1) * size * sizeof(double));
+
+  // Empty array
+  adamantine::NodeSharedArray<double> empty_array(communicator, {});
+  BOOST_TEST(empty_array.empty());
+  BOOST_TEST(empty_array.memory_saved() == 0);
+}
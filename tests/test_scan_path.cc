@@ -1,4 +1,4 @@
-/* Copyright (c) 2016 - 2021, the adamantine authors.
+/* Copyright (c) 2016 - 2024, the adamantine authors.
  *
  * This file is subject to the Modified BSD License and may not be distributed
  * without copyright and license information. Please refer to the file LICENSE
@@ -100,4 +100,47 @@ BOOST_AUTO_TEST_CASE(scan_path_location, *utf::tolerance(1e-10))
   BOOST_TEST(power == 0.0);
 }
 
+BOOST_AUTO_TEST_CASE(scan_path_share_on_node, *utf::tolerance(1e-10))
+{
+  ScanPath scan_path("scan_path.txt", "segment");
+  ScanPath shared_scan_path("scan_path.txt", "segment");
+  shared_scan_path.share_on_node(MPI_COMM_WORLD);
+
+  auto segment_list = scan_path.get_segment_list();
+  auto shared_segment_list = shared_scan_path.get_segment_list();
+  BOOST_TEST(segment_list.size() == shared_segment_list.size());
+  for (unsigned int i = 0; i < segment_list.size(); ++i)
+  {
+    BOOST_TEST(segment_list[i].end_time == shared_segment_list[i].end_time);
+    BOOST_TEST(segment_list[i].power_modifier ==
+               shared_segment_list[i].power_modifier);
+    BOOST_TEST(segment_list[i].end_point.distance(
+                   shared_segment_list[i].end_point) == 0.);
+  }
+
+  for (double time : {1.0e-7, 0.001001})
+  {
+    dealii::Point<3> p = scan_path.value(time);
+    dealii::Point<3> shared_p = shared_scan_path.value(time);
+    BOOST_TEST(p.distance(shared_p) == 0.);
+    BOOST_TEST(scan_path.get_power_modifier(time) ==
+               shared_scan_path.get_power_modifier(time));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(scan_path_travel_end_time, *utf::tolerance(1e-12))
+{
+  ScanPath scan_path("scan_path.txt", "segment");
+  double const path_end_time = 1.0e-6 + 0.002 / 0.8;
+
+  // The heat source moves at 0.8 m/s after the first segment
+  BOOST_TEST(scan_path.get_travel_end_time(1.0e-6, 8.0e-4) == 0.001001);
+  // The heat source does not move during the first segment
+  BOOST_TEST(scan_path.get_travel_end_time(0., 8.0e-4) == 0.001001);
+  BOOST_TEST(scan_path.get_travel_end_time(0.001001, 4.0e-4) == 0.001501);
+  // The scan path ends before the heat source has traveled the distance
+  BOOST_TEST(scan_path.get_travel_end_time(0.001001, 1.) == path_end_time);
+  BOOST_TEST(scan_path.get_travel_end_time(1., 1.) == path_end_time);
+}
+
 } // namespace adamantine
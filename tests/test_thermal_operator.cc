@@ -13,17 +13,21 @@
 #include <Geometry.hh>
 #include <GoldakHeatSource.hh>
 #include <ThermalOperator.hh>
+#include <dof_renumbering.hh>
 
+#include <deal.II/base/function.h>
 #include <deal.II/base/quadrature_lib.h>
 #include <deal.II/dofs/dof_tools.h>
 #include <deal.II/fe/fe_nothing.h>
 #include <deal.II/fe/fe_q.h>
 #include <deal.II/fe/fe_values.h>
 #include <deal.II/fe/mapping_q1.h>
+#include <deal.II/grid/filtered_iterator.h>
 #include <deal.II/lac/dynamic_sparsity_pattern.h>
 #include <deal.II/lac/sparse_matrix.h>
 #include <deal.II/matrix_free/fe_point_evaluation.h>
 #include <deal.II/numerics/matrix_tools.h>
+#include <deal.II/numerics/vector_tools.h>
 
 #include <boost/property_tree/ptree.hpp>
 
@@ -921,3 +925,372 @@ BOOST_AUTO_TEST_CASE(spmv_conv, *utf::tolerance(1e-12))
     BOOST_TEST(dst_1 == dst_2, tt::per_element());
   }
 }
+
+BOOST_AUTO_TEST_CASE(gradient_jump_indicators, *utf::tolerance(1e-6))
+{
+  MPI_Comm communicator = MPI_COMM_WORLD;
+
+  // Create the Geometry
+  boost::property_tree::ptree geometry_database;
+  geometry_database.put("import_mesh", false);
+  geometry_database.put("length", 12);
+  geometry_database.put("length_divisions", 4);
+  geometry_database.put("height", 6);
+  geometry_database.put("height_divisions", 5);
+  adamantine::Geometry<2> geometry(communicator, geometry_database);
+  // Create the DoFHandler
+  dealii::hp::FECollection<2> fe_collection;
+  fe_collection.push_back(dealii::FE_Q<2>(1));
+  fe_collection.push_back(dealii::FE_Nothing<2>());
+  dealii::DoFHandler<2> dof_handler(geometry.get_triangulation());
+  dof_handler.distribute_dofs(fe_collection);
+  dealii::AffineConstraints<double> affine_constraints;
+  affine_constraints.close();
+  dealii::hp::QCollection<1> q_collection;
+  q_collection.push_back(dealii::QGauss<1>(2));
+  q_collection.push_back(dealii::QGauss<1>(1));
+
+  // Create the MaterialProperty
+  boost::property_tree::ptree mat_prop_database;
+  mat_prop_database.put("property_format", "polynomial");
+  mat_prop_database.put("n_materials", 1);
+  mat_prop_database.put("material_0.solid.density", 1.);
+  mat_prop_database.put("material_0.powder.density", 1.);
+  mat_prop_database.put("material_0.liquid.density", 1.);
+  mat_prop_database.put("material_0.solid.specific_heat", 1.);
+  mat_prop_database.put("material_0.powder.specific_heat", 1.);
+  mat_prop_database.put("material_0.liquid.specific_heat", 1.);
+  mat_prop_database.put("material_0.solid.thermal_conductivity_x", 10.);
+  mat_prop_database.put("material_0.solid.thermal_conductivity_z", 10.);
+  mat_prop_database.put("material_0.powder.thermal_conductivity_x", 10.);
+  mat_prop_database.put("material_0.powder.thermal_conductivity_z", 10.);
+  mat_prop_database.put("material_0.liquid.thermal_conductivity_x", 10.);
+  mat_prop_database.put("material_0.liquid.thermal_conductivity_z", 10.);
+  adamantine::MaterialProperty<2, 1, adamantine::SolidLiquidPowder,
+                               dealii::MemorySpace::Host>
+      mat_properties(communicator, geometry.get_triangulation(),
+                     mat_prop_database);
+
+  // Initialize the ThermalOperator
+  std::vector<std::shared_ptr<adamantine::HeatSource<2>>> heat_sources;
+  adamantine::ThermalOperator<2, false, 1, 1, adamantine::SolidLiquidPowder,
+                              dealii::MemorySpace::Host>
+      thermal_operator(communicator, adamantine::BoundaryType::adiabatic,
+                       mat_properties, heat_sources);
+  thermal_operator.reinit(dof_handler, affine_constraints, q_collection);
+
+  // The temperature has a kink at x = 6 which is a face of the mesh
+  dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host>
+      temperature;
+  thermal_operator.initialize_dof_vector(temperature);
+  dealii::VectorTools::interpolate(
+      dof_handler,
+      dealii::ScalarFunctionFromFunctionObject<2>(
+          [](dealii::Point<2> const &point) { return std::abs(point[0] - 6.); }),
+      temperature);
+
+  dealii::Vector<float> indicators;
+  thermal_operator.compute_gradient_jump_indicators(temperature, indicators);
+  BOOST_TEST(indicators.size() ==
+             geometry.get_triangulation().n_active_cells());
+
+  // Only the cells next to the kink have a jump. The jump of the normal
+  // derivative is 2 and the faces have a length of 1.2.
+  double const expected_indicator = std::sqrt(1.2 / 24. * 4. * 1.2);
+  for (auto const &cell : dealii::filter_iterators(
+           dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    double const indicator = indicators[cell->active_cell_index()];
+    if (std::abs(cell->center()[0] - 6.) < 2.)
+      BOOST_TEST(indicator == expected_indicator);
+    else
+      BOOST_TEST(indicator == 0.);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(thermal_operator_dof_renumbering, *utf::tolerance(1e-10))
+{
+  MPI_Comm communicator = MPI_COMM_WORLD;
+
+  // Create an adapted mesh with hanging nodes
+  boost::property_tree::ptree geometry_database;
+  geometry_database.put("import_mesh", false);
+  geometry_database.put("length", 12);
+  geometry_database.put("length_divisions", 48);
+  geometry_database.put("height", 6);
+  geometry_database.put("height_divisions", 24);
+  adamantine::Geometry<2> geometry(communicator, geometry_database);
+  auto &triangulation = geometry.get_triangulation();
+  for (auto const &cell : dealii::filter_iterators(
+           triangulation.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    if ((cell->center()[0] < 6.) && (cell->center()[1] > 2.))
+      cell->set_refine_flag();
+  }
+  triangulation.execute_coarsening_and_refinement();
+
+  dealii::hp::FECollection<2> fe_collection;
+  fe_collection.push_back(dealii::FE_Q<2>(2));
+  fe_collection.push_back(dealii::FE_Nothing<2>());
+  dealii::DoFHandler<2> dof_handler(triangulation);
+  dealii::AffineConstraints<double> affine_constraints;
+  dealii::hp::QCollection<1> q_collection;
+  q_collection.push_back(dealii::QGauss<1>(3));
+  q_collection.push_back(dealii::QGauss<1>(1));
+
+  // Create the MaterialProperty
+  boost::property_tree::ptree mat_prop_database;
+  mat_prop_database.put("property_format", "polynomial");
+  mat_prop_database.put("n_materials", 1);
+  mat_prop_database.put("material_0.solid.density", 1.);
+  mat_prop_database.put("material_0.powder.density", 1.);
+  mat_prop_database.put("material_0.liquid.density", 1.);
+  mat_prop_database.put("material_0.solid.specific_heat", 1.);
+  mat_prop_database.put("material_0.powder.specific_heat", 1.);
+  mat_prop_database.put("material_0.liquid.specific_heat", 1.);
+  mat_prop_database.put("material_0.solid.thermal_conductivity_x", 10.);
+  mat_prop_database.put("material_0.solid.thermal_conductivity_z", 10.);
+  mat_prop_database.put("material_0.powder.thermal_conductivity_x", 10.);
+  mat_prop_database.put("material_0.powder.thermal_conductivity_z", 10.);
+  mat_prop_database.put("material_0.liquid.thermal_conductivity_x", 10.);
+  mat_prop_database.put("material_0.liquid.thermal_conductivity_z", 10.);
+  adamantine::MaterialProperty<2, 1, adamantine::SolidLiquidPowder,
+                               dealii::MemorySpace::Host>
+      mat_properties(communicator, triangulation, mat_prop_database);
+
+  // Create the heat sources
+  boost::property_tree::ptree beam_database;
+  beam_database.put("depth", 0.1);
+  beam_database.put("absorption_efficiency", 0.1);
+  beam_database.put("diameter", 1.0);
+  beam_database.put("max_power", 0.);
+  beam_database.put("scan_path_file", "scan_path.txt");
+  beam_database.put("scan_path_file_format", "segment");
+  std::vector<std::shared_ptr<adamantine::HeatSource<2>>> heat_sources;
+  heat_sources.resize(1);
+  heat_sources[0] =
+      std::make_shared<adamantine::GoldakHeatSource<2>>(beam_database);
+  heat_sources[0]->update_time(0.);
+
+  adamantine::ThermalOperator<2, false, 1, 2, adamantine::SolidLiquidPowder,
+                              dealii::MemorySpace::Host>
+      thermal_operator(communicator, adamantine::BoundaryType::adiabatic,
+                       mat_properties, heat_sources);
+  std::vector<double> deposition_cos(
+      triangulation.n_locally_owned_active_cells(), 1.);
+  std::vector<double> deposition_sin(
+      triangulation.n_locally_owned_active_cells(), 0.);
+
+  dealii::ScalarFunctionFromFunctionObject<2> function(
+      [](dealii::Point<2> const &p) { return p[0] + 2. * p[1] * p[1]; });
+
+  // Apply the operator with the different orderings. The orderings only
+  // permute the degrees of freedom, so the value associated with each degree
+  // of freedom of each cell does not change.
+  std::vector<double> reference_values;
+  for (auto const dof_ordering : {adamantine::DoFOrdering::none,
+                                  adamantine::DoFOrdering::space_filling_curve,
+                                  adamantine::DoFOrdering::data_locality})
+  {
+    dof_handler.distribute_dofs(fe_collection);
+    auto make_constraints = [&]()
+    {
+      dealii::IndexSet locally_relevant_dofs;
+      dealii::DoFTools::extract_locally_relevant_dofs(dof_handler,
+                                                      locally_relevant_dofs);
+      affine_constraints.clear();
+      affine_constraints.reinit(locally_relevant_dofs);
+      dealii::DoFTools::make_hanging_node_constraints(dof_handler,
+                                                      affine_constraints);
+      affine_constraints.close();
+    };
+    make_constraints();
+    adamantine::renumber_dofs(dof_ordering, dof_handler, affine_constraints);
+    make_constraints();
+
+    thermal_operator.reinit(dof_handler, affine_constraints, q_collection);
+    thermal_operator.set_material_deposition_orientation(deposition_cos,
+                                                         deposition_sin);
+    thermal_operator.compute_inverse_mass_matrix(dof_handler,
+                                                 affine_constraints);
+    thermal_operator.get_state_from_material_properties();
+
+    dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host> src;
+    dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host> dst;
+    dealii::MatrixFree<2, double> const &matrix_free =
+        thermal_operator.get_matrix_free();
+    matrix_free.initialize_dof_vector(src);
+    matrix_free.initialize_dof_vector(dst);
+    dealii::VectorTools::interpolate(dof_handler, function, src);
+    affine_constraints.distribute(src);
+
+    thermal_operator.vmult(dst, src);
+    dst.update_ghost_values();
+
+    // The cells are visited in the same order for every ordering.
+    std::vector<double> values;
+    std::vector<dealii::types::global_dof_index> local_dof_indices;
+    for (auto const &cell : dealii::filter_iterators(
+             dof_handler.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell(),
+             dealii::IteratorFilters::ActiveFEIndexEqualTo(0)))
+    {
+      local_dof_indices.resize(cell->get_fe().n_dofs_per_cell());
+      cell->get_dof_indices(local_dof_indices);
+      for (auto const dof : local_dof_indices)
+        values.push_back(dst(dof));
+    }
+
+    if (dof_ordering == adamantine::DoFOrdering::none)
+    {
+      reference_values = values;
+      BOOST_TEST(dst.l2_norm() > 0.);
+    }
+    else
+    {
+      // The contributions of the cells may be added in a different order, so
+      // the values are compared relative to the largest value.
+      double max_value = 0.;
+      for (auto const value : reference_values)
+        max_value = std::max(max_value, std::abs(value));
+      BOOST_TEST(values.size() == reference_values.size());
+      for (unsigned int i = 0; i < values.size(); ++i)
+        BOOST_TEST(std::abs(values[i] - reference_values[i]) <=
+                   1e-12 * max_value);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(batched_vmult, *utf::tolerance(1e-12))
+{
+  MPI_Comm communicator = MPI_COMM_WORLD;
+
+  // Create the Geometry
+  boost::property_tree::ptree geometry_database;
+  geometry_database.put("import_mesh", false);
+  geometry_database.put("length", 12);
+  geometry_database.put("length_divisions", 8);
+  geometry_database.put("height", 6);
+  geometry_database.put("height_divisions", 4);
+  adamantine::Geometry<2> geometry(communicator, geometry_database);
+  // Create the DoFHandler
+  dealii::hp::FECollection<2> fe_collection;
+  fe_collection.push_back(dealii::FE_Q<2>(2));
+  fe_collection.push_back(dealii::FE_Nothing<2>());
+  dealii::DoFHandler<2> dof_handler(geometry.get_triangulation());
+  dof_handler.distribute_dofs(fe_collection);
+  dealii::AffineConstraints<double> affine_constraints;
+  affine_constraints.close();
+  dealii::hp::QCollection<1> q_collection;
+  q_collection.push_back(dealii::QGauss<1>(3));
+  q_collection.push_back(dealii::QGauss<1>(1));
+
+  // Create the MaterialProperty
+  boost::property_tree::ptree mat_prop_database;
+  mat_prop_database.put("property_format", "polynomial");
+  mat_prop_database.put("n_materials", 1);
+  mat_prop_database.put("material_0.solid.density", 1.);
+  mat_prop_database.put("material_0.powder.density", 1.);
+  mat_prop_database.put("material_0.liquid.density", 1.);
+  mat_prop_database.put("material_0.solid.specific_heat", 1.);
+  mat_prop_database.put("material_0.powder.specific_heat", 1.);
+  mat_prop_database.put("material_0.liquid.specific_heat", 1.);
+  mat_prop_database.put("material_0.solid.thermal_conductivity_x", "1.,0.1");
+  mat_prop_database.put("material_0.solid.thermal_conductivity_z", "1.,0.1");
+  mat_prop_database.put("material_0.powder.thermal_conductivity_x", 1.);
+  mat_prop_database.put("material_0.powder.thermal_conductivity_z", 1.);
+  mat_prop_database.put("material_0.liquid.thermal_conductivity_x", 1.);
+  mat_prop_database.put("material_0.liquid.thermal_conductivity_z", 1.);
+  mat_prop_database.put("material_0.solid.emissivity", 1.);
+  mat_prop_database.put("material_0.powder.emissivity", 1.);
+  mat_prop_database.put("material_0.liquid.emissivity", 1.);
+  mat_prop_database.put("material_0.radiation_temperature_infty", 0.0);
+  adamantine::MaterialProperty<2, 1, adamantine::SolidLiquidPowder,
+                               dealii::MemorySpace::Host>
+      mat_properties(communicator, geometry.get_triangulation(),
+                     mat_prop_database);
+
+  // Create the heat sources of each member. The members differ by their power.
+  unsigned int constexpr n_members = 2;
+  std::vector<std::vector<std::shared_ptr<adamantine::HeatSource<2>>>>
+      member_heat_sources(n_members);
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    boost::property_tree::ptree beam_database;
+    beam_database.put("depth", 1.);
+    beam_database.put("absorption_efficiency", 0.1);
+    beam_database.put("diameter", 4.0);
+    beam_database.put("max_power", 10. * (m + 1));
+    beam_database.put("scan_path_file", "scan_path.txt");
+    beam_database.put("scan_path_file_format", "segment");
+    member_heat_sources[m].push_back(
+        std::make_shared<adamantine::GoldakHeatSource<2>>(beam_database));
+  }
+
+  std::vector<double> deposition_cos(
+      geometry.get_triangulation().n_locally_owned_active_cells(), 1.);
+  std::vector<double> deposition_sin(
+      geometry.get_triangulation().n_locally_owned_active_cells(), 0.);
+  using ThermalOperatorType =
+      adamantine::ThermalOperator<2, false, 1, 2, adamantine::SolidLiquidPowder,
+                                  dealii::MemorySpace::Host>;
+  auto setup_operator = [&](ThermalOperatorType &thermal_operator)
+  {
+    thermal_operator.reinit(dof_handler, affine_constraints, q_collection);
+    thermal_operator.set_material_deposition_orientation(deposition_cos,
+                                                         deposition_sin);
+    thermal_operator.compute_inverse_mass_matrix(dof_handler,
+                                                 affine_constraints);
+    thermal_operator.get_state_from_material_properties();
+  };
+
+  // The batched operator uses the heat sources of the members while the
+  // reference operators apply each member separately.
+  ThermalOperatorType batched_operator(communicator,
+                                       adamantine::BoundaryType::radiative,
+                                       mat_properties, member_heat_sources[0]);
+  setup_operator(batched_operator);
+  for (unsigned int m = 0; m < n_members; ++m)
+    batched_operator.store_block_state(m);
+  batched_operator.set_block_heat_sources(member_heat_sources);
+  batched_operator.set_time_and_source_height(0.1, 6.);
+
+  dealii::LA::distributed::BlockVector<double> src(n_members);
+  dealii::LA::distributed::BlockVector<double> dst(n_members);
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    batched_operator.initialize_dof_vector(src.block(m));
+    batched_operator.initialize_dof_vector(dst.block(m));
+  }
+  src.collect_sizes();
+  dst.collect_sizes();
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    dealii::ScalarFunctionFromFunctionObject<2> function(
+        [&](dealii::Point<2> const &p)
+        { return 1. + m + 0.1 * p[0] + 0.05 * (m + 1) * p[1] * p[1]; });
+    dealii::VectorTools::interpolate(dof_handler, function, src.block(m));
+  }
+  batched_operator.vmult(dst, src);
+
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    ThermalOperatorType thermal_operator(
+        communicator, adamantine::BoundaryType::radiative, mat_properties,
+        member_heat_sources[m]);
+    setup_operator(thermal_operator);
+    thermal_operator.set_time_and_source_height(0.1, 6.);
+    dealii::LA::distributed::Vector<double, dealii::MemorySpace::Host>
+        reference;
+    thermal_operator.initialize_dof_vector(reference);
+    thermal_operator.vmult(reference, src.block(m));
+
+    BOOST_TEST(reference.l2_norm() > 0.);
+    BOOST_TEST(dst.block(m) == reference, tt::per_element());
+  }
+
+  // The heat sources contribute to the result of both members.
+  BOOST_TEST(dst.block(0).l2_norm() != dst.block(1).l2_norm());
+}
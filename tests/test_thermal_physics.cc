@@ -71,3 +71,8 @@ BOOST_AUTO_TEST_CASE(reference_temperature_host)
 {
   reference_temperature<dealii::MemorySpace::Host>();
 }
+
+BOOST_AUTO_TEST_CASE(shared_mesh_ensemble_host)
+{
+  shared_mesh_ensemble<dealii::MemorySpace::Host>();
+}
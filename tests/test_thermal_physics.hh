@@ -660,3 +660,87 @@ void reference_temperature()
   for (auto indicator : has_melted)
     BOOST_CHECK(indicator == true);
 }
+
+template <typename MemorySpaceType>
+void shared_mesh_ensemble()
+{
+  MPI_Comm communicator = MPI_COMM_WORLD;
+
+  boost::property_tree::ptree geometry_database;
+  geometry_database.put("import_mesh", false);
+  geometry_database.put("length", 12e-3);
+  geometry_database.put("length_divisions", 4);
+  geometry_database.put("height", 6e-3);
+  geometry_database.put("height_divisions", 5);
+  auto material_property_database = basic_material_properies_database();
+  auto database = basic_input_database();
+
+  // The members have their own initial temperature and beam power.
+  unsigned int const n_members = 2;
+  std::vector<double> const initial_temperature = {0., 10.};
+  std::vector<double> const max_power = {1e300, 2e300};
+  std::vector<boost::property_tree::ptree> source_databases(
+      n_members, database.get_child("sources"));
+  for (unsigned int m = 0; m < n_members; ++m)
+    source_databases[m].put("beam_0.max_power", max_power[m]);
+  unsigned int const n_time_steps = 5;
+  double const time_step = 0.01;
+  std::vector<adamantine::Timer> timers(adamantine::Timing::n_timers);
+
+  // Evolve the members sharing the mesh together.
+  adamantine::Geometry<2> geometry(communicator, geometry_database);
+  adamantine::MaterialProperty<2, 2, adamantine::SolidLiquidPowder,
+                               MemorySpaceType>
+      material_properties(communicator, geometry.get_triangulation(),
+                          material_property_database);
+  adamantine::ThermalPhysics<2, 2, 2, adamantine::SolidLiquidPowder,
+                             MemorySpaceType, dealii::QGauss<1>>
+      physics(communicator, database, geometry, material_properties);
+  physics.setup();
+  physics.set_n_members(n_members);
+  std::vector<dealii::LA::distributed::Vector<double, MemorySpaceType>>
+      solutions(n_members);
+  std::vector<dealii::LA::distributed::Vector<double, MemorySpaceType> *>
+      solution_pointers;
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    physics.select_member(m);
+    physics.update_physics_parameters(source_databases[m]);
+    physics.initialize_dof_vector(initial_temperature[m], solutions[m]);
+    solution_pointers.push_back(&solutions[m]);
+  }
+  double time = 0.;
+  for (unsigned int i = 0; i < n_time_steps; ++i)
+    time = physics.evolve_one_time_step(time, time_step, solution_pointers,
+                                        timers);
+
+  // Each member gives the same result as a simulation of the member alone.
+  for (unsigned int m = 0; m < n_members; ++m)
+  {
+    adamantine::Geometry<2> member_geometry(communicator, geometry_database);
+    adamantine::MaterialProperty<2, 2, adamantine::SolidLiquidPowder,
+                                 MemorySpaceType>
+        member_material_properties(communicator,
+                                   member_geometry.get_triangulation(),
+                                   material_property_database);
+    auto member_database = database;
+    member_database.put_child("sources", source_databases[m]);
+    adamantine::ThermalPhysics<2, 2, 2, adamantine::SolidLiquidPowder,
+                               MemorySpaceType, dealii::QGauss<1>>
+        member_physics(communicator, member_database, member_geometry,
+                       member_material_properties);
+    member_physics.setup();
+    dealii::LA::distributed::Vector<double, MemorySpaceType> solution;
+    member_physics.initialize_dof_vector(initial_temperature[m], solution);
+    double member_time = 0.;
+    for (unsigned int i = 0; i < n_time_steps; ++i)
+      member_time = member_physics.evolve_one_time_step(member_time, time_step,
+                                                        solution, timers);
+
+    BOOST_TEST(member_time == time, tt::tolerance(1e-12));
+    BOOST_TEST(solution.l2_norm() == solutions[m].l2_norm(),
+               tt::tolerance(1e-12));
+    solution -= solutions[m];
+    BOOST_TEST(solution.linfty_norm() <= 1e-12 * solutions[m].linfty_norm());
+  }
+}